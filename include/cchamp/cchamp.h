@@ -16,6 +16,7 @@
 #ifndef CCHAMP_H
 #define CCHAMP_H
 #include <inttypes.h>
+#include <stddef.h>
 
 
 /*
@@ -28,16 +29,84 @@ int     cchamp_init();
 void    cchamp_close();
 
 
+/*
+ * Memory held by the library.
+ *
+ * cchamp_init() only reserves the address space of the response buffer: each block of it is committed when a
+ * response is first received into it, and given back to the OS once it has been free for CCHAMP_CONFIG_CHANNEL_IDLE
+ * ms (the OS may then keep the pages until it runs short of memory). Static categories are only mapped when they
+ * are loaded. Buffers backed by huge pages (CCHAMP_MAP_HUGEPAGES) are committed in full.
+ *
+ * Idle blocks are looked for as responses are received; call cchamp_trim() to give back every free block at once,
+ * i.e. when the process is told about memory pressure or is about to stay idle. With CCHAMP_CONFIG_CHANNEL_IDLE
+ * at 0, blocks are only given back by cchamp_trim().
+ *
+ * Only the response buffers are trimmed, by cchamp_trim() and on idle alike. Static categories hold no free
+ * pages to give back: a loaded table is shrunk to the pages it uses when it is published, the pages it replaces
+ * are unmapped once no reader can see them, and the table a load builds is unmapped if the load fails.
+ *
+ * cchamp_stats() reports the memory (in bytes) reserved and committed by the response buffers (including those
+ * of the region workers) and by the static categories. Static data mapped from a snapshot is file-backed, and
+ * only counts as reserved.
+ */
+struct cchamp_stats {
+    size_t  channel_reserved;
+    size_t  channel_committed;
+    size_t  static_reserved;
+    size_t  static_committed;
+
+    size_t  reserved;
+    size_t  committed;
+};
+
+typedef struct cchamp_stats CChampStats;
+
+void    cchamp_stats(CChampStats* stats);
+void    cchamp_trim();
+
+
 /*
  * Provide cchamp with the necessary authentication token and maybe also limit the rate of access.
  *
  * By default, the number of API calls for 1 second / 100 seconds is the maximum allowed calls.
  * It should be 20 and 100 calls, respectively.
+ *
+ * More keys (up to 8) may be registered with cchamp_add_api_key(): calls are then spread over the keys, each
+ * within the limits above, and a key rejected by the server is left out from then on.
  */
 void    cchamp_set_api_key(char* key);
+int     cchamp_add_api_key(char* key);
 void    cchamp_set_max_requests(uint16_t per_second, uint16_t per_two_minutes);
 
 
+/*
+ * Requests go to https://<platform>.api.riotgames.com by default. cchamp_set_base_url() sends them elsewhere,
+ * i.e. to a local mock server (see mock/): the URL may hold a single "%s", which is replaced by the platform of
+ * the region (i.e. "http://127.0.0.1:8080/%s" for http://127.0.0.1:8080/na1/lol/...). NULL restores the default.
+ *
+ * Set it before any request is sent. It returns 1 (and changes nothing) if the URL is longer than
+ * CCHAMP_BASE_URL_MAX or holds a '%' other than the "%s".
+ */
+#define CCHAMP_BASE_URL_MAX 128
+
+int     cchamp_set_base_url(char* url);
+
+
+/*
+ * Region workers: one thread per region (pass REGION_* constants or'ed together), each running an event loop
+ * over its own connections, its own channel blocks and the rate limit of its region. Once started, the calls
+ * for these regions (from any thread) are handed to the worker of their region through a lock-free queue and
+ * wait for it, so that a slow or rate-limited region never holds back calls for another one; calls for the
+ * other regions are sent from the calling thread, as usual.
+ *
+ * cchamp_workers_start() returns 1 if a worker could not be started (workers already running are kept).
+ * cchamp_workers_stop() lets the workers finish the calls handed to them before it returns; it is invoked by
+ * cchamp_close().
+ */
+int     cchamp_workers_start(uint16_t regions);
+void    cchamp_workers_stop();
+
+
 /*
  * The current API version.
  * You *must* update this once the version changes.
@@ -93,12 +162,21 @@ void    cchamp_set_max_requests(uint16_t per_second, uint16_t per_two_minutes);
 // Error: Unknown error has been reached.
 #define EUNKNOWN    6
 
+// Error: The region is failing for this API (i.e. an outage); the request was not sent (see CCHAMP_CONFIG_BREAKER_*).
+#define ECIRCUIT    7
+
+// Error: An argument of the request is invalid (i.e. an unknown SUMMONER_KEY_* constant, or a summoner name too long
+// once escaped for the url); it was not sent.
+#define EARGUMENT   8
+
 
 
 /*
  * Errors are reported and stored in cc_error.
+ * Each thread has its own cc_error, so errors met by background work (i.e. the static data refresher) are never
+ * reported to the caller.
  */
-extern uint16_t cc_error;
+extern __thread uint16_t cc_error;
 
 
 /*
@@ -107,6 +185,21 @@ extern uint16_t cc_error;
  */
 #define CCHAMP_STATIC_MULTITHREADING 0x0001
 
+/*
+ * Mapping policies for the memory of the library (the response buffer and static data). They are all off by
+ * default and apply to memory mapped after they are set, so set them before cchamp_init().
+ *
+ * CCHAMP_MAP_POPULATE      Faults memory in as soon as it is committed (a response block when it is first used, or
+ *                          static data when it is loaded) instead of on first touch.
+ * CCHAMP_MAP_HUGEPAGES     Backs the response buffer with reserved huge pages (MAP_HUGETLB) when available, and
+ *                          requests transparent huge pages for large static data.
+ * CCHAMP_MAP_NUMA_LOCAL    Prefers the NUMA node of the thread committing the memory (the first to receive a
+ *                          response into a block, or cchamp_static_load()).
+ */
+#define CCHAMP_MAP_POPULATE         0x0002
+#define CCHAMP_MAP_HUGEPAGES        0x0004
+#define CCHAMP_MAP_NUMA_LOCAL       0x0008
+
 
 /*
  * Update a cchamp configuration.
@@ -118,6 +211,68 @@ void cchamp_config_set(uint16_t config, char value);
  */
 char cchamp_config_get(uint16_t config);
 
+
+/*
+ * Tunables of the library, with their defaults and bounds. Like the mapping policies, sizes apply to memory
+ * allocated after they are set (i.e. set the channel blocks before cchamp_init()), and the others to work
+ * started after they are set (i.e. a dispatcher reads its slots, retries and timeouts when it is created).
+ *
+ * CCHAMP_CONFIG_CHANNEL_BLOCKS         Responses received at once, per set of channel blocks.     8   [1, 64]
+ * CCHAMP_CONFIG_CHANNEL_BLOCK_SIZE     The largest response, in bytes.                    262144   [4096, 64MB]
+ * CCHAMP_CONFIG_DISPATCH_SLOTS         Requests in flight per dispatcher (no more than the blocks). 8   [1, 64]
+ * CCHAMP_CONFIG_DISPATCH_RETRIES       Retries of a failed request.                                3   [0, 16]
+ * CCHAMP_CONFIG_DISPATCH_BACKOFF       The delay before the first retry, in ms (then doubled).   500   [0, 60000]
+ * CCHAMP_CONFIG_TIMEOUT                The longest a request may take, in ms (0 for no limit).     0   [0, 600000]
+ * CCHAMP_CONFIG_CONNECT_TIMEOUT        The longest a connection may take, in ms (0 for curl's).    0   [0, 600000]
+ * CCHAMP_CONFIG_RATE_HEADROOM          The share of the rate limits left unused, in percent.       0   [0, 90]
+ * CCHAMP_CONFIG_SUMMONER_SLAB_SIZE     The size of a slab of summoner pools, in bytes.         65536   [4096, 64MB]
+ * CCHAMP_CONFIG_STATIC_PAGES           Pages a static category is first loaded into.               1   [1, 65536]
+ * CCHAMP_CONFIG_CRAWLER_QUEUE_MAX      Nodes a crawler queues per region and kind.           4194304   [1024, 2^30]
+ * CCHAMP_CONFIG_EXPORT_GROUP_ROWS      Rows of a group of a columnar export.                   65536   [1, 2^24]
+ * CCHAMP_CONFIG_HEDGE_BUDGET           Hedged requests, in percent of the requests sent (0: none). 0   [0, 50]
+ * CCHAMP_CONFIG_HEDGE_PERCENTILE       The latency percentile after which a request is hedged.    95   [50, 99]
+ * CCHAMP_CONFIG_HEDGE_DELAY_MIN        The shortest time before a request is hedged, in ms.       50   [0, 60000]
+ * CCHAMP_CONFIG_BREAKER_ERRORS         Failed requests that open a circuit, in percent (0: never). 50  [0, 100]
+ * CCHAMP_CONFIG_BREAKER_SLOW           Requests slower than this count as failed, in ms (0: none). 0   [0, 600000]
+ * CCHAMP_CONFIG_BREAKER_WINDOW         The period failures are counted over, in ms.            10000   [1000, 600000]
+ * CCHAMP_CONFIG_BREAKER_COOLDOWN       The time a circuit stays open before it is probed, in ms. 5000  [100, 600000]
+ * CCHAMP_CONFIG_BREAKER_PROBES         Successful probes that close a circuit again.               3   [1, 64]
+ * CCHAMP_CONFIG_CHANNEL_IDLE           The time a free channel block keeps its memory, in ms.  30000   [0, 3600000]
+ *
+ * cchamp_config_set_int() returns 1 (and changes nothing) if the key is unknown or the value out of bounds.
+ *
+ * The tunables may also be read from the environment, as CCHAMP_<NAME> (i.e. CCHAMP_CHANNEL_BLOCKS=16), or
+ * from a file of "name = value" lines (i.e. channel_blocks = 16), where '#' starts a comment. Both loaders
+ * apply every valid entry and return 1 if any entry was invalid (or the file could not be read). The base URL of
+ * the requests (see cchamp_set_base_url()) is loaded the same way, as CCHAMP_BASE_URL or base_url.
+ */
+#define CCHAMP_CONFIG_CHANNEL_BLOCKS        0
+#define CCHAMP_CONFIG_CHANNEL_BLOCK_SIZE    1
+#define CCHAMP_CONFIG_DISPATCH_SLOTS        2
+#define CCHAMP_CONFIG_DISPATCH_RETRIES      3
+#define CCHAMP_CONFIG_DISPATCH_BACKOFF      4
+#define CCHAMP_CONFIG_TIMEOUT               5
+#define CCHAMP_CONFIG_CONNECT_TIMEOUT       6
+#define CCHAMP_CONFIG_RATE_HEADROOM         7
+#define CCHAMP_CONFIG_SUMMONER_SLAB_SIZE    8
+#define CCHAMP_CONFIG_STATIC_PAGES          9
+#define CCHAMP_CONFIG_CRAWLER_QUEUE_MAX     10
+#define CCHAMP_CONFIG_EXPORT_GROUP_ROWS     11
+#define CCHAMP_CONFIG_HEDGE_BUDGET          12
+#define CCHAMP_CONFIG_HEDGE_PERCENTILE      13
+#define CCHAMP_CONFIG_HEDGE_DELAY_MIN       14
+#define CCHAMP_CONFIG_BREAKER_ERRORS        15
+#define CCHAMP_CONFIG_BREAKER_SLOW          16
+#define CCHAMP_CONFIG_BREAKER_WINDOW        17
+#define CCHAMP_CONFIG_BREAKER_COOLDOWN      18
+#define CCHAMP_CONFIG_BREAKER_PROBES        19
+#define CCHAMP_CONFIG_CHANNEL_IDLE          20
+
+int     cchamp_config_set_int(int key, int64_t value);
+int64_t cchamp_config_get_int(int key);
+int     cchamp_config_load_env();
+int     cchamp_config_load_file(char* path);
+
 /*
  * Summoner struct defining all the relevant information on a player.
  * All of the fields are populated through usage of the Summoner API.
@@ -152,6 +307,528 @@ Summoner* get_summoner_by_sid(uint16_t region, char* summoner_id);
 Summoner* get_summoner_by_aid(uint16_t region, char* account_id);
 Summoner* get_summoner_by_name(uint16_t region, char* summoner_name);
 
+/*
+ * The methods above return a summoner that you must free(). The following ones fill the struct you provide
+ * instead, and return it; or NULL on failure, leaving its content unspecified.
+ */
+Summoner* get_summoner_by_sid_into(uint16_t region, char* summoner_id, Summoner* summoner);
+Summoner* get_summoner_by_aid_into(uint16_t region, char* account_id, Summoner* summoner);
+Summoner* get_summoner_by_name_into(uint16_t region, char* summoner_name, Summoner* summoner);
+
+
+
+/*
+ * Every summoner retrieved is recorded in an identity index (one per region), under its summoner id, account
+ * id and name alike. Names are matched regardless of case and spaces.
+ *
+ * cchamp_summoner_index_find() looks a summoner up in the index only, without any request. Once a time to live
+ * is set, the get_summoner_* methods also serve summoners recorded within that many seconds from the index,
+ * whichever key they were retrieved by. The time to live is 0 (never served) by default.
+ */
+#define SUMMONER_KEY_SID    0
+#define SUMMONER_KEY_AID    1
+#define SUMMONER_KEY_NAME   2
+
+Summoner*   cchamp_summoner_index_find(uint16_t region, int key, char* value, Summoner* summoner);
+void        cchamp_summoner_index_ttl(unsigned int seconds);
+void        cchamp_summoner_index_clear(uint16_t regions);
+
+/*
+ * Writes the canonical form of a summoner name (whitespace removed, lowercased), which is equal for all names
+ * that Riot considers the same. Use it to key caches by summoner name. Returns the length of the canonical
+ * name, or -1 if it does not fit in size bytes.
+ */
+int         cchamp_canonical_name(char* dest, size_t size, const char* name);
+
+/*
+ * Summoner pools hold large numbers of summoners without a heap allocation per summoner. Summoners are
+ * allocated back to back from large slabs, and are all released at once:
+ *
+ *      Summoner* summoner = get_summoner_by_name_into(REGION_NA, name, cchamp_summoner_pool_alloc(pool));
+ *      if (summoner == NULL) {
+ *          cchamp_summoner_pool_pop(pool);
+ *      }
+ *
+ * A summoner keeps its address until its pool is released or destroyed. A pool must not be used from more
+ * than one thread at a time.
+ */
+typedef struct summoner_pool SummonerPool;
+
+SummonerPool*   cchamp_summoner_pool_create();
+Summoner*       cchamp_summoner_pool_alloc(SummonerPool* pool);
+void            cchamp_summoner_pool_pop(SummonerPool* pool);
+size_t          cchamp_summoner_pool_count(SummonerPool* pool);
+Summoner*       cchamp_summoner_pool_next(SummonerPool* pool, Summoner* summoner);
+void            cchamp_summoner_pool_release(SummonerPool* pool);
+void            cchamp_summoner_pool_destroy(SummonerPool* pool);
+
+
+/*
+ * A match, as listed in the match list of a player.
+ */
+#define MATCHLIST_PAGE_SIZE     100
+
+struct match_reference {
+    uint64_t    game_id;
+    uint64_t    timestamp;
+    uint32_t    champion;
+    uint16_t    queue;
+    uint16_t    season;
+
+    // i.e. "BOTTOM" and "DUO_SUPPORT".
+    char        lane[8];
+    char        role[12];
+};
+
+/*
+ * A page of the match list of a player, most recent matches first.
+ */
+struct match_list {
+    uint32_t                total_games;
+    uint32_t                start_index;
+    uint32_t                end_index;
+    uint32_t                count;
+    struct match_reference  matches[MATCHLIST_PAGE_SIZE];
+};
+
+/*
+ * The details of a match, and of every player that took part in it.
+ */
+#define MATCH_PARTICIPANTS_MAX  10
+#define MATCH_ITEMS             7
+
+struct match_participant {
+    uint32_t    account_id;
+    uint32_t    summoner_id;
+    char        summoner_name[SUMMONER_NAME_MAX_LENGTH + 1];
+
+    uint32_t    champion;
+    uint16_t    team;
+    uint8_t     win;
+    uint8_t     spells[2];
+
+    uint16_t    kills;
+    uint16_t    deaths;
+    uint16_t    assists;
+    uint16_t    minions;
+    uint32_t    gold_earned;
+    uint32_t    items[MATCH_ITEMS];
+};
+
+struct match {
+    uint64_t                    game_id;
+    uint64_t                    creation;
+    uint32_t                    duration;
+    uint16_t                    queue;
+    uint16_t                    map;
+    uint16_t                    season;
+    char                        version[16];
+
+    uint8_t                     participants_count;
+    struct match_participant    participants[MATCH_PARTICIPANTS_MAX];
+};
+
+typedef struct match_reference MatchReference;
+typedef struct match_list MatchList;
+typedef struct match_participant MatchParticipant;
+typedef struct match Match;
+
+typedef void (*match_callback)(Match* match, void* data);
+
+
+/*
+ * API - Match (/lol/match)
+ * Rate Limit Applicable: YES
+ * ---
+ *
+ * The following methods retrieve the match list of a player, one page at a time, and the details of a
+ * match. They fill the struct you provide and return it; or NULL on failure.
+ *
+ * cchamp_match_history() fetches up to (limit) of the most recent matches of a player at the full rate the
+ * limits of the region allow, and hands each one to the callback as it arrives. It returns the number of
+ * matches handed over, or -1 if the match list could not be fetched. If the list is cut short by an error, the
+ * matches listed before it are still handed over and cc_error is set.
+ */
+MatchList*  get_matchlist_by_aid(uint16_t region, char* account_id, uint32_t begin_index, MatchList* list);
+Match*      get_match(uint16_t region, uint64_t match_id, Match* match);
+int         cchamp_match_history(uint16_t region, char* account_id, uint32_t limit, match_callback callback, void* data);
+
+
+/*
+ * Event loop integration: requests run within an event loop of your own (i.e. epoll), from the thread driving
+ * it, without the library ever blocking or starting a thread.
+ *
+ * The library tells which sockets it needs watched through the watch callback: (events) is CCHAMP_POLL_IN
+ * and/or CCHAMP_POLL_OUT, or 0 to stop watching (fd). It tells when it needs to be called back through the
+ * timer callback: in (timeout) milliseconds (0 for right away), replacing any timer set before, or never if
+ * (timeout) is -1. When a socket is ready, invoke cchamp_loop_socket() with its readiness; when the timer
+ * expires, invoke cchamp_loop_timeout(). Both return the number of calls left in progress.
+ *
+ * Calls complete through their callback, from within cchamp_loop_socket() or cchamp_loop_timeout(): the
+ * result is only valid for the duration of the callback, and is NULL on failure (cc_error then holds the
+ * reason). A summoner recorded in the identity index is handed over before cchamp_loop_summoner() returns.
+ * The number of calls in progress is bounded by CCHAMP_CONFIG_DISPATCH_SLOTS; the call functions return 1
+ * (with cc_error set to E2MANY) beyond it, and 0 once the call is under way. cchamp_loop_summoner() also
+ * returns 1 (with cc_error set to EARGUMENT) for a key that is not a SUMMONER_KEY_* constant.
+ *
+ * A loop uses connections of its own, and must only be used from one thread at a time.
+ */
+#define CCHAMP_POLL_IN      0x01
+#define CCHAMP_POLL_OUT     0x02
+#define CCHAMP_POLL_ERROR   0x04
+
+typedef struct cchamp_loop CChampLoop;
+typedef void (*loop_watch_callback)(int fd, int events, void* data);
+typedef void (*loop_timer_callback)(long timeout, void* data);
+typedef void (*summoner_callback)(Summoner* summoner, void* data);
+
+CChampLoop* cchamp_loop_create(loop_watch_callback watch, loop_timer_callback timer, void* data);
+int         cchamp_loop_socket(CChampLoop* loop, int fd, int events);
+int         cchamp_loop_timeout(CChampLoop* loop);
+int         cchamp_loop_summoner(CChampLoop* loop, uint16_t region, int key, char* value, summoner_callback callback, void* data);
+int         cchamp_loop_match(CChampLoop* loop, uint16_t region, uint64_t match_id, match_callback callback, void* data);
+void        cchamp_loop_free(CChampLoop* loop);
+
+
+/*
+ * The ranked queues, as named by the league API.
+ */
+#define QUEUE_RANKED_SOLO       "RANKED_SOLO_5x5"
+#define QUEUE_RANKED_FLEX_SR    "RANKED_FLEX_SR"
+#define QUEUE_RANKED_FLEX_TT    "RANKED_FLEX_TT"
+
+/*
+ * Tiers are numbered from the lowest up, so that they may be compared. The rank of an entry is its division
+ * within the tier, from 1 (I) to 5 (V).
+ */
+#define TIER_UNRANKED           0
+#define TIER_BRONZE             1
+#define TIER_SILVER             2
+#define TIER_GOLD               3
+#define TIER_PLATINUM           4
+#define TIER_DIAMOND            5
+#define TIER_MASTER             6
+#define TIER_CHALLENGER         7
+
+#define LEAGUE_VETERAN          0x01
+#define LEAGUE_INACTIVE         0x02
+#define LEAGUE_FRESH_BLOOD      0x04
+#define LEAGUE_HOT_STREAK       0x08
+
+#define LEAGUE_ID_LENGTH        36
+#define LEAGUE_NAME_MAX_LENGTH  32
+#define QUEUE_MAX_LENGTH        24
+
+/*
+ * A player, as ranked in a league.
+ */
+struct league_entry {
+    uint32_t    summoner_id;
+
+    // The index of the league in its ladder (see cchamp_ladder_league()); only set for the entries of a ladder.
+    uint32_t    league;
+    uint16_t    region;
+
+    uint16_t    league_points;
+    uint16_t    wins;
+    uint16_t    losses;
+    uint8_t     tier;
+    uint8_t     rank;
+
+    // LEAGUE_* flags.
+    uint8_t     flags;
+    char        summoner_name[SUMMONER_NAME_MAX_LENGTH + 1];
+};
+
+/*
+ * A league, covering every division of its tier. Its entries are stored contiguously.
+ */
+struct league {
+    char                    id[LEAGUE_ID_LENGTH + 1];
+    char                    name[LEAGUE_NAME_MAX_LENGTH + 1];
+    char                    queue[QUEUE_MAX_LENGTH + 1];
+    uint16_t                region;
+    uint8_t                 tier;
+
+    uint32_t                count;
+    struct league_entry*    entries;
+};
+
+/*
+ * The standing of a player in one of the ranked queues.
+ */
+struct league_position {
+    char                    league_id[LEAGUE_ID_LENGTH + 1];
+    char                    queue[QUEUE_MAX_LENGTH + 1];
+    struct league_entry     entry;
+};
+
+typedef struct league_entry LeagueEntry;
+typedef struct league League;
+typedef struct league_position LeaguePosition;
+
+
+/*
+ * API - League (/lol/league)
+ * Rate Limit Applicable: YES
+ * ---
+ *
+ * The following methods retrieve a whole league, which must be freed (along with its entries) by a single
+ * free() call. NULL is returned on failure.
+ *
+ * get_league_positions_by_sid() fills up to (max) positions of a player, one per ranked queue, and returns
+ * how many were filled; or -1 on failure.
+ */
+League* get_challenger_league(uint16_t region, char* queue);
+League* get_master_league(uint16_t region, char* queue);
+League* get_league_by_id(uint16_t region, char* league_id);
+int     get_league_positions_by_sid(uint16_t region, char* summoner_id, LeaguePosition* positions, int max);
+
+
+/*
+ * A ladder gathers the leagues of a ranked queue across regions, with all their entries in one contiguous
+ * array, and each player only once.
+ *
+ * cchamp_ladder_crawl() fetches the challenger and master leagues of the regions, along with the leagues of
+ * every seeded player (cchamp_ladder_seed()) or league (cchamp_ladder_seed_league()), running requests for
+ * all the regions concurrently within their rate limits. Leagues that were already crawled are not fetched
+ * again (those that failed are), so seeds may be added and crawled in rounds. It returns the number of entries that were added; if
+ * any request failed, cc_error is set to its error.
+ *
+ * Entries are returned in the order their leagues arrived. The entries of a league are contiguous, and
+ * cchamp_ladder_league() points the league at them. Pointers into a ladder only remain valid until the next
+ * crawl.
+ *
+ *      Ladder* ladder = cchamp_ladder_create(QUEUE_RANKED_SOLO);
+ *      cchamp_ladder_crawl(ladder, REGION_NA | REGION_EUW);
+ */
+typedef struct ladder Ladder;
+
+Ladder*         cchamp_ladder_create(char* queue);
+int             cchamp_ladder_seed(Ladder* ladder, uint16_t region, uint32_t summoner_id);
+int             cchamp_ladder_seed_league(Ladder* ladder, uint16_t region, char* league_id);
+int             cchamp_ladder_crawl(Ladder* ladder, uint16_t regions);
+uint32_t        cchamp_ladder_count(Ladder* ladder);
+LeagueEntry*    cchamp_ladder_entries(Ladder* ladder);
+uint32_t        cchamp_ladder_league_count(Ladder* ladder);
+League*         cchamp_ladder_league(Ladder* ladder, uint32_t index, League* league);
+LeagueEntry*    cchamp_ladder_find(Ladder* ladder, uint16_t region, uint32_t summoner_id);
+void            cchamp_ladder_free(Ladder* ladder);
+
+
+/*
+ * The mastery of a player over a champion.
+ */
+struct champion_mastery {
+    uint32_t    summoner_id;
+    uint32_t    champion;
+    uint32_t    points;
+    uint32_t    points_since_last_level;
+    uint32_t    points_until_next_level;
+    uint64_t    last_play_time;
+    uint8_t     level;
+    uint8_t     tokens;
+    uint8_t     chest_granted;
+};
+
+/*
+ * The masteries of many players, one column per field. Row i of every column describes the same mastery, and
+ * the rows of a player are contiguous. Columns are aligned to 64 bytes.
+ */
+struct mastery_columns {
+    uint32_t    count;
+    uint32_t    capacity;
+
+    uint32_t*   summoner_ids;
+    uint32_t*   champions;
+    uint32_t*   points;
+    uint8_t*    levels;
+};
+
+typedef struct champion_mastery ChampionMastery;
+typedef struct mastery_columns MasteryColumns;
+
+
+/*
+ * API - Champion Mastery (/lol/champion-mastery)
+ * Rate Limit Applicable: YES
+ * ---
+ *
+ * get_champion_masteries_by_sid() fills up to (max) masteries of a player, highest points first, and returns
+ * how many were filled; or -1 on failure. get_mastery_score_by_sid() returns the total of the mastery levels of
+ * a player; or -1 on failure.
+ *
+ * cchamp_mastery_bulk() fetches the masteries of many players of a region concurrently, within its rate limit,
+ * and appends them to the columns. It returns the number of players whose masteries were fetched; if any
+ * request failed, cc_error is set to its error.
+ */
+int                 get_champion_masteries_by_sid(uint16_t region, char* summoner_id, ChampionMastery* masteries, int max);
+ChampionMastery*    get_champion_mastery(uint16_t region, char* summoner_id, uint32_t champion, ChampionMastery* mastery);
+int                 get_mastery_score_by_sid(uint16_t region, char* summoner_id);
+
+MasteryColumns*     cchamp_mastery_columns_create();
+int                 cchamp_mastery_bulk(uint16_t region, uint32_t* summoner_ids, uint32_t count, MasteryColumns* columns);
+void                cchamp_mastery_columns_free(MasteryColumns* columns);
+
+
+/*
+ * A game being played, as seen by the spectator API.
+ */
+struct active_participant {
+    uint32_t    summoner_id;
+    char        summoner_name[SUMMONER_NAME_MAX_LENGTH + 1];
+    uint32_t    champion;
+    uint16_t    team;
+    uint8_t     spells[2];
+    uint8_t     bot;
+};
+
+struct active_game {
+    uint64_t                    game_id;
+    uint64_t                    start_time;
+    uint32_t                    length;
+    uint16_t                    queue;
+    uint16_t                    map;
+    char                        mode[16];
+
+    uint8_t                     participants_count;
+    struct active_participant   participants[MATCH_PARTICIPANTS_MAX];
+};
+
+typedef struct active_participant ActiveParticipant;
+typedef struct active_game ActiveGame;
+
+
+/*
+ * API - Spectator (/lol/spectator)
+ * Rate Limit Applicable: YES
+ * ---
+ *
+ * get_active_game_by_sid() fills the game a player is currently in and returns it; or NULL on failure, with
+ * cc_error set to ENOTFOUND if the player is not in a game.
+ */
+ActiveGame* get_active_game_by_sid(uint16_t region, char* summoner_id, ActiveGame* game);
+
+
+/*
+ * A spectator watches the games of many tracked players, reporting when a game starts, ends or changes.
+ *
+ * cchamp_spectator_run() polls the tracked players in turn, every player about once per (interval)
+ * milliseconds, spacing the polls of each region evenly. When a region tracks more players than its rate
+ * limit allows to poll within the interval, the polls are spread over the rate limit instead. It runs for
+ * (duration) milliseconds, or until cchamp_spectator_stop() when 0.
+ *
+ * Responses identical to the previous poll of a player are recognized by their hash and never parsed, so
+ * events only cost the polls that changed. The game of a SPECTATOR_GAME_ENDED event is NULL.
+ */
+#define SPECTATOR_GAME_STARTED  1
+#define SPECTATOR_GAME_ENDED    2
+#define SPECTATOR_GAME_CHANGED  3
+
+struct spectator_event {
+    int             type;
+    uint16_t        region;
+    uint32_t        summoner_id;
+    uint64_t        game_id;
+    ActiveGame*     game;
+};
+
+typedef struct spectator_event SpectatorEvent;
+typedef struct spectator Spectator;
+typedef void (*spectator_callback)(SpectatorEvent* event, void* data);
+
+Spectator*  cchamp_spectator_create(spectator_callback callback, void* data);
+int         cchamp_spectator_track(Spectator* spectator, uint16_t region, uint32_t summoner_id);
+int         cchamp_spectator_untrack(Spectator* spectator, uint16_t region, uint32_t summoner_id);
+int         cchamp_spectator_run(Spectator* spectator, unsigned int interval, unsigned int duration);
+void        cchamp_spectator_stop(Spectator* spectator);
+void        cchamp_spectator_free(Spectator* spectator);
+
+
+/*
+ * A crawler walks the graph of players and matches: the match list of every player leads to matches, and the
+ * participants of every match lead to more players. Every match is handed to the callback as it arrives.
+ *
+ * Players and matches are crawled once: visited ones are remembered in a Bloom filter sized for (capacity)
+ * players and matches at a 1% false positive rate, beyond which more of them are wrongly skipped. Only the
+ * (matches_per_player) most recent matches of a player are followed.
+ *
+ * cchamp_crawler_run() keeps the rate limit of every region with players or matches to crawl saturated, and
+ * runs for (duration) milliseconds, until the graph is exhausted, or until cchamp_crawler_stop() when 0. It
+ * returns the number of matches handed to the callback.
+ *
+ * The frontier and the visited filter may be saved with cchamp_crawler_checkpoint(), between runs or from the
+ * callback, and a crawl resumed with cchamp_crawler_restore(). Both return 0 or the crawler on success.
+ */
+typedef struct crawler Crawler;
+typedef void (*crawler_callback)(uint16_t region, Match* match, void* data);
+
+Crawler*    cchamp_crawler_create(uint32_t capacity, uint32_t matches_per_player, crawler_callback callback, void* data);
+int         cchamp_crawler_seed(Crawler* crawler, uint16_t region, uint32_t account_id);
+int         cchamp_crawler_run(Crawler* crawler, unsigned int duration);
+void        cchamp_crawler_stop(Crawler* crawler);
+int         cchamp_crawler_checkpoint(Crawler* crawler, char* path);
+Crawler*    cchamp_crawler_restore(char* path, crawler_callback callback, void* data);
+void        cchamp_crawler_free(Crawler* crawler);
+
+
+/*
+ * Tables of a columnar export, and the columns of each one. Pass EXPORT_ALL for all columns of a table.
+ * EXPORT_PARTICIPANTS has a row per participant of a match, and EXPORT_MATCHES a row per match.
+ */
+#define EXPORT_MATCHES                  0
+#define EXPORT_PARTICIPANTS             1
+#define EXPORT_SUMMONERS                2
+
+#define EXPORT_MATCH_ID                 0x0001
+#define EXPORT_MATCH_CREATION           0x0002
+#define EXPORT_MATCH_DURATION           0x0004
+#define EXPORT_MATCH_QUEUE              0x0008
+#define EXPORT_MATCH_MAP                0x0010
+#define EXPORT_MATCH_SEASON             0x0020
+#define EXPORT_MATCH_VERSION            0x0040
+
+#define EXPORT_PARTICIPANT_MATCH_ID     0x0001
+#define EXPORT_PARTICIPANT_ACCOUNT_ID   0x0002
+#define EXPORT_PARTICIPANT_SUMMONER_ID  0x0004
+#define EXPORT_PARTICIPANT_NAME         0x0008
+#define EXPORT_PARTICIPANT_CHAMPION     0x0010
+#define EXPORT_PARTICIPANT_TEAM         0x0020
+#define EXPORT_PARTICIPANT_WIN          0x0040
+#define EXPORT_PARTICIPANT_KILLS        0x0080
+#define EXPORT_PARTICIPANT_DEATHS       0x0100
+#define EXPORT_PARTICIPANT_ASSISTS      0x0200
+#define EXPORT_PARTICIPANT_MINIONS      0x0400
+#define EXPORT_PARTICIPANT_GOLD         0x0800
+
+#define EXPORT_SUMMONER_ID              0x0001
+#define EXPORT_SUMMONER_ACCOUNT_ID      0x0002
+#define EXPORT_SUMMONER_NAME            0x0004
+#define EXPORT_SUMMONER_REGION          0x0008
+#define EXPORT_SUMMONER_LEVEL           0x0010
+#define EXPORT_SUMMONER_ICON            0x0020
+
+#define EXPORT_ALL                      0xFFFFFFFF
+
+/*
+ * An exporter appends the selected columns of one table to a columnar file, as the data is fetched: pass
+ * cchamp_export_match() as the callback of cchamp_match_history() (with the exporter as its data), or invoke
+ * it from a crawler callback. Strings are dictionary encoded, ids and times delta encoded, and rows are written
+ * out in groups of 65536, so that the file is only ever appended to and stays readable while it grows (see
+ * src/features/export.c for the layout).
+ *
+ * cchamp_export_open() appends to the file if it exists with the same table and columns; it returns NULL if the
+ * file could not be opened or holds another table. cchamp_export_flush() writes out the rows of the current
+ * group right away. cchamp_export_close() flushes and frees the exporter; both return 1 if any write failed.
+ */
+typedef struct exporter Exporter;
+
+Exporter*   cchamp_export_open(char* path, int table, uint32_t columns);
+void        cchamp_export_match(Match* match, void* exporter);
+void        cchamp_export_summoner(Summoner* summoner, void* exporter);
+int         cchamp_export_flush(Exporter* exporter);
+int         cchamp_export_close(Exporter* exporter);
+
 
 /*
  * Defines all kinds of data retrievable by the static-data API.
@@ -190,10 +867,155 @@ void cchamp_static_load(uint16_t data);
 /*
  * Invalidates the specified static data categories.
  * Any operations on the targeted categories futher on will require a fresh read from the server.
+ * The current data keeps being served until the fresh read completes.
  *
  * Keep in mind before invalidating data that Riot limits method calls to static data to 10 calls an hour.
  * Use wisely.
  */
 void cchamp_static_invalidate(uint16_t data);
 
+
+/*
+ * Keeps loaded static data current in the background, i.e. through a new game version.
+ *
+ * Every interval seconds, STATIC_VERSIONS is polled with a conditional request. Only once a new game version
+ * appears are the categories whose data changed (as reported by STATIC_REALMS) fetched again, each with a
+ * conditional request, and published without stalling readers. Mind the static data call limits when picking
+ * the interval: a poll costs one call, and a new game version costs one call per changed category.
+ *
+ * Pass 0 to stop the refresher, which is the default. Returns 1 if the refresher could not be started.
+ */
+int cchamp_static_refresh(unsigned int interval);
+
+/*
+ * Static data may be reloaded at any time, even from another thread. A reload never blocks readers: the new
+ * data is built aside and published atomically, and the previous data is released only once no reader can
+ * still be using it.
+ *
+ * Anything read from static data (i.e. names) is guaranteed to stay valid between cchamp_static_read_lock()
+ * and the matching cchamp_static_read_unlock(). Keep these sections short, as they delay the release of
+ * replaced data. They may be nested.
+ */
+int     cchamp_static_read_lock();
+void    cchamp_static_read_unlock(int lock);
+
+
+/*
+ * Views over loaded static data, filled by the lookup functions below.
+ * Strings point into static data and follow the cchamp_static_read_lock() rules.
+ */
+struct champion {
+    uint32_t    id;
+    const char* key;
+    const char* name;
+    const char* title;
+};
+
+struct item {
+    uint32_t    id;
+    const char* name;
+    const char* plaintext;
+
+    uint16_t    gold_base;
+    uint16_t    gold_total;
+    uint16_t    gold_sell;
+
+    // Bit N is set if the item is available on the map of id N (i.e. 11 for Summoner's Rift).
+    uint32_t    maps;
+
+    const void* __table;
+    uint32_t    __row;
+};
+
+struct summoner_spell {
+    uint32_t    id;
+    const char* key;
+    const char* name;
+    const char* description;
+    uint16_t    summoner_level;
+};
+
+typedef struct champion Champion;
+typedef struct item Item;
+typedef struct summoner_spell SummonerSpell;
+
+
+/*
+ * Constant time lookups into loaded static data (STATIC_CHAMPIONS, STATIC_ITEMS, STATIC_SUMMONER_SPELLS).
+ *
+ * The provided struct is filled and returned on success. NULL is returned and cc_error is set to ENOTFOUND if
+ * the key is unknown or the category has not been loaded.
+ */
+Champion*       cchamp_champion_by_id(uint32_t id, Champion* champion);
+Champion*       cchamp_champion_by_key(char* key, Champion* champion);
+Item*           cchamp_item_by_id(uint32_t id, Item* item);
+SummonerSpell*  cchamp_spell_by_id(uint32_t id, SummonerSpell* spell);
+
+/*
+ * The value of a stat (i.e. "FlatHPPoolMod") of an item acquired through a lookup. 0 if the item lacks the stat.
+ */
+float           cchamp_item_stat(Item* item, char* stat);
+
+
+/*
+ * Filtered queries over loaded static data (STATIC_ITEMS, STATIC_CHAMPIONS).
+ *
+ * A query starts out matching every record and is narrowed (or widened) by filters, each combined into the
+ * current matches with one of the QUERY_* operations. For instance, all boots on Summoner's Rift under 1000
+ * gold:
+ *
+ *      StaticQuery* query = cchamp_query_create(STATIC_ITEMS);
+ *      cchamp_query_tag(query, QUERY_AND, "Boots");
+ *      cchamp_query_map(query, QUERY_AND, 11);
+ *      cchamp_query_range(query, QUERY_AND, QUERY_GOLD_TOTAL, 0, 999);
+ *
+ *      for (int row = cchamp_query_next(query, -1); row != -1; row = cchamp_query_next(query, row)) {
+ *          cchamp_query_item(query, row, &item);
+ *      }
+ *      cchamp_query_free(query);
+ *
+ * Champion roles (i.e. "Mage") are tags. A query refers to the data it was created from and follows the
+ * cchamp_static_read_lock() rules.
+ */
+#define QUERY_AND               0
+#define QUERY_OR                1
+#define QUERY_AND_NOT           2
+
+#define QUERY_ID                0
+#define QUERY_GOLD_BASE         1
+#define QUERY_GOLD_TOTAL        2
+#define QUERY_GOLD_SELL         3
+
+typedef struct static_query StaticQuery;
+
+StaticQuery*    cchamp_query_create(uint16_t category);
+void            cchamp_query_tag(StaticQuery* query, char op, char* tag);
+void            cchamp_query_map(StaticQuery* query, char op, uint8_t map);
+void            cchamp_query_range(StaticQuery* query, char op, int field, uint32_t min, uint32_t max);
+void            cchamp_query_stat(StaticQuery* query, char op, char* stat, float min, float max);
+uint32_t        cchamp_query_count(StaticQuery* query);
+int             cchamp_query_next(StaticQuery* query, int row);
+Champion*       cchamp_query_champion(StaticQuery* query, int row, Champion* champion);
+Item*           cchamp_query_item(StaticQuery* query, int row, Item* item);
+void            cchamp_query_free(StaticQuery* query);
+
+/*
+ * Reports the memory (in bytes) held by the specified static data categories.
+ *
+ * Categories are sized from the data they hold; a category that was never loaded holds none.
+ */
+size_t cchamp_static_size(uint16_t data);
+
+
+/*
+ * Shares loaded static data between processes through a snapshot file.
+ *
+ * Once a path is configured, cchamp_static_load() maps categories straight from the snapshot (read-only and
+ * without any parsing or network access) and writes any category it had to fetch back to it. A snapshot is
+ * keyed by the latest game version: once STATIC_VERSIONS is loaded, snapshots of other versions are ignored.
+ *
+ * Pass NULL to disable snapshots, which is the default.
+ */
+void cchamp_static_snapshot(char* path);
+
 #endif
@@ -0,0 +1,812 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A mock of the Riot API, to load-test the library on localhost without spending the quota of a real key.
+ *
+ * Requests are served from fixture files: /lol/summoner/v3/summoners/by-name/Foo is answered with the first of
+ * summoner/v3/summoners/by-name/Foo.json, summoner/v3/summoners/by-name.json, summoner/v3/summoners.json, ...
+ * found in the fixtures directory. In a fixture, {{id}} stands for the last segment of the path (i.e. "Foo")
+ * and {{rand}} for a random number, so that a single fixture serves every id.
+ *
+ * The platform of a request is taken from the first segment of its path (i.e. /na1/lol/..., as requested by the
+ * library with cchamp_set_base_url("http://127.0.0.1:8080/%s")), or from its Host header otherwise.
+ *
+ * Like the real servers, the mock:
+ *  - rejects requests without an X-Riot-Token (401) or with a malformed one (403).
+ *  - counts requests per key and platform (and per key, platform and endpoint for the method limits) in fixed
+ *    windows, reports them in X-App-Rate-Limit(-Count) and X-Method-Rate-Limit(-Count) and answers 429 with a
+ *    Retry-After once a limit is reached. Static data only counts against the method limits.
+ *  - sends an ETag with every response and answers 304 to a matching If-None-Match.
+ *
+ * Latencies are drawn from a configurable distribution, and a share of the requests fails with a 5xx error.
+ * Runs are reproducible for a given seed, as far as the order of the requests is.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define REQUEST_MAX     8192
+#define PATH_MAX_SIZE   1024
+#define LIMITS_MAX      4
+#define BUCKETS         1024
+
+#define LATENCY_FIXED       0
+#define LATENCY_UNIFORM     1
+#define LATENCY_LOGNORMAL   2
+
+/*
+ * A rate limit: count requests every seconds.
+ */
+struct limit {
+    int count;
+    int seconds;
+};
+
+/*
+ * The windows of the limits of a key, platform (and endpoint) combination.
+ */
+struct bucket {
+    char            key[256];
+    uint64_t        start[LIMITS_MAX];
+    int             count[LIMITS_MAX];
+    struct bucket*  next;
+};
+
+static struct {
+    int             port;
+    char*           fixtures;
+    struct limit    app[LIMITS_MAX];
+    int             app_count;
+    struct limit    method[LIMITS_MAX];
+    int             method_count;
+    int             latency;
+    double          latency_a;
+    double          latency_b;
+    double          errors;
+    uint64_t        seed;
+    int             verbose;
+} options = {
+    .port = 8080,
+    .fixtures = "fixtures",
+    .app = { { 20, 1 }, { 100, 120 } },
+    .app_count = 2,
+    .latency = LATENCY_FIXED
+};
+
+static struct bucket* buckets[BUCKETS];
+static pthread_mutex_t buckets_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Responses sent, by class: 2xx, 304, 429, other 4xx and 5xx.
+static long served[5];
+static uint64_t connections;
+static volatile sig_atomic_t stopping;
+
+
+/**
+ * Milliseconds on the monotonic clock.
+ */
+static uint64_t __mock_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/**
+ * The next number of a xorshift64* generator.
+ */
+static uint64_t __mock_random(uint64_t* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+
+/**
+ * A number drawn uniformly from [0, 1).
+ */
+static double __mock_uniform(uint64_t* state)
+{
+    return (__mock_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/**
+ * Draws the latency of a response, in ms, from the configured distribution.
+ */
+static double __mock_latency(uint64_t* state)
+{
+    switch (options.latency) {
+        case LATENCY_UNIFORM:
+            return options.latency_a + (options.latency_b - options.latency_a) * __mock_uniform(state);
+
+        case LATENCY_LOGNORMAL: {
+            // Box-Muller; latency_a is the median and latency_b the sigma of the underlying normal distribution.
+            double u = 1.0 - __mock_uniform(state);
+            double normal = sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * __mock_uniform(state));
+
+            return options.latency_a * exp(options.latency_b * normal);
+        }
+    }
+
+    return options.latency_a;
+}
+
+
+/**
+ * Parses rate limits, as the servers report them (i.e. "20:1,100:120").
+ *
+ * @return 0 on success; or <br>
+ *         1 if the limits are malformed.
+ */
+static int __mock_limits_parse(const char* text, struct limit* limits, int* count)
+{
+    int consumed;
+
+    *count = 0;
+    while (*text != 0x00) {
+        if (*count == LIMITS_MAX || sscanf(text, "%d:%d%n", &limits[*count].count, &limits[*count].seconds,
+                                           &consumed) != 2 || limits[*count].count <= 0
+                || limits[*count].seconds <= 0) {
+            return 1;
+        }
+
+        (*count)++;
+        text += consumed;
+        if (*text == ',') text++;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Parses the latency distribution: "MS" (fixed), "MIN-MAX" (uniform) or "lognormal:MEDIAN:SIGMA".
+ *
+ * @return 0 on success; or <br>
+ *         1 if the distribution is malformed.
+ */
+static int __mock_latency_parse(const char* text)
+{
+    char end;
+
+    if (sscanf(text, "lognormal:%lf:%lf%c", &options.latency_a, &options.latency_b, &end) == 2) {
+        options.latency = LATENCY_LOGNORMAL;
+    } else if (sscanf(text, "%lf-%lf%c", &options.latency_a, &options.latency_b, &end) == 2) {
+        options.latency = LATENCY_UNIFORM;
+    } else if (sscanf(text, "%lf%c", &options.latency_a, &end) == 1) {
+        options.latency = LATENCY_FIXED;
+    } else {
+        return 1;
+    }
+
+    return options.latency_a < 0 || options.latency_b < 0;
+}
+
+
+/**
+ * Formats rate limits, or their counts, as the servers report them.
+ */
+static void __mock_limits_format(char* out, size_t size, const struct limit* limits, const int* counts, int count)
+{
+    size_t length = 0;
+    out[0] = 0x00;
+
+    for (int i = 0; i < count && length < size; i++) {
+        length += snprintf(out + length, size - length, "%s%d:%d", i ? "," : "",
+                           counts != NULL ? counts[i] : limits[i].count, limits[i].seconds);
+    }
+}
+
+
+/**
+ * Counts a request against the limits of a bucket.
+ * Requests are counted in fixed windows that start with the first request, as the servers do; rejected requests
+ * are not counted.
+ *
+ * @param key       The bucket (i.e. the API key and platform).
+ * @param limits    The limits of the bucket.
+ * @param count     The number of limits.
+ * @param counts    Receives the number of requests counted in every window.
+ *
+ * @return 0 if the request is allowed; or <br>
+ *         The number of seconds to wait (at least 1) if a limit was reached.
+ */
+static int __mock_limits_count(const char* key, const struct limit* limits, int count, int* counts)
+{
+    uint64_t now = __mock_now();
+    unsigned long hash = 5381;
+    int retry = 0;
+
+    for (const char* c = key; *c != 0x00; c++) {
+        hash = hash * 33 + (unsigned char)*c;
+    }
+
+    pthread_mutex_lock(&buckets_lock);
+
+    struct bucket* bucket = buckets[hash % BUCKETS];
+    while (bucket != NULL && strcmp(bucket->key, key) != 0) {
+        bucket = bucket->next;
+    }
+
+    if (bucket == NULL) {
+        bucket = calloc(1, sizeof(struct bucket));
+        snprintf(bucket->key, sizeof(bucket->key), "%s", key);
+        bucket->next = buckets[hash % BUCKETS];
+        buckets[hash % BUCKETS] = bucket;
+    }
+
+    for (int i = 0; i < count; i++) {
+        uint64_t window = (uint64_t)limits[i].seconds * 1000;
+
+        if (bucket->count[i] == 0 || now - bucket->start[i] >= window) {
+            bucket->start[i] = now;
+            bucket->count[i] = 0;
+        }
+
+        if (bucket->count[i] >= limits[i].count) {
+            int wait = (bucket->start[i] + window - now + 999) / 1000;
+            retry = wait > retry ? wait : retry;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        bucket->count[i] += retry == 0;
+        counts[i] = bucket->count[i];
+    }
+
+    pthread_mutex_unlock(&buckets_lock);
+    return retry;
+}
+
+
+/**
+ * Reads the fixture answering a path, from the most specific file to the least (see above).
+ *
+ * @param path      The path, after /lol/ and without its query.
+ * @param matched   Receives the path of the fixture, relative to the fixtures directory and without ".json".
+ * @param size      Receives the size of the fixture.
+ *
+ * @return The content of the fixture, to be freed; or <br>
+ *         NULL if no fixture answers the path.
+ */
+static char* __mock_fixture(const char* path, char* matched, size_t* size)
+{
+    char file[PATH_MAX_SIZE + 64];
+
+    strcpy(matched, path);
+    while (matched[0] != 0x00) {
+        snprintf(file, sizeof(file), "%s/%s.json", options.fixtures, matched);
+
+        FILE* fixture = fopen(file, "rb");
+        if (fixture != NULL) {
+            fseek(fixture, 0, SEEK_END);
+            long length = ftell(fixture);
+            rewind(fixture);
+
+            char* content = length >= 0 ? malloc(length + 1) : NULL;
+            if (content != NULL && fread(content, 1, length, fixture) == (size_t)length) {
+                content[length] = 0x00;
+                *size = length;
+                fclose(fixture);
+                return content;
+            }
+
+            free(content);
+            fclose(fixture);
+            return NULL;
+        }
+
+        char* slash = strrchr(matched, '/');
+        if (slash == NULL) break;
+        *slash = 0x00;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Fills the placeholders of a fixture.
+ *
+ * @param fixture   The fixture.
+ * @param id        The last segment of the path, decoded and escaped for JSON.
+ * @param size      The size of the fixture; receives the size of the body.
+ *
+ * @return The body, to be freed.
+ */
+static char* __mock_render(const char* fixture, const char* id, size_t* size, uint64_t* state)
+{
+    size_t capacity = *size + 64;
+    size_t length = 0;
+    char* body = malloc(capacity);
+
+    while (*fixture != 0x00) {
+        char value[64];
+        const char* insert = NULL;
+
+        if (strncmp(fixture, "{{id}}", 6) == 0) {
+            insert = id;
+            fixture += 6;
+        } else if (strncmp(fixture, "{{rand}}", 8) == 0) {
+            snprintf(value, sizeof(value), "%u", (unsigned)(__mock_random(state) % 2147483646) + 1);
+            insert = value;
+            fixture += 8;
+        }
+
+        size_t extra = insert != NULL ? strlen(insert) : 1;
+        if (length + extra + 1 > capacity) {
+            capacity = (length + extra + 1) * 2;
+            body = realloc(body, capacity);
+        }
+
+        if (insert != NULL) {
+            memcpy(body + length, insert, extra);
+        } else {
+            body[length] = *fixture++;
+        }
+
+        length += extra;
+    }
+
+    body[length] = 0x00;
+    *size = length;
+    return body;
+}
+
+
+/**
+ * Decodes the last segment of a path, and escapes it for a JSON string.
+ */
+static void __mock_path_id(const char* path, char* id, size_t size)
+{
+    const char* segment = strrchr(path, '/');
+    size_t length = 0;
+
+    segment = segment != NULL ? segment + 1 : path;
+    while (*segment != 0x00 && length + 3 < size) {
+        unsigned int c = (unsigned char)*segment++;
+
+        if (c == '%' && segment[0] != 0x00 && segment[1] != 0x00 && sscanf(segment, "%2x", &c) == 1) {
+            segment += 2;
+        }
+
+        if (c == '"' || c == '\\') {
+            id[length++] = '\\';
+        }
+
+        // Control characters would make the JSON invalid.
+        id[length++] = c < 0x20 ? ' ' : c;
+    }
+
+    id[length] = 0x00;
+}
+
+
+/**
+ * A 32-bit FNV-1a hash, used as the ETag of a body.
+ */
+static uint32_t __mock_hash(const char* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+
+/**
+ * The reason phrase of a status code.
+ */
+static const char* __mock_reason(int status)
+{
+    switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+    }
+
+    return "Unknown";
+}
+
+
+/**
+ * Writes a whole buffer to a connection.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the connection was closed.
+ */
+static int __mock_write(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return 1;
+
+        data += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+
+/*
+ * A request, as much of it as the mock looks at.
+ */
+struct mock_request {
+    char    path[PATH_MAX_SIZE];
+    char    host[256];
+    char    token[128];
+    char    etag[64];
+    int     close;
+};
+
+
+/**
+ * Answers a request.
+ *
+ * @param fd        The connection.
+ * @param request   The request.
+ * @param state     The random state of the connection.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the connection was closed.
+ */
+static int __mock_serve(int fd, struct mock_request* request, uint64_t* state)
+{
+    char headers[1024] = "";
+    char platform[64] = "";
+    char matched[PATH_MAX_SIZE];
+    char id[PATH_MAX_SIZE];
+    char* body = NULL;
+    size_t size = 0;
+    int status = 200;
+    uint64_t started = __mock_now();
+
+    char* query = strchr(request->path, '?');
+    if (query != NULL) *query = 0x00;
+
+    // The platform is either the first segment of the path, or the first label of the host.
+    char* path = request->path;
+    if (strncmp(path, "/lol/", 5) != 0) {
+        char* slash = strchr(path + 1, '/');
+        if (slash != NULL && (size_t)(slash - path - 1) < sizeof(platform)) {
+            memcpy(platform, path + 1, slash - path - 1);
+            platform[slash - path - 1] = 0x00;
+            path = slash;
+        }
+    } else {
+        sscanf(request->host, "%63[^.:]", platform);
+    }
+
+    if (strncmp(path, "/lol/", 5) != 0 || strstr(path, "..") != NULL) {
+        status = 404;
+    } else if (request->token[0] == 0x00) {
+        status = 401;
+    } else if (strncmp(request->token, "RGAPI-", 6) != 0) {
+        status = 403;
+    } else if ((body = __mock_fixture(path + 5, matched, &size)) == NULL) {
+        status = 404;
+    }
+
+    if (status == 200) {
+        char key[512], limits[128], counts[128];
+        int app_counts[LIMITS_MAX], method_counts[LIMITS_MAX];
+        size_t length = 0;
+
+        int retry = 0;
+        const char* type = NULL;
+
+        // Static data does not count against the application limits; only against its method limits.
+        if (strncmp(matched, "static-data/", 12) != 0) {
+            snprintf(key, sizeof(key), "%s %s", request->token, platform);
+            retry = __mock_limits_count(key, options.app, options.app_count, app_counts);
+            type = retry != 0 ? "application" : NULL;
+
+            __mock_limits_format(limits, sizeof(limits), options.app, NULL, options.app_count);
+            __mock_limits_format(counts, sizeof(counts), options.app, app_counts, options.app_count);
+            length += snprintf(headers + length, sizeof(headers) - length,
+                               "X-App-Rate-Limit: %s\r\nX-App-Rate-Limit-Count: %s\r\n", limits, counts);
+        }
+
+        if (options.method_count != 0 && retry == 0) {
+            snprintf(key, sizeof(key), "%s %s %s", request->token, platform, matched);
+            retry = __mock_limits_count(key, options.method, options.method_count, method_counts);
+            type = retry != 0 ? "method" : NULL;
+
+            __mock_limits_format(limits, sizeof(limits), options.method, NULL, options.method_count);
+            __mock_limits_format(counts, sizeof(counts), options.method, method_counts, options.method_count);
+            length += snprintf(headers + length, sizeof(headers) - length,
+                               "X-Method-Rate-Limit: %s\r\nX-Method-Rate-Limit-Count: %s\r\n", limits, counts);
+        }
+
+        if (retry != 0) {
+            status = 429;
+            snprintf(headers + length, sizeof(headers) - length, "Retry-After: %d\r\nX-Rate-Limit-Type: %s\r\n",
+                     retry, type);
+        } else if (__mock_uniform(state) * 100 < options.errors) {
+            static const int errors[] = { 500, 502, 503, 503, 504 };
+            status = errors[__mock_random(state) % 5];
+        }
+    }
+
+    if (status == 200) {
+        __mock_path_id(path, id, sizeof(id));
+
+        char* rendered = __mock_render(body, id, &size, state);
+        free(body);
+        body = rendered;
+
+        char etag[32];
+        snprintf(etag, sizeof(etag), "\"%08x\"", __mock_hash(body, size));
+        snprintf(headers + strlen(headers), sizeof(headers) - strlen(headers), "ETag: %s\r\n", etag);
+
+        if (strcmp(request->etag, etag) == 0) {
+            status = 304;
+            size = 0;
+        }
+    } else {
+        free(body);
+        body = malloc(128);
+        size = sprintf(body, "{\"status\":{\"message\":\"%s\",\"status_code\":%d}}", __mock_reason(status), status);
+    }
+
+    // Rate-limited requests are turned down at once, as the servers do.
+    if (status != 429) {
+        double latency = __mock_latency(state);
+        struct timespec delay = { (time_t)(latency / 1000), (long)(fmod(latency, 1000) * 1000000) };
+
+        while (nanosleep(&delay, &delay) != 0 && errno == EINTR);
+    }
+
+    char head[1536];
+    int length = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: application/json;charset=utf-8\r\n"
+                          "Content-Length: %zu\r\nConnection: %s\r\n%s\r\n", status, __mock_reason(status), size,
+                          request->close ? "close" : "keep-alive", headers);
+
+    int closed = __mock_write(fd, head, length) || __mock_write(fd, body, size);
+    free(body);
+
+    int class = status < 300 ? 0 : status == 304 ? 1 : status == 429 ? 2 : status < 500 ? 3 : 4;
+    __atomic_add_fetch(&served[class], 1, __ATOMIC_RELAXED);
+
+    if (options.verbose) {
+        fprintf(stderr, "%s %s -> %d (%llu ms)\n", platform, path, status,
+                (unsigned long long)(__mock_now() - started));
+    }
+
+    return closed;
+}
+
+
+/**
+ * Parses the head of a request.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the request is malformed.
+ */
+static int __mock_parse(char* head, struct mock_request* request)
+{
+    char method[8], version[16];
+
+    memset(request, 0x00, sizeof(struct mock_request));
+    if (sscanf(head, "%7s %1023s %15s", method, request->path, version) != 3 || strcmp(method, "GET") != 0) {
+        return 1;
+    }
+
+    request->close = strcmp(version, "HTTP/1.0") == 0;
+
+    for (char* line = strstr(head, "\r\n"); line != NULL; line = strstr(line, "\r\n")) {
+        line += 2;
+
+        if (strncasecmp(line, "Host:", 5) == 0) {
+            sscanf(line + 5, " %255[^\r\n]", request->host);
+        } else if (strncasecmp(line, "X-Riot-Token:", 13) == 0) {
+            sscanf(line + 13, " %127[^\r\n ]", request->token);
+        } else if (strncasecmp(line, "If-None-Match:", 14) == 0) {
+            sscanf(line + 14, " %63[^\r\n ]", request->etag);
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            char value[16] = "";
+            sscanf(line + 11, " %15[^\r\n ]", value);
+            request->close = strcasecmp(value, "close") == 0 ? 1 : strcasecmp(value, "keep-alive") == 0 ? 0
+                             : request->close;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Serves the requests of a connection until it is closed.
+ */
+static void* __mock_connection(void* argument)
+{
+    int fd = (int)(intptr_t)argument;
+    uint64_t state = options.seed ^ (__atomic_add_fetch(&connections, 1, __ATOMIC_RELAXED) * 0x9E3779B97F4A7C15ULL);
+    struct mock_request request;
+    char buffer[REQUEST_MAX + 1];
+    size_t used = 0;
+
+    // A zero state would make the generator stick at zero.
+    state = state != 0 ? state : 1;
+
+    for (;;) {
+        char* end;
+
+        buffer[used] = 0x00;
+        while ((end = strstr(buffer, "\r\n\r\n")) == NULL) {
+            if (used == REQUEST_MAX) goto closed;
+
+            ssize_t received = recv(fd, buffer + used, REQUEST_MAX - used, 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) goto closed;
+
+            used += received;
+            buffer[used] = 0x00;
+        }
+
+        // Requests carry no body; the bytes after the head belong to the next request.
+        *end = 0x00;
+        size_t consumed = end + 4 - buffer;
+
+        if (__mock_parse(buffer, &request) != 0) {
+            static const char bad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            __mock_write(fd, bad, sizeof(bad) - 1);
+            break;
+        }
+
+        if (__mock_serve(fd, &request, &state) != 0 || request.close) {
+            break;
+        }
+
+        memmove(buffer, buffer + consumed, used - consumed);
+        used -= consumed;
+    }
+
+closed:
+    close(fd);
+    return NULL;
+}
+
+
+/**
+ * Stops accepting connections.
+ */
+static void __mock_stop(int signal)
+{
+    (void)signal;
+    stopping = 1;
+}
+
+
+static void __mock_usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [-p port] [-f fixtures] [-r app limits] [-m method limits] [-l latency] [-e errors]\n"
+            "          [-s seed] [-v]\n"
+            "\n"
+            "  -p port      The port to listen on, on 127.0.0.1 (8080).\n"
+            "  -f fixtures  The directory of the fixtures (fixtures).\n"
+            "  -r limits    The limits per key and platform, as \"count:seconds,...\" (20:1,100:120).\n"
+            "  -m limits    The limits per key, platform and endpoint (none).\n"
+            "  -l latency   \"MS\", \"MIN-MAX\" (uniform) or \"lognormal:MEDIAN:SIGMA\", in ms (0).\n"
+            "  -e errors    The share of the requests failing with a 5xx error, in percent (0).\n"
+            "  -s seed      The seed of the random numbers (0).\n"
+            "  -v           Logs every request to stderr.\n", name);
+}
+
+
+int main(int argc, char** argv)
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "p:f:r:m:l:e:s:vh")) != -1) {
+        int failed = 0;
+
+        switch (option) {
+            case 'p': options.port = atoi(optarg); failed = options.port <= 0 || options.port > 65535; break;
+            case 'f': options.fixtures = optarg; break;
+            case 'r': failed = __mock_limits_parse(optarg, options.app, &options.app_count); break;
+            case 'm': failed = __mock_limits_parse(optarg, options.method, &options.method_count); break;
+            case 'l': failed = __mock_latency_parse(optarg); break;
+            case 'e': options.errors = atof(optarg); failed = options.errors < 0 || options.errors > 100; break;
+            case 's': options.seed = strtoull(optarg, NULL, 10); break;
+            case 'v': options.verbose = 1; break;
+            default: failed = 1; break;
+        }
+
+        if (failed) {
+            __mock_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(options.port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 128) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    // Without SA_RESTART, accept() returns once the mock is told to stop.
+    struct sigaction stop = { .sa_handler = __mock_stop };
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    fprintf(stderr, "listening on 127.0.0.1:%d, fixtures in %s\n", options.port, options.fixtures);
+
+    while (!stopping) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        pthread_t thread;
+        if (pthread_create(&thread, &attributes, __mock_connection, (void *)(intptr_t)fd) != 0) {
+            close(fd);
+        }
+    }
+
+    close(listener);
+    fprintf(stderr, "served %ld: %ld ok, %ld not modified, %ld rate limited, %ld other 4xx, %ld 5xx\n",
+            served[0] + served[1] + served[2] + served[3] + served[4], served[0], served[1], served[2], served[3],
+            served[4]);
+    return 0;
+}
@@ -8,6 +8,10 @@ clock_t delta;
 int main(void)
 {
     clock_t absolute_beginning = clock();
+
+    // i.e. CCHAMP_BASE_URL, to run against the mock server.
+    cchamp_config_load_env();
+
     begin = clock();
     cchamp_init();
     delta = clock() - begin;
@@ -0,0 +1,206 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks of the library against the mock server (see mock/server.c), one scenario per run, as the server has
+ * to be started with the options of the scenario (see the Makefile):
+ *
+ *  history     The match history of a player is fetched in full, and only up to its limit.
+ *  ladder      The apex leagues of two regions and the league of a seeded player are crawled once each.
+ *  ratelimit   The server allows far fewer requests than the client is told: calls wait for Retry-After after
+ *              a 429 instead of failing over and over, and a match history still completes.
+ *  errors      A share of the responses are 5xx errors: the requests of a match history are retried.
+ *
+ * The base URL of the mock is read from CCHAMP_BASE_URL.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <cchamp/cchamp.h>
+
+#define MOCK_ACCOUNT        "35259927"
+#define MOCK_MATCHES        10
+
+static int failures;
+
+
+/**
+ * Reports a check, and counts it if it failed.
+ */
+static void __mock_report(const char* name, int passed, const char* detail)
+{
+    printf("%s %s%s%s\n", passed ? "PASS" : "FAIL", name, passed || detail == NULL ? "" : ": ", passed ? "" : detail);
+    failures += !passed;
+}
+
+
+/**
+ * Milliseconds on the monotonic clock.
+ */
+static long __mock_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/**
+ * Counts the matches handed over by a match history, and those that were parsed in full.
+ */
+static void __mock_match(Match* match, void* data)
+{
+    int* counts = data;
+
+    counts[0]++;
+    counts[1] += match->game_id != 0 && match->participants_count == MATCH_PARTICIPANTS_MAX;
+}
+
+
+/**
+ * Fetches the match history of the mock player.
+ *
+ * @return 0 if every match up to the limit was handed over, parsed in full; or <br>
+ *         1 otherwise.
+ */
+static int __mock_history(uint32_t limit)
+{
+    int counts[2] = {0};
+    uint32_t expected = limit < MOCK_MATCHES ? limit : MOCK_MATCHES;
+
+    int delivered = cchamp_match_history(REGION_NA, MOCK_ACCOUNT, limit, __mock_match, counts);
+
+    return delivered != (int)expected || counts[0] != (int)expected || counts[1] != (int)expected
+        || cc_error != EPASS;
+}
+
+
+static void __mock_check_history()
+{
+    __mock_report("history", __mock_history(100) == 0, "the history is incomplete");
+    __mock_report("history limit", __mock_history(4) == 0, "the history does not stop at its limit");
+}
+
+
+static void __mock_check_ladder()
+{
+    Ladder* ladder = cchamp_ladder_create(QUEUE_RANKED_SOLO);
+    League league;
+
+    // The challenger and master leagues of both regions, 50 players each.
+    int added = cchamp_ladder_crawl(ladder, REGION_NA | REGION_EUW);
+    __mock_report("ladder apex", added == 200 && cc_error == EPASS && cchamp_ladder_count(ladder) == 200
+                  && cchamp_ladder_league_count(ladder) == 4, "the apex leagues were not crawled in full");
+
+    LeagueEntry* entry = cchamp_ladder_entries(ladder);
+    __mock_report("ladder find", cchamp_ladder_find(ladder, entry->region, entry->summoner_id) == entry
+                  && cchamp_ladder_league(ladder, entry->league, &league) != NULL, "a crawled player was not found");
+
+    // The leagues crawled already are not fetched again; a seeded player leads to its own league.
+    __mock_report("ladder again", cchamp_ladder_crawl(ladder, REGION_NA | REGION_EUW) == 0 && cc_error == EPASS,
+                  "the apex leagues were crawled twice");
+
+    cchamp_ladder_seed(ladder, REGION_NA, 21748566);
+    added = cchamp_ladder_crawl(ladder, REGION_NA);
+    __mock_report("ladder seed", added == 50 && cc_error == EPASS && cchamp_ladder_league_count(ladder) == 5,
+                  "the league of the seeded player was not crawled");
+
+    cchamp_ladder_free(ladder);
+}
+
+
+static void __mock_check_ratelimit()
+{
+    int passed = 0, limited = 0;
+
+    // The server allows 5 requests a second (see the Makefile); the client is told 50.
+    cchamp_set_max_requests(50, 1000);
+    cchamp_config_set_int(CCHAMP_CONFIG_DISPATCH_RETRIES, 16);
+
+    long started = __mock_now();
+    for (int i = 0; i < 12; i++) {
+        Summoner summoner;
+        char summoner_id[16];
+
+        // Every call asks for another player, so that none is answered without a request.
+        snprintf(summoner_id, sizeof(summoner_id), "%d", 21748566 + i);
+
+        if (get_summoner_by_sid_into(REGION_NA, summoner_id, &summoner) != NULL) {
+            passed++;
+        } else {
+            limited += cc_error == ERATELIMIT;
+        }
+    }
+
+    // A 429 holds the region back for its Retry-After, so that the next call goes through.
+    __mock_report("429 retry-after", passed + limited == 12 && limited <= 3 && __mock_now() - started >= 1000,
+                  "calls kept on being rate limited");
+
+    started = __mock_now();
+    __mock_report("429 history", __mock_history(100) == 0 && __mock_now() - started >= 1000,
+                  "the history did not complete within the server limits");
+}
+
+
+static void __mock_check_errors()
+{
+    // The breaker would open on the errors; the retries are what is checked here.
+    cchamp_config_set_int(CCHAMP_CONFIG_BREAKER_ERRORS, 0);
+    cchamp_config_set_int(CCHAMP_CONFIG_DISPATCH_RETRIES, 8);
+    cchamp_config_set_int(CCHAMP_CONFIG_DISPATCH_BACKOFF, 10);
+
+    int failed = 0;
+    for (int i = 0; i < 3; i++) {
+        failed |= __mock_history(100);
+    }
+
+    __mock_report("5xx retries", !failed, "a history failed despite its retries");
+}
+
+
+int main(int argc, char** argv)
+{
+    static const struct {
+        const char* name;
+        void (*check)();
+    } scenarios[] = {
+        { "history",    __mock_check_history },
+        { "ladder",     __mock_check_ladder },
+        { "ratelimit",  __mock_check_ratelimit },
+        { "errors",     __mock_check_errors }
+    };
+
+    cchamp_config_load_env();
+
+    if (cchamp_init() != 0) {
+        printf("cchamp_init() failed.\n");
+        return 1;
+    }
+
+    cchamp_set_api_key("RGAPI-72cdaa16-0b91-4f10-9231-6665d0ad05d9");
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        if (argc < 2 || strcmp(argv[1], scenarios[i].name) == 0) {
+            scenarios[i].check();
+        }
+    }
+
+    cchamp_close();
+
+    printf("%d check(s) failed.\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,528 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Round-trips of the encodings that need no server: the lookup indexes (phash) and bitsets of static tables,
+ * the columnar export (varints, deltas and the dictionary) and crawler checkpoints.
+ *
+ * Static tables are built straight from generated JSON through the internal builders of the library, so this
+ * program is compiled against the headers of src/ as well (see the Makefile).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cJSON.h>
+#include <cchamp/cchamp.h>
+#include <network/riot/ddragon/tables.h>
+#include <network/riot/ddragon/phash.h>
+#include <network/riot/ddragon/bitset.h>
+
+#define UNIT_ITEMS          3000
+#define UNIT_CHAMPIONS      1500
+#define UNIT_TAGS           12
+#define UNIT_MATCHES        2500
+#define UNIT_MATCHES_MORE   500
+#define UNIT_GROUP_ROWS     700
+
+static const char* tags[UNIT_TAGS] = {
+    "Boots", "Damage", "SpellDamage", "Armor", "Health", "Mana",
+    "AttackSpeed", "CriticalStrike", "Lane", "Jungle", "Vision", "Consumable"
+};
+
+static const char* versions[] = { "7.24.215.1310", "8.1.216.5012", "8.2.217.1107", "8.3.218.3346" };
+
+static int failures;
+
+
+/**
+ * Reports a check, and counts it if it failed.
+ */
+static void __unit_report(const char* name, int passed, const char* detail)
+{
+    printf("%s %s%s%s\n", passed ? "PASS" : "FAIL", name, passed || detail == NULL ? "" : ": ", passed ? "" : detail);
+    failures += !passed;
+}
+
+
+/**
+ * Builds a static table from a JSON payload into fresh anonymous pages, along with its indexes and bitsets,
+ * as a load does before it publishes the table.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the table could not be built.
+ */
+static int __unit_table(uint16_t category, cJSON* json, struct category* cat)
+{
+    memset(cat, 0x00, sizeof(struct category));
+    cat->__init_pages_size = 1;
+    cat->__pages_size = 1;
+    cat->__first_page = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (cat->__first_page == MAP_FAILED || (cat->__used = table_build(category, json, cat)) == 0) {
+        return 1;
+    }
+
+    return phash_build(category, cat) != 0 || bitset_build(category, cat) != 0
+        || !table_valid(category, cat->__first_page, cat->__used);
+}
+
+
+/**
+ * The tags of a generated record: a few of them, spread by a multiplicative hash of the record.
+ */
+static uint32_t __unit_tags(uint32_t record)
+{
+    return (record * 2654435761u >> 7) & ((1u << UNIT_TAGS) - 1);
+}
+
+
+/**
+ * Checks that a bitset holds exactly the rows of a table whose mask has a given bit.
+ */
+static int __unit_bitset_matches(const uint64_t* bitset, uint32_t count, const void* masks, int width, int bit)
+{
+    for (uint32_t row = 0; row < count; row++) {
+        uint64_t mask = width == 8 ? ((const uint64_t *)masks)[row] : ((const uint32_t *)masks)[row];
+
+        if (((bitset[row / 64] >> (row % 64)) & 1) != ((mask >> bit) & 1)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * Appends formatted text to a growing payload.
+ */
+static void __unit_append(char** payload, size_t* length, size_t* capacity, const char* format, ...)
+{
+    va_list arguments;
+
+    for (;;) {
+        va_start(arguments, format);
+        int written = vsnprintf(*payload + *length, *capacity - *length, format, arguments);
+        va_end(arguments);
+
+        if (*length + written < *capacity) {
+            *length += written;
+            return;
+        }
+
+        *capacity *= 2;
+        *payload = realloc(*payload, *capacity);
+    }
+}
+
+
+/**
+ * Items: every id is found through the index, ids in between are not, and every tag and map bitset holds
+ * exactly the items with that tag or map.
+ */
+static void __unit_items()
+{
+    static const int maps[] = { 1, 8, 10, 11, 12, 14 };
+    size_t length = 0, capacity = 4096;
+    char* payload = malloc(capacity);
+    struct category cat;
+
+    __unit_append(&payload, &length, &capacity, "{\"type\":\"item\",\"version\":\"8.3.1\",\"data\":{");
+
+    for (uint32_t i = 0; i < UNIT_ITEMS; i++) {
+        __unit_append(&payload, &length, &capacity, "%s\"%u\":{\"id\":%u,\"name\":\"Item %u\",\"plaintext\":\"A "
+                      "generated item\",\"gold\":{\"base\":%u,\"total\":%u,\"sell\":%u},\"tags\":[", i ? "," : "",
+                      1000 + i * 7, 1000 + i * 7, i, i % 1000, i % 4000, i % 700);
+
+        for (int t = 0, first = 1; t < UNIT_TAGS; t++) {
+            if (__unit_tags(i) & (1u << t)) {
+                __unit_append(&payload, &length, &capacity, "%s\"%s\"", first ? "" : ",", tags[t]);
+                first = 0;
+            }
+        }
+
+        __unit_append(&payload, &length, &capacity, "],\"maps\":{");
+        for (size_t m = 0; m < sizeof(maps) / sizeof(maps[0]); m++) {
+            __unit_append(&payload, &length, &capacity, "%s\"%d\":%s", m ? "," : "", maps[m],
+                          (i >> m) & 1 ? "true" : "false");
+        }
+
+        __unit_append(&payload, &length, &capacity, "}}");
+    }
+
+    __unit_append(&payload, &length, &capacity, "}}");
+    cJSON* json = cJSON_Parse(payload);
+    free(payload);
+
+    int failed = __unit_table(STATIC_ITEMS, json, &cat);
+    cJSON_Delete(json);
+    __unit_report("items table", !failed, "the table could not be built");
+    if (failed) return;
+
+    struct static_table* table = cat.__first_page;
+    uint32_t* ids = TABLE_COLUMN(table, uint32_t, ITEM_ID);
+    int found = table->index[INDEX_ID] != 0 && table->count == UNIT_ITEMS;
+    int missed = 1;
+
+    for (uint32_t i = 0; i < UNIT_ITEMS && found && missed; i++) {
+        uint32_t row = phash_find_id(table, INDEX_ID, ITEM_ID, 1000 + i * 7);
+
+        found = row != UINT32_MAX && ids[row] == 1000 + i * 7;
+        missed = phash_find_id(table, INDEX_ID, ITEM_ID, 1000 + i * 7 + 3) == UINT32_MAX;
+    }
+
+    __unit_report("phash items by id", found, "an id was not found through the index");
+    __unit_report("phash items miss", missed, "an unknown id was found");
+
+    int matches = table->tags_count == UNIT_TAGS;
+    for (uint32_t t = 0; t < table->tags_count && matches; t++) {
+        matches = __unit_bitset_matches(BITSET_TAG(table, t), table->count, TABLE_COLUMN(table, uint64_t, ITEM_TAGS),
+                                        8, t);
+    }
+
+    __unit_report("bitset item tags", matches, "a tag bitset differs from the tags column");
+
+    matches = 1;
+    for (int m = 0; m < BITSET_MAPS && matches; m++) {
+        matches = __unit_bitset_matches(BITSET_MAP(table, m), table->count, TABLE_COLUMN(table, uint32_t, ITEM_MAPS),
+                                        4, m);
+    }
+
+    __unit_report("bitset item maps", matches, "a map bitset differs from the maps column");
+    munmap(cat.__first_page, cat.__pages_size * PAGE_SIZE);
+}
+
+
+/**
+ * Champions: every champion is found by id and by key through the indexes, and unknown keys are not.
+ */
+static void __unit_champions()
+{
+    size_t length = 0, capacity = 4096;
+    char* payload = malloc(capacity);
+    struct category cat;
+    char key[64];
+
+    __unit_append(&payload, &length, &capacity, "{\"type\":\"champion\",\"version\":\"8.3.1\",\"data\":{");
+
+    for (uint32_t i = 0; i < UNIT_CHAMPIONS; i++) {
+        __unit_append(&payload, &length, &capacity, "%s\"Champion%u\":{\"id\":%u,\"key\":\"Champion%u\",\"name\":"
+                      "\"Champion %u\",\"title\":\"the Generated\",\"tags\":[\"%s\"]}", i ? "," : "", i, i + 1, i, i,
+                      tags[i % UNIT_TAGS]);
+    }
+
+    __unit_append(&payload, &length, &capacity, "}}");
+    cJSON* json = cJSON_Parse(payload);
+    free(payload);
+
+    int failed = __unit_table(STATIC_CHAMPIONS, json, &cat);
+    cJSON_Delete(json);
+    __unit_report("champions table", !failed, "the table could not be built");
+    if (failed) return;
+
+    struct static_table* table = cat.__first_page;
+    uint32_t* ids = TABLE_COLUMN(table, uint32_t, CHAMPION_ID);
+    int found = table->index[INDEX_ID] != 0 && table->index[INDEX_KEY] != 0 && table->count == UNIT_CHAMPIONS;
+
+    for (uint32_t i = 0; i < UNIT_CHAMPIONS && found; i++) {
+        snprintf(key, sizeof(key), "Champion%u", i);
+
+        uint32_t by_id = phash_find_id(table, INDEX_ID, CHAMPION_ID, i + 1);
+        uint32_t by_key = phash_find_string(table, INDEX_KEY, CHAMPION_KEY, key);
+        found = by_id != UINT32_MAX && by_id == by_key && ids[by_id] == i + 1;
+    }
+
+    __unit_report("phash champions by id and key", found, "a champion was not found through the indexes");
+    __unit_report("phash champions miss", phash_find_string(table, INDEX_KEY, CHAMPION_KEY, "Champion") == UINT32_MAX
+                  && phash_find_id(table, INDEX_ID, CHAMPION_ID, UNIT_CHAMPIONS + 1) == UINT32_MAX,
+                  "an unknown champion was found");
+    munmap(cat.__first_page, cat.__pages_size * PAGE_SIZE);
+}
+
+
+/**
+ * The match of a row of the export. Ids go back and forth, so that deltas are negative as well, and creation
+ * times need more than 32 bits.
+ */
+static void __unit_match(uint32_t row, Match* match)
+{
+    memset(match, 0x00, sizeof(Match));
+    match->game_id = 3000000000ULL + (row % 2 ? row * 11 : row * 5);
+    match->creation = 1500000000000ULL + (uint64_t)row * 60000;
+    match->duration = 900 + row % 1800;
+    match->queue = row % 3 ? 420 : 440;
+    match->map = 11;
+    match->season = 9;
+    strcpy(match->version, versions[row % 4]);
+}
+
+
+/**
+ * Reads an unsigned LEB128 varint, advancing the cursor.
+ */
+static uint64_t __unit_varint(const uint8_t** data)
+{
+    uint64_t value = 0;
+
+    for (int shift = 0; ; shift += 7) {
+        uint8_t byte = *(*data)++;
+
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+}
+
+
+/**
+ * Reads a little-endian u32.
+ */
+static uint32_t __unit_le32(const uint8_t* data)
+{
+    return data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+
+/**
+ * Decodes an export of EXPORT_MATCHES with all its columns, checking every row against the match it was
+ * written from (see src/features/export.c for the layout).
+ *
+ * @return The number of rows that matched, up to the first that did not; or <br>
+ *         -1 if the file could not be read.
+ */
+static long __unit_export_decode(const char* path, uint32_t* groups)
+{
+    static const int delta[] = { 1, 1, 0, 0, 0, 0 };
+    char* dictionary[64];
+    uint32_t dictionary_count = 0;
+    long rows = 0;
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return -1;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    uint8_t* content = malloc(size);
+    if (content == NULL || fread(content, 1, size, file) != (size_t)size || size < 12
+            || __unit_le32(content) != 0x58504343 || (content[4] | content[5] << 8) != 1
+            || (content[6] | content[7] << 8) != EXPORT_MATCHES || __unit_le32(content + 8) != 0x7F) {
+        free(content);
+        fclose(file);
+        return -1;
+    }
+
+    fclose(file);
+    *groups = 0;
+
+    for (const uint8_t* group = content + 12; group < content + size; (*groups)++) {
+        uint32_t count = __unit_le32(group);
+        uint32_t added = __unit_le32(group + 4);
+        const uint8_t* strings = group + 4 * 10;
+        const uint8_t* columns[7];
+        uint64_t previous[7] = {0};
+
+        columns[0] = strings + __unit_le32(group + 8);
+        for (int c = 1; c < 7; c++) {
+            columns[c] = columns[c - 1] + __unit_le32(group + 4 * (2 + c));
+        }
+
+        const uint8_t* end = columns[6] + __unit_le32(group + 4 * 9);
+
+        for (uint32_t i = 0; i < added && dictionary_count < 64; i++) {
+            uint64_t length = __unit_varint(&strings);
+
+            dictionary[dictionary_count] = strndup((const char *)strings, length);
+            dictionary_count++;
+            strings += length;
+        }
+
+        for (uint32_t i = 0; i < count; i++, rows++) {
+            uint64_t values[6];
+            Match expected;
+
+            for (int c = 0; c < 6; c++) {
+                values[c] = __unit_varint(&columns[c]);
+
+                if (delta[c]) {
+                    previous[c] += (uint64_t)((int64_t)(values[c] >> 1) ^ -(int64_t)(values[c] & 1));
+                    values[c] = previous[c];
+                }
+            }
+
+            uint64_t version = __unit_varint(&columns[6]);
+            __unit_match(rows, &expected);
+
+            if (values[0] != expected.game_id || values[1] != expected.creation || values[2] != expected.duration
+                    || values[3] != expected.queue || values[4] != expected.map || values[5] != expected.season
+                    || version >= dictionary_count || strcmp(dictionary[version], expected.version) != 0) {
+                goto done;
+            }
+        }
+
+        group = end;
+    }
+
+done:
+    for (uint32_t i = 0; i < dictionary_count; i++) {
+        free(dictionary[i]);
+    }
+
+    free(content);
+    return rows;
+}
+
+
+/**
+ * Export: rows written in several groups, and appended to after the file is opened again, read back exactly;
+ * every version string is stored once in the dictionary across groups and reopening.
+ */
+static void __unit_export()
+{
+    char path[] = "/tmp/cchamp-unit-export-XXXXXX";
+    uint32_t groups;
+    Match match;
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        __unit_report("export", 0, "no temporary file");
+        return;
+    }
+
+    close(fd);
+    unlink(path);
+    cchamp_config_set_int(CCHAMP_CONFIG_EXPORT_GROUP_ROWS, UNIT_GROUP_ROWS);
+
+    Exporter* exporter = cchamp_export_open(path, EXPORT_MATCHES, EXPORT_ALL);
+    for (uint32_t row = 0; exporter != NULL && row < UNIT_MATCHES; row++) {
+        __unit_match(row, &match);
+        cchamp_export_match(&match, exporter);
+    }
+
+    int failed = exporter == NULL || cchamp_export_close(exporter) != 0;
+
+    // Opening the file again rebuilds the dictionary, so that the versions are not added twice.
+    exporter = failed ? NULL : cchamp_export_open(path, EXPORT_MATCHES, EXPORT_ALL);
+    for (uint32_t row = UNIT_MATCHES; exporter != NULL && row < UNIT_MATCHES + UNIT_MATCHES_MORE; row++) {
+        __unit_match(row, &match);
+        cchamp_export_match(&match, exporter);
+    }
+
+    failed = failed || exporter == NULL || cchamp_export_close(exporter) != 0;
+    __unit_report("export write", !failed, "the export could not be written");
+
+    long rows = failed ? -1 : __unit_export_decode(path, &groups);
+    __unit_report("export round-trip", rows == UNIT_MATCHES + UNIT_MATCHES_MORE,
+                  "the rows read back differ from the rows written");
+    __unit_report("export groups", rows < 0 || groups == (UNIT_MATCHES + UNIT_GROUP_ROWS - 1) / UNIT_GROUP_ROWS
+                  + (UNIT_MATCHES_MORE + UNIT_GROUP_ROWS - 1) / UNIT_GROUP_ROWS, "unexpected number of groups");
+    __unit_report("export reopen", cchamp_export_open(path, EXPORT_MATCHES, EXPORT_MATCH_ID) == NULL,
+                  "an export was opened with other columns");
+
+    cchamp_config_set_int(CCHAMP_CONFIG_EXPORT_GROUP_ROWS, 65536);
+    unlink(path);
+}
+
+
+/**
+ * Compares the content of two files.
+ */
+static int __unit_same_files(const char* first, const char* second)
+{
+    FILE* a = fopen(first, "rb");
+    FILE* b = fopen(second, "rb");
+    int same = a != NULL && b != NULL;
+
+    while (same) {
+        int x = fgetc(a), y = fgetc(b);
+
+        same = x == y;
+        if (x == EOF) break;
+    }
+
+    if (a != NULL) fclose(a);
+    if (b != NULL) fclose(b);
+    return same;
+}
+
+
+/**
+ * Crawler checkpoints: a restored crawler checkpoints to the same bytes, remembers the players it visited, and
+ * a checkpoint cut short is refused.
+ */
+static void __unit_crawler()
+{
+    char first[] = "/tmp/cchamp-unit-crawler-XXXXXX";
+    char second[sizeof(first) + 8];
+    int seeded = 1;
+
+    int fd = mkstemp(first);
+    if (fd < 0) {
+        __unit_report("crawler", 0, "no temporary file");
+        return;
+    }
+
+    close(fd);
+    snprintf(second, sizeof(second), "%s.second", first);
+
+    Crawler* crawler = cchamp_crawler_create(10000, 20, NULL, NULL);
+    for (uint32_t i = 0; crawler != NULL && i < 300; i++) {
+        seeded &= cchamp_crawler_seed(crawler, i % 3 ? REGION_NA : REGION_EUW, 35259927 + i * 13) == 0;
+    }
+
+    int failed = crawler == NULL || !seeded || cchamp_crawler_checkpoint(crawler, first) != 0;
+    cchamp_crawler_free(crawler);
+
+    Crawler* restored = failed ? NULL : cchamp_crawler_restore(first, NULL, NULL);
+    __unit_report("crawler checkpoint", restored != NULL, "the checkpoint could not be written or restored");
+
+    if (restored != NULL) {
+        __unit_report("crawler round-trip", cchamp_crawler_checkpoint(restored, second) == 0
+                      && __unit_same_files(first, second), "the restored crawler checkpoints differently");
+        __unit_report("crawler visited", cchamp_crawler_seed(restored, REGION_NA, 35259927 + 13) == 1
+                      && cchamp_crawler_seed(restored, REGION_NA, 1) == 0, "the visited filter was not restored");
+        cchamp_crawler_free(restored);
+
+        // A checkpoint cut short (i.e. by a full disk) is refused rather than resumed from.
+        FILE* file = fopen(second, "r+b");
+        fseek(file, 0, SEEK_END);
+        int truncated = ftruncate(fileno(file), ftell(file) - 8) == 0;
+        fclose(file);
+
+        restored = truncated ? cchamp_crawler_restore(second, NULL, NULL) : NULL;
+        __unit_report("crawler truncated", truncated && restored == NULL, "a truncated checkpoint was restored");
+        cchamp_crawler_free(restored);
+    }
+
+    unlink(first);
+    unlink(second);
+}
+
+
+int main(void)
+{
+    __unit_items();
+    __unit_champions();
+    __unit_export();
+    __unit_crawler();
+
+    printf("%d check(s) failed.\n", failures);
+    return failures != 0;
+}
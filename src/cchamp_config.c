@@ -14,10 +14,72 @@
  * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <cchamp/cchamp.h>
 
 static uint16_t settings;
 
+/*
+ * The tunables, by CCHAMP_CONFIG_* key: the name they are loaded by, and their bounds.
+ */
+static const struct config_tunable {
+    const char* name;
+    int64_t     minimum;
+    int64_t     maximum;
+} tunables[] = {
+    [CCHAMP_CONFIG_CHANNEL_BLOCKS]      = { "channel_blocks",       1,      64 },
+    [CCHAMP_CONFIG_CHANNEL_BLOCK_SIZE]  = { "channel_block_size",   4096,   64 * 1024 * 1024 },
+    [CCHAMP_CONFIG_DISPATCH_SLOTS]      = { "dispatch_slots",       1,      64 },
+    [CCHAMP_CONFIG_DISPATCH_RETRIES]    = { "dispatch_retries",     0,      16 },
+    [CCHAMP_CONFIG_DISPATCH_BACKOFF]    = { "dispatch_backoff",     0,      60000 },
+    [CCHAMP_CONFIG_TIMEOUT]             = { "timeout",              0,      600000 },
+    [CCHAMP_CONFIG_CONNECT_TIMEOUT]     = { "connect_timeout",      0,      600000 },
+    [CCHAMP_CONFIG_RATE_HEADROOM]       = { "rate_headroom",        0,      90 },
+    [CCHAMP_CONFIG_SUMMONER_SLAB_SIZE]  = { "summoner_slab_size",   4096,   64 * 1024 * 1024 },
+    [CCHAMP_CONFIG_STATIC_PAGES]        = { "static_pages",         1,      65536 },
+    [CCHAMP_CONFIG_CRAWLER_QUEUE_MAX]   = { "crawler_queue_max",    1024,   1 << 30 },
+    [CCHAMP_CONFIG_EXPORT_GROUP_ROWS]   = { "export_group_rows",    1,      1 << 24 },
+    [CCHAMP_CONFIG_HEDGE_BUDGET]        = { "hedge_budget",         0,      50 },
+    [CCHAMP_CONFIG_HEDGE_PERCENTILE]    = { "hedge_percentile",     50,     99 },
+    [CCHAMP_CONFIG_HEDGE_DELAY_MIN]     = { "hedge_delay_min",      0,      60000 },
+    [CCHAMP_CONFIG_BREAKER_ERRORS]      = { "breaker_errors",       0,      100 },
+    [CCHAMP_CONFIG_BREAKER_SLOW]        = { "breaker_slow",         0,      600000 },
+    [CCHAMP_CONFIG_BREAKER_WINDOW]      = { "breaker_window",       1000,   600000 },
+    [CCHAMP_CONFIG_BREAKER_COOLDOWN]    = { "breaker_cooldown",     100,    600000 },
+    [CCHAMP_CONFIG_BREAKER_PROBES]      = { "breaker_probes",       1,      64 },
+    [CCHAMP_CONFIG_CHANNEL_IDLE]        = { "channel_idle",         0,      3600000 }
+};
+
+#define TUNABLES (int)(sizeof(tunables) / sizeof(tunables[0]))
+
+static int64_t values[TUNABLES] = {
+    [CCHAMP_CONFIG_CHANNEL_BLOCKS]      = 8,
+    [CCHAMP_CONFIG_CHANNEL_BLOCK_SIZE]  = 256 * 1024,
+    [CCHAMP_CONFIG_DISPATCH_SLOTS]      = 8,
+    [CCHAMP_CONFIG_DISPATCH_RETRIES]    = 3,
+    [CCHAMP_CONFIG_DISPATCH_BACKOFF]    = 500,
+    [CCHAMP_CONFIG_TIMEOUT]             = 0,
+    [CCHAMP_CONFIG_CONNECT_TIMEOUT]     = 0,
+    [CCHAMP_CONFIG_RATE_HEADROOM]       = 0,
+    [CCHAMP_CONFIG_SUMMONER_SLAB_SIZE]  = 64 * 1024,
+    [CCHAMP_CONFIG_STATIC_PAGES]        = 1,
+    [CCHAMP_CONFIG_CRAWLER_QUEUE_MAX]   = 1 << 22,
+    [CCHAMP_CONFIG_EXPORT_GROUP_ROWS]   = 65536,
+    [CCHAMP_CONFIG_HEDGE_BUDGET]        = 0,
+    [CCHAMP_CONFIG_HEDGE_PERCENTILE]    = 95,
+    [CCHAMP_CONFIG_HEDGE_DELAY_MIN]     = 50,
+    [CCHAMP_CONFIG_BREAKER_ERRORS]      = 50,
+    [CCHAMP_CONFIG_BREAKER_SLOW]        = 0,
+    [CCHAMP_CONFIG_BREAKER_WINDOW]      = 10000,
+    [CCHAMP_CONFIG_BREAKER_COOLDOWN]    = 5000,
+    [CCHAMP_CONFIG_BREAKER_PROBES]      = 3,
+    [CCHAMP_CONFIG_CHANNEL_IDLE]        = 30000
+};
+
 
 /**
  * Overrides the current specified setting.
@@ -28,7 +90,7 @@ static uint16_t settings;
 void cchamp_config_set(uint16_t config, char op)
 {
     // Value must be either 0 or 1.
-    if (op & 0xFE != 0) return;
+    if ((op & 0xFE) != 0) return;
 
     if (op == 0) {
         settings &= ~config;
@@ -58,3 +120,162 @@ char cchamp_config_get(uint16_t config)
 
     return settings & config;
 }
+
+
+/**
+ * Overrides the value of a tunable.
+ *
+ * @param key   One of the CCHAMP_CONFIG_* constants.
+ * @param value The new value.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the key is unknown or the value is out of its bounds.
+ */
+int cchamp_config_set_int(int key, int64_t value)
+{
+    if (key < 0 || key >= TUNABLES || value < tunables[key].minimum || value > tunables[key].maximum) {
+        return 1;
+    }
+
+    // Tunables are read by other threads (i.e. the region workers) without any lock.
+    __atomic_store_n(&values[key], value, __ATOMIC_RELAXED);
+    return 0;
+}
+
+
+/**
+ * Acquires the current value of a tunable.
+ *
+ * @param key One of the CCHAMP_CONFIG_* constants.
+ *
+ * @return The value of the tunable; or <br>
+ *         0 if the key is unknown.
+ */
+int64_t cchamp_config_get_int(int key)
+{
+    if (key < 0 || key >= TUNABLES) {
+        return 0;
+    }
+
+    return __atomic_load_n(&values[key], __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Sets a tunable from its textual name and value.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the name is unknown or the value malformed or out of bounds.
+ */
+static int __config_set_named(const char* name, size_t length, const char* value)
+{
+    char* end;
+
+    if (length == 8 && strncasecmp(name, "base_url", length) == 0) {
+        char url[CCHAMP_BASE_URL_MAX];
+        size_t size = strlen(value);
+
+        while (size > 0 && isspace((unsigned char)value[size - 1])) size--;
+        if (size >= sizeof(url)) {
+            return 1;
+        }
+
+        memcpy(url, value, size);
+        url[size] = 0x00;
+        return cchamp_set_base_url(url);
+    }
+
+    for (int key = 0; key < TUNABLES; key++) {
+        if (strlen(tunables[key].name) == length && strncasecmp(tunables[key].name, name, length) == 0) {
+            int64_t number = strtoll(value, &end, 10);
+
+            while (isspace((unsigned char)*end)) end++;
+            if (end == value || *end != 0x00) {
+                return 1;
+            }
+
+            return cchamp_config_set_int(key, number);
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * Loads the tunables set in the environment, as CCHAMP_<NAME> (i.e. CCHAMP_CHANNEL_BLOCKS), and CCHAMP_BASE_URL.
+ *
+ * @return 0 on success; or <br>
+ *         1 if any of them was invalid (the valid ones are applied regardless).
+ */
+int cchamp_config_load_env()
+{
+    char variable[64];
+    int failed = 0;
+
+    for (int key = 0; key < TUNABLES; key++) {
+        int length = snprintf(variable, sizeof(variable), "CCHAMP_%s", tunables[key].name);
+
+        for (int i = 7; i < length; i++) {
+            variable[i] = toupper((unsigned char)variable[i]);
+        }
+
+        char* value = getenv(variable);
+        if (value != NULL) {
+            failed |= __config_set_named(tunables[key].name, strlen(tunables[key].name), value);
+        }
+    }
+
+    char* url = getenv("CCHAMP_BASE_URL");
+    if (url != NULL) {
+        failed |= __config_set_named("base_url", 8, url);
+    }
+
+    return failed;
+}
+
+
+/**
+ * Loads the tunables set in a file of "name = value" lines. Blank lines and '#' comments are skipped.
+ *
+ * @param path The path of the file.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the file could not be read or any of its lines was invalid (the valid ones are applied regardless).
+ */
+int cchamp_config_load_file(char* path)
+{
+    char line[256];
+    int failed = 0;
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = 0x00;
+
+        char* name = line;
+        while (isspace((unsigned char)*name)) name++;
+        if (*name == 0x00) continue;
+
+        char* equals = strchr(name, '=');
+        if (equals == NULL) {
+            failed = 1;
+            continue;
+        }
+
+        char* end = equals;
+        while (end > name && isspace((unsigned char)end[-1])) end--;
+
+        char* value = equals + 1;
+        while (isspace((unsigned char)*value)) value++;
+
+        failed |= __config_set_named(name, end - name, value);
+    }
+
+    fclose(file);
+    return failed;
+}
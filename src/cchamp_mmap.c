@@ -0,0 +1,181 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <cchamp/cchamp.h>
+#include "cchamp_utils.h"
+#include "cchamp_mmap.h"
+
+/*
+ * Memory policy modes of mbind(2), from <numaif.h>. libnuma is not required to bind pages.
+ */
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+/*
+ * Every anonymous region of the library (the channel buffer and the static categories) is mapped through
+ * mmap_anonymous(), which applies the mapping policies selected with cchamp_config_set():
+ *
+ *  - CCHAMP_MAP_HUGEPAGES backs the channel buffer with reserved huge pages when available, and asks for
+ *    transparent huge pages on any region of at least HUGE_PAGE_SIZE.
+ *  - CCHAMP_MAP_NUMA_LOCAL prefers the NUMA node of the calling thread for the pages of a region.
+ *  - CCHAMP_MAP_POPULATE faults all pages in when a region is mapped or grown, rather than on first touch.
+ *
+ * Pages are only populated once the other policies are in place, as they decide where the pages are faulted.
+ *
+ * A region may also be reserved (MMAP_RESERVE): it takes address space but no memory until parts of it are
+ * committed, and the policies then apply to each part as it is committed. Decommitted parts give their pages
+ * back to the OS and become inaccessible again.
+ */
+
+
+/**
+ * Prefers the NUMA node of the calling thread for the pages of a region.
+ * Pages that were already faulted in are not moved.
+ */
+static void __mmap_bind_local(void* addr, size_t size)
+{
+    unsigned int cpu, node;
+    unsigned long mask;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= sizeof(mask) * 8) {
+        return;
+    }
+
+    mask = 1UL << node;
+    syscall(SYS_mbind, addr, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+}
+
+
+/**
+ * Faults in the pages of a region for writing.
+ * Kernels without MADV_POPULATE_WRITE (Linux 5.14) have every page touched instead.
+ */
+static void __mmap_populate(void* addr, size_t size)
+{
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(addr, size, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        ((volatile char *)addr)[offset] = 0;
+    }
+}
+
+
+/**
+ * Applies the configured mapping policies to an anonymous region, after it was mapped or grown.
+ *
+ * @param addr      The beginning of the region.
+ * @param size      The size of the region.
+ * @param touched   The number of bytes at the beginning of the region that may already hold data. Only the
+ *                  pages after them are populated.
+ */
+void mmap_advise(void* addr, size_t size, size_t touched)
+{
+    if (cchamp_config_get(CCHAMP_MAP_HUGEPAGES) && size >= HUGE_PAGE_SIZE) {
+        madvise(addr, size, MADV_HUGEPAGE);
+    }
+
+    if (cchamp_config_get(CCHAMP_MAP_NUMA_LOCAL)) {
+        __mmap_bind_local(addr, size);
+    }
+
+    touched = PAGE_ALIGN(touched);
+    if (cchamp_config_get(CCHAMP_MAP_POPULATE) && touched < size) {
+        __mmap_populate((char *)addr + touched, size - touched);
+    }
+}
+
+
+/**
+ * Maps an anonymous, private and writable region under the configured mapping policies.
+ *
+ * @param size  The size of the region, in bytes.
+ * @param flags MMAP_HUGETLB if the region may be backed by reserved huge pages (it is never remapped), or
+ *              MMAP_RESERVE if the region is only reserved, to be committed with mmap_commit().
+ *
+ * @return The address of the region; or <br>
+ *         MAP_FAILED if the region could not be mapped.
+ */
+void* mmap_anonymous(size_t size, int flags)
+{
+    void* addr = MAP_FAILED;
+
+    if (flags & MMAP_RESERVE) {
+        return mmap(NULL, size, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    }
+
+    // Reserved huge pages are scarce; the region falls back to regular pages when none are left.
+    if ((flags & MMAP_HUGETLB) && cchamp_config_get(CCHAMP_MAP_HUGEPAGES) && size % HUGE_PAGE_SIZE == 0) {
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
+    }
+
+    if (addr == MAP_FAILED) {
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (addr == MAP_FAILED) {
+            return MAP_FAILED;
+        }
+    }
+
+    mmap_advise(addr, size, 0);
+    return addr;
+}
+
+
+/**
+ * Commits part of a region reserved with MMAP_RESERVE, under the configured mapping policies.
+ *
+ * @param addr  The beginning of the part, page aligned.
+ * @param size  The size of the part.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the pages could not be made accessible.
+ */
+int mmap_commit(void* addr, size_t size)
+{
+    if (mprotect(addr, size, PROT_READ | PROT_WRITE) != 0) {
+        return 1;
+    }
+
+    mmap_advise(addr, size, 0);
+    return 0;
+}
+
+
+/**
+ * Gives the pages of a committed part of a reserved region back to the OS. The part stays reserved.
+ *
+ * @param addr  The beginning of the part, page aligned.
+ * @param size  The size of the part.
+ * @param lazy  Non-zero if the OS may leave the pages in place until it runs short of memory (MADV_FREE, on
+ *              Linux 4.5 and later), which is cheaper if they are committed again soon; otherwise they are
+ *              dropped at once (MADV_DONTNEED).
+ */
+void mmap_decommit(void* addr, size_t size, int lazy)
+{
+#ifdef MADV_FREE
+    if (!lazy || madvise(addr, size, MADV_FREE) != 0)
+#endif
+    madvise(addr, size, MADV_DONTNEED);
+
+    mprotect(addr, size, PROT_NONE);
+}
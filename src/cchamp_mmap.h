@@ -0,0 +1,32 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_MMAP_H
+#define CCHAMP_MMAP_H
+#include <stddef.h>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Allows mmap_anonymous() to back a mapping with reserved huge pages (MAP_HUGETLB). It can never be remapped.
+#define MMAP_HUGETLB 0x01
+
+// Has mmap_anonymous() only reserve the address space of a region; its pages are committed with mmap_commit().
+#define MMAP_RESERVE 0x02
+
+void*  mmap_anonymous(size_t size, int flags);
+void   mmap_advise(void* addr, size_t size, size_t touched);
+int    mmap_commit(void* addr, size_t size);
+void   mmap_decommit(void* addr, size_t size, int lazy);
+#endif
@@ -15,8 +15,13 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <cchamp/cchamp.h>
 #include "cchamp_utils.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 
 /**
  * Acquires the index of the set bit by shifting the bits until the value becomes zero.
@@ -39,31 +44,213 @@ char get_bit_index(uint16_t val)
 
 
 /**
- * Replaces all illegal web strings (i.e. spaces) to their safe equivalent.
- * Always remember to free the returned string after usage is complete.
+ * Reads a number out of a JSON object.
+ *
+ * @param object    The JSON object.
+ * @param key       The name of the number.
+ *
+ * @return The number; or <br>
+ *         0 if it is missing.
+ */
+double json_number(cJSON* object, char* key)
+{
+    cJSON* item = cJSON_GetObjectItemCaseSensitive(object, key);
+    return cJSON_IsNumber(item) ? item->valuedouble : 0;
+}
+
+
+/**
+ * Copies a string out of a JSON object, truncated to the destination; empty if it is missing.
+ *
+ * @param dest      The destination of the string.
+ * @param size      The size of the destination, including the null-terminator.
+ * @param object    The JSON object.
+ * @param key       The name of the string.
+ */
+void json_string(char* dest, size_t size, cJSON* object, char* key)
+{
+    cJSON* item = cJSON_GetObjectItemCaseSensitive(object, key);
+
+    memset(dest, 0x00, size);
+    if (cJSON_IsString(item)) {
+        strncpy(dest, item->valuestring, size - 1);
+    }
+}
+
+
+/*
+ * Percent-encoding (RFC 3986) leaves only unreserved characters as they are: letters, digits and "-._~".
+ * Every other byte, including each byte of a multi-byte UTF-8 sequence, is written as %XX.
+ */
+static const char __hex[] = "0123456789ABCDEF";
+
+static inline int __webstr_unreserved(unsigned char c, int flags)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || c == '-' || c == '.' || c == '_' || c == '~' || (c == '/' && (flags & WEBSTR_PATH));
+}
+
+#ifdef __SSE2__
+
+// Sets the lanes of v that fall within [lo, hi]. Bytes >= 0x80 are negative, so they never match.
+#define __WEBSTR_RANGE(v, lo, hi) \
+    _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((lo) - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8((hi) + 1)))
+
+/**
+ * Tests 16 bytes at once for unreserved characters.
+ *
+ * @return A mask with bit N set if byte N of the block is unreserved.
+ */
+static inline int __webstr_unreserved_block(__m128i v, int flags)
+{
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i safe = __WEBSTR_RANGE(lower, 'a', 'z');
+
+    safe = _mm_or_si128(safe, __WEBSTR_RANGE(v, '0', '9'));
+    safe = _mm_or_si128(safe, _mm_cmpeq_epi8(v, _mm_set1_epi8('-')));
+    safe = _mm_or_si128(safe, _mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+    safe = _mm_or_si128(safe, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    safe = _mm_or_si128(safe, _mm_cmpeq_epi8(v, _mm_set1_epi8('~')));
+
+    if (flags & WEBSTR_PATH) {
+        safe = _mm_or_si128(safe, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+    }
+
+    return _mm_movemask_epi8(safe);
+}
+#endif
+
+
+/**
+ * Percent-encodes a string so that it may be used within a url.
+ *
+ * Blocks of 16 bytes without anything to escape (the vast majority of ids and names) are copied at once.
+ *
+ * @param dest      The destination of the encoded string.
+ * @param size      The size of the destination, including the null-terminator.
+ * @param unsafe    A potentially web unsafe string, in UTF-8.
+ * @param flags     WEBSTR_PATH to leave "/" unescaped (i.e. for path qualifiers); 0 otherwise.
  *
- * @param unsafe A potentially web unsafe string.
+ * @return The length of the encoded string; or <br>
+ *         -1 if it does not fit in the destination, which is then left empty.
  */
-void webstr(char* dest, char* unsafe)
+int webstr(char* dest, size_t size, const char* unsafe, int flags)
 {
-    int len = strlen(unsafe);
-
-    // I allocate len * 3 because at worst case, the whole string could be just spaces
-    // and it would require len * 3 bytes to satisfy the translation.
-    char safe[len * 3];
-    int i = 0, j = 0;
-    for (int i = 0; i < len; i++) {
-        if (unsafe[i] == ' ') {
-            safe[j++] = '%';
-            safe[j++] = '2';
-            safe[j++] = '0';
+    size_t len = strlen(unsafe);
+    size_t i = 0, j = 0;
+
+    if (size == 0) return -1;
+
+#ifdef __SSE2__
+    for (; i + 16 <= len && j + 16 < size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(unsafe + i));
+        int safe = __webstr_unreserved_block(v, flags);
+
+        if (safe == 0xFFFF) {
+            _mm_storeu_si128((__m128i *)(dest + j), v);
+            j += 16;
+            continue;
+        }
+
+        for (int k = 0; k < 16; k++) {
+            unsigned char c = unsafe[i + k];
+
+            if (safe & (1 << k)) {
+                if (j + 1 >= size) goto overflow;
+                dest[j++] = c;
+            } else {
+                if (j + 3 >= size) goto overflow;
+                dest[j++] = '%';
+                dest[j++] = __hex[c >> 4];
+                dest[j++] = __hex[c & 0x0F];
+            }
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        unsigned char c = unsafe[i];
+
+        if (__webstr_unreserved(c, flags)) {
+            if (j + 1 >= size) goto overflow;
+            dest[j++] = c;
+        } else {
+            if (j + 3 >= size) goto overflow;
+            dest[j++] = '%';
+            dest[j++] = __hex[c >> 4];
+            dest[j++] = __hex[c & 0x0F];
+        }
+    }
+
+    dest[j] = 0x00;
+    return j;
+
+overflow:
+    dest[0] = 0x00;
+    return -1;
+}
+
+
+/**
+ * Writes the canonical form of a summoner name, under which names that Riot considers the same are equal:
+ * whitespace is removed and letters are lowercased. Besides ASCII, uppercase letters of the Latin-1, Greek and
+ * Cyrillic blocks are lowercased, which keeps the length of their UTF-8 sequences.
+ *
+ * @param dest  The destination of the canonical name.
+ * @param size  The size of the destination, including the null-terminator.
+ * @param name  The summoner name, in UTF-8.
+ *
+ * @return The length of the canonical name; or <br>
+ *         -1 if it does not fit in the destination, which is then left empty.
+ */
+int cchamp_canonical_name(char* dest, size_t size, const char* name)
+{
+    const unsigned char* c = (const unsigned char *)name;
+    size_t j = 0;
+
+    while (*c != 0x00) {
+        unsigned char lead = c[0], next = c[1];
+
+        if (lead == ' ' || (lead >= '\t' && lead <= '\r')) {
+            c++;
+            continue;
+        }
+
+        // Lowercasing keeps the length of every sequence; the whole sequence and the null-terminator must fit.
+        int length = lead >= 0xC0 && next >= 0x80 && next <= 0xBF ? 2 : 1;
+        if (j + length >= size) {
+            dest[0] = 0x00;
+            return -1;
+        }
+
+        if (lead >= 'A' && lead <= 'Z') {
+            dest[j++] = lead + 0x20;
+            c++;
+        } else if (lead == 0xC3 && next >= 0x80 && next <= 0x9E && next != 0x97) {
+
+            // U+00C0 - U+00DE (except U+00D7, the multiplication sign) map to U+00E0 - U+00FE.
+            dest[j++] = lead;
+            dest[j++] = next + 0x20;
+            c += 2;
+        } else if (lead == 0xCE && next >= 0x91 && next <= 0xA9 && next != 0xA2) {
+
+            // Greek capitals U+0391 - U+03A9 map to U+03B1 - U+03C9.
+            dest[j++] = next < 0xA0 ? 0xCE : 0xCF;
+            dest[j++] = next < 0xA0 ? next + 0x20 : next - 0x20;
+            c += 2;
+        } else if (lead == 0xD0 && next >= 0x80 && next <= 0xAF) {
+
+            // Cyrillic capitals U+0400 - U+040F map to U+0450 - U+045F, and U+0410 - U+042F to U+0430 - U+044F.
+            dest[j++] = next < 0x90 || next >= 0xA0 ? 0xD1 : 0xD0;
+            dest[j++] = next < 0x90 ? next + 0x10 : next < 0xA0 ? next + 0x20 : next - 0x20;
+            c += 2;
         } else {
-            safe[j++] = unsafe[i];
+            memcpy(dest + j, c, length);
+            j += length;
+            c += length;
         }
     }
 
-    // Must null-terminate the local string to guarantee that a strlen() call would return
-    // the correct size of the string.
-    safe[j] = 0x00;
-    memcpy(dest, safe, strlen(safe));
+    dest[j] = 0x00;
+    return j;
 }
@@ -16,9 +16,19 @@
 #ifndef CCHAMP_UTILS_H
 #define CCHAMP_UTILS_H
 #include <inttypes.h>
+#include <stddef.h>
+#include <cJSON.h>
 
 #define PAGE_SIZE 4096
 
+// Rounds a size (in bytes) up to a whole number of pages.
+#define PAGE_ALIGN(size) (((size) + PAGE_SIZE - 1) & ~((uint64_t)PAGE_SIZE - 1))
+
+// Leaves "/" unescaped in webstr(), for the fixed parts of an API path (never for user values).
+#define WEBSTR_PATH 0x01
+
 char   get_bit_index(uint16_t val);
-void   webstr(char *dest, char *str);
+int    webstr(char* dest, size_t size, const char* unsafe, int flags);
+double json_number(cJSON* object, char* key);
+void   json_string(char* dest, size_t size, cJSON* object, char* key);
 #endif
@@ -0,0 +1,636 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include <network/riot/api.h>
+#include <network/riot/dispatch.h>
+#include <network/riot/rate.h>
+#include <network/riot/breaker.h>
+#include "match.h"
+
+#define CRAWLER_REGIONS         11
+
+// The kinds of nodes of the graph; a player is crawled through the player's match list.
+#define CRAWL_PLAYER            0
+#define CRAWL_MATCH             1
+
+// The probes of the visited filter; with 10 bits per node, 7 probes give a 1% false positive rate.
+#define CRAWLER_PROBES          7
+#define CRAWLER_BITS_PER_NODE   10
+
+#define CRAWLER_MAGIC           0x57524343
+#define CRAWLER_FORMAT          1
+
+/*
+ * The nodes of a kind waiting to be crawled in a region, in a ring.
+ */
+struct crawler_queue {
+    uint64_t*   nodes;
+    uint32_t    head;
+    uint32_t    count;
+    uint32_t    capacity;
+};
+
+struct crawler_region {
+    struct crawler_queue    queues[2];
+    int                     inflight;
+};
+
+struct crawler_call {
+    Crawler*    crawler;
+    uint16_t    region;
+    int         kind;
+    uint64_t    node;
+    int         used;
+};
+
+struct crawler {
+    crawler_callback        callback;
+    void*                   data;
+    uint32_t                matches_per_player;
+    int                     stopped;
+
+    // Nodes discovered past this many in a queue are dropped (and left unvisited, to be discovered again).
+    uint32_t                queue_max;
+    uint64_t                delivered;
+
+    // Nodes in flight that could not be queued again, as memory ran out (see __crawler_requeue()).
+    uint64_t                lost;
+
+    // The visited filter, a power of 2 of bits.
+    uint64_t*               visited;
+    uint64_t                words;
+
+    int                     cursor;
+    struct crawler_region   regions[CRAWLER_REGIONS];
+    struct crawler_call     calls[DISPATCH_SLOTS];
+
+    MatchList               list;
+    Match                   match;
+};
+
+/*
+ * The layout of a checkpoint: the header, the visited filter, then the queues of every region (players, then
+ * matches), nodes in flight included.
+ */
+struct crawler_header {
+    uint32_t    magic;
+    uint32_t    format;
+    uint64_t    words;
+    uint64_t    delivered;
+    uint32_t    matches_per_player;
+    uint32_t    counts[CRAWLER_REGIONS][2];
+};
+
+
+/**
+ * Mixes the bits of a 64-bit value (the finalizer of splitmix64).
+ */
+static uint64_t __crawler_mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+
+/**
+ * Marks a node as visited.
+ *
+ * @return 1 if the node was (most likely) visited already; or <br>
+ *         0 if it was not.
+ */
+static int __crawler_visit(Crawler* crawler, uint16_t region, int kind, uint64_t node)
+{
+    uint64_t hash = __crawler_mix(((uint64_t)kind << 56) ^ ((uint64_t)get_bit_index(region) << 48) ^ node);
+    uint64_t step = __crawler_mix(hash) | 1;
+    uint64_t mask = crawler->words * 64 - 1;
+    int visited = 1;
+
+    for (int i = 0; i < CRAWLER_PROBES; i++, hash += step) {
+        uint64_t bit = 1ULL << (hash & 63);
+        uint64_t* word = crawler->visited + ((hash & mask) >> 6);
+
+        visited &= (*word & bit) != 0;
+        *word |= bit;
+    }
+
+    return visited;
+}
+
+
+/**
+ * Grows a queue until it has room for a number of nodes more.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the queue could not grow.
+ */
+static int __queue_reserve(struct crawler_queue* queue, uint32_t room)
+{
+    if (queue->capacity - queue->count < room) {
+        uint32_t capacity = queue->capacity ? queue->capacity : 256;
+        uint64_t* nodes;
+
+        while (capacity - queue->count < room && capacity * 2 > capacity) {
+            capacity *= 2;
+        }
+
+        if (capacity - queue->count < room || (nodes = malloc(sizeof(uint64_t) * capacity)) == NULL) {
+            return 1;
+        }
+
+        // The ring is unrolled into the larger one.
+        for (uint32_t i = 0; i < queue->count; i++) {
+            nodes[i] = queue->nodes[(queue->head + i) & (queue->capacity - 1)];
+        }
+
+        free(queue->nodes);
+        queue->nodes = nodes;
+        queue->capacity = capacity;
+        queue->head = 0;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Appends a node to a queue, growing it as needed.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the queue could not grow.
+ */
+static int __queue_push(struct crawler_queue* queue, uint64_t node)
+{
+    if (__queue_reserve(queue, 1)) {
+        return 1;
+    }
+
+    queue->nodes[(queue->head + queue->count++) & (queue->capacity - 1)] = node;
+    return 0;
+}
+
+
+/**
+ * Takes the oldest node of a queue, which must not be empty.
+ */
+static uint64_t __queue_pop(struct crawler_queue* queue)
+{
+    uint64_t node = queue->nodes[queue->head];
+
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->count--;
+    return node;
+}
+
+
+/**
+ * Queues a node for crawling, unless it was visited already.
+ */
+static void __crawler_discover(Crawler* crawler, uint16_t region, int kind, uint64_t node)
+{
+    struct crawler_region* crawling = crawler->regions + get_bit_index(region);
+    struct crawler_queue* queue = &crawling->queues[kind];
+
+    /*
+     * A full queue would lose the node; it is tested without being marked first, so that it stays unvisited
+     * and may be discovered again once the queue drains. Room is made before the node is marked for the same
+     * reason, along with room for every node of the region in flight, so that those can always be queued again
+     * (see __crawler_requeue()).
+     */
+    if (queue->count >= crawler->queue_max || __queue_reserve(queue, 1 + crawling->inflight)) {
+        return;
+    }
+
+    if (!__crawler_visit(crawler, region, kind, node)) {
+        __queue_push(queue, node);
+    }
+}
+
+
+/**
+ * Queues the node of a call again, into the room kept for it by __crawler_discover().
+ *
+ * @return 0 on success; or <br>
+ *         1 if the queue could not grow (the node is then lost).
+ */
+static int __crawler_requeue(Crawler* crawler, struct crawler_call* call)
+{
+    struct crawler_region* region = crawler->regions + get_bit_index(call->region);
+
+    region->inflight--;
+    call->used = 0;
+    return __queue_push(&region->queues[call->kind], call->node);
+}
+
+
+/**
+ * Follows the matches of a player, or the participants of a match, and hands the match to the callback.
+ */
+static void __crawler_received(Request* req, uint16_t status, void* data)
+{
+    struct crawler_call* call = data;
+    Crawler* crawler = call->crawler;
+
+    // A node of a region found down is crawled once it is back; nodes that failed otherwise are left out.
+    if (status == ECIRCUIT) {
+        if (__crawler_requeue(crawler, call)) {
+            crawler->lost++;
+        }
+
+        return;
+    }
+
+    crawler->regions[(int)get_bit_index(call->region)].inflight--;
+    call->used = 0;
+
+    if (status != EPASS) {
+        return;
+    }
+
+    if (call->kind == CRAWL_PLAYER) {
+        if (match_list_parse(req->response.addr, &crawler->list) == NULL) return;
+
+        for (uint32_t i = 0; i < crawler->list.count && i < crawler->matches_per_player; i++) {
+            __crawler_discover(crawler, call->region, CRAWL_MATCH, crawler->list.matches[i].game_id);
+        }
+    } else {
+        if (match_parse(req->response.addr, &crawler->match) == NULL) return;
+
+        for (int i = 0; i < crawler->match.participants_count; i++) {
+            if (crawler->match.participants[i].account_id != 0) {
+                __crawler_discover(crawler, call->region, CRAWL_PLAYER, crawler->match.participants[i].account_id);
+            }
+        }
+
+        crawler->delivered++;
+        crawler->callback(call->region, &crawler->match, crawler->data);
+    }
+}
+
+
+/**
+ * Allocates a crawler with an empty visited filter of a number of words.
+ */
+static Crawler* __crawler_allocate(uint64_t words, uint32_t matches_per_player, crawler_callback callback, void* data)
+{
+    Crawler* crawler = calloc(1, sizeof(Crawler));
+
+    if (crawler == NULL || (crawler->visited = calloc(words, sizeof(uint64_t))) == NULL) {
+        free(crawler);
+        return NULL;
+    }
+
+    crawler->words = words;
+    crawler->matches_per_player = matches_per_player;
+    crawler->queue_max = cchamp_config_get_int(CCHAMP_CONFIG_CRAWLER_QUEUE_MAX);
+    crawler->callback = callback;
+    crawler->data = data;
+    return crawler;
+}
+
+
+/**
+ * Creates a crawler without any node to crawl.
+ *
+ * @param capacity              The number of players and matches the visited filter is sized for.
+ * @param matches_per_player    The number of the most recent matches of a player to follow (at most
+ *                              MATCHLIST_PAGE_SIZE).
+ * @param callback              Invoked for every match, from within cchamp_crawler_run().
+ * @param data                  Passed on to the callback.
+ *
+ * @return The crawler, to be freed with cchamp_crawler_free(); or <br>
+ *         NULL if memory ran out.
+ */
+Crawler* cchamp_crawler_create(uint32_t capacity, uint32_t matches_per_player, crawler_callback callback, void* data)
+{
+    uint64_t words = 1;
+
+    while (words * 64 < (uint64_t)capacity * CRAWLER_BITS_PER_NODE) {
+        words <<= 1;
+    }
+
+    return __crawler_allocate(words, matches_per_player, callback, data);
+}
+
+
+/**
+ * Queues a player to be crawled, unless the player was visited already.
+ *
+ * @return 0 if the player was queued; or <br>
+ *         1 if the player was visited already, or the queue is full.
+ */
+int cchamp_crawler_seed(Crawler* crawler, uint16_t region, uint32_t account_id)
+{
+    struct crawler_queue* queue = &crawler->regions[(int)get_bit_index(region)].queues[CRAWL_PLAYER];
+    uint32_t count = queue->count;
+
+    __crawler_discover(crawler, region, CRAWL_PLAYER, account_id);
+    return queue->count == count;
+}
+
+
+/**
+ * Crawls the graph.
+ *
+ * @param crawler   The crawler.
+ * @param duration  The time to run for, in milliseconds; 0 to run until the graph is exhausted or
+ *                  cchamp_crawler_stop().
+ *
+ * @return The number of matches handed to the callback; or <br>
+ *         -1 if the crawl could not start, or memory ran out for nodes to crawl again (see cc_error).
+ */
+int cchamp_crawler_run(Crawler* crawler, unsigned int duration)
+{
+    Dispatcher* dispatcher = malloc(sizeof(Dispatcher));
+    uint64_t delivered = crawler->delivered;
+    uint64_t lost = crawler->lost;
+    uint64_t end = rate_now() + duration;
+
+    if (dispatcher == NULL || dispatch_init(dispatcher)) {
+        free(dispatcher);
+        return -1;
+    }
+
+    __atomic_store_n(&crawler->stopped, 0, __ATOMIC_RELAXED);
+
+    while (!__atomic_load_n(&crawler->stopped, __ATOMIC_RELAXED) && (duration == 0 || rate_now() < end)) {
+        int active = 0, wait = 1000, limited = 0;
+
+        for (int r = 0; r < CRAWLER_REGIONS; r++) {
+            struct crawler_region* region = crawler->regions + r;
+            active += region->queues[CRAWL_PLAYER].count + region->queues[CRAWL_MATCH].count > 0 || region->inflight > 0;
+        }
+
+        if (active == 0) {
+            break;
+        }
+
+        // The slots are shared evenly among the regions with nodes left, so that every region keeps sending.
+        int share = dispatcher->size / active > 1 ? dispatcher->size / active : 1;
+
+        for (int visited = 0; visited < CRAWLER_REGIONS; visited++) {
+            int r = crawler->cursor = (crawler->cursor + 1) % CRAWLER_REGIONS;
+            struct crawler_region* region = crawler->regions + r;
+            Request* req;
+            int ready;
+
+            while (region->inflight < share && region->queues[CRAWL_PLAYER].count + region->queues[CRAWL_MATCH].count > 0) {
+
+                // Requests are only handed to the dispatcher once the region has room (and is up), so none sits waiting.
+                if ((ready = rate_ready(1 << r)) != 0 || (ready = breaker_ready(1 << r, API_MATCH)) != 0) {
+                    wait = ready < wait ? ready : wait;
+                    limited = 1;
+                    break;
+                }
+
+                if ((req = dispatch_request(dispatcher)) == NULL) {
+                    break;
+                }
+
+                struct crawler_call* call = crawler->calls;
+                while (call->used) call++;
+
+                // Matches go first: they yield data, and keep the frontier of players from growing unbounded.
+                call->crawler = crawler;
+                call->region = 1 << r;
+                call->kind = region->queues[CRAWL_MATCH].count > 0 ? CRAWL_MATCH : CRAWL_PLAYER;
+                call->node = __queue_pop(&region->queues[call->kind]);
+                call->used = 1;
+                region->inflight++;
+
+                if (call->kind == CRAWL_MATCH) {
+                    match_request(req, call->region, call->node);
+                } else {
+                    char account_id[16];
+                    sprintf(account_id, "%u", (uint32_t)call->node);
+                    match_list_request(req, call->region, account_id, 0);
+                }
+
+                dispatch_submit(dispatcher, req, __crawler_received, call);
+            }
+        }
+
+        // Without any request in flight, the dispatcher returns right away and the rate limits are slept on.
+        if (dispatch_run(dispatcher, wait) == 0 && limited) {
+            struct timespec delay = { .tv_sec = wait / 1000, .tv_nsec = (wait % 1000) * 1000000L };
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    dispatch_cleanup(dispatcher);
+    free(dispatcher);
+
+    // The nodes still in flight are queued again, to be crawled by the next run.
+    for (int i = 0; i < DISPATCH_SLOTS; i++) {
+        struct crawler_call* call = crawler->calls + i;
+
+        if (call->used && __crawler_requeue(crawler, call)) {
+            crawler->lost++;
+        }
+    }
+
+    if (crawler->lost != lost) {
+        cc_error = E2MANY;
+        return -1;
+    }
+
+    return crawler->delivered - delivered;
+}
+
+
+/**
+ * Stops cchamp_crawler_run() before it sends more requests. The requests in progress are dropped, and their
+ * players and matches queued again for the next run. May be invoked from any thread, or from the callback.
+ */
+void cchamp_crawler_stop(Crawler* crawler)
+{
+    __atomic_store_n(&crawler->stopped, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Writes a block in full.
+ */
+static int __crawler_write(int fd, const void* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written <= 0) return 1;
+
+        data = (const char *)data + written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Saves the state of a crawler: the visited filter, and the queued nodes along with those in flight.
+ *
+ * The checkpoint is written to a temporary file which is then renamed over path, so that a crash while
+ * checkpointing leaves the previous checkpoint intact.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the checkpoint could not be written.
+ */
+int cchamp_crawler_checkpoint(Crawler* crawler, char* path)
+{
+    struct crawler_header header;
+    char tmp[PATH_MAX];
+
+    if (snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid()) >= (int)sizeof(tmp)) {
+        return 1;
+    }
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return 1;
+    }
+
+    memset(&header, 0x00, sizeof(header));
+    header.magic = CRAWLER_MAGIC;
+    header.format = CRAWLER_FORMAT;
+    header.words = crawler->words;
+    header.delivered = crawler->delivered;
+    header.matches_per_player = crawler->matches_per_player;
+
+    for (int r = 0; r < CRAWLER_REGIONS; r++) {
+        header.counts[r][CRAWL_PLAYER] = crawler->regions[r].queues[CRAWL_PLAYER].count;
+        header.counts[r][CRAWL_MATCH] = crawler->regions[r].queues[CRAWL_MATCH].count;
+    }
+
+    for (int i = 0; i < DISPATCH_SLOTS; i++) {
+        if (crawler->calls[i].used) {
+            header.counts[(int)get_bit_index(crawler->calls[i].region)][crawler->calls[i].kind]++;
+        }
+    }
+
+    int failed = __crawler_write(fd, &header, sizeof(header))
+              || __crawler_write(fd, crawler->visited, sizeof(uint64_t) * crawler->words);
+
+    for (int r = 0; r < CRAWLER_REGIONS && !failed; r++) {
+        for (int kind = CRAWL_PLAYER; kind <= CRAWL_MATCH && !failed; kind++) {
+            struct crawler_queue* queue = &crawler->regions[r].queues[kind];
+
+            // A ring is written in (at most) two runs.
+            uint32_t first = queue->capacity - queue->head < queue->count ? queue->capacity - queue->head : queue->count;
+            failed = (first > 0 && __crawler_write(fd, queue->nodes + queue->head, sizeof(uint64_t) * first))
+                  || (first < queue->count && __crawler_write(fd, queue->nodes, sizeof(uint64_t) * (queue->count - first)));
+
+            for (int i = 0; i < DISPATCH_SLOTS && !failed; i++) {
+                struct crawler_call* call = crawler->calls + i;
+
+                if (call->used && call->kind == kind && get_bit_index(call->region) == r) {
+                    failed = __crawler_write(fd, &call->node, sizeof(uint64_t));
+                }
+            }
+        }
+    }
+
+    failed = close(fd) != 0 || failed;
+
+    if (failed || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Resumes a crawl from a checkpoint.
+ *
+ * @param path      The path of the checkpoint.
+ * @param callback  Invoked for every match, from within cchamp_crawler_run().
+ * @param data      Passed on to the callback.
+ *
+ * @return The crawler, to be freed with cchamp_crawler_free(); or <br>
+ *         NULL if the checkpoint could not be read.
+ */
+Crawler* cchamp_crawler_restore(char* path, crawler_callback callback, void* data)
+{
+    struct crawler_header header;
+    Crawler* crawler = NULL;
+    int failed = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (read(fd, &header, sizeof(header)) != sizeof(header) || header.magic != CRAWLER_MAGIC
+            || header.format != CRAWLER_FORMAT || header.words == 0 || (header.words & (header.words - 1)) != 0
+            || (crawler = __crawler_allocate(header.words, header.matches_per_player, callback, data)) == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    crawler->delivered = header.delivered;
+    failed = read(fd, crawler->visited, sizeof(uint64_t) * header.words) != (ssize_t)(sizeof(uint64_t) * header.words);
+
+    for (int r = 0; r < CRAWLER_REGIONS && !failed; r++) {
+        for (int kind = CRAWL_PLAYER; kind <= CRAWL_MATCH && !failed; kind++) {
+            uint64_t nodes[512];
+
+            for (uint32_t i = 0, n; i < header.counts[r][kind] && !failed; i += n) {
+                n = header.counts[r][kind] - i < 512 ? header.counts[r][kind] - i : 512;
+                failed = read(fd, nodes, sizeof(uint64_t) * n) != (ssize_t)(sizeof(uint64_t) * n);
+
+                for (uint32_t j = 0; j < n && !failed; j++) {
+                    failed = __queue_push(&crawler->regions[r].queues[kind], nodes[j]);
+                }
+            }
+        }
+    }
+
+    close(fd);
+
+    if (failed) {
+        cchamp_crawler_free(crawler);
+        return NULL;
+    }
+
+    return crawler;
+}
+
+
+/**
+ * Frees a crawler. It must not be running.
+ */
+void cchamp_crawler_free(Crawler* crawler)
+{
+    if (crawler == NULL) {
+        return;
+    }
+
+    for (int r = 0; r < CRAWLER_REGIONS; r++) {
+        free(crawler->regions[r].queues[CRAWL_PLAYER].nodes);
+        free(crawler->regions[r].queues[CRAWL_MATCH].nodes);
+    }
+
+    free(crawler->visited);
+    free(crawler);
+}
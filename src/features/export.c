@@ -0,0 +1,674 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <cchamp/cchamp.h>
+
+/*
+ * Layout of an export file (all integers are little-endian):
+ *
+ *  header      magic (u32), format (u16), table (u16), columns (u32).
+ *  groups      Any number of row groups, one after the other. A group starts with its row count (u32), the count
+ *              of strings it adds to the dictionary (u32), the size of these strings (u32) and the size of each
+ *              selected column, in the order of their bits (u32 each). The strings follow (each a varint length,
+ *              then its bytes), then the columns.
+ *
+ * Values are unsigned LEB128 varints. A string is the varint index of its entry in the dictionary of the file,
+ * which grows with every group. Delta encoded columns hold the zigzag varint of the difference with the
+ * previous row of the group (or with 0, for the first row), so that groups are read apart from each other but
+ * for the dictionary.
+ */
+#define EXPORT_MAGIC            0x58504343
+#define EXPORT_FORMAT           1
+
+#define EXPORT_TABLES           3
+#define EXPORT_COLUMNS_MAX      16
+
+#define ENCODE_NONE             0
+#define ENCODE_VARINT           1
+#define ENCODE_DELTA            2
+#define ENCODE_DICTIONARY       3
+
+// The encoding of every column of a table, by bit index; a table has the columns with an encoding.
+static const uint8_t __encodings[EXPORT_TABLES][EXPORT_COLUMNS_MAX] = {
+    [EXPORT_MATCHES] = {
+        ENCODE_DELTA, ENCODE_DELTA, ENCODE_VARINT, ENCODE_VARINT, ENCODE_VARINT, ENCODE_VARINT,
+        ENCODE_DICTIONARY
+    },
+    [EXPORT_PARTICIPANTS] = {
+        ENCODE_DELTA, ENCODE_DELTA, ENCODE_DELTA, ENCODE_DICTIONARY, ENCODE_VARINT, ENCODE_VARINT,
+        ENCODE_VARINT, ENCODE_VARINT, ENCODE_VARINT, ENCODE_VARINT, ENCODE_VARINT, ENCODE_VARINT
+    },
+    [EXPORT_SUMMONERS] = {
+        ENCODE_DELTA, ENCODE_DELTA, ENCODE_DICTIONARY, ENCODE_DICTIONARY, ENCODE_VARINT, ENCODE_VARINT
+    }
+};
+
+struct export_header {
+    uint32_t    magic;
+    uint16_t    format;
+    uint16_t    table;
+    uint32_t    columns;
+};
+
+/*
+ * A growing run of bytes.
+ */
+struct export_buffer {
+    uint8_t*    data;
+    size_t      size;
+    size_t      capacity;
+};
+
+struct export_column {
+    struct export_buffer    bytes;
+    uint64_t                previous;
+};
+
+struct exporter {
+    int                     fd;
+    int                     table;
+    uint32_t                columns;
+    int                     failed;
+
+    // The rows of the group being built, column by column (by bit index), up to group_rows.
+    uint32_t                rows;
+    uint32_t                group_rows;
+    struct export_column    values[EXPORT_COLUMNS_MAX];
+
+    /*
+     * The dictionary: the bytes of all strings one after the other, where string i spans from offsets[i] to
+     * offsets[i + 1], and an open-addressing table of their indexes + 1 (0 marks an empty slot), by hash.
+     * The strings added since the last group are also kept encoded, to be written out with it.
+     */
+    struct export_buffer    strings;
+    uint32_t*               offsets;
+    uint32_t                count;
+    uint32_t*               slots;
+    uint32_t                mask;
+
+    struct export_buffer    added;
+    uint32_t                added_count;
+};
+
+
+/**
+ * Converts an integer between host order and the little-endian order of the file; the conversion is its own
+ * inverse.
+ */
+static uint32_t __le32(uint32_t value)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_bswap32(value);
+#else
+    return value;
+#endif
+}
+
+static uint16_t __le16(uint16_t value)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_bswap16(value);
+#else
+    return value;
+#endif
+}
+
+
+/**
+ * Makes room for (size) more bytes in a buffer.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the buffer could not grow.
+ */
+static int __buffer_reserve(struct export_buffer* buffer, size_t size)
+{
+    if (buffer->size + size <= buffer->capacity) {
+        return 0;
+    }
+
+    size_t capacity = buffer->capacity != 0 ? buffer->capacity : 4096;
+    while (capacity < buffer->size + size) {
+        capacity *= 2;
+    }
+
+    uint8_t* data = realloc(buffer->data, capacity);
+    if (data == NULL) {
+        return 1;
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+
+/**
+ * Appends an unsigned LEB128 varint to a buffer.
+ */
+static int __buffer_varint(struct export_buffer* buffer, uint64_t value)
+{
+    if (__buffer_reserve(buffer, 10) != 0) {
+        return 1;
+    }
+
+    while (value >= 0x80) {
+        buffer->data[buffer->size++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+
+    buffer->data[buffer->size++] = (uint8_t)value;
+    return 0;
+}
+
+
+/**
+ * Reads an unsigned LEB128 varint.
+ *
+ * @return The number of bytes read; or <br>
+ *         0 if the varint runs past (end).
+ */
+static size_t __read_varint(const uint8_t* data, const uint8_t* end, uint64_t* value)
+{
+    const uint8_t* start = data;
+    int shift = 0;
+
+    *value = 0;
+    while (data < end && shift < 64) {
+        *value |= (uint64_t)(*data & 0x7F) << shift;
+        if ((*data++ & 0x80) == 0) {
+            return data - start;
+        }
+        shift += 7;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Hashes a string (FNV-1a).
+ */
+static uint32_t __export_hash(const char* value, size_t length)
+{
+    uint32_t hash = 0x811C9DC5;
+
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)value[i]) * 0x01000193;
+    }
+
+    return hash;
+}
+
+
+/**
+ * Doubles the slots of the dictionary, placing its strings again.
+ */
+static int __dictionary_grow(Exporter* exporter)
+{
+    uint32_t size = exporter->mask != 0 ? (exporter->mask + 1) * 2 : 1024;
+    uint32_t* slots = calloc(size, sizeof(uint32_t));
+    uint32_t* offsets = realloc(exporter->offsets, sizeof(uint32_t) * (size / 2 + 1));
+
+    if (slots == NULL || offsets == NULL) {
+        free(slots);
+        if (offsets != NULL) exporter->offsets = offsets;
+        return 1;
+    }
+
+    exporter->offsets = offsets;
+    if (exporter->count == 0) {
+        offsets[0] = 0;
+    }
+
+    for (uint32_t i = 0; i < exporter->count; i++) {
+        uint32_t slot = __export_hash((char *)exporter->strings.data + offsets[i], offsets[i + 1] - offsets[i]);
+
+        while (slots[slot & (size - 1)] != 0) slot++;
+        slots[slot & (size - 1)] = i + 1;
+    }
+
+    free(exporter->slots);
+    exporter->slots = slots;
+    exporter->mask = size - 1;
+    return 0;
+}
+
+
+/**
+ * Finds the index of a string in the dictionary, adding it if it is new.
+ *
+ * @param fresh Set to 1 if the string was added; or 0 if it was in the dictionary already.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the dictionary could not grow.
+ */
+static int __dictionary_index(Exporter* exporter, const char* value, size_t length, uint32_t* index, int* fresh)
+{
+    // The dictionary is kept at most half full, which also leaves room in offsets for the new string.
+    if (exporter->count >= (exporter->mask + 1) / 2 && __dictionary_grow(exporter) != 0) {
+        return 1;
+    }
+
+    uint32_t slot = __export_hash(value, length);
+
+    for (;; slot++) {
+        uint32_t entry = exporter->slots[slot & exporter->mask];
+
+        if (entry == 0) {
+            break;
+        }
+
+        uint32_t start = exporter->offsets[entry - 1];
+        if (exporter->offsets[entry] - start == length && memcmp(exporter->strings.data + start, value, length) == 0) {
+            *index = entry - 1;
+            *fresh = 0;
+            return 0;
+        }
+    }
+
+    if (__buffer_reserve(&exporter->strings, length) != 0) {
+        return 1;
+    }
+
+    memcpy(exporter->strings.data + exporter->strings.size, value, length);
+    exporter->strings.size += length;
+
+    *index = exporter->count++;
+    exporter->offsets[exporter->count] = exporter->strings.size;
+    exporter->slots[slot & exporter->mask] = exporter->count;
+    *fresh = 1;
+    return 0;
+}
+
+
+/**
+ * Appends a value to a column of the current row, if the column is selected.
+ */
+static void __export_value(Exporter* exporter, uint32_t column, uint64_t value)
+{
+    if ((exporter->columns & column) == 0) {
+        return;
+    }
+
+    int index = __builtin_ctz(column);
+    struct export_column* values = exporter->values + index;
+
+    if (__encodings[exporter->table][index] == ENCODE_DELTA) {
+        int64_t delta = (int64_t)(value - values->previous);
+
+        values->previous = value;
+        value = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    }
+
+    exporter->failed |= __buffer_varint(&values->bytes, value);
+}
+
+
+/**
+ * Appends a string to a column of the current row, if the column is selected.
+ */
+static void __export_string(Exporter* exporter, uint32_t column, const char* value)
+{
+    size_t length = strlen(value);
+    uint32_t index;
+    int fresh;
+
+    if ((exporter->columns & column) == 0) {
+        return;
+    }
+
+    if (__dictionary_index(exporter, value, length, &index, &fresh) != 0) {
+        exporter->failed = 1;
+        return;
+    }
+
+    // A string new to the dictionary is written out along with the group.
+    if (fresh) {
+        exporter->failed |= __buffer_varint(&exporter->added, length) || __buffer_reserve(&exporter->added, length);
+
+        if (!exporter->failed) {
+            memcpy(exporter->added.data + exporter->added.size, value, length);
+            exporter->added.size += length;
+            exporter->added_count++;
+        }
+    }
+
+    exporter->failed |= __buffer_varint(&exporter->values[__builtin_ctz(column)].bytes, index);
+}
+
+
+/**
+ * Writes out a set of buffers in full, resuming after partial writes.
+ */
+static int __export_write(int fd, struct iovec* vectors, int count)
+{
+    while (count > 0) {
+        ssize_t written = writev(fd, vectors, count);
+        if (written < 0) return 1;
+
+        while (count > 0 && (size_t)written >= vectors->iov_len) {
+            written -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+
+        if (count > 0) {
+            vectors->iov_base = (char *)vectors->iov_base + written;
+            vectors->iov_len -= written;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Writes out the rows of the current group, with the strings it added to the dictionary, in a single call
+ * (but for partial writes), and starts a new group.
+ *
+ * @param exporter  The exporter.
+ *
+ * @return 0 on success; or <br>
+ *         1 if any write failed so far.
+ */
+int cchamp_export_flush(Exporter* exporter)
+{
+    uint32_t sizes[3 + EXPORT_COLUMNS_MAX];
+    struct iovec vectors[2 + EXPORT_COLUMNS_MAX];
+    int count = 0, columns = 0;
+
+    if (exporter->rows == 0 || exporter->failed) {
+        return exporter->failed;
+    }
+
+    sizes[0] = __le32(exporter->rows);
+    sizes[1] = __le32(exporter->added_count);
+    sizes[2] = __le32(exporter->added.size);
+    vectors[1] = (struct iovec){ exporter->added.data, exporter->added.size };
+    count = 2;
+
+    for (int i = 0; i < EXPORT_COLUMNS_MAX; i++) {
+        if (exporter->columns & (1 << i)) {
+            sizes[3 + columns++] = __le32(exporter->values[i].bytes.size);
+            vectors[count++] = (struct iovec){ exporter->values[i].bytes.data, exporter->values[i].bytes.size };
+        }
+    }
+
+    vectors[0] = (struct iovec){ sizes, sizeof(uint32_t) * (3 + columns) };
+    exporter->failed = __export_write(exporter->fd, vectors, count);
+
+    exporter->rows = 0;
+    exporter->added.size = 0;
+    exporter->added_count = 0;
+
+    for (int i = 0; i < EXPORT_COLUMNS_MAX; i++) {
+        exporter->values[i].bytes.size = 0;
+        exporter->values[i].previous = 0;
+    }
+
+    return exporter->failed;
+}
+
+
+/**
+ * Ends the current row, writing out the group once it is full.
+ */
+static void __export_row(Exporter* exporter)
+{
+    if (++exporter->rows == exporter->group_rows) {
+        cchamp_export_flush(exporter);
+    }
+}
+
+
+/**
+ * Reads the groups of an existing file to rebuild its dictionary, and positions the file after the last whole
+ * group. A group cut short (i.e. by a crash while writing it) is dropped.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the file could not be read.
+ */
+static int __export_resume(Exporter* exporter, int columns)
+{
+    uint32_t sizes[3 + EXPORT_COLUMNS_MAX];
+    off_t end = lseek(exporter->fd, 0, SEEK_END);
+    off_t position = sizeof(struct export_header);
+    size_t header = sizeof(uint32_t) * (3 + columns);
+
+    while (position + (off_t)header <= end) {
+        uint64_t length, columns_size = 0;
+        uint32_t index;
+        int fresh;
+
+        if (pread(exporter->fd, sizes, header, position) != (ssize_t)header) {
+            return 1;
+        }
+
+        for (int i = 0; i < 3 + columns; i++) {
+            sizes[i] = __le32(sizes[i]);
+        }
+
+        for (int i = 0; i < columns; i++) {
+            columns_size += sizes[3 + i];
+        }
+
+        if (position + (off_t)(header + sizes[2] + columns_size) > end) {
+            break;
+        }
+
+        exporter->added.size = 0;
+        if (__buffer_reserve(&exporter->added, sizes[2]) != 0 ||
+            pread(exporter->fd, exporter->added.data, sizes[2], position + header) != (ssize_t)sizes[2]) {
+            return 1;
+        }
+
+        uint8_t* data = exporter->added.data;
+        uint8_t* limit = data + sizes[2];
+
+        for (uint32_t i = 0; i < sizes[1]; i++) {
+            size_t used = __read_varint(data, limit, &length);
+
+            if (used == 0 || length > (uint64_t)(limit - data - used) ||
+                __dictionary_index(exporter, (char *)data + used, length, &index, &fresh) != 0) {
+                return 1;
+            }
+
+            data += used + length;
+        }
+
+        position += header + sizes[2] + columns_size;
+    }
+
+    exporter->added.size = 0;
+
+    if (position != end && ftruncate(exporter->fd, position) != 0) {
+        return 1;
+    }
+
+    return lseek(exporter->fd, position, SEEK_SET) != position;
+}
+
+
+/**
+ * Opens a columnar export of a table.
+ *
+ * @param path      The path of the file, which is appended to if it exists.
+ * @param table     One of the EXPORT_MATCHES, EXPORT_PARTICIPANTS or EXPORT_SUMMONERS constants.
+ * @param columns   The EXPORT_* columns of the table to export, or'ed together; EXPORT_ALL for all of them.
+ *
+ * @return The exporter, to be closed with cchamp_export_close(); or <br>
+ *         NULL if the file could not be opened, or holds another table or other columns.
+ */
+Exporter* cchamp_export_open(char* path, int table, uint32_t columns)
+{
+    struct export_header header;
+    uint32_t valid = 0;
+
+    if (table < 0 || table >= EXPORT_TABLES) {
+        return NULL;
+    }
+
+    for (int i = 0; i < EXPORT_COLUMNS_MAX; i++) {
+        if (__encodings[table][i] != ENCODE_NONE) valid |= 1 << i;
+    }
+
+    if ((columns &= valid) == 0) {
+        return NULL;
+    }
+
+    Exporter* exporter = calloc(1, sizeof(Exporter));
+    if (exporter == NULL) {
+        return NULL;
+    }
+
+    exporter->table = table;
+    exporter->columns = columns;
+    exporter->group_rows = cchamp_config_get_int(CCHAMP_CONFIG_EXPORT_GROUP_ROWS);
+
+    if ((exporter->fd = open(path, O_RDWR | O_CREAT, 0644)) < 0 || __dictionary_grow(exporter) != 0) {
+        cchamp_export_close(exporter);
+        return NULL;
+    }
+
+    ssize_t size = pread(exporter->fd, &header, sizeof(header), 0);
+
+    // A new (or empty) file starts with its header; an existing one must describe the same export.
+    if (size == 0) {
+        header = (struct export_header){ __le32(EXPORT_MAGIC), __le16(EXPORT_FORMAT), __le16(table), __le32(columns) };
+        exporter->failed = __export_write(exporter->fd, &(struct iovec){ &header, sizeof(header) }, 1);
+    } else {
+        exporter->failed = size != sizeof(header) || __le32(header.magic) != EXPORT_MAGIC
+                        || __le16(header.format) != EXPORT_FORMAT || __le16(header.table) != table
+                        || __le32(header.columns) != columns
+                        || __export_resume(exporter, __builtin_popcount(columns));
+    }
+
+    if (exporter->failed) {
+        cchamp_export_close(exporter);
+        return NULL;
+    }
+
+    return exporter;
+}
+
+
+/**
+ * Appends a match to an export of EXPORT_MATCHES (a row), or of EXPORT_PARTICIPANTS (a row per participant).
+ * It fits the match_callback type, so that it may be handed to cchamp_match_history() as-is.
+ *
+ * @param match     The match.
+ * @param exporter  The exporter.
+ */
+void cchamp_export_match(Match* match, void* exporter)
+{
+    Exporter* export = (Exporter *)exporter;
+
+    if (export->table == EXPORT_MATCHES) {
+        __export_value(export, EXPORT_MATCH_ID, match->game_id);
+        __export_value(export, EXPORT_MATCH_CREATION, match->creation);
+        __export_value(export, EXPORT_MATCH_DURATION, match->duration);
+        __export_value(export, EXPORT_MATCH_QUEUE, match->queue);
+        __export_value(export, EXPORT_MATCH_MAP, match->map);
+        __export_value(export, EXPORT_MATCH_SEASON, match->season);
+        __export_string(export, EXPORT_MATCH_VERSION, match->version);
+        __export_row(export);
+    } else if (export->table == EXPORT_PARTICIPANTS) {
+        for (int i = 0; i < match->participants_count; i++) {
+            MatchParticipant* participant = match->participants + i;
+
+            __export_value(export, EXPORT_PARTICIPANT_MATCH_ID, match->game_id);
+            __export_value(export, EXPORT_PARTICIPANT_ACCOUNT_ID, participant->account_id);
+            __export_value(export, EXPORT_PARTICIPANT_SUMMONER_ID, participant->summoner_id);
+            __export_string(export, EXPORT_PARTICIPANT_NAME, participant->summoner_name);
+            __export_value(export, EXPORT_PARTICIPANT_CHAMPION, participant->champion);
+            __export_value(export, EXPORT_PARTICIPANT_TEAM, participant->team);
+            __export_value(export, EXPORT_PARTICIPANT_WIN, participant->win);
+            __export_value(export, EXPORT_PARTICIPANT_KILLS, participant->kills);
+            __export_value(export, EXPORT_PARTICIPANT_DEATHS, participant->deaths);
+            __export_value(export, EXPORT_PARTICIPANT_ASSISTS, participant->assists);
+            __export_value(export, EXPORT_PARTICIPANT_MINIONS, participant->minions);
+            __export_value(export, EXPORT_PARTICIPANT_GOLD, participant->gold_earned);
+            __export_row(export);
+        }
+    }
+}
+
+
+/**
+ * Appends a player to an export of EXPORT_SUMMONERS.
+ *
+ * @param summoner  The player.
+ * @param exporter  The exporter.
+ */
+void cchamp_export_summoner(Summoner* summoner, void* exporter)
+{
+    Exporter* export = (Exporter *)exporter;
+    char name[SUMMONER_NAME_MAX_LENGTH + 1];
+    char region[REGION_MAX_LENGTH + 1];
+
+    if (export->table != EXPORT_SUMMONERS) {
+        return;
+    }
+
+    // The name and region of a player are not necessarily null-terminated.
+    memcpy(name, summoner->name, SUMMONER_NAME_MAX_LENGTH);
+    name[SUMMONER_NAME_MAX_LENGTH] = 0x00;
+    memcpy(region, summoner->region, REGION_MAX_LENGTH);
+    region[REGION_MAX_LENGTH] = 0x00;
+
+    __export_value(export, EXPORT_SUMMONER_ID, summoner->summoner_id);
+    __export_value(export, EXPORT_SUMMONER_ACCOUNT_ID, summoner->account_id);
+    __export_string(export, EXPORT_SUMMONER_NAME, name);
+    __export_string(export, EXPORT_SUMMONER_REGION, region);
+    __export_value(export, EXPORT_SUMMONER_LEVEL, summoner->level);
+    __export_value(export, EXPORT_SUMMONER_ICON, summoner->profile_icon_id);
+    __export_row(export);
+}
+
+
+/**
+ * Writes out the rows left and frees an exporter.
+ *
+ * @param exporter  The exporter.
+ *
+ * @return 0 on success; or <br>
+ *         1 if any write failed.
+ */
+int cchamp_export_close(Exporter* exporter)
+{
+    int failed = 0;
+
+    if (exporter->fd >= 0) {
+        failed = cchamp_export_flush(exporter);
+        failed = close(exporter->fd) != 0 || failed;
+    }
+
+    for (int i = 0; i < EXPORT_COLUMNS_MAX; i++) {
+        free(exporter->values[i].bytes.data);
+    }
+
+    free(exporter->strings.data);
+    free(exporter->added.data);
+    free(exporter->offsets);
+    free(exporter->slots);
+    free(exporter);
+
+    return failed;
+}
@@ -0,0 +1,709 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cJSON.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include <network/riot/api.h>
+#include <network/riot/dispatch.h>
+#include "league.h"
+
+#define LADDER_REGIONS      11
+
+// The positions of a player span the ranked queues, of which there are only a few.
+#define LADDER_POSITIONS    8
+
+// The states of a league in a ladder.
+#define LEAGUE_QUEUED       0
+#define LEAGUE_FETCHED      1
+#define LEAGUE_FAILED       2
+
+/*
+ * An open-addressing hash table of 64-bit keys (0 marks an empty slot) to the index of their record.
+ * Keys may repeat (i.e. hashes of league ids), in which case the records themselves tell them apart.
+ */
+struct ladder_slot {
+    uint64_t    key;
+    uint32_t    value;
+};
+
+struct ladder_set {
+    struct ladder_slot* slots;
+    uint32_t            capacity;
+    uint32_t            count;
+};
+
+/*
+ * A request yet to be sent by a crawl: the LEAGUE_* kind along with the queue, league id or summoner id.
+ */
+struct ladder_job {
+    int         kind;
+    char        value[LEAGUE_ID_LENGTH + 1];
+};
+
+struct ladder_frontier {
+    struct ladder_job*  jobs;
+    uint32_t            head;
+    uint32_t            size;
+    uint32_t            capacity;
+
+    // The number of requests of the region in flight, during a crawl.
+    int                 inflight;
+};
+
+struct ladder_league {
+    League      league;
+    uint32_t    first;
+    int         state;
+};
+
+struct ladder {
+    char                    queue[QUEUE_MAX_LENGTH + 1];
+
+    LeagueEntry*            entries;
+    uint32_t                count;
+    uint32_t                capacity;
+
+    struct ladder_league*   leagues;
+    uint32_t                leagues_count;
+    uint32_t                leagues_capacity;
+
+    // Players by (region, summoner id) and leagues by hash of (region, league id).
+    struct ladder_set       players;
+    struct ladder_set       league_ids;
+
+    // The regions whose challenger (LEAGUE_CHALLENGER) and master (LEAGUE_MASTER) leagues were fetched already.
+    uint16_t                apex[2];
+    struct ladder_frontier  frontiers[LADDER_REGIONS];
+};
+
+/*
+ * A request of a crawl in flight. There is at most one per dispatcher slot.
+ */
+struct ladder_call {
+    Ladder*             ladder;
+    uint16_t            region;
+    struct ladder_job   job;
+    int                 used;
+    uint16_t*           error;
+};
+
+
+/**
+ * Finds the next slot of a set holding the key, or the empty slot ending its probe sequence.
+ *
+ * @param set   The set to probe.
+ * @param key   The key to find.
+ * @param from  The slot the previous probe returned, to find a further slot with the same key; NULL to start.
+ */
+static struct ladder_slot* __set_probe(struct ladder_set* set, uint64_t key, struct ladder_slot* from)
+{
+    uint32_t mask = set->capacity - 1;
+    uint32_t i = from != NULL ? (uint32_t)(from - set->slots) + 1 : (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+
+    while (set->slots[i & mask].key != key && set->slots[i & mask].key != 0) {
+        i++;
+    }
+
+    return set->slots + (i & mask);
+}
+
+
+/**
+ * Finds the first slot of a set holding the key.
+ *
+ * @return The slot; or <br>
+ *         NULL if the set does not hold the key.
+ */
+static struct ladder_slot* __set_find(struct ladder_set* set, uint64_t key)
+{
+    if (set->capacity == 0) {
+        return NULL;
+    }
+
+    struct ladder_slot* slot = __set_probe(set, key, NULL);
+    return slot->key == key ? slot : NULL;
+}
+
+
+/**
+ * Adds a key to a set, growing it to keep it at most half full.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the set could not grow.
+ */
+static int __set_insert(struct ladder_set* set, uint64_t key, uint32_t value)
+{
+    if ((set->count + 1) * 2 > set->capacity) {
+        struct ladder_set grown = { .capacity = set->capacity ? set->capacity * 2 : 1024 };
+
+        if ((grown.slots = calloc(grown.capacity, sizeof(struct ladder_slot))) == NULL) {
+            return 1;
+        }
+
+        for (uint32_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i].key != 0) {
+                struct ladder_slot* slot = __set_probe(&grown, set->slots[i].key, NULL);
+
+                // Duplicate keys are moved past the ones already moved.
+                while (slot->key != 0) slot = __set_probe(&grown, set->slots[i].key, slot);
+                *slot = set->slots[i];
+                grown.count++;
+            }
+        }
+
+        free(set->slots);
+        *set = grown;
+    }
+
+    struct ladder_slot* slot = __set_probe(set, key, NULL);
+    while (slot->key != 0) slot = __set_probe(set, key, slot);
+
+    slot->key = key;
+    slot->value = value;
+    set->count++;
+    return 0;
+}
+
+
+/**
+ * The key of a player, in the players set.
+ */
+static uint64_t __player_key(uint16_t region, uint32_t summoner_id)
+{
+    return ((uint64_t)(get_bit_index(region) + 1) << 32) | summoner_id;
+}
+
+
+/**
+ * The key of a league (FNV-1a of the league id and region), in the league ids set. Never 0.
+ */
+static uint64_t __league_key(uint16_t region, char* league_id)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL ^ region;
+
+    for (; *league_id; league_id++) {
+        hash = (hash ^ (uint8_t)*league_id) * 0x100000001B3ULL;
+    }
+
+    return hash | 1;
+}
+
+
+/**
+ * Finds a league of the ladder.
+ *
+ * @return The index of the league; or <br>
+ *         -1 if the ladder does not know of it.
+ */
+static int64_t __league_find(Ladder* ladder, uint16_t region, char* league_id)
+{
+    uint64_t key = __league_key(region, league_id);
+
+    for (struct ladder_slot* slot = __set_find(&ladder->league_ids, key); slot != NULL && slot->key != 0;
+            slot = __set_probe(&ladder->league_ids, key, slot)) {
+        League* league = &ladder->leagues[slot->value].league;
+
+        if (league->region == region && strcmp(league->id, league_id) == 0) {
+            return slot->value;
+        }
+    }
+
+    return -1;
+}
+
+
+/**
+ * Records a new league in the ladder, yet to be fetched.
+ *
+ * @return The index of the league; or <br>
+ *         -1 if memory ran out.
+ */
+static int64_t __league_add(Ladder* ladder, uint16_t region, char* league_id)
+{
+    if (ladder->leagues_count == ladder->leagues_capacity) {
+        uint32_t capacity = ladder->leagues_capacity ? ladder->leagues_capacity * 2 : 64;
+        struct ladder_league* leagues = realloc(ladder->leagues, sizeof(struct ladder_league) * capacity);
+
+        if (leagues == NULL) {
+            return -1;
+        }
+
+        ladder->leagues = leagues;
+        ladder->leagues_capacity = capacity;
+    }
+
+    struct ladder_league* record = ladder->leagues + ladder->leagues_count;
+    memset(record, 0x00, sizeof(struct ladder_league));
+    strncpy(record->league.id, league_id, LEAGUE_ID_LENGTH);
+    record->league.region = region;
+    record->state = LEAGUE_QUEUED;
+
+    if (__set_insert(&ladder->league_ids, __league_key(region, record->league.id), ladder->leagues_count)) {
+        return -1;
+    }
+
+    return ladder->leagues_count++;
+}
+
+
+/**
+ * Queues a request for the next crawl.
+ *
+ * @return 0 on success; or <br>
+ *         1 if memory ran out.
+ */
+static int __ladder_queue(Ladder* ladder, uint16_t region, int kind, char* value)
+{
+    struct ladder_frontier* frontier = ladder->frontiers + get_bit_index(region);
+
+    // The jobs before the head were sent already, and their room is reclaimed before growing.
+    if (frontier->size == frontier->capacity && frontier->head > 0) {
+        memmove(frontier->jobs, frontier->jobs + frontier->head, sizeof(struct ladder_job) * (frontier->size - frontier->head));
+        frontier->size -= frontier->head;
+        frontier->head = 0;
+    }
+
+    if (frontier->size == frontier->capacity) {
+        uint32_t capacity = frontier->capacity ? frontier->capacity * 2 : 64;
+        struct ladder_job* jobs = realloc(frontier->jobs, sizeof(struct ladder_job) * capacity);
+
+        if (jobs == NULL) {
+            return 1;
+        }
+
+        frontier->jobs = jobs;
+        frontier->capacity = capacity;
+    }
+
+    struct ladder_job* job = frontier->jobs + frontier->size++;
+    job->kind = kind;
+    memset(job->value, 0x00, sizeof(job->value));
+    strncpy(job->value, value, LEAGUE_ID_LENGTH);
+    return 0;
+}
+
+
+/**
+ * Queues a league to be fetched, unless the ladder knows of it already. Leagues that failed are queued again.
+ */
+static int __ladder_queue_league(Ladder* ladder, uint16_t region, char* league_id)
+{
+    int64_t index = __league_find(ladder, region, league_id);
+
+    if (index == -1) {
+        if (__league_add(ladder, region, league_id) == -1) {
+            return 1;
+        }
+    } else if (ladder->leagues[index].state == LEAGUE_FAILED) {
+        ladder->leagues[index].state = LEAGUE_QUEUED;
+    } else {
+        return 0;
+    }
+
+    return __ladder_queue(ladder, region, LEAGUE_BY_ID, league_id);
+}
+
+
+/**
+ * Grows the entries of a ladder to make room for (count) more.
+ *
+ * @return 0 on success; or <br>
+ *         1 if memory ran out.
+ */
+static int __ladder_reserve(Ladder* ladder, uint32_t count)
+{
+    uint32_t capacity = ladder->capacity ? ladder->capacity : 4096;
+
+    if (ladder->count + count <= ladder->capacity) {
+        return 0;
+    }
+
+    while (capacity < ladder->count + count) {
+        capacity *= 2;
+    }
+
+    LeagueEntry* entries = realloc(ladder->entries, sizeof(LeagueEntry) * capacity);
+    if (entries == NULL) {
+        return 1;
+    }
+
+    ladder->entries = entries;
+    ladder->capacity = capacity;
+    return 0;
+}
+
+
+/**
+ * Stores a fetched league and those of its entries that the ladder does not hold yet.
+ *
+ * @return The number of entries added.
+ */
+static uint32_t __ladder_store(Ladder* ladder, uint16_t region, char* response, uint16_t* error)
+{
+    League header;
+    cJSON* data = league_parse(region, response, &header);
+    cJSON* item;
+    int64_t index;
+
+    if (data == NULL) {
+        *error = EUNKNOWN;
+        return 0;
+    }
+
+    // A league of another queue was seeded; there is nothing to store.
+    if (strcmp(header.queue, ladder->queue) != 0) {
+        if ((index = __league_find(ladder, region, header.id)) != -1) {
+            ladder->leagues[index].state = LEAGUE_FAILED;
+        }
+
+        cJSON_Delete(data);
+        return 0;
+    }
+
+    // The challenger and master leagues are only known by id once they arrive.
+    if ((index = __league_find(ladder, region, header.id)) != -1 && ladder->leagues[index].state == LEAGUE_FETCHED) {
+        cJSON_Delete(data);
+        return 0;
+    }
+
+    if ((index == -1 && (index = __league_add(ladder, region, header.id)) == -1) || __ladder_reserve(ladder, header.count)) {
+        *error = E2MANY;
+        cJSON_Delete(data);
+        return 0;
+    }
+
+    struct ladder_league* record = ladder->leagues + index;
+    record->league = header;
+    record->league.count = 0;
+    record->league.entries = NULL;
+    record->first = ladder->count;
+    record->state = LEAGUE_FETCHED;
+
+    cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(data, "entries")) {
+        LeagueEntry* entry = ladder->entries + ladder->count;
+
+        if (!league_entry_parse(item, region, header.tier, entry)) continue;
+
+        // A player moving between leagues during the crawl is only kept once.
+        uint64_t key = __player_key(region, entry->summoner_id);
+        if (__set_find(&ladder->players, key) != NULL) continue;
+
+        if (__set_insert(&ladder->players, key, ladder->count)) {
+            *error = E2MANY;
+            break;
+        }
+
+        entry->league = index;
+        record->league.count++;
+        ladder->count++;
+    }
+
+    cJSON_Delete(data);
+    return record->league.count;
+}
+
+
+/**
+ * Queues the league of a player in the queue of the ladder, out of the player's positions.
+ */
+static void __ladder_positions(Ladder* ladder, uint16_t region, char* response, uint16_t* error)
+{
+    LeaguePosition positions[LADDER_POSITIONS];
+    int count = league_positions_parse(region, response, positions, LADDER_POSITIONS);
+
+    if (count == -1) {
+        *error = EUNKNOWN;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(positions[i].queue, ladder->queue) == 0 && __ladder_queue_league(ladder, region, positions[i].league_id)) {
+            *error = E2MANY;
+        }
+    }
+}
+
+
+/**
+ * Handles the response of a crawl request.
+ */
+static void __ladder_received(Request* request, uint16_t status, void* data)
+{
+    struct ladder_call* call = data;
+    Ladder* ladder = call->ladder;
+
+    ladder->frontiers[(int)get_bit_index(call->region)].inflight--;
+    call->used = 0;
+
+    if (status != EPASS) {
+        int64_t index;
+
+        // The league may be seeded again to be retried on the next crawl.
+        if (call->job.kind == LEAGUE_BY_ID && (index = __league_find(ladder, call->region, call->job.value)) != -1) {
+            ladder->leagues[index].state = LEAGUE_FAILED;
+        }
+
+        // An unranked player has no positions to be found.
+        if (!(status == ENOTFOUND && call->job.kind == LEAGUE_POSITIONS)) {
+            *call->error = status;
+        }
+
+        return;
+    }
+
+    if (call->job.kind == LEAGUE_CHALLENGER || call->job.kind == LEAGUE_MASTER) {
+        ladder->apex[call->job.kind] |= call->region;
+    }
+
+    if (call->job.kind == LEAGUE_POSITIONS) {
+        __ladder_positions(ladder, call->region, request->response.addr, call->error);
+    } else {
+        __ladder_store(ladder, call->region, request->response.addr, call->error);
+    }
+}
+
+
+/**
+ * Creates an empty ladder of a ranked queue.
+ *
+ * @param queue The ranked queue (i.e. QUEUE_RANKED_SOLO).
+ *
+ * @return The ladder, to be freed with cchamp_ladder_free(); or <br>
+ *         NULL if memory ran out.
+ */
+Ladder* cchamp_ladder_create(char* queue)
+{
+    Ladder* ladder = calloc(1, sizeof(Ladder));
+
+    if (ladder != NULL) {
+        strncpy(ladder->queue, queue, QUEUE_MAX_LENGTH);
+    }
+
+    return ladder;
+}
+
+
+/**
+ * Seeds the next crawl with the league of a player.
+ *
+ * @return 0 on success; or <br>
+ *         1 if memory ran out.
+ */
+int cchamp_ladder_seed(Ladder* ladder, uint16_t region, uint32_t summoner_id)
+{
+    char value[16];
+
+    // A player held by the ladder already has their league crawled.
+    if (__set_find(&ladder->players, __player_key(region, summoner_id)) != NULL) {
+        return 0;
+    }
+
+    sprintf(value, "%u", summoner_id);
+    return __ladder_queue(ladder, region, LEAGUE_POSITIONS, value);
+}
+
+
+/**
+ * Seeds the next crawl with a league.
+ *
+ * @return 0 on success; or <br>
+ *         1 if memory ran out.
+ */
+int cchamp_ladder_seed_league(Ladder* ladder, uint16_t region, char* league_id)
+{
+    return __ladder_queue_league(ladder, region, league_id);
+}
+
+
+/**
+ * Crawls the challenger and master leagues of the regions, along with all seeded leagues.
+ *
+ * @param ladder    The ladder to fill.
+ * @param regions   The REGION_* constants of the regions whose challenger and master leagues to crawl.
+ *
+ * @return The number of entries added to the ladder; or <br>
+ *         -1 if the crawl could not start (see cc_error).
+ */
+int cchamp_ladder_crawl(Ladder* ladder, uint16_t regions)
+{
+    struct ladder_call calls[DISPATCH_SLOTS] = { 0 };
+    uint32_t count = ladder->count;
+    uint16_t error = EPASS;
+    int cursor = 0;
+
+    for (int r = 0; r < LADDER_REGIONS; r++) {
+        uint16_t region = 1 << r;
+
+        if (!(regions & region)) continue;
+
+        // An apex league is queued until it was fetched once, so that a failed one is tried again on the next crawl.
+        for (int kind = LEAGUE_CHALLENGER; kind <= LEAGUE_MASTER; kind++) {
+            if (!(ladder->apex[kind] & region) && __ladder_queue(ladder, region, kind, ladder->queue)) {
+                cc_error = E2MANY;
+                return -1;
+            }
+        }
+    }
+
+    Dispatcher* dispatcher = malloc(sizeof(Dispatcher));
+    if (dispatcher == NULL || dispatch_init(dispatcher)) {
+        free(dispatcher);
+        cc_error = dispatcher == NULL ? E2MANY : cc_error;
+        return -1;
+    }
+
+    for (;;) {
+        int active = 0;
+
+        for (int r = 0; r < LADDER_REGIONS; r++) {
+            struct ladder_frontier* frontier = ladder->frontiers + r;
+            active += frontier->head < frontier->size || frontier->inflight > 0;
+        }
+
+        /*
+         * The slots are shared evenly among the regions with work left, so that a region waiting on its rate
+         * limit does not hold up the others. Regions are visited round-robin to hand out the remainder.
+         */
+        int share = active > 0 && dispatcher->size / active > 1 ? dispatcher->size / active : 1;
+
+        for (int visited = 0; visited < LADDER_REGIONS; visited++, cursor = (cursor + 1) % LADDER_REGIONS) {
+            struct ladder_frontier* frontier = ladder->frontiers + cursor;
+            Request* request;
+
+            while (frontier->head < frontier->size && frontier->inflight < share
+                    && (request = dispatch_request(dispatcher)) != NULL) {
+                struct ladder_call* call = calls;
+                while (call->used) call++;
+
+                call->ladder = ladder;
+                call->region = 1 << cursor;
+                call->job = frontier->jobs[frontier->head++];
+                call->used = 1;
+                call->error = &error;
+                frontier->inflight++;
+
+                league_request(request, call->region, call->job.kind, call->job.value);
+                dispatch_submit(dispatcher, request, __ladder_received, call);
+            }
+        }
+
+        if (dispatch_run(dispatcher, 1000) == 0) {
+            int pending = 0;
+
+            for (int r = 0; r < LADDER_REGIONS; r++) {
+                pending |= ladder->frontiers[r].head < ladder->frontiers[r].size;
+            }
+
+            if (!pending) break;
+        }
+    }
+
+    dispatch_cleanup(dispatcher);
+    free(dispatcher);
+
+    for (int r = 0; r < LADDER_REGIONS; r++) {
+        ladder->frontiers[r].head = ladder->frontiers[r].size = 0;
+    }
+
+    cc_error = error;
+    return ladder->count - count;
+}
+
+
+/**
+ * The number of entries of a ladder.
+ */
+uint32_t cchamp_ladder_count(Ladder* ladder)
+{
+    return ladder->count;
+}
+
+
+/**
+ * The entries of a ladder, contiguous and grouped by league.
+ */
+LeagueEntry* cchamp_ladder_entries(Ladder* ladder)
+{
+    return ladder->entries;
+}
+
+
+/**
+ * The number of leagues known to a ladder, including those yet to be fetched (which have no entries).
+ */
+uint32_t cchamp_ladder_league_count(Ladder* ladder)
+{
+    return ladder->leagues_count;
+}
+
+
+/**
+ * Fills a league of a ladder, pointing it at its entries in the ladder.
+ *
+ * @param ladder    The ladder.
+ * @param index     The index of the league (i.e. LeagueEntry.league).
+ * @param league    The struct to fill.
+ *
+ * @return The filled league; or <br>
+ *         NULL if the index is out of range.
+ */
+League* cchamp_ladder_league(Ladder* ladder, uint32_t index, League* league)
+{
+    if (index >= ladder->leagues_count) {
+        return NULL;
+    }
+
+    *league = ladder->leagues[index].league;
+    league->entries = league->count > 0 ? ladder->entries + ladder->leagues[index].first : NULL;
+    return league;
+}
+
+
+/**
+ * Finds the entry of a player in a ladder.
+ *
+ * @return The entry; or <br>
+ *         NULL if the ladder does not hold the player.
+ */
+LeagueEntry* cchamp_ladder_find(Ladder* ladder, uint16_t region, uint32_t summoner_id)
+{
+    struct ladder_slot* slot = __set_find(&ladder->players, __player_key(region, summoner_id));
+
+    return slot != NULL ? ladder->entries + slot->value : NULL;
+}
+
+
+/**
+ * Frees a ladder along with all its entries.
+ */
+void cchamp_ladder_free(Ladder* ladder)
+{
+    if (ladder == NULL) {
+        return;
+    }
+
+    for (int r = 0; r < LADDER_REGIONS; r++) {
+        free(ladder->frontiers[r].jobs);
+    }
+
+    free(ladder->players.slots);
+    free(ladder->league_ids.slots);
+    free(ladder->leagues);
+    free(ladder->entries);
+    free(ladder);
+}
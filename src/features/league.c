@@ -0,0 +1,307 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <cJSON.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include <network/riot/api.h>
+#include "league.h"
+
+// Calls may be made from many threads at once (see cchamp_workers_start()).
+static __thread Request request;
+
+// The API path for each of the LEAGUE_* request kinds.
+static char* __qualifiers[] = {
+    "/challengerleagues/by-queue/",
+    "/masterleagues/by-queue/",
+    "/leagues/",
+    "/positions/by-summoner/"
+};
+
+// The names of the TIER_* constants.
+static char* __tiers[] = {
+    "UNRANKED", "BRONZE", "SILVER", "GOLD", "PLATINUM", "DIAMOND", "MASTER", "CHALLENGER"
+};
+
+
+/**
+ * Translates the name of a tier into its TIER_* constant; TIER_UNRANKED if it is unknown.
+ */
+static uint8_t __league_tier(cJSON* object)
+{
+    cJSON* tier = cJSON_GetObjectItemCaseSensitive(object, "tier");
+
+    for (uint8_t i = 0; cJSON_IsString(tier) && i < sizeof(__tiers) / sizeof(char *); i++) {
+        if (strcmp(tier->valuestring, __tiers[i]) == 0) {
+            return i;
+        }
+    }
+
+    return TIER_UNRANKED;
+}
+
+
+/**
+ * Translates a division in roman numerals (I to V) into its number; 0 if it is unknown.
+ */
+static uint8_t __league_rank(cJSON* object)
+{
+    static char* numerals[] = { "I", "II", "III", "IV", "V" };
+    cJSON* rank = cJSON_GetObjectItemCaseSensitive(object, "rank");
+
+    for (uint8_t i = 0; cJSON_IsString(rank) && i < 5; i++) {
+        if (strcmp(rank->valuestring, numerals[i]) == 0) {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Fills the arguments of a league request.
+ *
+ * @param request   The request to fill.
+ * @param region    The region of the league.
+ * @param kind      The LEAGUE_* kind of the request.
+ * @param value     The queue (challenger, master), the league id or the summoner id (positions).
+ */
+void league_request(Request* request, uint16_t region, int kind, char* value)
+{
+    request->api = API_LEAGUE;
+    request->region = region;
+    request->arguments.path.head = path_qualifier(request, __qualifiers[kind], path_arg(request, value, NULL));
+}
+
+
+/**
+ * Parses a league, without its entries.
+ *
+ * @param region    The region of the league.
+ * @param response  The response from the API servers in JSON format.
+ * @param league    The struct to fill. Its count is set to the number of entries; the entries are left alone.
+ *
+ * @return The parsed response, whose "entries" array is to be parsed with league_entry_parse() and which must
+ *         be freed with cJSON_Delete(); or <br>
+ *         NULL if the response is not a league (cc_error is set to EUNKNOWN).
+ */
+cJSON* league_parse(uint16_t region, char* response, League* league)
+{
+    cJSON* data = cJSON_Parse(response);
+    cJSON* entries = cJSON_GetObjectItemCaseSensitive(data, "entries");
+
+    if (!cJSON_IsArray(entries)) {
+        cJSON_Delete(data);
+        cc_error = EUNKNOWN;
+        return NULL;
+    }
+
+    json_string(league->id, sizeof(league->id), data, "leagueId");
+    json_string(league->name, sizeof(league->name), data, "name");
+    json_string(league->queue, sizeof(league->queue), data, "queue");
+    league->region = region;
+    league->tier = __league_tier(data);
+    league->count = cJSON_GetArraySize(entries);
+
+    return data;
+}
+
+
+/**
+ * Parses an entry of a league, or the entry of a position.
+ *
+ * @param item      The JSON entry.
+ * @param region    The region of the league.
+ * @param tier      The TIER_* constant of the league.
+ * @param entry     The struct to fill.
+ *
+ * @return 1 if the entry was filled; or <br>
+ *         0 if it does not identify a player.
+ */
+int league_entry_parse(cJSON* item, uint16_t region, uint8_t tier, LeagueEntry* entry)
+{
+    cJSON* id = cJSON_GetObjectItemCaseSensitive(item, "playerOrTeamId");
+    uint8_t flags = 0;
+
+    if (!cJSON_IsString(id) || (entry->summoner_id = strtoul(id->valuestring, NULL, 10)) == 0) {
+        return 0;
+    }
+
+    flags |= cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(item, "veteran")) ? LEAGUE_VETERAN : 0;
+    flags |= cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(item, "inactive")) ? LEAGUE_INACTIVE : 0;
+    flags |= cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(item, "freshBlood")) ? LEAGUE_FRESH_BLOOD : 0;
+    flags |= cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(item, "hotStreak")) ? LEAGUE_HOT_STREAK : 0;
+
+    cJSON* points = cJSON_GetObjectItemCaseSensitive(item, "leaguePoints");
+    cJSON* wins = cJSON_GetObjectItemCaseSensitive(item, "wins");
+    cJSON* losses = cJSON_GetObjectItemCaseSensitive(item, "losses");
+
+    entry->league = 0;
+    entry->region = region;
+    entry->league_points = cJSON_IsNumber(points) ? points->valueint : 0;
+    entry->wins = cJSON_IsNumber(wins) ? wins->valueint : 0;
+    entry->losses = cJSON_IsNumber(losses) ? losses->valueint : 0;
+    entry->tier = tier;
+    entry->rank = __league_rank(item);
+    entry->flags = flags;
+    json_string(entry->summoner_name, sizeof(entry->summoner_name), item, "playerOrTeamName");
+
+    return 1;
+}
+
+
+/**
+ * Parses the positions of a player.
+ *
+ * @param region    The region of the player.
+ * @param response  The response from the API servers in JSON format.
+ * @param positions The structs to fill.
+ * @param max       The number of structs available.
+ *
+ * @return The number of positions filled; or <br>
+ *         -1 if the response is not a list of positions (cc_error is set to EUNKNOWN).
+ */
+int league_positions_parse(uint16_t region, char* response, LeaguePosition* positions, int max)
+{
+    cJSON* data = cJSON_Parse(response);
+    cJSON* item;
+    int count = 0;
+
+    if (!cJSON_IsArray(data)) {
+        cJSON_Delete(data);
+        cc_error = EUNKNOWN;
+        return -1;
+    }
+
+    cJSON_ArrayForEach(item, data) {
+        if (count == max) break;
+
+        if (league_entry_parse(item, region, __league_tier(item), &positions[count].entry)) {
+            json_string(positions[count].league_id, sizeof(positions[count].league_id), item, "leagueId");
+            json_string(positions[count].queue, sizeof(positions[count].queue), item, "queueType");
+            count++;
+        }
+    }
+
+    cJSON_Delete(data);
+    return count;
+}
+
+
+/**
+ * Retrieves a league into a single allocation holding its entries.
+ */
+static League* __league_get(uint16_t region, int kind, char* value)
+{
+    League* league = NULL;
+    League header;
+    cJSON* data;
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+    league_request(&request, region, kind, value);
+
+    cchamp_send_request(&request);
+    if (request.http_code == 200 && (data = league_parse(region, request.response.addr, &header)) != NULL) {
+        league = malloc(sizeof(League) + sizeof(LeagueEntry) * header.count);
+
+        if (league != NULL) {
+            cJSON* item;
+
+            *league = header;
+            league->count = 0;
+            league->entries = (LeagueEntry *)(league + 1);
+
+            cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(data, "entries")) {
+                league->count += league_entry_parse(item, region, header.tier, league->entries + league->count);
+            }
+        } else {
+            cc_error = E2MANY;
+        }
+
+        cJSON_Delete(data);
+    }
+
+    channel_clean(&request);
+    return league;
+}
+
+
+/**
+ * Retrieves the challenger league of a ranked queue.
+ *
+ * @param region    The region of the league.
+ * @param queue     The ranked queue (i.e. QUEUE_RANKED_SOLO).
+ */
+League* get_challenger_league(uint16_t region, char* queue)
+{
+    return __league_get(region, LEAGUE_CHALLENGER, queue);
+}
+
+
+/**
+ * Retrieves the master league of a ranked queue.
+ *
+ * @param region    The region of the league.
+ * @param queue     The ranked queue (i.e. QUEUE_RANKED_SOLO).
+ */
+League* get_master_league(uint16_t region, char* queue)
+{
+    return __league_get(region, LEAGUE_MASTER, queue);
+}
+
+
+/**
+ * Retrieves a league by its id.
+ *
+ * @param region    The region of the league.
+ * @param league_id The id of the league.
+ */
+League* get_league_by_id(uint16_t region, char* league_id)
+{
+    return __league_get(region, LEAGUE_BY_ID, league_id);
+}
+
+
+/**
+ * Retrieves the positions of a player in the ranked queues.
+ *
+ * @param region        The region of the player.
+ * @param summoner_id   The summoner id of the player.
+ * @param positions     The structs to fill.
+ * @param max           The number of structs available.
+ *
+ * @return The number of positions filled (0 if the player is unranked); or <br>
+ *         -1 on failure (see cc_error).
+ */
+int get_league_positions_by_sid(uint16_t region, char* summoner_id, LeaguePosition* positions, int max)
+{
+    int count = -1;
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+    league_request(&request, region, LEAGUE_POSITIONS, summoner_id);
+
+    cchamp_send_request(&request);
+    if (request.http_code == 200) {
+        count = league_positions_parse(region, request.response.addr, positions, max);
+    }
+
+    channel_clean(&request);
+    return count;
+}
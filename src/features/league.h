@@ -0,0 +1,32 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_LEAGUE_H
+#define CCHAMP_LEAGUE_H
+#include <cJSON.h>
+#include <cchamp/cchamp.h>
+#include <network/channel.h>
+
+// The kinds of league requests, indexing the API paths.
+#define LEAGUE_CHALLENGER   0
+#define LEAGUE_MASTER       1
+#define LEAGUE_BY_ID        2
+#define LEAGUE_POSITIONS    3
+
+void    league_request(Request* request, uint16_t region, int kind, char* value);
+cJSON*  league_parse(uint16_t region, char* response, League* league);
+int     league_entry_parse(cJSON* item, uint16_t region, uint8_t tier, LeagueEntry* entry);
+int     league_positions_parse(uint16_t region, char* response, LeaguePosition* positions, int max);
+#endif
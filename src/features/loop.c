@@ -0,0 +1,333 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <curl/curl.h>
+#include <cchamp/cchamp.h>
+#include <network/riot/api.h>
+#include <network/riot/dispatch.h>
+#include <network/riot/rate.h>
+#include "summoner.h"
+#include "summoner_index.h"
+#include "match.h"
+
+#define LOOP_SUMMONER   0
+#define LOOP_MATCH      1
+
+/*
+ * A call in progress, by dispatcher slot.
+ */
+struct loop_call {
+    CChampLoop*     loop;
+    int             used;
+    int             kind;
+    uint16_t        region;
+    void*           data;
+
+    union {
+        summoner_callback   summoner;
+        match_callback      match;
+    } callback;
+};
+
+struct cchamp_loop {
+    Dispatcher              dispatcher;
+
+    loop_watch_callback     watch;
+    loop_timer_callback     timer;
+    void*                   data;
+
+    // The times (on the monotonic clock) curl needs to be called back at, and the timer is set for; 0 if never.
+    uint64_t                curl_due;
+    uint64_t                armed;
+
+    struct loop_call        calls[DISPATCH_SLOTS];
+
+    // The results handed to the callbacks; calls complete one at a time.
+    Summoner                summoner;
+    Match                   match;
+};
+
+
+/**
+ * Forwards the sockets curl needs watched to the watch callback.
+ */
+static int __loop_socket(CURL* easy, curl_socket_t fd, int what, void* data, void* socket)
+{
+    CChampLoop* loop = data;
+    (void)easy;
+    (void)socket;
+
+    loop->watch(fd, what == CURL_POLL_REMOVE ? 0 : what & (CCHAMP_POLL_IN | CCHAMP_POLL_OUT), loop->data);
+    return 0;
+}
+
+
+/**
+ * Records the time curl needs to be called back at (see __loop_arm()).
+ */
+static int __loop_curl_timer(CURLM* multi, long timeout, void* data)
+{
+    CChampLoop* loop = data;
+    (void)multi;
+
+    loop->curl_due = timeout < 0 ? 0 : rate_now() + timeout;
+    return 0;
+}
+
+
+/**
+ * Hands the earliest of the times curl and the dispatcher need to be called back at to the timer callback,
+ * unless it is the timer set already.
+ */
+static void __loop_arm(CChampLoop* loop, int next)
+{
+    uint64_t now = rate_now();
+    uint64_t due = loop->curl_due;
+
+    if (next >= 0 && (due == 0 || now + next < due)) {
+        due = now + next;
+    }
+
+    if (due == loop->armed) {
+        return;
+    }
+
+    loop->armed = due;
+    loop->timer(due == 0 ? -1 : due > now ? (long)(due - now) : 0, loop->data);
+}
+
+
+/**
+ * Hands the response of a call to its callback.
+ */
+static void __loop_received(Request* request, uint16_t status, void* data)
+{
+    struct loop_call* call = data;
+    CChampLoop* loop = call->loop;
+    void* result = NULL;
+
+    call->used = 0;
+    cc_error = status;
+
+    if (status == EPASS && call->kind == LOOP_SUMMONER) {
+        result = summoner_parse(call->region, request->response.addr, &loop->summoner);
+    } else if (status == EPASS) {
+        result = match_parse(request->response.addr, &loop->match);
+    }
+
+    if (call->kind == LOOP_SUMMONER) {
+        call->callback.summoner(result, call->data);
+    } else {
+        call->callback.match(result, call->data);
+    }
+}
+
+
+/**
+ * Claims a request and a call for a new call of a loop.
+ *
+ * @return The flushed request; or <br>
+ *         NULL if as many calls as there are slots are in progress (cc_error is set to E2MANY).
+ */
+static Request* __loop_call(CChampLoop* loop, int kind, uint16_t region, void* data, struct loop_call** call)
+{
+    Request* request = dispatch_request(&loop->dispatcher);
+
+    if (request == NULL) {
+        cc_error = E2MANY;
+        return NULL;
+    }
+
+    for (*call = loop->calls; (*call)->used; (*call)++);
+
+    (*call)->loop = loop;
+    (*call)->used = 1;
+    (*call)->kind = kind;
+    (*call)->region = region;
+    (*call)->data = data;
+    return request;
+}
+
+
+/**
+ * Hands a request to the dispatcher. It goes out from within the next call to the loop, which the timer is set
+ * for right away, so that its callback is never invoked before the call returns.
+ */
+static void __loop_submit(CChampLoop* loop, Request* request, struct loop_call* call)
+{
+    dispatch_submit(&loop->dispatcher, request, __loop_received, call);
+    __loop_arm(loop, 0);
+}
+
+
+/**
+ * Creates a loop, to be driven by an event loop of the caller.
+ *
+ * @param watch The callback that is told which sockets to watch.
+ * @param timer The callback that is told when to call back.
+ * @param data  Passed on to both callbacks.
+ *
+ * @return The loop; or <br>
+ *         NULL if it could not be allocated, or curl failed (cc_error is set to ECURL).
+ */
+CChampLoop* cchamp_loop_create(loop_watch_callback watch, loop_timer_callback timer, void* data)
+{
+    CChampLoop* loop = calloc(1, sizeof(CChampLoop));
+
+    if (loop == NULL) {
+        return NULL;
+    }
+
+    if (dispatch_init(&loop->dispatcher)) {
+        free(loop);
+        return NULL;
+    }
+
+    loop->watch = watch;
+    loop->timer = timer;
+    loop->data = data;
+
+    curl_multi_setopt(loop->dispatcher.multi, CURLMOPT_SOCKETFUNCTION, __loop_socket);
+    curl_multi_setopt(loop->dispatcher.multi, CURLMOPT_SOCKETDATA, loop);
+    curl_multi_setopt(loop->dispatcher.multi, CURLMOPT_TIMERFUNCTION, __loop_curl_timer);
+    curl_multi_setopt(loop->dispatcher.multi, CURLMOPT_TIMERDATA, loop);
+    return loop;
+}
+
+
+/**
+ * Lets the loop act on a socket that is ready.
+ *
+ * @param loop      The loop.
+ * @param fd        The socket, as handed to the watch callback.
+ * @param events    Its readiness: CCHAMP_POLL_IN, CCHAMP_POLL_OUT and/or CCHAMP_POLL_ERROR.
+ *
+ * @return The number of calls left in progress.
+ */
+int cchamp_loop_socket(CChampLoop* loop, int fd, int events)
+{
+    int ready = (events & CCHAMP_POLL_IN ? CURL_CSELECT_IN : 0) |
+                (events & CCHAMP_POLL_OUT ? CURL_CSELECT_OUT : 0) |
+                (events & CCHAMP_POLL_ERROR ? CURL_CSELECT_ERR : 0);
+
+    __loop_arm(loop, dispatch_socket(&loop->dispatcher, fd, ready));
+    return loop->dispatcher.busy;
+}
+
+
+/**
+ * Lets the loop act once the timer it asked for expires.
+ *
+ * @param loop The loop.
+ *
+ * @return The number of calls left in progress.
+ */
+int cchamp_loop_timeout(CChampLoop* loop)
+{
+    // The timer is spent; it stands for both curl's timeout and the dispatcher's, which curl does not mind.
+    loop->armed = 0;
+
+    __loop_arm(loop, dispatch_socket(&loop->dispatcher, CURL_SOCKET_TIMEOUT, 0));
+    return loop->dispatcher.busy;
+}
+
+
+/**
+ * Retrieves a summoner from within the loop.
+ *
+ * @param loop      The loop.
+ * @param region    The region which the player's account is in.
+ * @param key       The SUMMONER_KEY_* constant of the keyword type.
+ * @param value     The keyword (i.e. summoner id, account id, or summoner name).
+ * @param callback  Invoked with the summoner (or NULL) once retrieved.
+ * @param data      Passed on to the callback.
+ *
+ * @return 0 if the call is under way (or was served from the identity index); or <br>
+ *         1 if too many calls are in progress (cc_error is set to E2MANY), or key is not a SUMMONER_KEY_* constant
+ *         (cc_error is set to EARGUMENT).
+ */
+int cchamp_loop_summoner(CChampLoop* loop, uint16_t region, int key, char* value, summoner_callback callback, void* data)
+{
+    struct loop_call* call;
+    Request* request;
+
+    if (key < SUMMONER_KEY_SID || key > SUMMONER_KEY_NAME) {
+        cc_error = EARGUMENT;
+        return 1;
+    }
+
+    if (summoner_index_serve(region, key, value, &loop->summoner) != NULL) {
+        cc_error = EPASS;
+        callback(&loop->summoner, data);
+        return 0;
+    }
+
+    if ((request = __loop_call(loop, LOOP_SUMMONER, region, data, &call)) == NULL) {
+        return 1;
+    }
+
+    call->callback.summoner = callback;
+    summoner_request(request, region, key, value);
+    __loop_submit(loop, request, call);
+    return 0;
+}
+
+
+/**
+ * Retrieves a match from within the loop.
+ *
+ * @param loop      The loop.
+ * @param region    The region the match was played in.
+ * @param match_id  The id of the match.
+ * @param callback  Invoked with the match (or NULL) once retrieved.
+ * @param data      Passed on to the callback.
+ *
+ * @return 0 if the call is under way; or <br>
+ *         1 if too many calls are in progress (cc_error is set to E2MANY).
+ */
+int cchamp_loop_match(CChampLoop* loop, uint16_t region, uint64_t match_id, match_callback callback, void* data)
+{
+    struct loop_call* call;
+    Request* request;
+
+    if ((request = __loop_call(loop, LOOP_MATCH, region, data, &call)) == NULL) {
+        return 1;
+    }
+
+    call->callback.match = callback;
+    match_request(request, region, match_id);
+    __loop_submit(loop, request, call);
+    return 0;
+}
+
+
+/**
+ * Frees a loop. The calls still in progress are dropped without their callbacks being invoked, and the
+ * sockets of the loop are unwatched.
+ *
+ * @param loop The loop.
+ */
+void cchamp_loop_free(CChampLoop* loop)
+{
+    dispatch_cleanup(&loop->dispatcher);
+
+    if (loop->armed != 0) {
+        loop->timer(-1, loop->data);
+    }
+
+    free(loop);
+}
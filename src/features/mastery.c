@@ -0,0 +1,363 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cJSON.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include <network/riot/api.h>
+#include <network/riot/dispatch.h>
+
+#define MASTERY_ALIGNMENT   64
+
+// Calls may be made from many threads at once (see cchamp_workers_start()).
+static __thread Request request;
+
+/*
+ * A bulk fetch in progress: the players left to fetch, and the columns the masteries go to.
+ */
+struct mastery_bulk {
+    uint16_t        region;
+    uint32_t*       summoner_ids;
+    uint32_t        count;
+    uint32_t        next;
+
+    MasteryColumns* columns;
+    uint32_t        fetched;
+    uint16_t        error;
+};
+
+
+/**
+ * Parses a mastery.
+ */
+static void __parse_mastery(cJSON* item, ChampionMastery* mastery)
+{
+    mastery->summoner_id = json_number(item, "playerId");
+    mastery->champion = json_number(item, "championId");
+    mastery->points = json_number(item, "championPoints");
+    mastery->points_since_last_level = json_number(item, "championPointsSinceLastLevel");
+    mastery->points_until_next_level = json_number(item, "championPointsUntilNextLevel");
+    mastery->last_play_time = json_number(item, "lastPlayTime");
+    mastery->level = json_number(item, "championLevel");
+    mastery->tokens = json_number(item, "tokensEarned");
+    mastery->chest_granted = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(item, "chestGranted"));
+}
+
+
+/**
+ * Sends a champion mastery request.
+ *
+ * @param region        The region of the player.
+ * @param summoner_id   The summoner id of the player.
+ * @param qualifier     The API path of the request.
+ * @param suffix        What follows the summoner id in the path; NULL for nothing.
+ */
+static char* __mastery_request(uint16_t region, char* summoner_id, char* qualifier, Argument* suffix)
+{
+    request.api = API_CHAMPION_MASTERY;
+    request.region = region;
+    request.arguments.path.head = path_qualifier(&request, qualifier, path_arg(&request, summoner_id, suffix));
+
+    cchamp_send_request(&request);
+    return request.http_code != 200 ? NULL : request.response.addr;
+}
+
+
+/**
+ * Retrieves the masteries of a player.
+ *
+ * @param region        The region of the player.
+ * @param summoner_id   The summoner id of the player.
+ * @param masteries     The structs to fill.
+ * @param max           The number of structs available.
+ *
+ * @return The number of masteries filled; or <br>
+ *         -1 on failure (see cc_error).
+ */
+int get_champion_masteries_by_sid(uint16_t region, char* summoner_id, ChampionMastery* masteries, int max)
+{
+    int count = -1;
+    char* response;
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+
+    if ((response = __mastery_request(region, summoner_id, "/champion-masteries/by-summoner/", NULL)) != NULL) {
+        cJSON* data = cJSON_Parse(response);
+        cJSON* item;
+
+        if (cJSON_IsArray(data)) {
+            count = 0;
+
+            cJSON_ArrayForEach(item, data) {
+                if (count == max) break;
+                __parse_mastery(item, masteries + count++);
+            }
+        } else {
+            cc_error = EUNKNOWN;
+        }
+
+        cJSON_Delete(data);
+    }
+
+    channel_clean(&request);
+    return count;
+}
+
+
+/**
+ * Retrieves the mastery of a player over a champion.
+ *
+ * @param region        The region of the player.
+ * @param summoner_id   The summoner id of the player.
+ * @param champion      The id of the champion.
+ * @param mastery       The struct to fill.
+ */
+ChampionMastery* get_champion_mastery(uint16_t region, char* summoner_id, uint32_t champion, ChampionMastery* mastery)
+{
+    ChampionMastery* result = NULL;
+    char champion_id[16];
+    char* response;
+
+    sprintf(champion_id, "%u", champion);
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+
+    response = __mastery_request(region, summoner_id, "/champion-masteries/by-summoner/",
+                                 path_qualifier(&request, "/by-champion/", path_arg(&request, champion_id, NULL)));
+
+    if (response != NULL) {
+        cJSON* data = cJSON_Parse(response);
+
+        if (cJSON_IsObject(data)) {
+            __parse_mastery(data, mastery);
+            result = mastery;
+        } else {
+            cc_error = EUNKNOWN;
+        }
+
+        cJSON_Delete(data);
+    }
+
+    channel_clean(&request);
+    return result;
+}
+
+
+/**
+ * Retrieves the mastery score of a player (the total of the player's mastery levels).
+ *
+ * @param region        The region of the player.
+ * @param summoner_id   The summoner id of the player.
+ *
+ * @return The score; or <br>
+ *         -1 on failure (see cc_error).
+ */
+int get_mastery_score_by_sid(uint16_t region, char* summoner_id)
+{
+    int score = -1;
+    char* response;
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+
+    if ((response = __mastery_request(region, summoner_id, "/scores/by-summoner/", NULL)) != NULL) {
+        score = strtol(response, NULL, 10);
+    }
+
+    channel_clean(&request);
+    return score;
+}
+
+
+/**
+ * Moves a column into a larger aligned allocation.
+ *
+ * @return 0 on success; or <br>
+ *         1 if memory ran out (the column is left as it was).
+ */
+static int __column_grow(void** column, size_t width, uint32_t count, uint32_t capacity)
+{
+    void* grown;
+
+    if (posix_memalign(&grown, MASTERY_ALIGNMENT, width * capacity) != 0) {
+        return 1;
+    }
+
+    if (*column != NULL) {
+        memcpy(grown, *column, width * count);
+    }
+
+    free(*column);
+    *column = grown;
+    return 0;
+}
+
+
+/**
+ * Makes room for (count) more rows in the columns.
+ *
+ * @return 0 on success; or <br>
+ *         1 if memory ran out.
+ */
+static int __columns_reserve(MasteryColumns* columns, uint32_t count)
+{
+    uint32_t capacity = columns->capacity ? columns->capacity : 1024;
+
+    if (columns->count + count <= columns->capacity) {
+        return 0;
+    }
+
+    while (capacity < columns->count + count) {
+        capacity *= 2;
+    }
+
+    if (__column_grow((void **)&columns->summoner_ids, sizeof(uint32_t), columns->count, capacity) ||
+            __column_grow((void **)&columns->champions, sizeof(uint32_t), columns->count, capacity) ||
+            __column_grow((void **)&columns->points, sizeof(uint32_t), columns->count, capacity) ||
+            __column_grow((void **)&columns->levels, sizeof(uint8_t), columns->count, capacity)) {
+
+        // The columns that grew already are only larger than needed; the capacity stays that of the smallest.
+        return 1;
+    }
+
+    columns->capacity = capacity;
+    return 0;
+}
+
+
+/**
+ * Appends the masteries of a player to the columns of a bulk fetch.
+ */
+static void __mastery_received(Request* req, uint16_t status, void* data)
+{
+    struct mastery_bulk* bulk = data;
+    MasteryColumns* columns = bulk->columns;
+    cJSON* response;
+    cJSON* item;
+
+    // A player without any mastery is simply not found.
+    if (status == ENOTFOUND) {
+        bulk->fetched++;
+        return;
+    }
+
+    if (status != EPASS) {
+        bulk->error = status;
+        return;
+    }
+
+    response = cJSON_Parse(req->response.addr);
+    if (!cJSON_IsArray(response)) {
+        cJSON_Delete(response);
+        bulk->error = EUNKNOWN;
+        return;
+    }
+
+    if (__columns_reserve(columns, cJSON_GetArraySize(response))) {
+        cJSON_Delete(response);
+        bulk->error = E2MANY;
+        return;
+    }
+
+    cJSON_ArrayForEach(item, response) {
+        columns->summoner_ids[columns->count] = json_number(item, "playerId");
+        columns->champions[columns->count] = json_number(item, "championId");
+        columns->points[columns->count] = json_number(item, "championPoints");
+        columns->levels[columns->count] = json_number(item, "championLevel");
+        columns->count++;
+    }
+
+    bulk->fetched++;
+    cJSON_Delete(response);
+}
+
+
+/**
+ * Creates empty mastery columns.
+ *
+ * @return The columns, to be freed with cchamp_mastery_columns_free(); or <br>
+ *         NULL if memory ran out.
+ */
+MasteryColumns* cchamp_mastery_columns_create()
+{
+    return calloc(1, sizeof(MasteryColumns));
+}
+
+
+/**
+ * Fetches the masteries of many players concurrently.
+ *
+ * @param region        The region of the players.
+ * @param summoner_ids  The summoner ids of the players.
+ * @param count         The number of players.
+ * @param columns       The columns to append the masteries to.
+ *
+ * @return The number of players whose masteries were fetched; or <br>
+ *         -1 if the fetch could not start (see cc_error).
+ */
+int cchamp_mastery_bulk(uint16_t region, uint32_t* summoner_ids, uint32_t count, MasteryColumns* columns)
+{
+    struct mastery_bulk bulk = {
+        .region = region, .summoner_ids = summoner_ids, .count = count, .columns = columns, .error = EPASS
+    };
+    Dispatcher* dispatcher = malloc(sizeof(Dispatcher));
+    Request* req;
+
+    if (dispatcher == NULL || dispatch_init(dispatcher)) {
+        free(dispatcher);
+        return -1;
+    }
+
+    do {
+        while (bulk.next < bulk.count && (req = dispatch_request(dispatcher)) != NULL) {
+            char summoner_id[16];
+
+            sprintf(summoner_id, "%u", summoner_ids[bulk.next++]);
+            req->api = API_CHAMPION_MASTERY;
+            req->region = region;
+            req->arguments.path.head = path_qualifier(req, "/champion-masteries/by-summoner/",
+                                                      path_arg(req, summoner_id, NULL));
+            dispatch_submit(dispatcher, req, __mastery_received, &bulk);
+        }
+    } while (dispatch_run(dispatcher, 1000) != 0 || bulk.next < bulk.count);
+
+    dispatch_cleanup(dispatcher);
+    free(dispatcher);
+
+    cc_error = bulk.error;
+    return bulk.fetched;
+}
+
+
+/**
+ * Frees mastery columns.
+ */
+void cchamp_mastery_columns_free(MasteryColumns* columns)
+{
+    if (columns == NULL) {
+        return;
+    }
+
+    free(columns->summoner_ids);
+    free(columns->champions);
+    free(columns->points);
+    free(columns->levels);
+    free(columns);
+}
@@ -0,0 +1,378 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cJSON.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include <network/riot/api.h>
+#include <network/riot/dispatch.h>
+#include "match.h"
+
+// Calls may be made from many threads at once (see cchamp_workers_start()).
+static __thread Request request;
+
+/*
+ * The state of a match history being fetched by cchamp_match_history(). Pages of the match list are fetched
+ * one after another, and the ids of every page are queued for their details to be fetched concurrently.
+ */
+struct match_history {
+    uint16_t        region;
+    char*           account_id;
+    uint32_t        limit;
+
+    // The number of match ids listed so far, and whether the list is exhausted (or failed).
+    uint32_t        listed;
+    int             listing;
+    int             list_done;
+    uint16_t        list_status;
+
+    // The match ids waiting for their details to be fetched.
+    uint64_t*       queue;
+    uint32_t        queue_head;
+    uint32_t        queue_size;
+
+    uint32_t        delivered;
+    match_callback  callback;
+    void*           data;
+
+    MatchList       page;
+    Match           match;
+};
+
+
+/**
+ * Parses a page of a match list.
+ *
+ * @param response  The response from the API servers in JSON format.
+ * @param list      The struct to fill.
+ *
+ * @return The filled list; or <br>
+ *         NULL if the response is not a match list (cc_error is set to EUNKNOWN).
+ */
+MatchList* match_list_parse(char* response, MatchList* list)
+{
+    cJSON* data = cJSON_Parse(response);
+    cJSON* matches = cJSON_GetObjectItemCaseSensitive(data, "matches");
+    cJSON* reference;
+
+    if (!cJSON_IsArray(matches)) {
+        cJSON_Delete(data);
+        cc_error = EUNKNOWN;
+        return NULL;
+    }
+
+    list->total_games = json_number(data, "totalGames");
+    list->start_index = json_number(data, "startIndex");
+    list->end_index = json_number(data, "endIndex");
+    list->count = 0;
+
+    cJSON_ArrayForEach(reference, matches) {
+        if (list->count == MATCHLIST_PAGE_SIZE) break;
+
+        MatchReference* match = list->matches + list->count++;
+        match->game_id = json_number(reference, "gameId");
+        match->timestamp = json_number(reference, "timestamp");
+        match->champion = json_number(reference, "champion");
+        match->queue = json_number(reference, "queue");
+        match->season = json_number(reference, "season");
+        json_string(match->lane, sizeof(match->lane), reference, "lane");
+        json_string(match->role, sizeof(match->role), reference, "role");
+    }
+
+    cJSON_Delete(data);
+    return list;
+}
+
+
+/**
+ * Parses the details of a match.
+ *
+ * @param response  The response from the API servers in JSON format.
+ * @param match     The struct to fill.
+ *
+ * @return The filled match; or <br>
+ *         NULL if the response is not a match (cc_error is set to EUNKNOWN).
+ */
+Match* match_parse(char* response, Match* match)
+{
+    cJSON* data = cJSON_Parse(response);
+    cJSON* participants = cJSON_GetObjectItemCaseSensitive(data, "participants");
+    cJSON* identities = cJSON_GetObjectItemCaseSensitive(data, "participantIdentities");
+    cJSON* participant;
+
+    if (!cJSON_IsArray(participants)) {
+        cJSON_Delete(data);
+        cc_error = EUNKNOWN;
+        return NULL;
+    }
+
+    memset(match, 0x00, sizeof(Match));
+    match->game_id = json_number(data, "gameId");
+    match->creation = json_number(data, "gameCreation");
+    match->duration = json_number(data, "gameDuration");
+    match->queue = json_number(data, "queueId");
+    match->map = json_number(data, "mapId");
+    match->season = json_number(data, "seasonId");
+    json_string(match->version, sizeof(match->version), data, "gameVersion");
+
+    cJSON_ArrayForEach(participant, participants) {
+        if (match->participants_count == MATCH_PARTICIPANTS_MAX) break;
+
+        MatchParticipant* p = match->participants + match->participants_count++;
+        cJSON* stats = cJSON_GetObjectItemCaseSensitive(participant, "stats");
+        int id = json_number(participant, "participantId");
+        char item[8] = "item0";
+
+        p->champion = json_number(participant, "championId");
+        p->team = json_number(participant, "teamId");
+        p->spells[0] = json_number(participant, "spell1Id");
+        p->spells[1] = json_number(participant, "spell2Id");
+        p->win = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(stats, "win"));
+        p->kills = json_number(stats, "kills");
+        p->deaths = json_number(stats, "deaths");
+        p->assists = json_number(stats, "assists");
+        p->minions = json_number(stats, "totalMinionsKilled");
+        p->gold_earned = json_number(stats, "goldEarned");
+
+        for (int i = 0; i < MATCH_ITEMS; i++) {
+            item[4] = '0' + i;
+            p->items[i] = json_number(stats, item);
+        }
+
+        // The identity of a participant is listed apart, under the same participant id.
+        cJSON* identity;
+        cJSON_ArrayForEach(identity, identities) {
+            if (json_number(identity, "participantId") != id) continue;
+
+            cJSON* player = cJSON_GetObjectItemCaseSensitive(identity, "player");
+            p->account_id = json_number(player, "accountId");
+            p->summoner_id = json_number(player, "summonerId");
+            json_string(p->summoner_name, sizeof(p->summoner_name), player, "summonerName");
+            break;
+        }
+    }
+
+    cJSON_Delete(data);
+    return match;
+}
+
+
+/**
+ * Fills the arguments of a match list request.
+ */
+void match_list_request(Request* req, uint16_t region, char* account_id, uint32_t begin_index)
+{
+    char begin[16], end[16];
+
+    sprintf(begin, "%u", begin_index);
+    sprintf(end, "%u", begin_index + MATCHLIST_PAGE_SIZE);
+
+    req->api = API_MATCH;
+    req->region = region;
+    req->arguments.path.head = path_qualifier(req, "/matchlists/by-account/", path_arg(req, account_id, NULL));
+    req->arguments.query.head = query_arg(req, "beginIndex", begin, query_arg(req, "endIndex", end, NULL));
+}
+
+
+/**
+ * Fills the arguments of a match request.
+ */
+void match_request(Request* req, uint16_t region, uint64_t match_id)
+{
+    char id[24];
+
+    sprintf(id, "%llu", (unsigned long long)match_id);
+
+    req->api = API_MATCH;
+    req->region = region;
+    req->arguments.path.head = path_qualifier(req, "/matches/", path_arg(req, id, NULL));
+}
+
+
+/**
+ * Retrieves a page of the match list of a player, most recent matches first.
+ *
+ * @param region        The region which the player's account is in.
+ * @param account_id    The account id of the player's account.
+ * @param begin_index   The index of the first match of the page (0 for the most recent match).
+ * @param list          The struct to fill.
+ */
+MatchList* get_matchlist_by_aid(uint16_t region, char* account_id, uint32_t begin_index, MatchList* list)
+{
+    MatchList* result = NULL;
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+    match_list_request(&request, region, account_id, begin_index);
+
+    cchamp_send_request(&request);
+    if (request.http_code == 200) {
+        result = match_list_parse(request.response.addr, list);
+    }
+
+    channel_clean(&request);
+    return result;
+}
+
+
+/**
+ * Retrieves the details of a match.
+ *
+ * @param region    The region which the match was played in.
+ * @param match_id  The id of the match (gameId).
+ * @param match     The struct to fill.
+ */
+Match* get_match(uint16_t region, uint64_t match_id, Match* match)
+{
+    Match* result = NULL;
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+    match_request(&request, region, match_id);
+
+    cchamp_send_request(&request);
+    if (request.http_code == 200) {
+        result = match_parse(request.response.addr, match);
+    }
+
+    channel_clean(&request);
+    return result;
+}
+
+
+/**
+ * Queues the ids of a page of the match list. The list is done once a page comes back short, or the limit
+ * of the history is reached.
+ */
+static void __history_page(Request* req, uint16_t status, void* data)
+{
+    struct match_history* history = data;
+
+    history->listing = 0;
+
+    // A player without any match is reported as not found.
+    if (status != EPASS || match_list_parse(req->response.addr, &history->page) == NULL) {
+        history->list_done = 1;
+        history->list_status = status == ENOTFOUND ? EPASS : (status != EPASS ? status : EUNKNOWN);
+        return;
+    }
+
+    for (uint32_t i = 0; i < history->page.count && history->listed < history->limit; i++) {
+        if (history->queue_size % MATCHLIST_PAGE_SIZE == 0) {
+            uint64_t* queue = realloc(history->queue, sizeof(uint64_t) * (history->queue_size + MATCHLIST_PAGE_SIZE));
+            if (queue == NULL) {
+                history->list_done = 1;
+                history->list_status = E2MANY;
+                return;
+            }
+
+            history->queue = queue;
+        }
+
+        history->queue[history->queue_size++] = history->page.matches[i].game_id;
+        history->listed++;
+    }
+
+    if (history->page.count < MATCHLIST_PAGE_SIZE || history->listed >= history->limit
+            || history->page.end_index >= history->page.total_games) {
+        history->list_done = 1;
+    }
+}
+
+
+/**
+ * Hands the details of a match over to the callback of the history. Matches that failed are skipped.
+ */
+static void __history_match(Request* req, uint16_t status, void* data)
+{
+    struct match_history* history = data;
+
+    if (status == EPASS && match_parse(req->response.addr, &history->match) != NULL) {
+        history->delivered++;
+        history->callback(&history->match, history->data);
+    }
+}
+
+
+/**
+ * Fetches the match history of a player, streaming the details of every match to a callback.
+ *
+ * The details of the listed matches are fetched concurrently while the following pages of the list are
+ * still being fetched, with as many requests in flight as the rate limit of the region allows. Matches are
+ * handed to the callback in the order their details arrive. Blocks until the history is complete.
+ *
+ * @param region        The region which the player's account is in.
+ * @param account_id    The account id of the player's account.
+ * @param limit         The maximum number of matches to fetch, most recent first.
+ * @param callback      Invoked for every match. The match is only valid during the invocation.
+ * @param data          Passed on to the callback.
+ *
+ * @return The number of matches handed to the callback, with cc_error set if the list could not be fetched in
+ *         full; or <br>
+ *         -1 if the match list could not be fetched (see cc_error).
+ */
+int cchamp_match_history(uint16_t region, char* account_id, uint32_t limit, match_callback callback, void* data)
+{
+    struct match_history* history = calloc(1, sizeof(struct match_history));
+    Dispatcher* dispatcher = malloc(sizeof(Dispatcher));
+    Request* req;
+    int delivered;
+
+    if (history == NULL || dispatcher == NULL || dispatch_init(dispatcher)) {
+        free(history);
+        free(dispatcher);
+        return -1;
+    }
+
+    history->region = region;
+    history->account_id = account_id;
+    history->limit = limit;
+    history->callback = callback;
+    history->data = data;
+    history->list_done = limit == 0;
+
+    for (;;) {
+
+        // The next page of the list goes first, so that ids keep flowing ahead of the details.
+        if (!history->list_done && !history->listing && (req = dispatch_request(dispatcher)) != NULL) {
+            match_list_request(req, region, account_id, history->listed);
+            dispatch_submit(dispatcher, req, __history_page, history);
+            history->listing = 1;
+        }
+
+        while (history->queue_head < history->queue_size && (req = dispatch_request(dispatcher)) != NULL) {
+            match_request(req, region, history->queue[history->queue_head++]);
+            dispatch_submit(dispatcher, req, __history_match, history);
+        }
+
+        if (dispatch_run(dispatcher, 1000) == 0 && history->list_done && history->queue_head == history->queue_size) {
+            break;
+        }
+    }
+
+    dispatch_cleanup(dispatcher);
+
+    // A list cut short by an error still delivers the matches listed before it, but reports the error.
+    cc_error = history->list_status;
+    delivered = history->list_status != EPASS && history->listed == 0 ? -1 : (int)history->delivered;
+
+    free(history->queue);
+    free(history);
+    free(dispatcher);
+    return delivered;
+}
@@ -0,0 +1,25 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_MATCH_H
+#define CCHAMP_MATCH_H
+#include <cchamp/cchamp.h>
+#include <network/channel.h>
+
+void        match_list_request(Request* request, uint16_t region, char* account_id, uint32_t begin_index);
+void        match_request(Request* request, uint16_t region, uint64_t match_id);
+MatchList*  match_list_parse(char* response, MatchList* list);
+Match*      match_parse(char* response, Match* match);
+#endif
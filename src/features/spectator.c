@@ -0,0 +1,505 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cJSON.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include <network/riot/api.h>
+#include <network/riot/dispatch.h>
+#include <network/riot/rate.h>
+
+#define SPECTATOR_REGIONS   11
+
+// The field of a game that counts up between polls, and is left out of the hash of a response.
+#define SPECTATOR_VOLATILE  "\"gameLength\":"
+
+// Calls may be made from many threads at once (see cchamp_workers_start()).
+static __thread Request request;
+
+/*
+ * A tracked player, along with the hash of the latest response (0 while the player is not in a game).
+ */
+struct spectator_player {
+    uint32_t    summoner_id;
+    uint64_t    hash;
+    uint64_t    game_id;
+};
+
+struct spectator_region {
+    struct spectator_player*    players;
+    uint32_t                    count;
+    uint32_t                    capacity;
+
+    // The player to poll next, and when.
+    uint32_t                    cursor;
+    uint64_t                    due;
+};
+
+struct spectator_poll {
+    Spectator*  spectator;
+    uint16_t    region;
+    uint32_t    index;
+    uint32_t    summoner_id;
+    int         used;
+};
+
+struct spectator {
+    spectator_callback      callback;
+    void*                   data;
+    int                     stopped;
+    int                     events;
+
+    struct spectator_region regions[SPECTATOR_REGIONS];
+    struct spectator_poll   polls[DISPATCH_SLOTS];
+    ActiveGame              game;
+};
+
+
+/**
+ * Hashes a block of memory 8 bytes at a time.
+ */
+static uint64_t __spectator_hash(uint64_t hash, const char* data, size_t size)
+{
+    uint64_t word;
+
+    for (; size >= 8; data += 8, size -= 8) {
+        memcpy(&word, data, 8);
+        hash = (hash ^ word) * 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+
+    for (; size > 0; data++, size--) {
+        hash = (hash ^ (uint8_t)*data) * 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+
+/**
+ * Hashes a response of the spectator API, leaving out the length of the game. Never 0.
+ */
+static uint64_t __spectator_body_hash(const char* body, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    const char* field = memmem(body, size, SPECTATOR_VOLATILE, sizeof(SPECTATOR_VOLATILE) - 1);
+
+    if (field != NULL) {
+        const char* value = field + sizeof(SPECTATOR_VOLATILE) - 1;
+
+        hash = __spectator_hash(hash, body, value - body);
+        while (value < body + size && ((*value >= '0' && *value <= '9') || *value == '-')) value++;
+
+        size -= value - body;
+        body = value;
+    }
+
+    return __spectator_hash(hash, body, size) | 1;
+}
+
+
+/**
+ * Parses the game a player is in.
+ *
+ * @param response  The response from the API servers in JSON format.
+ * @param game      The struct to fill.
+ *
+ * @return The filled game; or <br>
+ *         NULL if the response is not a game (cc_error is set to EUNKNOWN).
+ */
+static ActiveGame* __parse_active_game(char* response, ActiveGame* game)
+{
+    cJSON* data = cJSON_Parse(response);
+    cJSON* participants = cJSON_GetObjectItemCaseSensitive(data, "participants");
+    cJSON* mode = cJSON_GetObjectItemCaseSensitive(data, "gameMode");
+    cJSON* participant;
+
+    if (!cJSON_IsArray(participants)) {
+        cJSON_Delete(data);
+        cc_error = EUNKNOWN;
+        return NULL;
+    }
+
+    memset(game, 0x00, sizeof(ActiveGame));
+    game->game_id = json_number(data, "gameId");
+    game->start_time = json_number(data, "gameStartTime");
+    game->length = json_number(data, "gameLength");
+    game->queue = json_number(data, "gameQueueConfigId");
+    game->map = json_number(data, "mapId");
+
+    if (cJSON_IsString(mode)) {
+        strncpy(game->mode, mode->valuestring, sizeof(game->mode) - 1);
+    }
+
+    cJSON_ArrayForEach(participant, participants) {
+        if (game->participants_count == MATCH_PARTICIPANTS_MAX) break;
+
+        ActiveParticipant* p = game->participants + game->participants_count++;
+        cJSON* name = cJSON_GetObjectItemCaseSensitive(participant, "summonerName");
+
+        p->summoner_id = json_number(participant, "summonerId");
+        p->champion = json_number(participant, "championId");
+        p->team = json_number(participant, "teamId");
+        p->spells[0] = json_number(participant, "spell1Id");
+        p->spells[1] = json_number(participant, "spell2Id");
+        p->bot = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(participant, "bot"));
+
+        if (cJSON_IsString(name)) {
+            strncpy(p->summoner_name, name->valuestring, SUMMONER_NAME_MAX_LENGTH);
+        }
+    }
+
+    cJSON_Delete(data);
+    return game;
+}
+
+
+/**
+ * Fills the arguments of an active game request.
+ */
+static void __spectator_request(Request* req, uint16_t region, char* summoner_id)
+{
+    req->api = API_SPECTATOR;
+    req->region = region;
+    req->arguments.path.head = path_qualifier(req, "/active-games/by-summoner/", path_arg(req, summoner_id, NULL));
+}
+
+
+/**
+ * Retrieves the game a player is currently in.
+ *
+ * @param region        The region of the player.
+ * @param summoner_id   The summoner id of the player.
+ * @param game          The struct to fill.
+ */
+ActiveGame* get_active_game_by_sid(uint16_t region, char* summoner_id, ActiveGame* game)
+{
+    ActiveGame* result = NULL;
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+    __spectator_request(&request, region, summoner_id);
+
+    cchamp_send_request(&request);
+    if (request.http_code == 200) {
+        result = __parse_active_game(request.response.addr, game);
+    }
+
+    channel_clean(&request);
+    return result;
+}
+
+
+/**
+ * Reports an event of a player to the callback of the spectator.
+ */
+static void __spectator_emit(Spectator* spectator, int type, uint16_t region, uint32_t summoner_id, uint64_t game_id,
+                             ActiveGame* game)
+{
+    SpectatorEvent event = {
+        .type = type, .region = region, .summoner_id = summoner_id, .game_id = game_id, .game = game
+    };
+
+    spectator->events++;
+    spectator->callback(&event, spectator->data);
+}
+
+
+/**
+ * Compares the response of a poll with the previous one of the player, and reports what changed.
+ */
+static void __spectator_polled(Request* req, uint16_t status, void* data)
+{
+    struct spectator_poll* poll = data;
+    Spectator* spectator = poll->spectator;
+    struct spectator_region* region = spectator->regions + get_bit_index(poll->region);
+    struct spectator_player* player = NULL;
+    uint64_t hash = 0;
+
+    poll->used = 0;
+
+    // Failed polls (other than a player out of game) tell nothing, and the player is polled again next time.
+    if (status != EPASS && status != ENOTFOUND) {
+        return;
+    }
+
+    // The player may have moved (or been untracked) while the poll was in flight.
+    if (poll->index < region->count && region->players[poll->index].summoner_id == poll->summoner_id) {
+        player = region->players + poll->index;
+    } else {
+        for (uint32_t i = 0; i < region->count && player == NULL; i++) {
+            if (region->players[i].summoner_id == poll->summoner_id) player = region->players + i;
+        }
+    }
+
+    if (player == NULL) {
+        return;
+    }
+
+    if (status == EPASS) {
+        hash = __spectator_body_hash(req->response.addr, req->response.size);
+    }
+
+    if (hash == player->hash) {
+        return;
+    }
+
+    uint64_t previous = player->game_id;
+    player->hash = hash;
+
+    if (hash == 0 || __parse_active_game(req->response.addr, &spectator->game) == NULL) {
+        player->hash = 0;
+        player->game_id = 0;
+
+        if (previous != 0) {
+            __spectator_emit(spectator, SPECTATOR_GAME_ENDED, poll->region, poll->summoner_id, previous, NULL);
+        }
+
+        return;
+    }
+
+    player->game_id = spectator->game.game_id;
+
+    if (previous == spectator->game.game_id) {
+        __spectator_emit(spectator, SPECTATOR_GAME_CHANGED, poll->region, poll->summoner_id, previous, &spectator->game);
+        return;
+    }
+
+    // The next game was already under way by the time the player was polled again.
+    if (previous != 0) {
+        __spectator_emit(spectator, SPECTATOR_GAME_ENDED, poll->region, poll->summoner_id, previous, NULL);
+    }
+
+    __spectator_emit(spectator, SPECTATOR_GAME_STARTED, poll->region, poll->summoner_id, player->game_id, &spectator->game);
+}
+
+
+/**
+ * Creates a spectator without any tracked player.
+ *
+ * @param callback  Invoked for every event, from within cchamp_spectator_run().
+ * @param data      Passed on to the callback.
+ *
+ * @return The spectator, to be freed with cchamp_spectator_free(); or <br>
+ *         NULL if memory ran out.
+ */
+Spectator* cchamp_spectator_create(spectator_callback callback, void* data)
+{
+    Spectator* spectator = calloc(1, sizeof(Spectator));
+
+    if (spectator != NULL) {
+        spectator->callback = callback;
+        spectator->data = data;
+    }
+
+    return spectator;
+}
+
+
+/**
+ * Starts tracking a player. Tracking a player twice has no effect.
+ *
+ * @return 0 on success; or <br>
+ *         1 if memory ran out.
+ */
+int cchamp_spectator_track(Spectator* spectator, uint16_t region, uint32_t summoner_id)
+{
+    struct spectator_region* tracked = spectator->regions + get_bit_index(region);
+
+    for (uint32_t i = 0; i < tracked->count; i++) {
+        if (tracked->players[i].summoner_id == summoner_id) return 0;
+    }
+
+    if (tracked->count == tracked->capacity) {
+        uint32_t capacity = tracked->capacity ? tracked->capacity * 2 : 64;
+        struct spectator_player* players = realloc(tracked->players, sizeof(struct spectator_player) * capacity);
+
+        if (players == NULL) {
+            return 1;
+        }
+
+        tracked->players = players;
+        tracked->capacity = capacity;
+    }
+
+    tracked->players[tracked->count++] = (struct spectator_player){ .summoner_id = summoner_id };
+    return 0;
+}
+
+
+/**
+ * Stops tracking a player. No event is reported for the game the player may be in.
+ *
+ * @return 0 if the player was untracked; or <br>
+ *         1 if the player was not tracked.
+ */
+int cchamp_spectator_untrack(Spectator* spectator, uint16_t region, uint32_t summoner_id)
+{
+    struct spectator_region* tracked = spectator->regions + get_bit_index(region);
+
+    for (uint32_t i = 0; i < tracked->count; i++) {
+        if (tracked->players[i].summoner_id == summoner_id) {
+            tracked->players[i] = tracked->players[--tracked->count];
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * The time between two polls of a region, in milliseconds: the interval shared among the tracked players,
+ * but no shorter than what the rate limit sustains (less its headroom, see rate_limits()).
+ */
+static uint64_t __spectator_spacing(struct spectator_region* region, unsigned int interval)
+{
+    uint64_t spacing = interval / region->count;
+    uint64_t sustained = 0;
+    uint64_t keys = api_keys_usable() > 0 ? api_keys_usable() : 1;
+    uint32_t per_second, per_two_minutes;
+
+    // Every key has rate limits of its own (see rate_acquire()).
+    if (rate_limits(&per_second, &per_two_minutes) == 0) {
+        sustained = 1000 / (per_second * keys);
+
+        if (120000 / (per_two_minutes * keys) > sustained) {
+            sustained = 120000 / (per_two_minutes * keys);
+        }
+    }
+
+    return spacing > sustained ? spacing : sustained;
+}
+
+
+/**
+ * Polls the tracked players, reporting the events to the callback.
+ *
+ * @param spectator The spectator.
+ * @param interval  The time between two polls of a player, in milliseconds, when the rate limit allows.
+ * @param duration  The time to run for, in milliseconds; 0 to run until cchamp_spectator_stop().
+ *
+ * @return The number of events reported; or <br>
+ *         -1 if polling could not start (see cc_error).
+ */
+int cchamp_spectator_run(Spectator* spectator, unsigned int interval, unsigned int duration)
+{
+    Dispatcher* dispatcher = malloc(sizeof(Dispatcher));
+    uint64_t now = rate_now();
+    uint64_t end = now + duration;
+
+    if (dispatcher == NULL || dispatch_init(dispatcher)) {
+        free(dispatcher);
+        return -1;
+    }
+
+    __atomic_store_n(&spectator->stopped, 0, __ATOMIC_RELAXED);
+    spectator->events = 0;
+
+    for (int r = 0; r < SPECTATOR_REGIONS; r++) {
+        spectator->regions[r].due = now;
+    }
+
+    while (!__atomic_load_n(&spectator->stopped, __ATOMIC_RELAXED) && (duration == 0 || now < end)) {
+        uint64_t next = now + 1000;
+
+        for (int r = 0; r < SPECTATOR_REGIONS; r++) {
+            struct spectator_region* region = spectator->regions + r;
+            Request* req;
+
+            if (region->count == 0) continue;
+
+            uint64_t spacing = __spectator_spacing(region, interval);
+
+            // A region that fell behind (i.e. all slots were busy) resumes its pace rather than catching up.
+            if (region->due + spacing < now) {
+                region->due = now;
+            }
+
+            while (region->due <= now && (req = dispatch_request(dispatcher)) != NULL) {
+                struct spectator_poll* poll = spectator->polls;
+                char summoner_id[16];
+
+                while (poll->used) poll++;
+
+                region->cursor %= region->count;
+                poll->spectator = spectator;
+                poll->region = 1 << r;
+                poll->index = region->cursor;
+                poll->summoner_id = region->players[region->cursor++].summoner_id;
+                poll->used = 1;
+
+                sprintf(summoner_id, "%u", poll->summoner_id);
+                __spectator_request(req, poll->region, summoner_id);
+                dispatch_submit(dispatcher, req, __spectator_polled, poll);
+
+                region->due += spacing;
+            }
+
+            if (region->due < next) {
+                next = region->due;
+            }
+        }
+
+        now = rate_now();
+        int wait = next > now ? next - now : 0;
+
+        // Without any poll in flight, the dispatcher returns right away and the next poll is slept on instead.
+        if (dispatch_run(dispatcher, wait) == 0 && wait > 0) {
+            struct timespec delay = { .tv_sec = wait / 1000, .tv_nsec = (wait % 1000) * 1000000L };
+            nanosleep(&delay, NULL);
+        }
+
+        now = rate_now();
+    }
+
+    dispatch_cleanup(dispatcher);
+    free(dispatcher);
+    memset(spectator->polls, 0x00, sizeof(spectator->polls));
+
+    return spectator->events;
+}
+
+
+/**
+ * Stops cchamp_spectator_run() before it sends more polls. The polls in progress are dropped without reporting
+ * any event. May be invoked from any thread, or from the callback.
+ */
+void cchamp_spectator_stop(Spectator* spectator)
+{
+    __atomic_store_n(&spectator->stopped, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Frees a spectator. It must not be running.
+ */
+void cchamp_spectator_free(Spectator* spectator)
+{
+    if (spectator == NULL) {
+        return;
+    }
+
+    for (int r = 0; r < SPECTATOR_REGIONS; r++) {
+        free(spectator->regions[r].players);
+    }
+
+    free(spectator);
+}
@@ -0,0 +1,170 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <cchamp/cchamp.h>
+#include <network/riot/ddragon/static.h>
+#include <network/riot/ddragon/tables.h>
+#include <network/riot/ddragon/phash.h>
+#include "static_lookup.h"
+
+/*
+ * The published table of a category; NULL if the category has never been loaded.
+ */
+const struct static_table* lookup_table(uint16_t category)
+{
+    const struct static_table* table;
+
+    if (categories == NULL) return NULL;
+
+    table = (const struct static_table *)GET_FIRST_PAGE(category);
+    return table->magic == TABLE_MAGIC ? table : NULL;
+}
+
+
+/**
+ * Fills a champion view out of a row of the champions table.
+ * A missing row (UINT32_MAX) is reported through cc_error.
+ */
+Champion* champion_fill(const struct static_table* table, uint32_t row, Champion* champion)
+{
+    if (row == UINT32_MAX) {
+        cc_error = ENOTFOUND;
+        return NULL;
+    }
+
+    champion->id = TABLE_COLUMN(table, uint32_t, CHAMPION_ID)[row];
+    champion->key = TABLE_STRING(table, TABLE_COLUMN(table, uint32_t, CHAMPION_KEY)[row]);
+    champion->name = TABLE_STRING(table, TABLE_COLUMN(table, uint32_t, CHAMPION_NAME)[row]);
+    champion->title = TABLE_STRING(table, TABLE_COLUMN(table, uint32_t, CHAMPION_TITLE)[row]);
+    return champion;
+}
+
+
+/**
+ * Fills an item view out of a row of the items table.
+ * A missing row (UINT32_MAX) is reported through cc_error.
+ */
+Item* item_fill(const struct static_table* table, uint32_t row, Item* item)
+{
+    if (row == UINT32_MAX) {
+        cc_error = ENOTFOUND;
+        return NULL;
+    }
+
+    item->id = TABLE_COLUMN(table, uint32_t, ITEM_ID)[row];
+    item->name = TABLE_STRING(table, TABLE_COLUMN(table, uint32_t, ITEM_NAME)[row]);
+    item->plaintext = TABLE_STRING(table, TABLE_COLUMN(table, uint32_t, ITEM_PLAINTEXT)[row]);
+    item->gold_base = TABLE_COLUMN(table, uint16_t, ITEM_GOLD_BASE)[row];
+    item->gold_total = TABLE_COLUMN(table, uint16_t, ITEM_GOLD_TOTAL)[row];
+    item->gold_sell = TABLE_COLUMN(table, uint16_t, ITEM_GOLD_SELL)[row];
+    item->maps = TABLE_COLUMN(table, uint32_t, ITEM_MAPS)[row];
+    item->__table = table;
+    item->__row = row;
+    return item;
+}
+
+
+/**
+ * Looks up a champion by its numeric id (i.e. 266).
+ *
+ * @param id        The id of the champion.
+ * @param champion  The struct to fill.
+ */
+Champion* cchamp_champion_by_id(uint32_t id, Champion* champion)
+{
+    const struct static_table* table = lookup_table(STATIC_CHAMPIONS);
+    uint32_t row = table == NULL ? UINT32_MAX : phash_find_id(table, INDEX_ID, CHAMPION_ID, id);
+
+    return champion_fill(table, row, champion);
+}
+
+
+/**
+ * Looks up a champion by its key (i.e. "Aatrox"). Keys are case-sensitive.
+ *
+ * @param key       The key of the champion.
+ * @param champion  The struct to fill.
+ */
+Champion* cchamp_champion_by_key(char* key, Champion* champion)
+{
+    const struct static_table* table = lookup_table(STATIC_CHAMPIONS);
+    uint32_t row = table == NULL ? UINT32_MAX : phash_find_string(table, INDEX_KEY, CHAMPION_KEY, key);
+
+    return champion_fill(table, row, champion);
+}
+
+
+/**
+ * Looks up an item by its numeric id (i.e. 1001).
+ *
+ * @param id    The id of the item.
+ * @param item  The struct to fill.
+ */
+Item* cchamp_item_by_id(uint32_t id, Item* item)
+{
+    const struct static_table* table = lookup_table(STATIC_ITEMS);
+    uint32_t row = table == NULL ? UINT32_MAX : phash_find_id(table, INDEX_ID, ITEM_ID, id);
+
+    return item_fill(table, row, item);
+}
+
+
+/**
+ * Looks up a summoner spell by its numeric id (i.e. 4 for Flash).
+ *
+ * @param id    The id of the summoner spell.
+ * @param spell The struct to fill.
+ */
+SummonerSpell* cchamp_spell_by_id(uint32_t id, SummonerSpell* spell)
+{
+    const struct static_table* table = lookup_table(STATIC_SUMMONER_SPELLS);
+    uint32_t row = table == NULL ? UINT32_MAX : phash_find_id(table, INDEX_ID, SPELL_ID, id);
+
+    if (row == UINT32_MAX) {
+        cc_error = ENOTFOUND;
+        return NULL;
+    }
+
+    spell->id = id;
+    spell->key = TABLE_STRING(table, TABLE_COLUMN(table, uint32_t, SPELL_KEY)[row]);
+    spell->name = TABLE_STRING(table, TABLE_COLUMN(table, uint32_t, SPELL_NAME)[row]);
+    spell->description = TABLE_STRING(table, TABLE_COLUMN(table, uint32_t, SPELL_DESCRIPTION)[row]);
+    spell->summoner_level = TABLE_COLUMN(table, uint16_t, SPELL_LEVEL)[row];
+    return spell;
+}
+
+
+/**
+ * Reads a stat of an item. The stat dictionary holds few entries, so a scan is cheaper than a hash.
+ *
+ * @param item  An item filled by cchamp_item_by_id().
+ * @param stat  The name of the stat (i.e. "FlatHPPoolMod").
+ *
+ * @return The value of the stat; or <br>
+ *         0 if the item does not have the stat.
+ */
+float cchamp_item_stat(Item* item, char* stat)
+{
+    const struct static_table* table = (const struct static_table *)item->__table;
+
+    for (uint32_t i = 0; i < table->stats_count; i++) {
+        if (strcmp(TABLE_STAT(table, i), stat) == 0) {
+            return TABLE_STAT_COLUMN(table, i)[item->__row];
+        }
+    }
+
+    return 0;
+}
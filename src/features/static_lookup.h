@@ -0,0 +1,24 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_STATIC_LOOKUP_H
+#define CCHAMP_STATIC_LOOKUP_H
+#include <cchamp/cchamp.h>
+#include <network/riot/ddragon/tables.h>
+
+const struct static_table*  lookup_table(uint16_t category);
+Champion*                   champion_fill(const struct static_table* table, uint32_t row, Champion* champion);
+Item*                       item_fill(const struct static_table* table, uint32_t row, Item* item);
+#endif
@@ -0,0 +1,324 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <cchamp/cchamp.h>
+#include <network/riot/ddragon/tables.h>
+#include <network/riot/ddragon/bitset.h>
+#include "static_lookup.h"
+
+/*
+ * A query holds the set of matching records as a bitset over the rows of a table, and a scratch bitset for
+ * the term of the filter being applied.
+ */
+struct static_query {
+    const struct static_table*  table;
+    uint16_t                    category;
+    uint32_t                    words;
+    uint64_t*                   term;
+    uint64_t                    bits[];
+};
+
+/*
+ * Evaluates (test) for every row of a table and packs the outcomes into a bitset, one 64-bit word at a time.
+ * The test is written without branches so that the inner loop can be vectorized.
+ */
+#define __QUERY_SCAN(count, term, test)                                                 \
+    for (uint32_t __word = 0; __word < BITSET_WORDS(count); __word++) {                 \
+        uint32_t __end = (__word + 1) * 64 < (count) ? (__word + 1) * 64 : (count);     \
+        uint64_t __bits = 0;                                                            \
+        for (uint32_t row = __word * 64; row < __end; row++) {                          \
+            __bits |= (uint64_t)(test) << (row % 64);                                   \
+        }                                                                               \
+        (term)[__word] = __bits;                                                        \
+    }
+
+
+/**
+ * Combines a term into the set of matching records of a query.
+ *
+ * @param query The query.
+ * @param op    One of QUERY_AND, QUERY_OR or QUERY_AND_NOT.
+ * @param term  The bitset of the records matching the term.
+ */
+static void __query_apply(StaticQuery* query, char op, const uint64_t* term)
+{
+    uint64_t* bits = query->bits;
+
+    switch (op) {
+        case QUERY_AND:
+            for (uint32_t i = 0; i < query->words; i++) bits[i] &= term[i];
+            break;
+        case QUERY_OR:
+            for (uint32_t i = 0; i < query->words; i++) bits[i] |= term[i];
+            break;
+        case QUERY_AND_NOT:
+            for (uint32_t i = 0; i < query->words; i++) bits[i] &= ~term[i];
+            break;
+    }
+}
+
+
+/**
+ * Creates a query over the records of a loaded category, STATIC_ITEMS or STATIC_CHAMPIONS.
+ * The query initially matches all records.
+ *
+ * @param category  The category to query.
+ *
+ * @return The query; or <br>
+ *         NULL if the category cannot be queried or was not loaded (cc_error is set to ENOTFOUND).
+ */
+StaticQuery* cchamp_query_create(uint16_t category)
+{
+    const struct static_table* table;
+    StaticQuery* query;
+
+    if (category != STATIC_ITEMS && category != STATIC_CHAMPIONS) {
+        cc_error = ENOTFOUND;
+        return NULL;
+    }
+
+    if ((table = lookup_table(category)) == NULL) {
+        cc_error = ENOTFOUND;
+        return NULL;
+    }
+
+    uint32_t words = BITSET_WORDS(table->count);
+    if ((query = malloc(sizeof(StaticQuery) + sizeof(uint64_t) * words * 2)) == NULL) {
+        return NULL;
+    }
+
+    query->table = table;
+    query->category = category;
+    query->words = words;
+    query->term = query->bits + words;
+
+    memset(query->bits, 0xFF, sizeof(uint64_t) * words);
+    if (table->count % 64 != 0) {
+        query->bits[words - 1] = ((uint64_t)1 << (table->count % 64)) - 1;
+    }
+
+    return query;
+}
+
+
+/**
+ * Filters a query by a tag (i.e. "Boots" for items, or a role such as "Mage" for champions).
+ * Tags are case-sensitive; an unknown tag matches no record.
+ *
+ * @param query The query.
+ * @param op    One of QUERY_AND, QUERY_OR or QUERY_AND_NOT.
+ * @param tag   The tag.
+ */
+void cchamp_query_tag(StaticQuery* query, char op, char* tag)
+{
+    const struct static_table* table = query->table;
+    const uint64_t* mask = TABLE_COLUMN(table, uint64_t, query->category == STATIC_ITEMS ? ITEM_TAGS : CHAMPION_TAGS);
+    uint32_t index = 0;
+
+    while (index < table->tags_count && strcmp(TABLE_TAG(table, index), tag) != 0) {
+        index++;
+    }
+
+    if (index == table->tags_count) {
+        memset(query->term, 0x00, sizeof(uint64_t) * query->words);
+        __query_apply(query, op, query->term);
+    } else if (table->words != 0) {
+        __query_apply(query, op, BITSET_TAG(table, index));
+    } else {
+        // The bitsets could not be built along with the table; fall back to a scan of the tags.
+        __QUERY_SCAN(table->count, query->term, (mask[row] >> index) & 1);
+        __query_apply(query, op, query->term);
+    }
+}
+
+
+/**
+ * Filters an item query by the map the items are available on (i.e. 11 for Summoner's Rift).
+ * Champion queries are left untouched.
+ *
+ * @param query The query.
+ * @param op    One of QUERY_AND, QUERY_OR or QUERY_AND_NOT.
+ * @param map   The id of the map.
+ */
+void cchamp_query_map(StaticQuery* query, char op, uint8_t map)
+{
+    const struct static_table* table = query->table;
+    const uint32_t* maps;
+
+    if (query->category != STATIC_ITEMS) return;
+
+    if (map >= BITSET_MAPS) {
+        memset(query->term, 0x00, sizeof(uint64_t) * query->words);
+        __query_apply(query, op, query->term);
+    } else if (table->words != 0) {
+        __query_apply(query, op, BITSET_MAP(table, map));
+    } else {
+        maps = TABLE_COLUMN(table, uint32_t, ITEM_MAPS);
+        __QUERY_SCAN(table->count, query->term, (maps[row] >> map) & 1);
+        __query_apply(query, op, query->term);
+    }
+}
+
+
+/**
+ * Filters a query by a numeric field falling within [min, max].
+ *
+ * @param query The query.
+ * @param op    One of QUERY_AND, QUERY_OR or QUERY_AND_NOT.
+ * @param field One of the QUERY_* fields; only QUERY_ID applies to champions. Other fields match no record.
+ * @param min   The lowest value matched.
+ * @param max   The highest value matched.
+ */
+void cchamp_query_range(StaticQuery* query, char op, int field, uint32_t min, uint32_t max)
+{
+    const struct static_table* table = query->table;
+    uint32_t span = max - min;
+    int column = -1;
+
+    if (field == QUERY_ID) {
+        column = query->category == STATIC_ITEMS ? ITEM_ID : CHAMPION_ID;
+    } else if (query->category == STATIC_ITEMS) {
+        column = field == QUERY_GOLD_BASE ? ITEM_GOLD_BASE :
+                 field == QUERY_GOLD_TOTAL ? ITEM_GOLD_TOTAL :
+                 field == QUERY_GOLD_SELL ? ITEM_GOLD_SELL : -1;
+    }
+
+    if (column == -1 || min > max) {
+        memset(query->term, 0x00, sizeof(uint64_t) * query->words);
+    } else if (table->width[column] == sizeof(uint16_t)) {
+        const uint16_t* values = TABLE_COLUMN(table, uint16_t, column);
+        __QUERY_SCAN(table->count, query->term, (uint32_t)(values[row] - min) <= span);
+    } else {
+        const uint32_t* values = TABLE_COLUMN(table, uint32_t, column);
+        __QUERY_SCAN(table->count, query->term, (uint32_t)(values[row] - min) <= span);
+    }
+
+    __query_apply(query, op, query->term);
+}
+
+
+/**
+ * Filters an item query by a stat (i.e. "FlatMovementSpeedMod") falling within [min, max].
+ * Items lacking the stat have it at 0, as with cchamp_item_stat(). Champion queries are left untouched.
+ *
+ * @param query The query.
+ * @param op    One of QUERY_AND, QUERY_OR or QUERY_AND_NOT.
+ * @param stat  The name of the stat.
+ * @param min   The lowest value matched.
+ * @param max   The highest value matched.
+ */
+void cchamp_query_stat(StaticQuery* query, char op, char* stat, float min, float max)
+{
+    const struct static_table* table = query->table;
+    uint32_t index = 0;
+
+    if (query->category != STATIC_ITEMS) return;
+
+    while (index < table->stats_count && strcmp(TABLE_STAT(table, index), stat) != 0) {
+        index++;
+    }
+
+    if (index == table->stats_count) {
+        __QUERY_SCAN(table->count, query->term, min <= 0 && 0 <= max);
+    } else {
+        const float* values = TABLE_STAT_COLUMN(table, index);
+        __QUERY_SCAN(table->count, query->term, (values[row] >= min) & (values[row] <= max));
+    }
+
+    __query_apply(query, op, query->term);
+}
+
+
+/**
+ * Counts the records matched by a query.
+ */
+uint32_t cchamp_query_count(StaticQuery* query)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < query->words; i++) {
+        count += __builtin_popcountll(query->bits[i]);
+    }
+
+    return count;
+}
+
+
+/**
+ * Iterates over the records matched by a query, in table order.
+ *
+ * @param query The query.
+ * @param row   The last row returned, or -1 to start.
+ *
+ * @return The next matching row; or <br>
+ *         -1 once all matching rows were returned.
+ */
+int cchamp_query_next(StaticQuery* query, int row)
+{
+    uint32_t next = row + 1;
+
+    for (uint32_t word = next / 64; word < query->words; word++) {
+        uint64_t bits = query->bits[word];
+
+        if (word == next / 64) {
+            bits &= ~(uint64_t)0 << (next % 64);
+        }
+
+        if (bits != 0) {
+            return word * 64 + __builtin_ctzll(bits);
+        }
+    }
+
+    return -1;
+}
+
+
+/**
+ * Fills a champion view out of a row returned by cchamp_query_next().
+ */
+Champion* cchamp_query_champion(StaticQuery* query, int row, Champion* champion)
+{
+    if (query->category != STATIC_CHAMPIONS || row < 0 || (uint32_t)row >= query->table->count) {
+        cc_error = ENOTFOUND;
+        return NULL;
+    }
+
+    return champion_fill(query->table, row, champion);
+}
+
+
+/**
+ * Fills an item view out of a row returned by cchamp_query_next().
+ */
+Item* cchamp_query_item(StaticQuery* query, int row, Item* item)
+{
+    if (query->category != STATIC_ITEMS || row < 0 || (uint32_t)row >= query->table->count) {
+        cc_error = ENOTFOUND;
+        return NULL;
+    }
+
+    return item_fill(query->table, row, item);
+}
+
+
+/**
+ * Releases a query.
+ */
+void cchamp_query_free(StaticQuery* query)
+{
+    free(query);
+}
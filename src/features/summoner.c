@@ -16,55 +16,84 @@
 #include <stdlib.h>
 #include <string.h>
 #include "summoner.h"
+#include "summoner_index.h"
 #include <cJSON.h>
 #include <network/riot/api.h>
 #include <cchamp_utils.h>
 
-static Request request;
+// Calls may be made from many threads at once (see cchamp_workers_start()).
+static __thread Request request;
+
+// The API path for each of the SUMMONER_KEY_* constants.
+static char* __qualifiers[] = {
+    "/summoners/",
+    "/summoners/by-account/",
+    "/summoners/by-name/"
+};
 
 /**
- * Parses the acquired JSON response from the server so that a summoner struct may be
- * created and returned.
+ * Parses the acquired JSON response from the server into a summoner struct.
  *
  * @param region    The region in which the player was found.
  * @param response  The response from the API servers in JSON format.
+ * @param summoner  The struct to fill.
+ *
+ * @return The filled summoner; or <br>
+ *         NULL if the response is not a summoner (cc_error is set to EUNKNOWN).
  */
-static Summoner* __parse_summoner(uint16_t region, char* response)
+Summoner* summoner_parse(uint16_t region, char* response, Summoner* summoner)
 {
     cJSON* data = cJSON_Parse(response);
-    char* name = cJSON_GetObjectItemCaseSensitive(data, "name")->valuestring;
-    uint32_t summoner_id = cJSON_GetObjectItemCaseSensitive(data, "id")->valueint;
-    uint32_t account_id = cJSON_GetObjectItemCaseSensitive(data, "accountId")->valueint;
-    int level = cJSON_GetObjectItemCaseSensitive(data, "summonerLevel")->valueint;
-    int icon_id = cJSON_GetObjectItemCaseSensitive(data, "profileIconId")->valueint;
-    char* region_str = regions[get_bit_index(region)];
-
-    Summoner* summoner = summoner_create(name, region_str, account_id, summoner_id);
-    summoner->level = level;
-    summoner->profile_icon_id = icon_id;
-
-    // clean up all memory used for this request now that it has been completed.
-    channel_clean(&request);
-    cJSON_Delete(data);
+    cJSON* name = cJSON_GetObjectItemCaseSensitive(data, "name");
+    cJSON* summoner_id = cJSON_GetObjectItemCaseSensitive(data, "id");
+    cJSON* account_id = cJSON_GetObjectItemCaseSensitive(data, "accountId");
+    cJSON* level = cJSON_GetObjectItemCaseSensitive(data, "summonerLevel");
+    cJSON* icon_id = cJSON_GetObjectItemCaseSensitive(data, "profileIconId");
+
+    if (!cJSON_IsString(name) || !cJSON_IsNumber(summoner_id) || !cJSON_IsNumber(account_id)) {
+        cJSON_Delete(data);
+        cc_error = EUNKNOWN;
+        return NULL;
+    }
+
+    summoner_init(summoner, name->valuestring, regions[(int)get_bit_index(region)], account_id->valueint,
+                  summoner_id->valueint);
+    summoner->level = cJSON_IsNumber(level) ? level->valueint : 0;
+    summoner->profile_icon_id = cJSON_IsNumber(icon_id) ? icon_id->valueint : 0;
+    summoner_index_update(region, summoner, name->valuestring);
 
+    cJSON_Delete(data);
     return summoner;
 }
 
+/**
+ * Fills a flushed request for a summoner, to be sent (i.e. by a dispatcher).
+ *
+ * @param request   The request.
+ * @param region    The region which the targeted summoner lies in.
+ * @param key       The SUMMONER_KEY_* constant of the keyword type.
+ * @param value     The query keyword (i.e. summoner id, account id, or summoner name).
+ */
+void summoner_request(Request* request, uint16_t region, int key, char* value)
+{
+    request->api = API_SUMMONER;
+    request->arguments.path.head = path_qualifier(request, __qualifiers[key], path_arg(request, value, NULL));
+    request->region = region;
+}
+
+
 /**
  * Dispatches a summoner information retrieval request.
  *
  * @param region        The region which the targeted summoner lies in.
- * @param keyword       The query keyword (i.e. summoner id, account id, or summoner name).
- * @param qualifier     Specifies to the api which path to take based on keyword type.
+ * @param key           The SUMMONER_KEY_* constant of the keyword type.
+ * @param value         The query keyword (i.e. summoner id, account id, or summoner name).
  */
-static char* summoner_request(uint16_t region, char* value, char* qualifier)
+static char* __summoner_send(uint16_t region, int key, char* value)
 {
     // Flush the request in preparation for new values.
     memset(&request, 0x00, sizeof(Request));
-
-    request.api = API_SUMMONER;
-    request.arguments.path.head = path_arg(&request, qualifier, path_arg(&request, value, NULL));
-    request.region = region;
+    summoner_request(&request, region, key, value);
 
     cchamp_send_request(&request);
     return request.http_code != 200 ? NULL : request.response.addr;
@@ -72,19 +101,70 @@ static char* summoner_request(uint16_t region, char* value, char* qualifier)
 
 
 /**
- * Allocates and initializes a summoner object.
+ * Retrieves a summoner into the provided storage.
+ * Summoners recently recorded in the identity index are served from it, without any request.
  *
+ * @param region    The region which the targeted summoner lies in.
+ * @param key       The SUMMONER_KEY_* constant of the keyword type.
+ * @param value     The query keyword (i.e. summoner id, account id, or summoner name).
+ * @param summoner  The struct to fill. NULL (i.e. an exhausted allocation) fails the retrieval.
+ */
+static Summoner* __summoner_get(uint16_t region, int key, char* value, Summoner* summoner)
+{
+    Summoner* result = NULL;
+
+    if (summoner == NULL) {
+        cc_error = E2MANY;
+        return NULL;
+    }
+
+    if (summoner_index_serve(region, key, value, summoner) != NULL) {
+        cc_error = EPASS;
+        return summoner;
+    }
+
+    char* response = __summoner_send(region, key, value);
+    if (response != NULL) {
+        result = summoner_parse(region, response, summoner);
+    }
+
+    // clean up all memory used for this request now that it has been completed, whatever its outcome.
+    channel_clean(&request);
+    return result;
+}
+
+
+/**
+ * Retrieves a summoner into a newly allocated struct, which the caller must free.
+ */
+static Summoner* __summoner_get_allocated(uint16_t region, int key, char* value)
+{
+    Summoner* summoner = malloc(sizeof(Summoner));
+    Summoner* result = __summoner_get(region, key, value, summoner);
+
+    if (result == NULL) {
+        free(summoner);
+    }
+
+    return result;
+}
+
+
+/**
+ * Initializes a summoner object.
+ * Names and regions that do not fit are truncated; unused bytes are zeroed.
+ *
+ * @param summoner      The struct to initialize.
  * @param summoner_name The name of the player.
  * @param region        The region which the player's account is in.
  */
-Summoner* summoner_create(char* summoner_name, char* region, uint32_t account_id, uint32_t summoner_id)
+void summoner_init(Summoner* summoner, char* summoner_name, char* region, uint32_t account_id, uint32_t summoner_id)
 {
-    Summoner* summoner= calloc(1, sizeof(Summoner));
+    memset(summoner, 0x00, sizeof(Summoner));
     summoner->account_id = account_id;
     summoner->summoner_id = summoner_id;
-    memcpy(summoner->name, summoner_name, strlen(summoner_name));
-    memcpy(summoner->region, region, strlen(region));
-    return summoner;
+    strncpy(summoner->name, summoner_name, sizeof(summoner->name));
+    strncpy(summoner->region, region, sizeof(summoner->region));
 }
 
 
@@ -96,8 +176,7 @@ Summoner* summoner_create(char* summoner_name, char* region, uint32_t account_id
  */
 Summoner* get_summoner_by_sid(uint16_t region, char* summoner_id)
 {
-    char* response = summoner_request(region, summoner_id, "/summoners/");
-    return response == NULL ? NULL : __parse_summoner(region, response);
+    return __summoner_get_allocated(region, SUMMONER_KEY_SID, summoner_id);
 }
 
 
@@ -109,8 +188,7 @@ Summoner* get_summoner_by_sid(uint16_t region, char* summoner_id)
  */
 Summoner* get_summoner_by_aid(uint16_t region, char* account_id)
 {
-    char* response = summoner_request(region, account_id, "/summoners/by-account/");
-    return response == NULL ? NULL : __parse_summoner(region, response);
+    return __summoner_get_allocated(region, SUMMONER_KEY_AID, account_id);
 }
 
 /**
@@ -121,6 +199,44 @@ Summoner* get_summoner_by_aid(uint16_t region, char* account_id)
  */
 Summoner* get_summoner_by_name(uint16_t region, char* summoner_name)
 {
-    char* response = summoner_request(region, summoner_name, "/summoners/by-name/");
-    return response == NULL ? NULL : __parse_summoner(region, response);
+    return __summoner_get_allocated(region, SUMMONER_KEY_NAME, summoner_name);
+}
+
+
+/**
+ * Retrieves a summoner into caller-provided storage, using the summoner id as the keyword.
+ *
+ * @param region        The region which the player's account is being searched for.
+ * @param summoner_id   The summoner id of the player's account.
+ * @param summoner      The struct to fill.
+ */
+Summoner* get_summoner_by_sid_into(uint16_t region, char* summoner_id, Summoner* summoner)
+{
+    return __summoner_get(region, SUMMONER_KEY_SID, summoner_id, summoner);
+}
+
+
+/**
+ * Retrieves a summoner into caller-provided storage, using the account id as the keyword.
+ *
+ * @param region        The region which the player's account is being searched for.
+ * @param account_id    The account id of the player's account.
+ * @param summoner      The struct to fill.
+ */
+Summoner* get_summoner_by_aid_into(uint16_t region, char* account_id, Summoner* summoner)
+{
+    return __summoner_get(region, SUMMONER_KEY_AID, account_id, summoner);
+}
+
+
+/**
+ * Retrieves a summoner into caller-provided storage, using the summoner name as the keyword.
+ *
+ * @param region        The region which the player's account is being searched for.
+ * @param summoner_name The name of the player's account.
+ * @param summoner      The struct to fill.
+ */
+Summoner* get_summoner_by_name_into(uint16_t region, char* summoner_name, Summoner* summoner)
+{
+    return __summoner_get(region, SUMMONER_KEY_NAME, summoner_name, summoner);
 }
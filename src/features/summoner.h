@@ -16,6 +16,9 @@
 #ifndef CCHAMP_SUMMONER_H
 #define CCHAMP_SUMMONER_H
 #include <cchamp/cchamp.h>
+#include <network/channel.h>
 
-Summoner* summoner_create(char* summoner_name, char* region, uint32_t account_id, uint32_t summoner_id);
+void        summoner_init(Summoner* summoner, char* summoner_name, char* region, uint32_t account_id, uint32_t summoner_id);
+void        summoner_request(Request* request, uint16_t region, int key, char* value);
+Summoner*   summoner_parse(uint16_t region, char* response, Summoner* summoner);
 #endif
@@ -0,0 +1,416 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include <network/riot/ddragon/phash.h>
+#include "summoner_index.h"
+
+/*
+ * The identity index keeps one record per summoner and region, reachable by any of its three keys (summoner
+ * id, account id and name). Every parsed summoner response updates the index, so a summoner resolved by name
+ * can later be served by id (and vice versa) without any request.
+ *
+ * Each region holds its records in a growable array, and one open-addressing table per key. A slot holds the
+ * hash of its key and the position of its record; the record itself is always compared against the key, so
+ * slots left behind by a renamed summoner simply stop matching until the tables are rebuilt.
+ */
+#define INDEX_REGIONS       11
+#define INDEX_KEYS          3
+#define INDEX_INITIAL_SIZE  64
+
+// Room for the canonical form of any summoner name: up to 16 characters of up to 4 bytes each.
+#define INDEX_NAME_SIZE     (SUMMONER_NAME_MAX_LENGTH * 4 + 1)
+
+struct index_slot {
+    uint32_t    hash;
+
+    // The position of the record + 1; 0 for an empty slot.
+    uint32_t    record;
+};
+
+struct index_record {
+    Summoner    summoner;
+    time_t      updated;
+
+    /*
+     * The canonical form of the full name, as the server sent it; Summoner.name may be cut short, and two names
+     * cut alike would otherwise be the same key. Empty if it did not fit, which keeps the record unreachable by name.
+     */
+    char        name[INDEX_NAME_SIZE];
+};
+
+static struct {
+    pthread_rwlock_t        lock;
+    struct index_record*    records;
+    uint32_t                count;
+    uint32_t                capacity;
+
+    // All key tables have (size) slots, a power of two. Stale slots are left behind by renamed summoners.
+    struct index_slot*      slots[INDEX_KEYS];
+    uint32_t                size;
+    uint32_t                stale;
+} regions_index[INDEX_REGIONS] = {
+    [0 ... INDEX_REGIONS - 1] = { .lock = PTHREAD_RWLOCK_INITIALIZER }
+};
+
+// Records younger than this (in seconds) are served by the get_summoner_* functions; 0 never serves them.
+static unsigned int ttl;
+
+
+/**
+ * Writes the canonical form of a summoner name (see cchamp_canonical_name()).
+ *
+ * @param dest  The destination, INDEX_NAME_SIZE bytes.
+ * @param name  The full name.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the name is empty or its canonical form does not fit (dest is then left empty).
+ */
+static int __index_name(char* dest, const char* name)
+{
+    return cchamp_canonical_name(dest, INDEX_NAME_SIZE, name) <= 0;
+}
+
+
+/**
+ * The hash of a key. Names must be in canonical form.
+ */
+static uint32_t __index_hash(int key, uint32_t id, const char* name)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    if (key != SUMMONER_KEY_NAME) {
+        return phash_mix(id);
+    }
+
+    for (; *name != 0x00; name++) {
+        hash = (hash ^ (uint8_t)*name) * 0x100000001b3ULL;
+    }
+
+    return phash_mix(hash);
+}
+
+
+/**
+ * Checks whether a record matches a key.
+ */
+static int __index_matches(struct index_record* record, int key, uint32_t id, const char* name)
+{
+    switch (key) {
+        case SUMMONER_KEY_SID:
+            return record->summoner.summoner_id == id;
+        case SUMMONER_KEY_AID:
+            return record->summoner.account_id == id;
+        default:
+            return record->name[0] != 0x00 && strcmp(record->name, name) == 0;
+    }
+}
+
+
+/**
+ * Finds the slot of a key in a key table of a region: either the slot of the record matching the key, or the
+ * empty slot where the key would be inserted.
+ */
+static struct index_slot* __index_probe(int region, int key, uint32_t hash, uint32_t id, const char* name)
+{
+    struct index_slot* slots = regions_index[region].slots[key];
+    uint32_t mask = regions_index[region].size - 1;
+
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        if (slots[i].record == 0) {
+            return slots + i;
+        }
+
+        if (slots[i].hash == hash
+                && __index_matches(regions_index[region].records + slots[i].record - 1, key, id, name)) {
+            return slots + i;
+        }
+    }
+}
+
+
+/**
+ * Points the slot of every key of a record to it.
+ */
+static void __index_link(int region, uint32_t record)
+{
+    Summoner* summoner = &regions_index[region].records[record].summoner;
+    char* name = regions_index[region].records[record].name;
+    uint32_t ids[INDEX_KEYS] = { summoner->summoner_id, summoner->account_id, 0 };
+
+    for (int key = 0; key < INDEX_KEYS; key++) {
+        if (key == SUMMONER_KEY_NAME && name[0] == 0x00) continue;
+
+        uint32_t hash = __index_hash(key, ids[key], name);
+        struct index_slot* slot = __index_probe(region, key, hash, ids[key], name);
+
+        slot->hash = hash;
+        slot->record = record + 1;
+    }
+}
+
+
+/**
+ * Grows the records of a region to hold at least one more record.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the memory could not be allocated. The region is left untouched in that case.
+ */
+static int __index_reserve(int region)
+{
+    typeof(regions_index[0])* index = regions_index + region;
+
+    if (index->count == index->capacity) {
+        uint32_t capacity = index->capacity == 0 ? INDEX_INITIAL_SIZE / 4 : index->capacity * 2;
+        struct index_record* records = realloc(index->records, sizeof(struct index_record) * capacity);
+
+        if (records == NULL) {
+            return 1;
+        }
+
+        index->records = records;
+        index->capacity = capacity;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Rebuilds the key tables of a region from its records, which drops stale slots. The tables are grown to keep
+ * them at most a quarter full.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the memory could not be allocated. The region is left untouched in that case.
+ */
+static int __index_rebuild(int region)
+{
+    typeof(regions_index[0])* index = regions_index + region;
+    struct index_slot* slots[INDEX_KEYS];
+    uint32_t size = index->size < INDEX_INITIAL_SIZE ? INDEX_INITIAL_SIZE : index->size;
+
+    while (index->count * 4 > size) {
+        size *= 2;
+    }
+
+    for (int key = 0; key < INDEX_KEYS; key++) {
+        if ((slots[key] = calloc(size, sizeof(struct index_slot))) == NULL) {
+            while (key-- > 0) free(slots[key]);
+            return 1;
+        }
+    }
+
+    for (int key = 0; key < INDEX_KEYS; key++) {
+        free(index->slots[key]);
+        index->slots[key] = slots[key];
+    }
+
+    index->size = size;
+    index->stale = 0;
+    for (uint32_t record = 0; record < index->count; record++) {
+        __index_link(region, record);
+    }
+
+    return 0;
+}
+
+
+/**
+ * Records a summoner parsed from a server response, replacing what the index held for it.
+ *
+ * @param region    The REGION_* constant of the summoner.
+ * @param summoner  The summoner.
+ * @param full_name The name of the summoner as the server sent it, which Summoner.name may hold cut short.
+ */
+void summoner_index_update(uint16_t region, Summoner* summoner, const char* full_name)
+{
+    int r = get_bit_index(region);
+    typeof(regions_index[0])* index = regions_index + r;
+    char name[INDEX_NAME_SIZE];
+    uint32_t record = 0;
+
+    __index_name(name, full_name);
+    pthread_rwlock_wrlock(&index->lock);
+
+    // The summoner id identifies the record, as it is the one key that never changes.
+    if (index->size != 0) {
+        uint32_t hash = __index_hash(SUMMONER_KEY_SID, summoner->summoner_id, NULL);
+        record = __index_probe(r, SUMMONER_KEY_SID, hash, summoner->summoner_id, NULL)->record;
+    }
+
+    if (record == 0) {
+        if (__index_reserve(r)) {
+            pthread_rwlock_unlock(&index->lock);
+            return;
+        }
+
+        record = ++index->count;
+    } else {
+
+        // A renamed summoner leaves its previous slots behind, until the tables are rebuilt.
+        index->stale += strcmp(name, index->records[record - 1].name) != 0;
+        index->stale += summoner->account_id != index->records[record - 1].summoner.account_id;
+    }
+
+    index->records[record - 1].summoner = *summoner;
+    index->records[record - 1].updated = time(NULL);
+    memcpy(index->records[record - 1].name, name, INDEX_NAME_SIZE);
+
+    /*
+     * Slots only ever belong to records or stale names, so probing always reaches an empty slot as long as
+     * their total stays under the size of the tables. Should the tables fail to grow, the record only becomes
+     * reachable once they do.
+     */
+    if ((index->count + index->stale) * 2 > index->size && __index_rebuild(r) == 0) {
+        // Every record, including this one, was linked by the rebuild.
+    } else if (index->count + index->stale < index->size) {
+        __index_link(r, record - 1);
+    }
+
+    pthread_rwlock_unlock(&index->lock);
+}
+
+
+/**
+ * Serves a summoner from the index if its record is younger than the configured time to live.
+ *
+ * @return The filled summoner; or <br>
+ *         NULL if the index cannot serve the summoner.
+ */
+Summoner* summoner_index_serve(uint16_t region, int key, char* value, Summoner* summoner)
+{
+    time_t updated;
+
+    if (ttl == 0 || summoner_index_find(region, key, value, summoner, &updated) == NULL) {
+        return NULL;
+    }
+
+    return time(NULL) - updated < ttl ? summoner : NULL;
+}
+
+
+/**
+ * Finds a summoner in the index.
+ *
+ * @param region    The REGION_* constant of the summoner.
+ * @param key       One of the SUMMONER_KEY_* constants.
+ * @param value     The value of the key.
+ * @param summoner  The struct to fill.
+ * @param updated   Receives the time the record was last updated; may be NULL.
+ *
+ * @return The filled summoner; or <br>
+ *         NULL if the index holds no such summoner.
+ */
+Summoner* summoner_index_find(uint16_t region, int key, char* value, Summoner* summoner, time_t* updated)
+{
+    int r = get_bit_index(region);
+    char name[INDEX_NAME_SIZE] = {0};
+    uint32_t id = 0;
+
+    if (key < 0 || key >= INDEX_KEYS || r < 0 || r >= INDEX_REGIONS) {
+        return NULL;
+    }
+
+    if (key == SUMMONER_KEY_NAME) {
+        if (__index_name(name, value)) {
+            return NULL;
+        }
+    } else {
+        id = strtoul(value, NULL, 10);
+    }
+
+    pthread_rwlock_rdlock(&regions_index[r].lock);
+
+    struct index_slot* slot = NULL;
+    if (regions_index[r].size != 0) {
+        slot = __index_probe(r, key, __index_hash(key, id, name), id, name);
+    }
+
+    if (slot == NULL || slot->record == 0) {
+        pthread_rwlock_unlock(&regions_index[r].lock);
+        return NULL;
+    }
+
+    *summoner = regions_index[r].records[slot->record - 1].summoner;
+    if (updated != NULL) {
+        *updated = regions_index[r].records[slot->record - 1].updated;
+    }
+
+    pthread_rwlock_unlock(&regions_index[r].lock);
+    return summoner;
+}
+
+
+/**
+ * Finds a summoner in the identity index, without any request.
+ *
+ * @param region    The REGION_* constant of the summoner.
+ * @param key       One of the SUMMONER_KEY_* constants.
+ * @param value     The value of the key (i.e. "21748566" for SUMMONER_KEY_SID).
+ * @param summoner  The struct to fill.
+ *
+ * @return The filled summoner; or <br>
+ *         NULL if the index holds no such summoner (cc_error is set to ENOTFOUND).
+ */
+Summoner* cchamp_summoner_index_find(uint16_t region, int key, char* value, Summoner* summoner)
+{
+    if (summoner_index_find(region, key, value, summoner, NULL) == NULL) {
+        cc_error = ENOTFOUND;
+        return NULL;
+    }
+
+    return summoner;
+}
+
+
+/**
+ * Sets for how long (in seconds) summoners recorded in the identity index are served by the get_summoner_*
+ * functions instead of the server.
+ *
+ * @param seconds   The time to live of records; 0 never serves them.
+ */
+void cchamp_summoner_index_ttl(unsigned int seconds)
+{
+    ttl = seconds;
+}
+
+
+/**
+ * Drops every record of the identity index for the specified regions.
+ *
+ * @param regions   The REGION_* constants of the regions to clear.
+ */
+void cchamp_summoner_index_clear(uint16_t regions)
+{
+    for (int r = 0; r < INDEX_REGIONS; r++) {
+        if (!(regions & (1 << r))) continue;
+
+        pthread_rwlock_wrlock(&regions_index[r].lock);
+        for (int key = 0; key < INDEX_KEYS; key++) {
+            free(regions_index[r].slots[key]);
+            regions_index[r].slots[key] = NULL;
+        }
+
+        free(regions_index[r].records);
+        regions_index[r].records = NULL;
+        regions_index[r].count = regions_index[r].capacity = regions_index[r].size = regions_index[r].stale = 0;
+        pthread_rwlock_unlock(&regions_index[r].lock);
+    }
+}
@@ -0,0 +1,24 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_SUMMONER_INDEX_H
+#define CCHAMP_SUMMONER_INDEX_H
+#include <time.h>
+#include <cchamp/cchamp.h>
+
+void        summoner_index_update(uint16_t region, Summoner* summoner, const char* full_name);
+Summoner*   summoner_index_find(uint16_t region, int key, char* value, Summoner* summoner, time_t* updated);
+Summoner*   summoner_index_serve(uint16_t region, int key, char* value, Summoner* summoner);
+#endif
@@ -0,0 +1,222 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include <cchamp_mmap.h>
+
+/*
+ * A summoner pool hands out summoners from slabs: anonymous mappings of CCHAMP_CONFIG_SUMMONER_SLAB_SIZE bytes
+ * holding summoners back to back, with no per-object header. Slabs never move, so summoners stay at the same address until the pool is
+ * released, and summoners allocated one after another are contiguous in memory.
+ *
+ * Releasing a pool keeps its slabs mapped for reuse; only destroying the pool returns them to the OS.
+ */
+struct summoner_slab {
+    struct summoner_slab*   next;
+    uint32_t                used;
+    uint32_t                capacity;
+
+    // The size of the mapping, as the configured size may have changed since.
+    size_t                  size;
+    Summoner                summoners[];
+};
+
+struct summoner_pool {
+    struct summoner_slab*   head;
+
+    // The slab summoners are currently allocated from; every slab after it is unused.
+    struct summoner_slab*   tail;
+
+    // The slab of the last summoner returned by cchamp_summoner_pool_next(), which makes iterating O(1).
+    struct summoner_slab*   cursor;
+    size_t                  count;
+};
+
+
+/**
+ * Maps a new, empty slab.
+ *
+ * @return The slab; or <br>
+ *         NULL if the anonymous pages could not be mapped.
+ */
+static struct summoner_slab* __summoner_slab_create()
+{
+    size_t size = PAGE_ALIGN(cchamp_config_get_int(CCHAMP_CONFIG_SUMMONER_SLAB_SIZE));
+
+    // A slab holds at least one summoner, whatever the configured size.
+    if (size < sizeof(struct summoner_slab) + sizeof(Summoner)) {
+        size = PAGE_ALIGN(sizeof(struct summoner_slab) + sizeof(Summoner));
+    }
+
+    struct summoner_slab* slab = mmap_anonymous(size, 0);
+    if (slab == MAP_FAILED) {
+        return NULL;
+    }
+
+    slab->next = NULL;
+    slab->used = 0;
+    slab->size = size;
+    slab->capacity = (size - sizeof(struct summoner_slab)) / sizeof(Summoner);
+    return slab;
+}
+
+
+/**
+ * Creates an empty summoner pool. No memory is mapped before the first allocation.
+ *
+ * @return The pool; or <br>
+ *         NULL if the pool could not be allocated.
+ */
+SummonerPool* cchamp_summoner_pool_create()
+{
+    return calloc(1, sizeof(SummonerPool));
+}
+
+
+/**
+ * Allocates a summoner from a pool. The summoner is left uninitialized.
+ *
+ * @param pool  The pool.
+ *
+ * @return The summoner; or <br>
+ *         NULL if no slab could be mapped.
+ */
+Summoner* cchamp_summoner_pool_alloc(SummonerPool* pool)
+{
+    struct summoner_slab* slab = pool->tail;
+
+    if (slab == NULL || slab->used == slab->capacity) {
+
+        // Slabs kept by a release are reused before any new one is mapped.
+        struct summoner_slab* next = slab != NULL ? slab->next : pool->head;
+        if (next == NULL && (next = __summoner_slab_create()) == NULL) {
+            return NULL;
+        }
+
+        if (slab == NULL) {
+            pool->head = next;
+        } else {
+            slab->next = next;
+        }
+
+        pool->tail = slab = next;
+    }
+
+    pool->count++;
+    return &slab->summoners[slab->used++];
+}
+
+
+/**
+ * Gives back the summoner allocated last from a pool (i.e. after its retrieval failed).
+ *
+ * @param pool  The pool.
+ */
+void cchamp_summoner_pool_pop(SummonerPool* pool)
+{
+    if (pool->tail != NULL && pool->tail->used != 0) {
+        pool->tail->used--;
+        pool->count--;
+    }
+}
+
+
+/**
+ * The number of summoners allocated from a pool.
+ */
+size_t cchamp_summoner_pool_count(SummonerPool* pool)
+{
+    return pool->count;
+}
+
+
+/**
+ * Iterates over the summoners of a pool, in allocation order.
+ *
+ * @param pool      The pool.
+ * @param summoner  The last summoner returned, or NULL to start.
+ *
+ * @return The next summoner; or <br>
+ *         NULL once all summoners were returned.
+ */
+Summoner* cchamp_summoner_pool_next(SummonerPool* pool, Summoner* summoner)
+{
+    struct summoner_slab* slab = pool->cursor;
+    uint32_t index = 0;
+
+    if (summoner == NULL) {
+        slab = pool->head;
+    } else {
+        if (slab == NULL || summoner < slab->summoners || summoner >= slab->summoners + slab->used) {
+            for (slab = pool->head; slab != NULL; slab = slab->next) {
+                if (summoner >= slab->summoners && summoner < slab->summoners + slab->used) break;
+            }
+        }
+
+        if (slab == NULL) {
+            return NULL;
+        }
+
+        index = summoner - slab->summoners + 1;
+    }
+
+    // Unused slabs (after the tail) hold no summoners, so they end the iteration.
+    while (slab != NULL && index >= slab->used) {
+        slab = slab->next;
+        index = 0;
+    }
+
+    pool->cursor = slab;
+    return slab != NULL ? &slab->summoners[index] : NULL;
+}
+
+
+/**
+ * Releases all summoners of a pool at once. The slabs are kept for the next allocations.
+ *
+ * @param pool  The pool.
+ */
+void cchamp_summoner_pool_release(SummonerPool* pool)
+{
+    for (struct summoner_slab* slab = pool->head; slab != NULL; slab = slab->next) {
+        slab->used = 0;
+    }
+
+    pool->tail = pool->head;
+    pool->cursor = NULL;
+    pool->count = 0;
+}
+
+
+/**
+ * Destroys a pool, returning all of its memory to the OS.
+ *
+ * @param pool  The pool.
+ */
+void cchamp_summoner_pool_destroy(SummonerPool* pool)
+{
+    struct summoner_slab* slab = pool->head;
+
+    while (slab != NULL) {
+        struct summoner_slab* next = slab->next;
+        munmap(slab, slab->size);
+        slab = next;
+    }
+
+    free(pool);
+}
@@ -14,13 +14,18 @@
  * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <curl/curl.h>
 #include <sys/mman.h>
+#include <pthread.h>
 #include <cchamp/cchamp.h>
 #include <cchamp_utils.h>
+#include <cchamp_mmap.h>
 #include "riot/api.h"
+#include "riot/rate.h"
 #include "channel.h"
 
 /*
@@ -37,26 +42,107 @@ char* api_path[] = {
 
 
 static __CBUFF buffer;
-static char url[512];
-struct curl_slist *http_headers;
+// Requests may be built on more than one thread (i.e. the static data refresher).
+static __thread char url[CHANNEL_URL_MAX];
+
+/*
+ * The base of every request URL, and the offset of the "%s" that stands for the platform of the region in it
+ * (-1 if there is none). See cchamp_set_base_url().
+ */
+static char base_url[CCHAMP_BASE_URL_MAX] = "https://%s.api.riotgames.com";
+static int base_platform = 8;
+
+// All buffers of the library (the shared one and those of the region workers), and the memory they hold.
+static __CBUFF* buffers;
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t reserved_bytes;
+static size_t committed_bytes;
 
 
 /**
- * Anonymously maps necessary pages for having sufficient memory backing for query responses
- * for up to CHANNEL_BLOCK_NUM (8) concurrent queries.
+ * The status bits of every block of a buffer.
+ */
+static uint64_t __channel_blocks_all(__CBUFF* blocks)
+{
+    return blocks->count == 64 ? ~0ULL : (1ULL << blocks->count) - 1;
+}
+
+
+/**
+ * Anonymously maps the blocks of a buffer, as many and as large as configured (see CCHAMP_CONFIG_CHANNEL_BLOCKS).
+ * Only their address space is reserved, unless they are backed by huge pages.
  *
  * @return      On success, a non-zero, postive number that represents the number of bytes allocated.
  *              0   If the mmap has failed.
  */
-static int __channel_blocks_allocate()
+static size_t __channel_blocks_map(__CBUFF* blocks)
 {
-    buffer.status = 0;
-    buffer.addr = mmap(NULL, CHANNEL_BLOCK_NUM * CHANNEL_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (buffer.addr == MAP_FAILED) {
+    // Huge pages cannot be given back one block at a time.
+    int huge = cchamp_config_get(CCHAMP_MAP_HUGEPAGES);
+
+    blocks->status = 0;
+    blocks->trimming = 0;
+    blocks->count = cchamp_config_get_int(CCHAMP_CONFIG_CHANNEL_BLOCKS);
+    blocks->size = PAGE_ALIGN(cchamp_config_get_int(CCHAMP_CONFIG_CHANNEL_BLOCK_SIZE));
+    blocks->addr = mmap_anonymous((size_t)blocks->count * blocks->size, huge ? MMAP_HUGETLB : MMAP_RESERVE);
+    if (blocks->addr == MAP_FAILED) {
+        blocks->addr = NULL;
         return 0;
     }
 
-    return CHANNEL_BLOCK_NUM * CHANNEL_BLOCK_SIZE;
+    blocks->lazy = !huge;
+    blocks->committed = blocks->lazy ? 0 : __channel_blocks_all(blocks);
+    blocks->swept = 0;
+    memset(blocks->idle, 0x00, sizeof(blocks->idle));
+
+    __atomic_add_fetch(&reserved_bytes, (size_t)blocks->count * blocks->size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&committed_bytes, (size_t)__builtin_popcountll(blocks->committed) * blocks->size,
+                       __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&buffers_lock);
+    blocks->next = buffers;
+    buffers = blocks;
+    pthread_mutex_unlock(&buffers_lock);
+
+    return (size_t)blocks->count * blocks->size;
+}
+
+
+/**
+ * Unmaps the blocks of a buffer. None of them may be in use.
+ */
+static void __channel_blocks_unmap(__CBUFF* blocks)
+{
+    pthread_mutex_lock(&buffers_lock);
+    __CBUFF** link = &buffers;
+    while (*link != NULL && *link != blocks) {
+        link = &(*link)->next;
+    }
+
+    if (*link != NULL) {
+        *link = blocks->next;
+    }
+    pthread_mutex_unlock(&buffers_lock);
+
+    __atomic_sub_fetch(&reserved_bytes, (size_t)blocks->count * blocks->size, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&committed_bytes, (size_t)__builtin_popcountll(blocks->committed) * blocks->size,
+                       __ATOMIC_RELAXED);
+
+    munmap(blocks->addr, (size_t)blocks->count * blocks->size);
+    blocks->addr = NULL;
+}
+
+
+/**
+ * Anonymously maps necessary pages for having sufficient memory backing for query responses
+ * for up to CCHAMP_CONFIG_CHANNEL_BLOCKS (8 by default) concurrent queries.
+ *
+ * @return      On success, a non-zero, postive number that represents the number of bytes allocated.
+ *              0   If the mmap has failed.
+ */
+static int __channel_blocks_allocate()
+{
+    return __channel_blocks_map(&buffer);
 }
 
 
@@ -65,36 +151,109 @@ static int __channel_blocks_allocate()
  */
 static void __channel_blocks_free()
 {
-    if (buffer.addr != MAP_FAILED || buffer.addr != NULL) {
-        munmap(buffer.addr, CHANNEL_BLOCK_NUM * CHANNEL_BLOCK_SIZE);
+    __channel_blocks_unmap(&buffer);
+}
+
+
+/**
+ * Decommits the free blocks of a buffer that have not been used since a given time.
+ * Each block is claimed while it is decommitted, so that no thread may receive a response into it meanwhile;
+ * threads finding no other free block wait for it (see __channel_blocks_claim()).
+ *
+ * @param blocks    The buffer.
+ * @param before    Blocks relinquished after this time (see rate_now()) are kept.
+ * @param lazy      Non-zero if the OS may keep the pages until it runs short of memory (see mmap_decommit()).
+ */
+static void __channel_blocks_decommit(__CBUFF* blocks, uint64_t before, int lazy)
+{
+    if (!blocks->lazy) {
+        return;
+    }
+
+    for (uint32_t index = 0; index < blocks->count; index++) {
+        uint64_t bit = 1ULL << index;
+
+        if (!(__atomic_load_n(&blocks->committed, __ATOMIC_ACQUIRE) & bit)
+                || __atomic_load_n(&blocks->idle[index], __ATOMIC_RELAXED) > before) {
+            continue;
+        }
+
+        // The block is in use, or was just claimed by another thread.
+        __atomic_or_fetch(&blocks->trimming, bit, __ATOMIC_RELEASE);
+        if (__atomic_fetch_or(&blocks->status, bit, __ATOMIC_ACQUIRE) & bit) {
+            __atomic_and_fetch(&blocks->trimming, ~bit, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        // It may have been used (and relinquished) in between.
+        if (__atomic_load_n(&blocks->idle[index], __ATOMIC_RELAXED) <= before
+                && (__atomic_load_n(&blocks->committed, __ATOMIC_ACQUIRE) & bit)) {
+            mmap_decommit(blocks->addr + (size_t)blocks->size * index, blocks->size, lazy);
+            __atomic_and_fetch(&blocks->committed, ~bit, __ATOMIC_RELEASE);
+            __atomic_sub_fetch(&committed_bytes, blocks->size, __ATOMIC_RELAXED);
+        }
+
+        __atomic_and_fetch(&blocks->status, ~bit, __ATOMIC_RELEASE);
+        __atomic_and_fetch(&blocks->trimming, ~bit, __ATOMIC_RELEASE);
     }
 }
 
 
 /**
- * Atmemts to claim a block in the buffer.
+ * Atmemts to claim a block in the buffer. A block that is only reserved is committed first.
+ *
+ * @param blocks    The buffer to claim a block from.
  *
- * @return      NULL    If it was unsucessful in acquiring a block (i.e. all blocks are in-use).
+ * @return      NULL    If it was unsucessful in acquiring a block (i.e. all blocks are in-use, or the block could
+ *                      not be committed).
  *              Pointer If it was successful. The starting address for the block is returned.
  */
-static void * __channel_blocks_claim()
+static void * __channel_blocks_claim(__CBUFF* blocks)
 {
-    uint8_t free_buffer = 0x01;
+    uint64_t status = __atomic_load_n(&blocks->status, __ATOMIC_RELAXED);
+    uint64_t free_buffer;
+    uint32_t index;
 
-    // Keep looping until the first cleared bit is detected.
-    while ((buffer.status & free_buffer) != 0)
-    {
-        free_buffer <<= 1;
-    }
+    /*
+     * Requests may be sent from more than one thread (i.e. the static data refresher), so the block is claimed
+     * by atomically setting its bit. The search restarts if another thread changed the status in between.
+     */
+    do {
+        free_buffer = 0x01;
+        index = 0;
+
+        // Keep looping until the first cleared bit is detected.
+        while (index < blocks->count && (status & free_buffer) != 0)
+        {
+            free_buffer <<= 1;
+            index++;
+        }
 
-    // if free_buffer is 0, then it must have overflowed which only happens when no buffers are available.
-    if (free_buffer == 0) {
-        return NULL;
+        // Past the last block, no buffers are available; unless one is only held while it is decommitted.
+        if (index == blocks->count) {
+            if (__atomic_load_n(&blocks->trimming, __ATOMIC_ACQUIRE) == 0) {
+                return NULL;
+            }
+
+            status = __atomic_load_n(&blocks->status, __ATOMIC_RELAXED);
+            free_buffer = 0;
+        }
+    } while (free_buffer == 0 || !__atomic_compare_exchange_n(&blocks->status, &status, status | free_buffer, 0,
+                                                              __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+    void* block = blocks->addr + (size_t)blocks->size * index;
+
+    if (!(__atomic_load_n(&blocks->committed, __ATOMIC_ACQUIRE) & free_buffer)) {
+        if (mmap_commit(block, blocks->size) != 0) {
+            __atomic_and_fetch(&blocks->status, ~free_buffer, __ATOMIC_RELEASE);
+            return NULL;
+        }
+
+        __atomic_or_fetch(&blocks->committed, free_buffer, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&committed_bytes, blocks->size, __ATOMIC_RELAXED);
     }
 
-    // Claim the block in the buffer by setting its corresponding bit in the buffer status.
-    buffer.status |= free_buffer;
-    return buffer.addr + (CHANNEL_BLOCK_SIZE * get_bit_index(free_buffer));
+    return block;
 }
 
 
@@ -102,23 +261,44 @@ static void * __channel_blocks_claim()
  * Clears the specified bit from the buffer status, effectively setting it to free.
  * Data in the block pages do not have to be flushed, only invalidated.
  *
+ * Once every CCHAMP_CONFIG_CHANNEL_IDLE ms at most, the blocks that have been free for as long are decommitted.
+ *
  * @param block The identifier for the block in the buffer.
  */
 static void __channel_blocks_relinquish(Request* request)
 {
+    __CBUFF* blocks = request->blocks != NULL ? request->blocks : &buffer;
+
+    // Requests that never received a response body have no block to give back.
+    if (request->response.addr == NULL) {
+        return;
+    }
+
     /*
      * Using the request's response address, the block index in the buffer must be reverse engineered.
      * It is quite simple to do so because all blocks have fixed sizes.
      */
-    size_t offset = (uintptr_t)request->response.addr - (uintptr_t)buffer.addr;
-    size_t block_index = offset / CHANNEL_BLOCK_SIZE;
+    size_t offset = (uintptr_t)request->response.addr - (uintptr_t)blocks->addr;
+    size_t block_index = offset / blocks->size;
 
     // Flush the response struct in the request in preparation for a relinquish of the block.
     request->response.size = 0;
     request->response.addr = NULL;
 
+    uint64_t now = blocks->lazy ? rate_now() : 0;
+    __atomic_store_n(&blocks->idle[block_index], now, __ATOMIC_RELAXED);
+
     // Clear the corresponding block index.
-    buffer.status &= ~(1 << block_index);
+    __atomic_and_fetch(&blocks->status, ~(1ULL << block_index), __ATOMIC_RELEASE);
+
+    uint64_t idle = cchamp_config_get_int(CCHAMP_CONFIG_CHANNEL_IDLE);
+    uint64_t swept = __atomic_load_n(&blocks->swept, __ATOMIC_RELAXED);
+
+    // A single thread sweeps the buffer, and the pages are only dropped if the OS needs them.
+    if (blocks->lazy && idle != 0 && now >= swept + idle
+            && __atomic_compare_exchange_n(&blocks->swept, &swept, now, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        __channel_blocks_decommit(blocks, now - idle, 1);
+    }
 }
 
 
@@ -147,12 +327,14 @@ static void __channel_arguments_free(Argument *head, int* size)
  * Only permits allocation if the buffer.addr is NULL.
  *
  * @return      The size (in bytes) of the allocated buffer; or <br>
- *              0 if the buffer has already been allocated.
+ *              0 if the buffer has already been allocated; or <br>
+ *              -1 if its address space could not be reserved.
  */
 int channel_blocks_allocate()
 {
     if (buffer.addr == NULL) {
-        return __channel_blocks_allocate();
+        int size = __channel_blocks_allocate();
+        return size != 0 ? size : -1;
     }
 
     return 0;
@@ -169,8 +351,72 @@ void channel_blocks_free()
     }
 }
 
+/**
+ * Allocates a set of blocks apart from the ones shared by the library.
+ * Requests pointing to them (see Request.blocks) receive their responses there, so that the thread sending
+ * them never competes with other threads for a block.
+ *
+ * @return The blocks, to be freed with channel_blocks_destroy(); or <br>
+ *         NULL if the mmap has failed.
+ */
+__CBUFF* channel_blocks_create()
+{
+    __CBUFF* blocks = malloc(sizeof(__CBUFF));
+    if (blocks == NULL) {
+        return NULL;
+    }
+
+    if (__channel_blocks_map(blocks) == 0) {
+        free(blocks);
+        return NULL;
+    }
+
+    return blocks;
+}
+
+/**
+ * Frees a set of blocks allocated with channel_blocks_create(). None of them may be in use.
+ *
+ * @param blocks The blocks.
+ */
+void channel_blocks_destroy(__CBUFF* blocks)
+{
+    if (blocks != NULL) {
+        __channel_blocks_unmap(blocks);
+        free(blocks);
+    }
+}
+
+/**
+ * Decommits every free block of every buffer of the library at once, whatever CCHAMP_CONFIG_CHANNEL_IDLE is.
+ * Blocks are committed again when they are next used.
+ */
+void channel_blocks_trim()
+{
+    uint64_t now = rate_now();
+
+    pthread_mutex_lock(&buffers_lock);
+    for (__CBUFF* blocks = buffers; blocks != NULL; blocks = blocks->next) {
+        __channel_blocks_decommit(blocks, now, 0);
+    }
+    pthread_mutex_unlock(&buffers_lock);
+}
+
+/**
+ * Reports the memory held by all buffers of the library.
+ *
+ * @param reserved  Receives the address space reserved for the blocks, in bytes.
+ * @param committed Receives the memory committed to blocks, in bytes.
+ */
+void channel_blocks_stats(size_t* reserved, size_t* committed)
+{
+    *reserved = __atomic_load_n(&reserved_bytes, __ATOMIC_RELAXED);
+    *committed = __atomic_load_n(&committed_bytes, __ATOMIC_RELAXED);
+}
+
 /**
  * Creates a path argument on the heap.
+ * Every reserved character of the value is escaped, "/" included, as it may come from the user (i.e. a name).
  *
  * @param value The value of the path argument being created.
  * @param next  The next Argument to link up with.
@@ -181,7 +427,33 @@ Argument* path_arg(Request* request, char* value, Argument* next)
 {
     Argument* arg = calloc(1, sizeof(Argument));
     arg->next = next;
-    webstr(arg->value, value);
+
+    if (webstr(arg->value, sizeof(arg->value), value, 0) < 0) {
+        request->arguments.overflow = 1;
+    }
+
+    request->arguments.path.size++;
+    return arg;
+}
+
+
+/**
+ * Creates a path argument on the heap from a fixed part of the API path (i.e. "/summoners/by-name/"),
+ * whose "/" are left as they are.
+ *
+ * @param value The value of the path argument being created.
+ * @param next  The next Argument to link up with.
+ *
+ * @return A pointer to the newly created argument.
+ */
+Argument* path_qualifier(Request* request, char* value, Argument* next)
+{
+    Argument* arg = calloc(1, sizeof(Argument));
+    arg->next = next;
+
+    if (webstr(arg->value, sizeof(arg->value), value, WEBSTR_PATH) < 0) {
+        request->arguments.overflow = 1;
+    }
 
     request->arguments.path.size++;
     return arg;
@@ -199,8 +471,12 @@ Argument* query_arg(Request* request, char* key, char* value, Argument* next)
 {
     Argument* arg = calloc(1, sizeof(Argument));
     arg->next = next;
-    sprintf(arg->value, "%s=%s", key, value);
-    webstr(arg->value, value);
+
+    // Only the value is web-escaped; the key is always a known, safe constant.
+    int len = sprintf(arg->value, "%s=", key);
+    if (webstr(arg->value + len, sizeof(arg->value) - len, value, 0) < 0) {
+        request->arguments.overflow = 1;
+    }
 
     request->arguments.query.size++;
     return arg;
@@ -208,24 +484,92 @@ Argument* query_arg(Request* request, char* key, char* value, Argument* next)
 
 
 /**
- * Updates the API token into the HTTP header struct.
+ * Builds the HTTP headers carrying an API token.
  * The official API requires this header so that it may authorize the query.
  *
  * @param key The API key used to authenticate the query.
+ *
+ * @return The headers, to be freed with curl_slist_free_all().
  */
-void channel_update_token(char* key)
+struct curl_slist* channel_token_headers(char* key)
 {
-    if (http_headers != NULL) {
-        curl_slist_free_all(http_headers);
-    }
-
     /*
      * Token is fixed size at 100 characters as this should always suffice.
      * The API key is always 42 characters long.
      */
     char token[100] = {0};
     sprintf(token, "X-Riot-Token: %s", key);
-    http_headers = curl_slist_append(http_headers, token);
+    return curl_slist_append(NULL, token);
+}
+
+
+/**
+ * The HTTP headers of a request that is not conditional: the ones of its API key.
+ *
+ * @param request The request.
+ *
+ * @return The headers, shared by all requests made with the key.
+ */
+struct curl_slist* channel_headers(Request* request)
+{
+    return __atomic_load_n(&api.keys[request->key].headers, __ATOMIC_ACQUIRE);
+}
+
+
+/**
+ * Builds the headers of a conditional request: a copy of the headers of its key with an extra If-None-Match.
+ * The ETag of the request is cleared, to receive the one of the response.
+ *
+ * @param request The request.
+ *
+ * @return The headers, to be freed with curl_slist_free_all() once the request completes; or <br>
+ *         NULL if the request is not conditional (channel_headers() apply).
+ */
+struct curl_slist* channel_conditional_headers(Request* request)
+{
+    struct curl_slist* conditional = NULL;
+    char line[REQUEST_ETAG_SIZE + 16];
+
+    if (request->etag[0] == 0x00) {
+        return NULL;
+    }
+
+    for (struct curl_slist* header = channel_headers(request); header != NULL; header = header->next) {
+        conditional = curl_slist_append(conditional, header->data);
+    }
+
+    sprintf(line, "If-None-Match: %s", request->etag);
+    conditional = curl_slist_append(conditional, line);
+    request->etag[0] = 0x00;
+
+    return conditional;
+}
+
+
+/**
+ * Replaces the base of the request URLs (the official servers by default).
+ * The base is copied as-is, and never used as a format: its "%s" is spliced with the platform of the region.
+ *
+ * @param base  The base URL, with at most a single "%s" and no trailing '/'; or NULL for the official servers.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the base is too long or holds a '%' other than the "%s".
+ */
+int channel_base_url(char* base)
+{
+    if (base == NULL) {
+        base = "https://%s.api.riotgames.com";
+    }
+
+    char* platform = strstr(base, "%s");
+    if (strlen(base) >= sizeof(base_url) || strchr(base, '%') != platform
+            || (platform != NULL && strchr(platform + 2, '%') != NULL)) {
+        return 1;
+    }
+
+    strcpy(base_url, base);
+    base_platform = platform != NULL ? (int)(platform - base) : -1;
+    return 0;
 }
 
 
@@ -234,32 +578,42 @@ void channel_update_token(char* key)
  *
  * @param request The struct used for information in building the query.
  *
- * @return The fully qualified query url that services the request.
+ * @return The fully qualified query url that services the request; or <br>
+ *         NULL if an argument of the request did not fit in its value (see path_arg()), or the url is longer
+ *         than CHANNEL_URL_MAX.
  */
 char* channel_url(Request* request)
 {
-    memset(url, 0x00, 512);
-    sprintf(url, "https://%s.api.riotgames.com/lol/%s/v%d", regions[get_bit_index(request->region)],
-            api_path[get_bit_index(request->api)], API_VERSION);
+    size_t length;
+
+    if (request->arguments.overflow) {
+        return NULL;
+    }
 
-    for (Argument* arg = request->arguments.path.head; arg != NULL; arg = arg->next) {
-        strcat(url, arg->value);
+    if (base_platform < 0) {
+        length = snprintf(url, sizeof(url), "%s", base_url);
+    } else {
+        length = snprintf(url, sizeof(url), "%.*s%s%s", base_platform, base_url,
+                          regions[(int)get_bit_index(request->region)], base_url + base_platform + 2);
     }
 
-    if (request->arguments.query.head != NULL) {
-        strcat(url, "?");
+    if (length < sizeof(url)) {
+        length += snprintf(url + length, sizeof(url) - length, "/lol/%s/v%d",
+                           api_path[(int)get_bit_index(request->api)], API_VERSION);
+    }
 
-        for (Argument* arg = request->arguments.query.head; arg != NULL; arg = arg->next) {
-            strcat(url, arg->value);
+    for (Argument* arg = request->arguments.path.head; arg != NULL && length < sizeof(url); arg = arg->next) {
+        length += snprintf(url + length, sizeof(url) - length, "%s", arg->value);
+    }
 
-            // If there is another query argumenteter then it must be prefixed with an "&".
-            if (arg->next != NULL) {
-                strcat(url, "&");
-            }
-        }
+    // Query arguments are separated with an "&", after a "?" for the first one.
+    for (Argument* arg = request->arguments.query.head; arg != NULL && length < sizeof(url); arg = arg->next) {
+        length += snprintf(url + length, sizeof(url) - length, "%c%s",
+                           arg == request->arguments.query.head ? '?' : '&', arg->value);
     }
 
-    return url;
+    // A url cut short would reach another endpoint than the one requested.
+    return length < sizeof(url) ? url : NULL;
 }
 
 
@@ -284,10 +638,10 @@ size_t channel_response_received(char* ptr, size_t size, size_t nmemb, void* arg
      * If the request does not have a block in the buffer reserved to it yet, then
      * an attempt to claim one must be done before writing any data.
      */
+    __CBUFF* blocks = request->blocks != NULL ? request->blocks : &buffer;
+
     if (request->response.addr == NULL) {
-        if (buffer.status != 0xFF) {
-            request->response.addr = __channel_blocks_claim();
-        } else {
+        if ((request->response.addr = __channel_blocks_claim(blocks)) == NULL) {
 
             /*
              * All possible buffers are currently exhausted and this new response cannot be serviced.
@@ -298,13 +652,75 @@ size_t channel_response_received(char* ptr, size_t size, size_t nmemb, void* arg
         }
     }
 
+    /*
+     * A response must fit in its block, with one extra byte for the null-terminator.
+     * Returning less than the received size makes curl abort the transfer.
+     */
+    if (request->response.size + size * nmemb >= blocks->size) {
+        cc_error = E2MANY;
+        return 0;
+    }
+
     // Load the received data into the correct buffer address and refresh the size with the latest one.
     memcpy(request->response.addr + request->response.size, ptr, size * nmemb);
     request->response.size += size * nmemb;
+
+    // Keep the response null-terminated so that it may be handed to the JSON parser as-is.
+    ((char *)request->response.addr)[request->response.size] = 0x00;
     return size * nmemb;
 }
 
 
+/**
+ * Picks the ETag and Retry-After out of the header lines received from the server.
+ * Curl is instructed to pass the relevant Request struct into this function in cchamp_send_request().
+ *
+ * @param ptr       A pointer to the header line, which is not null-terminated.
+ * @param size      Always 1.
+ * @param nitems    The length of the header line.
+ * @param argument  The request struct corresponding to the query.
+ *
+ * @return the total number of bytes received.
+ */
+size_t channel_header_received(char* ptr, size_t size, size_t nitems, void* argument)
+{
+    Request* request = (Request *)argument;
+    size_t length = size * nitems;
+
+    if (length > 5 && strncasecmp(ptr, "ETag:", 5) == 0) {
+        size_t start = 5, end = length;
+
+        while (start < end && (ptr[start] == ' ' || ptr[start] == '\t')) start++;
+        while (end > start && (ptr[end - 1] == '\r' || ptr[end - 1] == '\n' || ptr[end - 1] == ' ')) end--;
+
+        // An ETag that does not fit is dropped, which only costs the next request its condition.
+        if (end - start < REQUEST_ETAG_SIZE) {
+            memcpy(request->etag, ptr + start, end - start);
+            request->etag[end - start] = 0x00;
+        }
+    } else if (length > 12 && strncasecmp(ptr, "Retry-After:", 12) == 0) {
+        request->retry_after = 0;
+
+        for (size_t i = 12; i < length && (ptr[i] == ' ' || (ptr[i] >= '0' && ptr[i] <= '9')); i++) {
+            if (ptr[i] != ' ') request->retry_after = request->retry_after * 10 + ptr[i] - '0';
+        }
+    }
+
+    return length;
+}
+
+
+/**
+ * Gives back the channel block holding the response of this request. Its arguments are kept.
+ *
+ * @param request The request whose response is being released.
+ */
+void channel_release(Request* request)
+{
+    __channel_blocks_relinquish(request);
+}
+
+
 /**
  * Give up channel memory resources held by this request.
  *
@@ -312,10 +728,12 @@ size_t channel_response_received(char* ptr, size_t size, size_t nmemb, void* arg
  */
 void channel_clean(Request* request)
 {
-    // Mark the channel block as free.
+    // Mark the channel block as free; the next response goes to the shared blocks unless told otherwise.
     __channel_blocks_relinquish(request);
+    request->blocks = NULL;
 
     // Free up the heap arguments.
     __channel_arguments_free(request->arguments.path.head, &request->arguments.path.size);
     __channel_arguments_free(request->arguments.query.head, &request->arguments.query.size);
+    request->arguments.overflow = 0;
 }
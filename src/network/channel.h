@@ -43,13 +43,22 @@ struct arguments {
         int size;
         struct arg* head;
     } query;
+
+    // Set if an argument did not fit in its value once escaped; the request is then never sent.
+    int overflow;
 };
 
 
+#define REQUEST_ETAG_SIZE     64
+
+// The longest request url, including the null-terminator: room for the longest base url and a few arguments.
+#define CHANNEL_URL_MAX       1024
+
 /*
  * A catch-all api_request struct is now created that tracks all the needed data to:
  * -    Build a fully-qualified query URL.
  * -    Store the response text and the http code.
+ * -    Make the request conditional (If-None-Match) and store the ETag and Retry-After of the response.
  */
 struct api_request {
     uint16_t region;
@@ -62,25 +71,59 @@ struct api_request {
     } response;
 
     long http_code;
+
+    /*
+     * If set before sending, the server only responds with data if it no longer matches this ETag (otherwise,
+     * http_code is 304). Replaced by the ETag of the response, or cleared if the response has none.
+     */
+    char etag[REQUEST_ETAG_SIZE];
+
+    // The Retry-After delay (in seconds) of a response, if any.
+    int retry_after;
+
+    // The blocks the response is received into; the blocks shared by the library if NULL.
+    struct channel_buf* blocks;
+
+    // The API key the request is sent with, as picked by the rate limit (see rate_acquire()).
+    uint8_t key;
 };
 
 
-#define CHANNEL_BLOCK_NUM     8
-#define CHANNEL_BLOCK_SIZE    256 * 1024
+#define CHANNEL_BLOCKS_MAX    64
 
 /*
- * Query buffer maintains 8 exclusive blocks of memory for use in receiving
- * data.
+ * Query buffer maintains exclusive blocks of memory for use in receiving data: CCHAMP_CONFIG_CHANNEL_BLOCKS
+ * blocks (8 by default) of CCHAMP_CONFIG_CHANNEL_BLOCK_SIZE bytes (256KB by default), reserved contiguously.
+ * The count and size are fixed when the buffer is allocated.
  *
- * Each block of memory is 256KB. So, a total of 256KB * 8 = 2MB is reserved contiguously.
+ * Only the address space of the blocks is reserved up front. A block is committed when it is first claimed,
+ * and decommitted once it has been free for CCHAMP_CONFIG_CHANNEL_IDLE ms (or by cchamp_trim()). Buffers
+ * backed by huge pages are committed in full instead.
  */
 struct channel_buf {
 
     // tracks if a block of memory is in-use (1) or free (0).
-    uint8_t status;
+    uint64_t    status;
+
+    // tracks if a block of memory is committed (1) or only reserved (0), and if it is being decommitted (1).
+    uint64_t    committed;
+    uint64_t    trimming;
 
     // a pointer to the first block of memory.
-    void*   addr;
+    void*       addr;
+
+    uint32_t    count;
+    uint32_t    size;
+
+    // whether blocks are committed and decommitted one at a time.
+    int         lazy;
+
+    // when each block was last relinquished, and when the buffer was last swept for idle blocks (see rate_now()).
+    uint64_t    idle[CHANNEL_BLOCKS_MAX];
+    uint64_t    swept;
+
+    // the next buffer of the library, so that all of them can be trimmed and reported on.
+    struct channel_buf* next;
 };
 
 
@@ -88,7 +131,6 @@ typedef struct arg Argument;
 typedef struct api_request Request;
 typedef struct channel_buf __CBUFF;
 
-extern struct curl_slist* http_headers;
 extern char* regions[];
 
 
@@ -103,6 +145,12 @@ extern char* regions[];
 Argument*  path_arg(Request* request, char* value, Argument* next);
 
 
+/*
+ * Creates a new path argument from a fixed part of the API path.
+ */
+Argument*  path_qualifier(Request* request, char* value, Argument* next);
+
+
 /*
  * Creates a new query argument.
  */
@@ -121,6 +169,36 @@ int     channel_blocks_allocate();
 void    channel_blocks_free();
 
 
+/*
+ * Decommits every free block of every set of channel blocks.
+ */
+void    channel_blocks_trim();
+
+
+/*
+ * Reports the memory reserved and committed by all sets of channel blocks.
+ */
+void    channel_blocks_stats(size_t* reserved, size_t* committed);
+
+
+/*
+ * Allocates a set of channel blocks of its own, for a thread that receives its responses apart (see worker.h).
+ */
+__CBUFF* channel_blocks_create();
+
+
+/*
+ * Frees a set of channel blocks allocated with channel_blocks_create().
+ */
+void    channel_blocks_destroy(__CBUFF* blocks);
+
+
+/*
+ * Replaces the base of the request URLs (see cchamp_set_base_url()).
+ */
+int     channel_base_url(char* base);
+
+
 /*
  * Produces a fuly-qualified url by extracting data from the provided request.
  */
@@ -128,9 +206,21 @@ char*   channel_url(Request* request);
 
 
 /*
- * Updates the HTTP headers with the latest API key.
+ * Builds the HTTP headers that authenticate requests with an API key.
+ */
+struct curl_slist* channel_token_headers(char* key);
+
+
+/*
+ * The HTTP headers of the API key of the request.
  */
-void    channel_update_token(char* key);
+struct curl_slist* channel_headers(Request* request);
+
+
+/*
+ * Builds the headers of a conditional request; NULL if the request is not conditional.
+ */
+struct curl_slist* channel_conditional_headers(Request* request);
 
 
 /*
@@ -140,6 +230,19 @@ void    channel_update_token(char* key);
 size_t  channel_response_received(char* ptr, size_t size, size_t nmemb, void* request);
 
 
+/*
+ * Invoked for every header line received during an HTTP request.
+ * Responsible for storing the ETag and Retry-After of the response.
+ */
+size_t  channel_header_received(char* ptr, size_t size, size_t nitems, void* request);
+
+
+/*
+ * Gives back the response of the request, keeping its arguments (i.e. to send the request again).
+ */
+void    channel_release(Request* request);
+
+
 /*
  * Cleans up all resources used by the request.
  */
@@ -15,14 +15,24 @@
  */
 
 #include <string.h>
+#include <pthread.h>
 #include <curl/curl.h>
 #include <cchamp/cchamp.h>
 #include "api.h"
+#include "rate.h"
+#include "hedge.h"
+#include "breaker.h"
+#include "worker.h"
 #include "ddragon/static.h"
 
 static CURL* channel;
-uint16_t cc_error;
-extern struct curl_slist* http_headers;
+
+// The channel is shared by the caller and the static data refresher, which never send at the same time.
+static pthread_mutex_t channel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Serializes the registration of API keys; requests only read them.
+static pthread_mutex_t keys_lock = PTHREAD_MUTEX_INITIALIZER;
+__thread uint16_t cc_error;
 
 RiotAPI api = {
     .rate.per_second        = MAX_REQUESTS_PER_SECOND,
@@ -35,12 +45,18 @@ RiotAPI api = {
  * An option is passed to curl to override the default write function (i.e. fwrite) to a custom one.
  *
  * @return  0 If curl successfully initialized.
- *          1 If curl failed.
+ *          1 If curl failed (cc_error is set to ECURL), or the memory backing cchamp internal data could not be
+ *          reserved (cc_error is set to E2MANY).
  */
 int cchamp_init()
 {
-    // map all necessary pages for backing cchamp internal data.
-    int reserved = static_pages_allocate() + channel_blocks_allocate();
+    // Reserve the pages backing cchamp internal data; they are only committed once used.
+    if (static_pages_allocate() < 0 || channel_blocks_allocate() < 0) {
+        cc_error = E2MANY;
+        cchamp_close();
+
+        return 1;
+    }
 
     // Attempt to initialize the curl instance which will be used as the http medium.
     channel = curl_easy_init();
@@ -52,6 +68,7 @@ int cchamp_init()
     }
 
     curl_easy_setopt(channel, CURLOPT_WRITEFUNCTION, channel_response_received);
+    curl_easy_setopt(channel, CURLOPT_HEADERFUNCTION, channel_header_received);
     return 0;
 }
 
@@ -64,6 +81,10 @@ int cchamp_init()
  */
 void cchamp_close()
 {
+    // The refresher must be stopped before the channel and the static pages it uses are torn down.
+    cchamp_static_refresh(0);
+    cchamp_workers_stop();
+
     if (channel != NULL) {
         curl_easy_cleanup(channel);
         channel = NULL;
@@ -72,12 +93,116 @@ void cchamp_close()
     // return all anonymously backed pages to the OS.
     static_pages_free();
     channel_blocks_free();
+    rate_free();
+    hedge_reset();
+    breaker_reset();
+
+    // No request is in flight anymore: the headers of the replaced keys can go.
+    pthread_mutex_lock(&keys_lock);
+    curl_slist_free_all(api.retired);
+    api.retired = NULL;
+    pthread_mutex_unlock(&keys_lock);
+}
+
+
+/**
+ * Reports the memory reserved and committed by the library: its response buffers and its static categories.
+ *
+ * @param stats Receives the sizes, in bytes.
+ */
+void cchamp_stats(CChampStats* stats)
+{
+    channel_blocks_stats(&stats->channel_reserved, &stats->channel_committed);
+    static_pages_stats(&stats->static_reserved, &stats->static_committed);
+
+    stats->reserved = stats->channel_reserved + stats->static_reserved;
+    stats->committed = stats->channel_committed + stats->static_committed;
+}
+
+
+/**
+ * Gives every free block of the response buffers back to the OS at once, i.e. under memory pressure.
+ * They are committed again when responses are next received into them. Static categories are left as they are,
+ * since they only hold the pages of their published tables.
+ */
+void cchamp_trim()
+{
+    channel_blocks_trim();
+}
+
+
+/**
+ * Keeps the headers of a replaced key alive until cchamp_close(), since requests in flight may still send them.
+ * Should be invoked with keys_lock held.
+ *
+ * @param headers The headers of the key.
+ */
+static void __api_headers_retire(struct curl_slist* headers)
+{
+    struct curl_slist* last = headers;
+
+    while (last->next != NULL) {
+        last = last->next;
+    }
+
+    last->next = api.retired;
+    api.retired = headers;
+}
+
+
+/**
+ * Registers one more API key. See cchamp_add_api_key().
+ * Should be invoked with keys_lock held.
+ *
+ * @param key A sequence of characters used to identify the person making the API call.
+ *
+ * @return 0 on success; or <br>
+ *         1 if too many keys are registered already.
+ */
+static int __api_key_add(char* key)
+{
+    int count = api.key_count;
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(api.keys[i].key, key) == 0) {
+            __atomic_store_n(&api.keys[i].revoked, 0, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+
+    if (count == API_KEYS_MAX) {
+        return 1;
+    }
+
+    /*
+     * The slot may still hold a key that was replaced by cchamp_set_api_key(). Its headers are left in place,
+     * and retired, as a request in flight may have picked the slot before it was replaced.
+     */
+    struct api_key* slot = api.keys + count;
+    if (slot->headers == NULL || strcmp(slot->key, key) != 0) {
+        struct curl_slist* headers = channel_token_headers(key);
+
+        if (slot->headers != NULL) {
+            __api_headers_retire(slot->headers);
+        }
+
+        memcpy(slot->key, key, API_KEY_LENGTH);
+        slot->key[API_KEY_LENGTH] = 0x00;
+        __atomic_store_n(&slot->headers, headers, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&slot->revoked, 0, __ATOMIC_RELAXED);
+
+    // The key is only picked by the rate limit once it is fully set up.
+    __atomic_store_n(&api.key_count, count + 1, __ATOMIC_RELEASE);
+    return 0;
 }
 
 
 /**
- * Sets the API key that will be used when accessing the riot games API.
+ * Sets the API key that will be used when accessing the riot games API, in place of all keys registered so far.
  * You cannot make any API calls before configuring the API key.
+ * Requests in flight finish with the key they were sent with.
  *
  * @param key A sequence of characters used to identify the person making the API call.
  */
@@ -85,9 +210,53 @@ void cchamp_set_api_key(char* key)
 {
     if (strlen(key) != API_KEY_LENGTH) return;
 
-    memcpy(api.key, key, API_KEY_LENGTH);
-    api.key[API_KEY_LENGTH] = 0x00;
-    channel_update_token(api.key);
+    pthread_mutex_lock(&keys_lock);
+    __atomic_store_n(&api.key_count, 0, __ATOMIC_RELEASE);
+    __api_key_add(key);
+    pthread_mutex_unlock(&keys_lock);
+}
+
+
+/**
+ * Registers one more API key. Requests are spread over all keys, each within the rate limits of its own
+ * (see cchamp_set_max_requests()), so every key adds to the number of calls that can be made.
+ * A key that the server rejects (401/403) is not used anymore; registering it again brings it back.
+ * Keys may be registered while requests are in flight, from any thread.
+ *
+ * @param key A sequence of characters used to identify the person making the API call.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the key is malformed or too many keys are registered already.
+ */
+int cchamp_add_api_key(char* key)
+{
+    if (strlen(key) != API_KEY_LENGTH) {
+        return 1;
+    }
+
+    pthread_mutex_lock(&keys_lock);
+    int res = __api_key_add(key);
+    pthread_mutex_unlock(&keys_lock);
+
+    return res;
+}
+
+
+/**
+ * Counts the registered API keys that the server did not reject.
+ *
+ * @return The number of usable keys.
+ */
+int api_keys_usable()
+{
+    int count = __atomic_load_n(&api.key_count, __ATOMIC_ACQUIRE);
+    int usable = 0;
+
+    for (int i = 0; i < count; i++) {
+        usable += !__atomic_load_n(&api.keys[i].revoked, __ATOMIC_RELAXED);
+    }
+
+    return usable;
 }
 
 
@@ -105,32 +274,166 @@ void cchamp_set_max_requests(uint16_t per_second, uint16_t per_two_minutes)
 
 
 /**
- * Sends the request to the server, writes the response to a buffer, then exits.
+ * Sends the requests to another server than the official ones, i.e. a local mock server.
  *
- * @param request A struct containing the request data to be sent out.
+ * @param url The base URL, in which "%s" (if present) stands for the platform of the region; or NULL for the
+ *            official servers.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the URL is too long or malformed.
  */
-void cchamp_send_request(Request* request)
+int cchamp_set_base_url(char* url)
 {
-    if (channel == NULL) return;
+    return channel_base_url(url);
+}
+
+
+/**
+ * Applies the configured timeouts to a curl easy handle (see CCHAMP_CONFIG_TIMEOUT).
+ *
+ * @param easy The easy handle.
+ */
+void api_timeouts(void* easy)
+{
+    // Timeouts must not rely on signals, as requests are sent from more than one thread.
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, (long)cchamp_config_get_int(CCHAMP_CONFIG_TIMEOUT));
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, (long)cchamp_config_get_int(CCHAMP_CONFIG_CONNECT_TIMEOUT));
+}
+
+
+/**
+ * Sends the request to the server once, with the key picked by the rate limit.
+ */
+static void __api_send(Request* request)
+{
+    struct curl_slist* conditional;
+    uint64_t started;
+    char* url;
+
+    // A request that cannot be built is never sent, and uses none of the rate limit.
+    if ((url = channel_url(request)) == NULL) {
+        request->http_code = 0;
+        cc_error = EARGUMENT;
+        return;
+    }
+
+    // The static-data API is not subject to the rate limits; it goes out with any key the server accepts.
+    if (request->api != API_LOL_STATIC_DATA) {
+
+        // A region found down fails right away, before waiting on its rate limit (see breaker.h).
+        if (breaker_ready(request->region, request->api) != 0) {
+            request->http_code = 0;
+            cc_error = ECIRCUIT;
+            return;
+        }
+
+        request->key = rate_wait(request->region);
+
+        if (breaker_allow(request->region, request->api) != 0) {
+            rate_release(request->region, request->key);
+            request->http_code = 0;
+            cc_error = ECIRCUIT;
+            return;
+        }
+    } else {
+        int usable = api_keys_usable();
+
+        for (request->key = 0; usable != 0 && api.keys[request->key].revoked; request->key++);
+    }
+
+    conditional = channel_conditional_headers(request);
 
-    curl_easy_setopt(channel, CURLOPT_URL, channel_url(request));
+    pthread_mutex_lock(&channel_lock);
+    api_timeouts(channel);
+    curl_easy_setopt(channel, CURLOPT_URL, url);
     curl_easy_setopt(channel, CURLOPT_WRITEDATA, request);
-    curl_easy_setopt(channel, CURLOPT_HTTPHEADER, http_headers);
+    curl_easy_setopt(channel, CURLOPT_HEADERDATA, request);
+    curl_easy_setopt(channel, CURLOPT_HTTPHEADER, conditional != NULL ? conditional : channel_headers(request));
+
+    cc_error = EPASS;
+    started = rate_now();
     CURLcode res = curl_easy_perform(channel);
 
     // Store the http response code.
     curl_easy_getinfo(channel, CURLINFO_RESPONSE_CODE, &request->http_code);
+    pthread_mutex_unlock(&channel_lock);
+
+    if (request->api != API_LOL_STATIC_DATA) {
+        breaker_record(request->region, request->api, breaker_failed(res, request->http_code), rate_now() - started);
+    }
+
+    curl_slist_free_all(conditional);
+    cc_error = api_status(request, res);
+}
+
+
+/**
+ * Sends the request to the server, writes the response to a buffer, then exits.
+ * A request rejected for its key goes again with another one, as long as any is left.
+ *
+ * @param request A struct containing the request data to be sent out.
+ */
+void cchamp_send_request(Request* request)
+{
+    char etag[REQUEST_ETAG_SIZE];
+
+    if (channel == NULL) return;
+
+    // Requests for a region that has a worker are sent by it instead (see cchamp_workers_start()).
+    if (request->api != API_LOL_STATIC_DATA && worker_send(request) == 0) {
+        return;
+    }
+
+    // Sending a conditional request clears its ETag, which a second attempt needs again.
+    memcpy(etag, request->etag, REQUEST_ETAG_SIZE);
+
+    for (int attempt = 1; ; attempt++) {
+        __api_send(request);
+
+        if (cc_error != EAPIKEY || api_keys_usable() == 0 || attempt == API_KEYS_MAX) {
+            break;
+        }
+
+        channel_release(request);
+        memcpy(request->etag, etag, REQUEST_ETAG_SIZE);
+    }
+}
+
+
+/**
+ * Interprets the outcome of a transfer into a cc_error code.
+ * A rate limit reported by the server holds back further requests to the region.
+ *
+ * @param request   The request that was sent.
+ * @param res       The curl result of the transfer.
+ *
+ * @return The cc_error code describing the outcome.
+ */
+uint16_t api_status(Request* request, int res)
+{
+    /*
+     * A transfer that curl aborted (i.e. the response did not fit in a channel block) is never a success,
+     * regardless of the http code that was received before the abort.
+     */
+    if (res != CURLE_OK) {
+        request->http_code = 0;
+        return cc_error != EPASS ? cc_error : EUNKNOWN;
+    }
 
-    // Check the status of the request. Any errors reported are stored in cc_error.
-    if (request->http_code == 200) {
-        cc_error = EPASS;
+    // Check the status of the request.
+    if (request->http_code == 200 || request->http_code == 304) {
+        return EPASS;
     } else if (request->http_code == 401 || request->http_code == 403) {
-        cc_error = EAPIKEY;
+        // The key is not used anymore (see rate_acquire()), unless it was the last one.
+        __atomic_store_n(&api.keys[request->key].revoked, 1, __ATOMIC_RELAXED);
+        return EAPIKEY;
     } else if (request->http_code == 404) {
-        cc_error = ENOTFOUND;
+        return ENOTFOUND;
     } else if (request->http_code == 429) {
-        cc_error = ERATELIMIT;
+        rate_penalize(request->region, request->key, request->retry_after);
+        return ERATELIMIT;
     } else {
-        cc_error = EUNKNOWN;
+        return EUNKNOWN;
     }
 }
@@ -20,9 +20,29 @@
 #include <network/channel.h>
 
 #define API_KEY_LENGTH 42
+#define API_KEYS_MAX   8
 
-struct api_node {
+/*
+ * Requests are spread over all the registered keys, each within a rate limit of its own (see rate_acquire()).
+ */
+struct api_key {
     char key[API_KEY_LENGTH + 1];
+
+    // The headers sent along with the requests made with this key.
+    struct curl_slist* headers;
+
+    // Set once the server rejected the key (401/403); it is then only used if all keys are.
+    int revoked;
+};
+
+struct api_node {
+    struct api_key keys[API_KEYS_MAX];
+    int key_count;
+
+    // The headers of the keys that were replaced; requests in flight may still send them until cchamp_close().
+    struct curl_slist* retired;
+
+    // The limits apply to each key.
     struct rate_limit {
         uint16_t per_second;
         uint16_t per_two_minutes;
@@ -37,6 +57,9 @@ typedef struct api_node RiotAPI;
 extern RiotAPI api;
 
 void cchamp_send_request(Request* request);
+uint16_t api_status(Request* request, int res);
+int api_keys_usable();
+void api_timeouts(void* easy);
 
 // All different types of APIs available for requests
 #define API_CHAMPION_MASTERY    0x0001
@@ -49,4 +72,7 @@ void cchamp_send_request(Request* request);
 #define API_SUMMONER            0x0080
 #define API_THIRD_PARTY_CODE    0x0100
 
+// The number of APIs above, i.e. for state kept per API by bit index.
+#define API_INDEXES             9
+
 #endif
@@ -0,0 +1,251 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <pthread.h>
+#include <curl/curl.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include "api.h"
+#include "rate.h"
+#include "breaker.h"
+
+#define BREAKER_CLOSED      0
+#define BREAKER_OPEN        1
+#define BREAKER_HALF_OPEN   2
+
+static struct breaker {
+    pthread_mutex_t lock;
+    int             state;
+
+    // The requests completed (and failed) within the current window, which started at window.
+    uint32_t        requests;
+    uint32_t        failures;
+    uint64_t        window;
+
+    // The time the circuit opened; once half-open, the time the latest probe went out.
+    uint64_t        since;
+
+    // The probes in flight, and the successful ones, while half-open.
+    uint32_t        probes;
+    uint32_t        passed;
+} breakers[RATE_REGIONS][API_INDEXES] = {
+    [0 ... RATE_REGIONS - 1] = {
+        [0 ... API_INDEXES - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+    }
+};
+
+
+/**
+ * The breaker of a region and API; NULL if the API is not one of the API_* constants.
+ */
+static struct breaker* __breaker(uint16_t region, uint16_t api)
+{
+    int index = get_bit_index(api);
+
+    if (api == 0 || index >= API_INDEXES) {
+        return NULL;
+    }
+
+    return &breakers[(int)get_bit_index(region)][index];
+}
+
+
+/**
+ * The time until the breaker lets a request through; the breaker must be locked.
+ */
+static uint64_t __breaker_wait(struct breaker* breaker, uint64_t now)
+{
+    uint64_t cooldown = cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_COOLDOWN);
+
+    if (breaker->state == BREAKER_CLOSED || now >= breaker->since + cooldown) {
+        return 0;
+    }
+
+    // A half-open circuit admits probes until it has as many in flight as it needs.
+    if (breaker->state == BREAKER_HALF_OPEN && breaker->probes < cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_PROBES)) {
+        return 0;
+    }
+
+    return breaker->since + cooldown - now;
+}
+
+
+/**
+ * Tells whether a request of a region and API would be let through, without sending it as a probe.
+ *
+ * @param region    The region of the request.
+ * @param api       The API of the request.
+ *
+ * @return 0 if the request would go through; or <br>
+ *         the number of milliseconds until it may.
+ */
+int breaker_ready(uint16_t region, uint16_t api)
+{
+    struct breaker* breaker = __breaker(region, api);
+    uint64_t wait;
+
+    if (breaker == NULL || cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_ERRORS) == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&breaker->lock);
+    wait = __breaker_wait(breaker, rate_now());
+    pthread_mutex_unlock(&breaker->lock);
+
+    return wait;
+}
+
+
+/**
+ * Lets a request of a region and API through, as a probe if the circuit is half-open. The outcome of a request
+ * let through must be handed to breaker_record().
+ *
+ * @param region    The region of the request.
+ * @param api       The API of the request.
+ *
+ * @return 0 if the request may be sent; or <br>
+ *         1 if the circuit is open.
+ */
+int breaker_allow(uint16_t region, uint16_t api)
+{
+    struct breaker* breaker = __breaker(region, api);
+    uint64_t now = rate_now();
+
+    if (breaker == NULL || cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_ERRORS) == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&breaker->lock);
+
+    if (__breaker_wait(breaker, now) != 0) {
+        pthread_mutex_unlock(&breaker->lock);
+        return 1;
+    }
+
+    if (breaker->state == BREAKER_OPEN) {
+        breaker->state = BREAKER_HALF_OPEN;
+        breaker->probes = 0;
+        breaker->passed = 0;
+    } else if (breaker->state == BREAKER_HALF_OPEN && breaker->probes >= cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_PROBES)) {
+        // The probes have been out for a whole cooldown; they are given up on (i.e. their requests were dropped).
+        breaker->probes = 0;
+    }
+
+    if (breaker->state == BREAKER_HALF_OPEN) {
+        breaker->probes++;
+        breaker->since = now;
+    }
+
+    pthread_mutex_unlock(&breaker->lock);
+    return 0;
+}
+
+
+/**
+ * Records the outcome of a request that breaker_allow() let through.
+ *
+ * @param region    The region of the request.
+ * @param api       The API of the request.
+ * @param failed    Whether the request failed (see breaker_failed()).
+ * @param latency   The time the request took, in ms.
+ */
+void breaker_record(uint16_t region, uint16_t api, int failed, uint64_t latency)
+{
+    struct breaker* breaker = __breaker(region, api);
+    uint64_t slow = cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_SLOW);
+    uint64_t errors = cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_ERRORS);
+    uint64_t now = rate_now();
+
+    if (breaker == NULL || errors == 0) {
+        return;
+    }
+
+    failed |= slow != 0 && latency >= slow;
+
+    pthread_mutex_lock(&breaker->lock);
+
+    if (breaker->state == BREAKER_HALF_OPEN) {
+        if (breaker->probes > 0) breaker->probes--;
+
+        if (failed) {
+            breaker->state = BREAKER_OPEN;
+            breaker->since = now;
+        } else if (++breaker->passed >= cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_PROBES)) {
+            breaker->state = BREAKER_CLOSED;
+            breaker->requests = 0;
+            breaker->failures = 0;
+            breaker->window = now;
+        }
+    } else if (breaker->state == BREAKER_CLOSED) {
+        if (now - breaker->window >= (uint64_t)cchamp_config_get_int(CCHAMP_CONFIG_BREAKER_WINDOW)) {
+            breaker->requests = 0;
+            breaker->failures = 0;
+            breaker->window = now;
+        }
+
+        breaker->requests++;
+        breaker->failures += failed != 0;
+
+        if (breaker->requests >= BREAKER_MIN_REQUESTS && breaker->failures * 100 >= errors * breaker->requests) {
+            breaker->state = BREAKER_OPEN;
+            breaker->since = now;
+        }
+    }
+
+    // An open circuit ignores the requests that were already in flight when it opened.
+    pthread_mutex_unlock(&breaker->lock);
+}
+
+
+/**
+ * Tells whether the outcome of a transfer speaks against the health of the region: the transfer broke or timed
+ * out, or the server failed. A response too large for its channel block does not (the region answered).
+ *
+ * @param res       The result of the transfer.
+ * @param http_code The http code of the response.
+ *
+ * @return 1 if the request failed; or <br>
+ *         0 if it did not.
+ */
+int breaker_failed(int res, long http_code)
+{
+    if (res != CURLE_OK) {
+        return res != CURLE_WRITE_ERROR;
+    }
+
+    return http_code >= 500;
+}
+
+
+/**
+ * Closes all circuits.
+ */
+void breaker_reset()
+{
+    for (int i = 0; i < RATE_REGIONS; i++) {
+        for (int j = 0; j < API_INDEXES; j++) {
+            struct breaker* breaker = &breakers[i][j];
+
+            pthread_mutex_lock(&breaker->lock);
+            breaker->state = BREAKER_CLOSED;
+            breaker->requests = 0;
+            breaker->failures = 0;
+            breaker->window = 0;
+            breaker->probes = 0;
+            breaker->passed = 0;
+            pthread_mutex_unlock(&breaker->lock);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_BREAKER_H
+#define CCHAMP_BREAKER_H
+#include <inttypes.h>
+
+/*
+ * A circuit breaker per region and API keeps requests from waiting on a region that is down. A circuit opens
+ * once CCHAMP_CONFIG_BREAKER_ERRORS percent of the requests of a window (of at least BREAKER_MIN_REQUESTS)
+ * failed: the transfer broke or timed out, the server answered with a 5xx, or the response took longer than
+ * CCHAMP_CONFIG_BREAKER_SLOW.
+ *
+ * While a circuit is open, requests fail right away with ECIRCUIT. After the cooldown, it is half-open: up to
+ * CCHAMP_CONFIG_BREAKER_PROBES requests go through as probes. As many successful probes close the circuit,
+ * and a failed one opens it for another cooldown.
+ */
+#define BREAKER_MIN_REQUESTS    10
+
+int     breaker_ready(uint16_t region, uint16_t api);
+int     breaker_allow(uint16_t region, uint16_t api);
+void    breaker_record(uint16_t region, uint16_t api, int failed, uint64_t latency);
+int     breaker_failed(int res, long http_code);
+void    breaker_reset();
+#endif
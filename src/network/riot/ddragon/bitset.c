@@ -0,0 +1,100 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <cchamp/cchamp.h>
+#include "static.h"
+#include "bitset.h"
+
+/**
+ * Transposes a bitmask column (bit N of a record set for member N) into one bitset per bit.
+ *
+ * @param table     The table.
+ * @param mask      The bitmask column, with elements of width bytes.
+ * @param width     The size of the bitmask elements (4 or 8 bytes).
+ * @param bitsets   The number of bitsets to fill.
+ * @param out       The bitsets, (table->words) words each, zeroed.
+ */
+static void __bitset_transpose(struct static_table* table, const void* mask, int width, int bitsets, uint64_t* out)
+{
+    for (uint32_t row = 0; row < table->count; row++) {
+        uint64_t bits = width == 8 ? ((const uint64_t *)mask)[row] : ((const uint32_t *)mask)[row];
+
+        while (bits != 0) {
+            int bit = __builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            if (bit < bitsets) {
+                out[bit * table->words + row / 64] |= (uint64_t)1 << (row % 64);
+            }
+        }
+    }
+}
+
+
+/**
+ * Builds the tag bitsets (and map bitsets, for STATIC_ITEMS) of a table and appends them to the category
+ * pages, which may move. Must be invoked before the pages are sealed read-only.
+ *
+ * @param category  The STATIC_* constant of the table.
+ * @param cat       The category holding the table.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the category pages could not be grown.
+ */
+int bitset_build(uint16_t category, struct category* cat)
+{
+    struct static_table* table = (struct static_table *)cat->__first_page;
+    int maps = category == STATIC_ITEMS ? BITSET_MAPS : 0;
+    int tags_column;
+
+    if (category == STATIC_CHAMPIONS) {
+        tags_column = CHAMPION_TAGS;
+    } else if (category == STATIC_ITEMS) {
+        tags_column = ITEM_TAGS;
+    } else {
+        return 0;
+    }
+
+    if (table->magic != TABLE_MAGIC) {
+        return 0;
+    }
+
+    uint32_t words = BITSET_WORDS(table->count);
+    uint32_t offset = table->size;
+    size_t size = sizeof(uint64_t) * words * (table->tags_count + maps);
+
+    if (static_pages_grow(cat, offset + size)) {
+        return 1;
+    }
+
+    table = (struct static_table *)cat->__first_page;
+    uint64_t* bitsets = (uint64_t *)((char *)table + offset);
+    memset(bitsets, 0x00, size);
+
+    table->words = words;
+    table->tag_bitsets = offset;
+    table->map_bitsets = offset + sizeof(uint64_t) * words * table->tags_count;
+
+    __bitset_transpose(table, TABLE_COLUMN(table, uint64_t, tags_column), 8, table->tags_count, bitsets);
+    if (maps != 0) {
+        __bitset_transpose(table, TABLE_COLUMN(table, uint32_t, ITEM_MAPS), 4, maps,
+                           (uint64_t *)((char *)table + table->map_bitsets));
+    }
+
+    table->size = offset + size;
+    cat->__used = table->size;
+    return 0;
+}
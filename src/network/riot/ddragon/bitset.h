@@ -0,0 +1,38 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_BITSET_H
+#define CCHAMP_BITSET_H
+#include <inttypes.h>
+#include "tables.h"
+
+/*
+ * Bitsets over the records of a table: bit N of a bitset is set if record N is a member.
+ *
+ * Tables that carry tags (and maps, for items) hold one precomputed bitset per tag and per map id, so that
+ * filters over them are evaluated 64 records at a time with plain word-wide bitwise operations.
+ */
+#define BITSET_WORDS(count)         (((count) + 63) / 64)
+#define BITSET_MAPS                 32
+
+#define BITSET_TAG(table, tag)      ((const uint64_t *)((const char *)(table) + (table)->tag_bitsets) + (tag) * (table)->words)
+#define BITSET_MAP(table, map)      ((const uint64_t *)((const char *)(table) + (table)->map_bitsets) + (map) * (table)->words)
+
+/*
+ * Builds the tag and map bitsets of a category's table and appends them to its pages.
+ */
+int     bitset_build(uint16_t category, struct category* cat);
+
+#endif
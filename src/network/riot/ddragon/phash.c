@@ -0,0 +1,253 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <cchamp/cchamp.h>
+#include "static.h"
+#include "phash.h"
+
+// The average number of keys per bucket. Lower values build faster at the cost of a larger index.
+#define PHASH_LAMBDA    2
+
+// The number of seeds tried, and of displacements tried per bucket under a seed, before giving up.
+#define PHASH_SEEDS     16
+#define PHASH_TRIES     (1 << 16)
+
+/*
+ * The indexes built for every kind of table.
+ */
+static const struct {
+    uint16_t    category;
+    uint16_t    which;
+    uint16_t    column;
+    uint16_t    strings;
+} __indexes[] = {
+    { STATIC_CHAMPIONS,         INDEX_ID,   CHAMPION_ID,    0 },
+    { STATIC_CHAMPIONS,         INDEX_KEY,  CHAMPION_KEY,   1 },
+    { STATIC_ITEMS,             INDEX_ID,   ITEM_ID,        0 },
+    { STATIC_SUMMONER_SPELLS,   INDEX_ID,   SPELL_ID,       0 }
+};
+
+/*
+ * Scratch memory used while searching for the displacements of an index.
+ */
+struct phash_scratch {
+    uint64_t*   hashes;
+    uint32_t*   sizes;
+    uint32_t*   starts;
+    uint32_t*   members;
+    uint32_t*   order;
+    uint32_t*   slots;
+    uint8_t*    taken;
+};
+
+/*
+ * Orders buckets from the largest to the smallest, as large buckets are easiest to place while most slots
+ * are still free.
+ */
+static int __phash_bucket_compare(const void* a, const void* b, void* sizes)
+{
+    uint32_t size_a = ((uint32_t *)sizes)[*(const uint32_t *)a];
+    uint32_t size_b = ((uint32_t *)sizes)[*(const uint32_t *)b];
+    return (size_a < size_b) - (size_a > size_b);
+}
+
+
+/**
+ * Attempts to find a displacement for every bucket under a single seed.
+ *
+ * @param table         The table being indexed.
+ * @param column        The key column.
+ * @param strings       Whether the keys are strings.
+ * @param seed          The seed of the key hashes.
+ * @param buckets       The number of buckets.
+ * @param displacements Receives the displacement of every bucket.
+ * @param rows          Receives the row of every slot.
+ * @param scratch       Scratch memory sized for the table.
+ *
+ * @return 0 on success; or <br>
+ *         1 if some bucket could not be placed under this seed.
+ */
+static int __phash_search(struct static_table* table, int column, int strings, uint32_t seed, uint32_t buckets,
+                          uint32_t* displacements, uint32_t* rows, struct phash_scratch* scratch)
+{
+    uint32_t count = table->count;
+    uint32_t* keys = TABLE_COLUMN(table, uint32_t, column);
+
+    memset(scratch->sizes, 0x00, sizeof(uint32_t) * buckets);
+    memset(scratch->taken, 0x00, count);
+
+    for (uint32_t row = 0; row < count; row++) {
+        scratch->hashes[row] = strings ? phash_string(TABLE_STRING(table, keys[row]), seed) : phash_id(keys[row], seed);
+        scratch->sizes[PHASH_BUCKET(scratch->hashes[row], buckets)]++;
+    }
+
+    // Group the rows by bucket.
+    for (uint32_t b = 0, start = 0; b < buckets; b++) {
+        scratch->starts[b] = start;
+        start += scratch->sizes[b];
+        scratch->order[b] = b;
+    }
+
+    for (uint32_t row = 0; row < count; row++) {
+        uint32_t b = PHASH_BUCKET(scratch->hashes[row], buckets);
+        scratch->members[scratch->starts[b]++] = row;
+    }
+
+    for (uint32_t b = 0; b < buckets; b++) {
+        scratch->starts[b] -= scratch->sizes[b];
+    }
+
+    qsort_r(scratch->order, buckets, sizeof(uint32_t), __phash_bucket_compare, scratch->sizes);
+
+    for (uint32_t i = 0; i < buckets; i++) {
+        uint32_t b = scratch->order[i];
+        uint32_t size = scratch->sizes[b];
+        uint32_t* members = scratch->members + scratch->starts[b];
+        uint32_t d;
+
+        if (size == 0) break;
+
+        for (d = 0; d < PHASH_TRIES; d++) {
+            uint32_t placed = 0;
+
+            // Tentatively take a slot for every member, releasing them all on the first collision.
+            while (placed < size) {
+                uint32_t slot = PHASH_SLOT(scratch->hashes[members[placed]], d, count);
+                if (scratch->taken[slot]) break;
+
+                scratch->taken[slot] = 1;
+                scratch->slots[placed++] = slot;
+            }
+
+            if (placed == size) break;
+
+            while (placed > 0) {
+                scratch->taken[scratch->slots[--placed]] = 0;
+            }
+        }
+
+        if (d == PHASH_TRIES) {
+            return 1;
+        }
+
+        displacements[b] = d;
+        for (uint32_t m = 0; m < size; m++) {
+            rows[scratch->slots[m]] = members[m];
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Builds a single index and appends it to the category pages.
+ *
+ * @return 0 on success, or if the keys admit no perfect hash (the index is then left out); or <br>
+ *         1 if memory could not be acquired.
+ */
+static int __phash_build_index(struct category* cat, int which, int column, int strings)
+{
+    struct static_table* table = (struct static_table *)cat->__first_page;
+    uint32_t count = table->count;
+    uint32_t buckets = count / PHASH_LAMBDA + 1;
+    size_t size = (sizeof(struct table_index) + sizeof(uint32_t) * (buckets + count) + 7) & ~(size_t)7;
+
+    struct phash_scratch scratch = {
+        .hashes = malloc(sizeof(uint64_t) * count),
+        .sizes = malloc(sizeof(uint32_t) * buckets),
+        .starts = malloc(sizeof(uint32_t) * buckets),
+        .members = malloc(sizeof(uint32_t) * count),
+        .order = malloc(sizeof(uint32_t) * buckets),
+        .slots = malloc(sizeof(uint32_t) * count),
+        .taken = malloc(count)
+    };
+    uint32_t* displacements = calloc(buckets + count, sizeof(uint32_t));
+    uint32_t seed = 0;
+    int failed = 0;
+
+    if (scratch.hashes == NULL || scratch.sizes == NULL || scratch.starts == NULL || scratch.members == NULL
+            || scratch.order == NULL || scratch.slots == NULL || scratch.taken == NULL || displacements == NULL) {
+        failed = 1;
+    }
+
+    while (!failed && seed < PHASH_SEEDS
+            && __phash_search(table, column, strings, seed, buckets, displacements, displacements + buckets, &scratch)) {
+        seed++;
+    }
+
+    if (!failed && seed < PHASH_SEEDS) {
+        uint32_t offset = table->size;
+        failed = static_pages_grow(cat, offset + size);
+
+        if (!failed) {
+            table = (struct static_table *)cat->__first_page;
+
+            struct table_index* index = (struct table_index *)((char *)table + offset);
+            index->seed = seed;
+            index->buckets = buckets;
+            index->column = column;
+            index->strings = strings;
+            index->__padding = 0;
+            memcpy(PHASH_DISPLACEMENTS(index), displacements, sizeof(uint32_t) * (buckets + count));
+
+            table->index[which] = offset;
+            table->size = offset + size;
+            cat->__used = table->size;
+        }
+    }
+
+    free(scratch.hashes);
+    free(scratch.sizes);
+    free(scratch.starts);
+    free(scratch.members);
+    free(scratch.order);
+    free(scratch.slots);
+    free(scratch.taken);
+    free(displacements);
+    return failed;
+}
+
+
+/**
+ * Builds every lookup index of a table and appends them to the category pages, which may move.
+ * Must be invoked before the pages are sealed read-only.
+ *
+ * @param category  The STATIC_* constant of the table.
+ * @param cat       The category holding the table.
+ *
+ * @return 0 on success; or <br>
+ *         1 if memory could not be acquired for some index.
+ */
+int phash_build(uint16_t category, struct category* cat)
+{
+    int failed = 0;
+    struct static_table* table = (struct static_table *)cat->__first_page;
+
+    if (table->magic != TABLE_MAGIC || table->count == 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(__indexes) / sizeof(__indexes[0]); i++) {
+        if (__indexes[i].category == category) {
+            failed |= __phash_build_index(cat, __indexes[i].which, __indexes[i].column, __indexes[i].strings);
+        }
+    }
+
+    return failed;
+}
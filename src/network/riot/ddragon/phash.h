@@ -0,0 +1,159 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_PHASH_H
+#define CCHAMP_PHASH_H
+#include <inttypes.h>
+#include <string.h>
+#include "tables.h"
+
+/*
+ * Lookup indexes over static tables are minimal perfect hash tables (hash and displace).
+ *
+ * Keys are hashed once into 64 bits. The upper half selects a bucket, and the displacement stored for that
+ * bucket selects the slot of the key among exactly (count) slots, each holding a row of the table. Every key of
+ * the table lands in its own slot, so a lookup is a fixed sequence of two loads and a single key comparison
+ * which rejects keys that are not part of the table. There is no probing.
+ *
+ *  +-------------+--------------------------------+----------------------+
+ *  | table_index | uint32_t displacement[buckets] | uint32_t rows[count] |
+ *  +-------------+--------------------------------+----------------------+
+ *
+ * An index that could not be built (i.e. duplicate keys) is left out, and lookups fall back to a linear scan
+ * of the key column.
+ */
+struct table_index {
+    uint32_t    seed;
+    uint32_t    buckets;
+
+    // The column holding the keys, and whether the keys are strings (1) or uint32_t (0).
+    uint16_t    column;
+    uint16_t    strings;
+    uint32_t    __padding;
+};
+
+// The indexes built for each kind of table, stored in static_table.index[].
+#define INDEX_ID    0
+#define INDEX_KEY   1
+
+#define PHASH_DISPLACEMENTS(index)  ((uint32_t *)((index) + 1))
+#define PHASH_ROWS(index)           (PHASH_DISPLACEMENTS(index) + (index)->buckets)
+
+/*
+ * Multiplicative reduction of a 32-bit hash into [0, range) without a division.
+ */
+#define PHASH_REDUCE(hash, range)   ((uint32_t)(((uint64_t)(uint32_t)(hash) * (range)) >> 32))
+
+/*
+ * The bucket of a key hash, and its slot once the displacement of its bucket is applied.
+ */
+#define PHASH_BUCKET(hash, buckets)         PHASH_REDUCE((hash) >> 32, buckets)
+#define PHASH_SLOT(hash, displacement, n)   PHASH_REDUCE(phash_mix((hash) + (displacement) * 0x9e3779b97f4a7c15ULL), n)
+
+
+/*
+ * Finalizer of MurmurHash3; spreads every input bit over the whole output.
+ */
+static inline uint64_t phash_mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64_t phash_id(uint32_t id, uint32_t seed)
+{
+    return phash_mix(((uint64_t)seed << 32) | id);
+}
+
+static inline uint64_t phash_string(const char* str, uint32_t seed)
+{
+    uint64_t hash = 14695981039346656037ULL ^ seed;
+    while (*str) {
+        hash ^= (uint8_t)*str++;
+        hash *= 1099511628211ULL;
+    }
+
+    return phash_mix(hash);
+}
+
+/*
+ * Maps the hash of a key to its candidate row.
+ */
+static inline uint32_t phash_row(const struct static_table* table, const struct table_index* index, uint64_t hash)
+{
+    uint32_t displacement = PHASH_DISPLACEMENTS(index)[PHASH_BUCKET(hash, index->buckets)];
+    return PHASH_ROWS(index)[PHASH_SLOT(hash, displacement, table->count)];
+}
+
+
+/*
+ * Finds the row holding a uint32_t key in the given key column.
+ *
+ * @return The row; or <br>
+ *         UINT32_MAX if the key is not in the table.
+ */
+static inline uint32_t phash_find_id(const struct static_table* table, int which, int column, uint32_t id)
+{
+    uint32_t* keys = TABLE_COLUMN(table, uint32_t, column);
+
+    if (table->index[which] == 0) {
+        for (uint32_t row = 0; row < table->count; row++) {
+            if (keys[row] == id) return row;
+        }
+
+        return UINT32_MAX;
+    }
+
+    const struct table_index* index = (const struct table_index *)((const char *)table + table->index[which]);
+    uint32_t row = phash_row(table, index, phash_id(id, index->seed));
+
+    return keys[row] == id ? row : UINT32_MAX;
+}
+
+/*
+ * Finds the row holding a string key in the given key column.
+ *
+ * @return The row; or <br>
+ *         UINT32_MAX if the key is not in the table.
+ */
+static inline uint32_t phash_find_string(const struct static_table* table, int which, int column, const char* key)
+{
+    uint32_t* keys = TABLE_COLUMN(table, uint32_t, column);
+
+    if (table->index[which] == 0) {
+        for (uint32_t row = 0; row < table->count; row++) {
+            if (strcmp(TABLE_STRING(table, keys[row]), key) == 0) return row;
+        }
+
+        return UINT32_MAX;
+    }
+
+    const struct table_index* index = (const struct table_index *)((const char *)table + table->index[which]);
+    uint32_t row = phash_row(table, index, phash_string(key, index->seed));
+
+    return strcmp(TABLE_STRING(table, keys[row]), key) == 0 ? row : UINT32_MAX;
+}
+
+
+/*
+ * Builds the lookup indexes of a category's table and appends them to its pages.
+ */
+int     phash_build(uint16_t category, struct category* cat);
+
+#endif
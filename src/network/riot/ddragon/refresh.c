@@ -0,0 +1,99 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <time.h>
+#include <pthread.h>
+#include <cchamp/cchamp.h>
+#include "static.h"
+
+/*
+ * The refresher is a single background thread that wakes up every (interval) seconds to bring the loaded
+ * static categories up to date (see static_refresh()). Changing the interval wakes it up right away.
+ */
+static struct {
+    pthread_t       thread;
+    pthread_mutex_t control;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    unsigned int    interval;
+    int             running;
+} refresher = {
+    .control = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER
+};
+
+
+/**
+ * The body of the refresher thread. Exits once the interval is set to 0.
+ */
+static void* __refresh_run(void* argument)
+{
+    struct timespec deadline;
+    (void)argument;
+
+    pthread_mutex_lock(&refresher.lock);
+    while (refresher.interval != 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += refresher.interval;
+
+        if (pthread_cond_timedwait(&refresher.wake, &refresher.lock, &deadline) == 0) {
+            // Woken up by a new interval; the wait starts over from it.
+            continue;
+        }
+
+        // The refresh may take a while. The interval can be changed (and the wait interrupted) meanwhile.
+        pthread_mutex_unlock(&refresher.lock);
+        static_refresh();
+        pthread_mutex_lock(&refresher.lock);
+    }
+    pthread_mutex_unlock(&refresher.lock);
+
+    return NULL;
+}
+
+
+/**
+ * Starts, reschedules or stops the static data refresher.
+ *
+ * @param interval  The number of seconds between two refreshes; 0 stops the refresher and waits for it to exit.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the refresher thread could not be started.
+ */
+int cchamp_static_refresh(unsigned int interval)
+{
+    int failed = 0;
+
+    pthread_mutex_lock(&refresher.control);
+
+    pthread_mutex_lock(&refresher.lock);
+    refresher.interval = interval;
+    pthread_cond_signal(&refresher.wake);
+    pthread_mutex_unlock(&refresher.lock);
+
+    if (interval != 0 && !refresher.running) {
+        refresher.running = pthread_create(&refresher.thread, NULL, __refresh_run, NULL) == 0;
+        failed = !refresher.running;
+    } else if (interval == 0 && refresher.running) {
+
+        // A refresh in progress is completed before the thread exits.
+        pthread_join(refresher.thread, NULL);
+        refresher.running = 0;
+    }
+
+    pthread_mutex_unlock(&refresher.control);
+    return failed;
+}
@@ -0,0 +1,156 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cchamp/cchamp.h>
+#include "static.h"
+#include "snapshot.h"
+
+/**
+ * Maps every requested category present in a snapshot into the shadow of its category.
+ *
+ * Tables are mapped privately and read-only: all processes mapping the same snapshot share a single copy
+ * of it in the page cache, and nothing has to be parsed. A mapped table is checked for structural integrity
+ * before it is handed over as a shadow.
+ *
+ * @param path      The path of the snapshot file.
+ * @param data      The static categories requested.
+ * @param version   The game version the snapshot must have been written for; NULL accepts any version.
+ * @param shadows   The shadow categories, respective to the bit index of the STATIC_* constants.
+ *
+ * @return The STATIC_* constants of the categories that were mapped.
+ */
+uint16_t snapshot_map(char* path, uint16_t data, const char* version, struct category* shadows)
+{
+    struct snapshot_header header;
+    struct stat st;
+    uint16_t mapped = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || fstat(fd, &st) != 0
+            || header.magic != SNAPSHOT_MAGIC || header.format != SNAPSHOT_FORMAT
+            || header.version[TABLE_VERSION_SIZE - 1] != 0x00
+            || (version != NULL && strcmp(version, header.version) != 0)) {
+        close(fd);
+        return 0;
+    }
+
+    for (uint16_t cat_index = 1; cat_index <= STATIC_VERSIONS; cat_index <<= 1) {
+        if (!(data & header.categories & cat_index)) continue;
+
+        struct category* shadow = shadows + get_bit_index(cat_index);
+        uint64_t offset = header.tables[(int)get_bit_index(cat_index)].offset;
+        uint64_t size = header.tables[(int)get_bit_index(cat_index)].size;
+        int pages = PAGE_ALIGN(size) / PAGE_SIZE;
+
+        if (size == 0 || offset % PAGE_SIZE != 0 || offset + PAGE_ALIGN(size) > (uint64_t)st.st_size) {
+            continue;
+        }
+
+        // The file pages are shared with other processes through the page cache; only pre-faulting applies.
+        int populate = cchamp_config_get(CCHAMP_MAP_POPULATE) ? MAP_POPULATE : 0;
+        void* addr = mmap(NULL, pages * PAGE_SIZE, PROT_READ, MAP_PRIVATE | populate, fd, offset);
+        if (addr == MAP_FAILED) {
+            continue;
+        }
+
+        if (!table_valid(cat_index, addr, size)) {
+            munmap(addr, pages * PAGE_SIZE);
+            continue;
+        }
+
+        shadow->__init_pages_size = GET_CATEGORY(cat_index)->__init_pages_size;
+        shadow->__first_page = addr;
+        shadow->__pages_size = pages;
+        shadow->__used = size;
+        shadow->__snapshot = 1;
+
+        mapped |= cat_index;
+    }
+
+    // The mappings hold their own reference to the file.
+    close(fd);
+    return mapped;
+}
+
+
+/**
+ * Writes the tables of the specified categories to a snapshot.
+ *
+ * The snapshot is written to a temporary file which is then renamed over path. Processes that already mapped
+ * a previous snapshot keep their (now unlinked) copy, and readers never observe a partially written file.
+ *
+ * @param path      The path of the snapshot file.
+ * @param data      The static categories to persist. Every one of them must hold a built table.
+ * @param version   The latest game version, used as the snapshot key.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the snapshot could not be written.
+ */
+int snapshot_write(char* path, uint16_t data, const char* version)
+{
+    struct snapshot_header header;
+    char tmp[PATH_MAX];
+
+    if (version == NULL || snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid()) >= (int)sizeof(tmp)) {
+        return 1;
+    }
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return 1;
+    }
+
+    memset(&header, 0x00, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.format = SNAPSHOT_FORMAT;
+    strncpy(header.version, version, TABLE_VERSION_SIZE - 1);
+
+    uint64_t offset = PAGE_ALIGN(sizeof(header));
+    int failed = 0;
+
+    for (uint16_t cat_index = 1; cat_index <= STATIC_VERSIONS && !failed; cat_index <<= 1) {
+        struct category* cat = GET_CATEGORY(cat_index);
+        if (!(data & cat_index) || cat->__used == 0) continue;
+
+        header.categories |= cat_index;
+        header.tables[(int)get_bit_index(cat_index)].offset = offset;
+        header.tables[(int)get_bit_index(cat_index)].size = cat->__used;
+
+        failed = pwrite(fd, cat->__first_page, cat->__used, offset) != cat->__used;
+        offset += PAGE_ALIGN(cat->__used);
+    }
+
+    // The header is written last and the file is padded so that every table can be mapped in full pages.
+    failed = failed || pwrite(fd, &header, sizeof(header), 0) != sizeof(header) || ftruncate(fd, offset) != 0;
+    failed = close(fd) != 0 || failed;
+
+    if (failed || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_SNAPSHOT_H
+#define CCHAMP_SNAPSHOT_H
+#include <inttypes.h>
+#include "tables.h"
+
+/*
+ * A snapshot persists the binary tables of static categories to a file, so that other processes can map them
+ * directly instead of downloading and parsing the data again.
+ *
+ *  +-----------------+---------+---------+-----+
+ *  | snapshot_header | table 0 | table 1 | ... |
+ *  +-----------------+---------+---------+-----+
+ *
+ * The header and every table start on a page boundary so that each table can be mmaped on its own.
+ * A snapshot is keyed by the latest game version (STATIC_VERSIONS) at the time it was written.
+ */
+#define SNAPSHOT_MAGIC      0x4e534343
+
+// Bump whenever the layout of struct static_table or of a table kind changes.
+#define SNAPSHOT_FORMAT     3
+
+struct snapshot_header {
+    uint32_t    magic;
+    uint32_t    format;
+
+    // The STATIC_* constants of the categories present in the snapshot.
+    uint16_t    categories;
+
+    char        version[TABLE_VERSION_SIZE];
+
+    struct {
+        uint64_t offset;
+        uint64_t size;
+    } tables[STATIC_CATEGORY_SIZE];
+};
+
+
+/*
+ * Maps the requested categories found in the snapshot at path directly into shadow categories.
+ */
+uint16_t    snapshot_map(char* path, uint16_t data, const char* version, struct category* shadows);
+
+/*
+ * Writes the tables of the specified categories to a snapshot at path.
+ */
+int         snapshot_write(char* path, uint16_t data, const char* version);
+
+#endif
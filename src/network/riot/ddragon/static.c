@@ -13,9 +13,21 @@
  * You should have received a copy of the GNU General Public License
  * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
  */
+#define _GNU_SOURCE
 #include "static.h"
+#include "tables.h"
+#include "snapshot.h"
+#include "phash.h"
+#include "bitset.h"
 #include <sys/mman.h>
+#include <cchamp_mmap.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <cJSON.h>
+#include <cchamp/cchamp.h>
+#include <network/riot/api.h>
 
 /*
  * Using the STATIC_* constants defined in <cchamp/cchamp.h>, You may read this variable's bits to determine
@@ -24,38 +36,165 @@
 static uint16_t valid;
 struct category* categories;
 
+/*
+ * The pages of a category that was never loaded: an empty table, shared by all of them, so that readers never
+ * find a category without a first page. Categories are only mapped when they are first loaded.
+ */
+static const struct static_table unloaded;
+
+/*
+ * Categories are double-buffered. A load builds every new table into a shadow category that readers cannot
+ * see, and validation publishes it by atomically swapping the first page pointer of the category.
+ *
+ * Readers announce themselves with cchamp_static_read_lock(). The pages a category held before a swap are only
+ * unmapped once every reader that could have observed them has unlocked (the grace period).
+ */
+static struct category shadows[STATIC_CATEGORY_SIZE];
+static pthread_mutex_t writer = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Readers are counted per epoch parity. Counters are striped over separate cache lines so that concurrent
+ * readers on different threads do not contend on a single counter.
+ */
+#define READER_STRIPES  16
+#define CACHE_LINE      64
+
+static struct {
+    long count;
+    char __padding[CACHE_LINE - sizeof(long)];
+} readers[2][READER_STRIPES] __attribute__((aligned(CACHE_LINE)));
+
+static unsigned long epoch;
+static __thread int stripe = -1;
+static int stripes_assigned;
+
+/*
+ * Pages replaced by a publication, waiting for the grace period to end.
+ */
+struct retired {
+    void*   addr;
+    int     pages;
+};
+
+// The snapshot file shared between processes; NULL if snapshots are disabled.
+static char* snapshot;
+
 // Page status operations
 #define PAGE_STATUS_VALIDATE    0x00
 #define PAGE_STATUS_INVALIDATE  0x01
 
 /*
- * Number of Anonymous pages to be backed for specific static api categories.
- * This number is determined by estimating the maximum required data storage of a specific category.
- */
-#define PAGES_RUNES            8
-#define PAGES_MASTERIES        8
-#define PAGES_CHAMPIONS        8
-#define PAGES_ITEMS            8
-#define PAGES_MAPS             8
-#define PAGES_PROFILE_ICONS    8
-#define PAGES_REALMS           8
-#define PAGES_SUMMONER_SPELLS  8
-#define PAGES_LANGUAGES        8
-#define PAGES_VERSIONS         8
-
-static int __categories_pages[] = {
-    PAGES_RUNES,
-    PAGES_MASTERIES,
-    PAGES_CHAMPIONS,
-    PAGES_ITEMS,
-    PAGES_MAPS,
-    PAGES_PROFILE_ICONS,
-    PAGES_REALMS,
-    PAGES_SUMMONER_SPELLS,
-    PAGES_LANGUAGES,
-    PAGES_VERSIONS
+ * A binary table is always smaller than the JSON it was parsed from. Before a category is built, its pages are
+ * resized to (payload / PAGES_PAYLOAD_RATIO), which avoids most of the growth steps during the build.
+ */
+#define PAGES_PAYLOAD_RATIO    4
+
+#define PAGES_FOR(size)        (((size) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+/*
+ * The static-data API path of every category, respective to the bit index of the STATIC_* constants.
+ */
+static char* __categories_paths[] = {
+    "/runes",
+    "/masteries",
+    "/champions",
+    "/items",
+    "/maps",
+    "/profile-icons",
+    "/realms",
+    "/summoner-spells",
+    "/languages",
+    "/versions"
+};
+
+/*
+ * Additional data ("tags" query arguments) required to build the binary table of a category.
+ * Categories without an entry only need the default data returned by the server.
+ */
+#define TAGS_MAX 5
+
+static char* __categories_tags[STATIC_CATEGORY_SIZE][TAGS_MAX] = {
+    [2] = { "tags" },
+    [3] = { "gold", "maps", "plaintext", "stats", "tags" }
+};
+
+/*
+ * The key of every category in the "n" object of the realms data, which holds the current data version of
+ * each category. Categories without a key are assumed to change with every new game version.
+ */
+static char* __categories_realms[] = {
+    "n.rune",
+    "n.mastery",
+    "n.champion",
+    "n.item",
+    "n.map",
+    "n.profileicon",
+    NULL,
+    "n.summoner",
+    "n.language",
+    NULL
 };
 
+/*
+ * The ETag of the published data of every category, sent along with its next request so that the server may
+ * answer 304 (Not Modified) instead of the full data. Empty if the published data did not come from the server.
+ */
+static char etags[STATIC_CATEGORY_SIZE][REQUEST_ETAG_SIZE];
+
+// Returned by __static_category_load() if the published data of a category is still current.
+#define CATEGORY_NOT_MODIFIED   -1
+
+static Request request;
+
+/**
+ * Remaps the pages of a category to exactly the given number of pages.
+ * The pages may move, but their content (up to the smaller of both sizes) is preserved.
+ *
+ * @param cat   The category to resize.
+ * @param pages The new number of pages. Never less than 1.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the remapping failed. The category is left untouched in that case.
+ */
+static int __static_pages_resize(struct category* cat, int pages)
+{
+    if (pages < 1) pages = 1;
+    if (pages == cat->__pages_size) return 0;
+
+    void* addr = mremap(cat->__first_page, cat->__pages_size * PAGE_SIZE, pages * PAGE_SIZE, MREMAP_MAYMOVE);
+    if (addr == MAP_FAILED) {
+        return 1;
+    }
+
+    if (pages > cat->__pages_size) {
+        mmap_advise(addr, pages * PAGE_SIZE, cat->__pages_size * PAGE_SIZE);
+    }
+
+    cat->__first_page = addr;
+    cat->__pages_size = pages;
+    return 0;
+}
+
+/**
+ * Waits until no reader can hold a reference to pages that were unpublished before this call.
+ *
+ * Readers increment the counter of the epoch parity they observed before reading any first page pointer.
+ * Flipping the parity and draining the previous counter twice guarantees that both counters have been seen
+ * empty after the unpublication, including readers that observed a parity just before it was flipped.
+ */
+static void __static_synchronize()
+{
+    for (int flip = 0; flip < 2; flip++) {
+        unsigned long drain = __atomic_fetch_add(&epoch, 1, __ATOMIC_SEQ_CST) & 1;
+
+        for (int i = 0; i < READER_STRIPES; i++) {
+            while (__atomic_load_n(&readers[drain][i].count, __ATOMIC_SEQ_CST) != 0) {
+                sched_yield();
+            }
+        }
+    }
+}
+
 /**
  * Handles validation and invalidation of static categories.
  * Should not be invoked directly.
@@ -65,37 +204,127 @@ static int __categories_pages[] = {
  */
 static void __static_pages_status(uint16_t data, char op)
 {
+    struct retired retired[STATIC_CATEGORY_SIZE];
+    int retired_size = 0;
+
     // Although only internally invoked, it is safer to check for data correctness.
     if (op != PAGE_STATUS_INVALIDATE && op != PAGE_STATUS_VALIDATE) {
         return;
     }
 
     uint16_t cat_index = 1;
-    while (cat_index <= data) {
+    while (cat_index <= data && cat_index <= STATIC_VERSIONS) {
 
         /*
          * Handles both validation and invaidation operations.
          *
-         * On invalidation, all corresponding pages protection must be overriden to allow writing on top of
-         * reading. This is to allow for future calls to load data into the pages.
+         * On invalidation, the category is only marked as stale. Readers keep being served the published
+         * pages until a load validates new ones.
          *
-         * On validation, it is understood that the data is now considered final. Hence, the memory protection
-         * for the pages is overriden to be read-only.
+         * On validation, it is understood that the data in the shadow of the category is now considered final.
+         * Its lookup indexes and bitsets are built (snapshots already hold theirs), the memory protection for
+         * the shadow pages is overriden to be read-only and the shadow is published in place of the current
+         * pages, which are retired.
          */
         if (data & cat_index) {
             struct category* cat = GET_CATEGORY(cat_index);
-            int prot = op == PAGE_STATUS_VALIDATE ? PROT_READ : PROT_WRITE | PROT_READ;
-            mprotect(cat->__first_page, cat->__init_pages_size * PAGE_SIZE, prot);
+            struct category* shadow = shadows + get_bit_index(cat_index);
+
+            if (op == PAGE_STATUS_VALIDATE && shadow->__first_page != NULL) {
+                if (!shadow->__snapshot) {
+                    phash_build(cat_index, shadow);
+                    bitset_build(cat_index, shadow);
+                    __static_pages_resize(shadow, PAGES_FOR(shadow->__used));
+                }
+
+                mprotect(shadow->__first_page, shadow->__pages_size * PAGE_SIZE, PROT_READ);
+
+                retired[retired_size].addr = cat->__first_page;
+                retired[retired_size].pages = cat->__pages_size;
+                retired_size++;
 
-            if (op == PAGE_STATUS_VALIDATE) {
-                valid |= cat_index;
+                cat->__pages_size = shadow->__pages_size;
+                cat->__used = shadow->__used;
+                cat->__snapshot = shadow->__snapshot;
+                __atomic_store_n(&cat->__first_page, shadow->__first_page, __ATOMIC_SEQ_CST);
+
+                memset(shadow, 0x00, sizeof(struct category));
+                __atomic_or_fetch(&valid, cat_index, __ATOMIC_SEQ_CST);
             } else if (op == PAGE_STATUS_INVALIDATE) {
-                valid &= ~cat_index;
+                __atomic_and_fetch(&valid, ~cat_index, __ATOMIC_SEQ_CST);
             }
         }
 
         cat_index <<= 1;
     }
+
+    // A single grace period covers every category published by this validation.
+    if (retired_size != 0) {
+        __static_synchronize();
+    }
+
+    for (int i = 0; i < retired_size; i++) {
+        if (retired[i].addr != &unloaded) {
+            munmap(retired[i].addr, retired[i].pages * PAGE_SIZE);
+        }
+    }
+}
+
+/**
+ * Maps fresh anonymous pages for the shadow of a category, in which a new table can be built.
+ *
+ * @param cat_index The STATIC_* constant of the category.
+ *
+ * @return The shadow category; or <br>
+ *         NULL if the anonymous pages could not be mapped.
+ */
+static struct category* __static_shadow_create(uint16_t cat_index)
+{
+    struct category* shadow = shadows + get_bit_index(cat_index);
+
+    shadow->__init_pages_size = GET_CATEGORY(cat_index)->__init_pages_size;
+    shadow->__pages_size = shadow->__init_pages_size;
+    shadow->__used = 0;
+    shadow->__snapshot = 0;
+    shadow->__first_page = mmap_anonymous(shadow->__pages_size * PAGE_SIZE, 0);
+
+    if (shadow->__first_page == MAP_FAILED) {
+        memset(shadow, 0x00, sizeof(struct category));
+        return NULL;
+    }
+
+    return shadow;
+}
+
+/**
+ * Unmaps the shadow of a category that will not be published.
+ *
+ * @param cat_index The STATIC_* constant of the category.
+ */
+static void __static_shadow_discard(uint16_t cat_index)
+{
+    struct category* shadow = shadows + get_bit_index(cat_index);
+
+    if (shadow->__first_page != NULL) {
+        munmap(shadow->__first_page, shadow->__pages_size * PAGE_SIZE);
+    }
+
+    memset(shadow, 0x00, sizeof(struct category));
+}
+
+/**
+ * The latest game version, as reported by the STATIC_VERSIONS category.
+ *
+ * @return The version string; or <br>
+ *         NULL if STATIC_VERSIONS is not loaded.
+ */
+static const char* __static_version()
+{
+    if (!(valid & STATIC_VERSIONS)) {
+        return NULL;
+    }
+
+    return ((struct static_table *)GET_FIRST_PAGE(STATIC_VERSIONS))->version;
 }
 
 /**
@@ -120,52 +349,53 @@ static void __static_pages_free()
 {
     struct category* cat = categories;
 
+    for (uint16_t cat_index = 1; cat_index <= STATIC_VERSIONS; cat_index <<= 1) {
+        __static_shadow_discard(cat_index);
+    }
+
     for (int i = 0; i < STATIC_CATEGORY_SIZE; cat++, i++) {
-        if (cat->__first_page != NULL && cat->__first_page != MAP_FAILED) {
+        if (cat->__first_page != NULL && cat->__first_page != &unloaded) {
 
             // free the anonymous pages backed for this category.
-            munmap(cat->__first_page, cat->__init_pages_size * PAGE_SIZE);
+            munmap(cat->__first_page, cat->__pages_size * PAGE_SIZE);
         }
     }
 
     // all pages backed by the categories have now been freed. It is possible to free the headers
     // that track these pages.
     free(categories);
+    categories = NULL;
+    valid = 0;
+    memset(etags, 0x00, sizeof(etags));
 }
 
 /**
- * Memory maps a sufficient amount of anonymous pages for static categories.
- * The number of anonymous backing pages per static category is determined by __categories_pages config
- * array in this file.
+ * Prepares the headers that keep track of the pages of the static categories.
+ * No page is mapped until a category is loaded: every category starts out on the shared unloaded table, and is
+ * built into CCHAMP_CONFIG_STATIC_PAGES anonymous pages at first (see __static_shadow_create()).
  *
- * @return A non-zero, positive number of how many bytes were allocated.
- *         0    Failure in mmaping anonymous pages.
+ * @return The size (in bytes) of the headers; or <br>
+ *         0 if they could not be allocated.
  */
 static int __static_pages_allocate()
 {
 
     // Allocate, on the heap, the necessary headers for keeping track of the anonymous pages.
-    categories = (struct category *)malloc(sizeof(struct category) * STATIC_CATEGORY_SIZE);
+    categories = (struct category *)calloc(STATIC_CATEGORY_SIZE, sizeof(struct category));
+    if (categories == NULL) {
+        return 0;
+    }
+
     struct category* cat = categories;
-    int pages_alloc = 0;
 
     for (int i = 0; i < STATIC_CATEGORY_SIZE; cat++, i++) {
-        cat->__init_pages_size = __categories_pages[i];
-        cat->__first_page = mmap(NULL,
-                                 cat->__init_pages_size * PAGE_SIZE,
-                                 PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-
-        // if the anonymous page mapping failed, then an error indicating value is returned.
-        // errno should be read instead of cc_error in this case as mmap() sets errno on failure.
-        if (cat->__first_page == MAP_FAILED) {
-            __static_pages_free();
-            return 0;
-        }
-
-        pages_alloc += cat->__init_pages_size;
+        cat->__init_pages_size = cchamp_config_get_int(CCHAMP_CONFIG_STATIC_PAGES);
+        cat->__pages_size = 0;
+        cat->__used = 0;
+        cat->__first_page = (void *)&unloaded;
     }
 
-    return pages_alloc * PAGE_SIZE;
+    return STATIC_CATEGORY_SIZE * sizeof(struct category);
 }
 
 /**
@@ -178,27 +408,331 @@ void cchamp_static_invalidate(uint16_t data)
 {
 
     /*
-     * The corresponding anonymous pages are not affected by this invocation.
-     * Anonymous pages are kept in memory throughout the whole life cycle of cchamp.
+     * The corresponding pages are not affected by this invocation.
+     * Readers keep being served the current data until a load publishes its replacement.
      */
 
     __static_pages_status(data, PAGE_STATUS_INVALIDATE);
 }
 
+/**
+ * Fetches a single static category and writes its binary table into the shadow of the category.
+ * The published pages of the category are not touched; the table becomes visible once validated.
+ *
+ * The request is conditional if the published data came from the server, in which case the server only
+ * responds with data that changed since.
+ *
+ * @param cat_index The STATIC_* constant of the category.
+ *
+ * @return The size (in bytes) of the table written; or <br>
+ *         CATEGORY_NOT_MODIFIED if the published data is still current; or <br>
+ *         0 if the category could not be fetched or does not fit in its pages.
+ */
+static int __static_category_load(uint16_t cat_index)
+{
+    char** tags = __categories_tags[(int)get_bit_index(cat_index)];
+
+    // Flush the request in preparation for new values.
+    memset(&request, 0x00, sizeof(Request));
+    memcpy(request.etag, etags[(int)get_bit_index(cat_index)], REQUEST_ETAG_SIZE);
+
+    request.api = API_LOL_STATIC_DATA;
+    request.region = REGION_NA;
+    request.arguments.path.head = path_qualifier(&request, __categories_paths[(int)get_bit_index(cat_index)], NULL);
+
+    for (int i = 0; i < TAGS_MAX && tags[i] != NULL; i++) {
+        request.arguments.query.head = query_arg(&request, "tags", tags[i], request.arguments.query.head);
+    }
+
+    cchamp_send_request(&request);
+
+    int size = 0;
+    struct category* shadow;
+    if (request.http_code == 304) {
+        size = CATEGORY_NOT_MODIFIED;
+    } else if (request.http_code == 200 && (shadow = __static_shadow_create(cat_index)) != NULL) {
+        __static_pages_resize(shadow, PAGES_FOR(request.response.size / PAGES_PAYLOAD_RATIO));
+
+        // The JSON document is only needed until the binary table has been written.
+        cJSON* json = cJSON_Parse(request.response.addr);
+        size = table_build(cat_index, json, shadow);
+        cJSON_Delete(json);
+
+        // Give back whatever the estimate over-provisioned.
+        if (size != 0) {
+            __static_pages_resize(shadow, PAGES_FOR(size));
+            shadow->__used = size;
+            memcpy(etags[(int)get_bit_index(cat_index)], request.etag, REQUEST_ETAG_SIZE);
+        } else {
+            __static_shadow_discard(cat_index);
+        }
+    }
+
+    channel_clean(&request);
+    return size;
+}
+
 /**
  * Loads the specified static data into memory.
+ * Only categories that were fetched and parsed successfully are validated.
+ *
+ * If a snapshot is configured, categories present in it are mapped straight from the file and never reach
+ * the server. Whatever had to be fetched is then written back to the snapshot for other processes.
  */
 void cchamp_static_load(uint16_t data)
 {
-    // Invalidate all pages that are about to be updated to prevent access until the load is complete.
+    pthread_mutex_lock(&writer);
+
+    // Mark the categories as stale. Readers keep being served the current pages until the load completes.
     cchamp_static_invalidate(data);
+
+    uint16_t loaded = 0;
+    uint16_t unchanged = 0;
+    uint16_t fetch = data;
+    if (snapshot != NULL) {
+        loaded = snapshot_map(snapshot, data, __static_version(), shadows);
+        fetch &= ~loaded;
+
+        for (uint16_t cat_index = 1; cat_index <= loaded && cat_index <= STATIC_VERSIONS; cat_index <<= 1) {
+            if (loaded & cat_index) etags[(int)get_bit_index(cat_index)][0] = 0x00;
+        }
+
+        // A snapshot is keyed by the latest game version, which must be known before one can be written.
+        if (fetch != 0 && !(valid & STATIC_VERSIONS)) {
+            fetch |= STATIC_VERSIONS;
+        }
+    }
+
+    for (uint16_t cat_index = 1; cat_index <= fetch && cat_index <= STATIC_VERSIONS; cat_index <<= 1) {
+        if (!(fetch & cat_index)) continue;
+
+        int size = __static_category_load(cat_index);
+        if (size == CATEGORY_NOT_MODIFIED) {
+            unchanged |= cat_index;
+        } else if (size != 0) {
+            loaded |= cat_index;
+        }
+    }
+
+    __static_pages_validate(loaded);
+
+    // The published data of these categories was confirmed current by the server; it is valid as it stands.
+    __atomic_or_fetch(&valid, unchanged, __ATOMIC_SEQ_CST);
+
+    if (snapshot != NULL && (loaded & fetch) != 0) {
+        snapshot_write(snapshot, valid, __static_version());
+    }
+
+    pthread_mutex_unlock(&writer);
+}
+
+/**
+ * Finds the categories whose published data is older than the data version reported by the realms data.
+ *
+ * @param realms    The realms table.
+ * @param data      The categories to check.
+ *
+ * @return The stale categories among data.
+ */
+static uint16_t __static_stale(const struct static_table* realms, uint16_t data)
+{
+    uint16_t stale = 0;
+
+    for (uint16_t cat_index = 1; cat_index <= data && cat_index <= STATIC_VERSIONS; cat_index <<= 1) {
+        if (!(data & cat_index)) continue;
+
+        const struct static_table* table = (const struct static_table *)GET_FIRST_PAGE(cat_index);
+        const char* key = __categories_realms[(int)get_bit_index(cat_index)];
+        uint32_t row = 0;
+
+        while (key != NULL && row < realms->count
+                && strcmp(TABLE_STRING(realms, TABLE_COLUMN(realms, uint32_t, PAIR_KEY)[row]), key) != 0) {
+            row++;
+        }
+
+        if (key == NULL || row == realms->count || table->magic != TABLE_MAGIC
+                || strcmp(TABLE_STRING(realms, TABLE_COLUMN(realms, uint32_t, PAIR_VALUE)[row]), table->version) != 0) {
+            stale |= cat_index;
+        }
+    }
+
+    return stale;
+}
+
+/**
+ * Brings the loaded static categories up to date with the server, at the lowest possible request cost.
+ *
+ * STATIC_VERSIONS is polled with a conditional request, which costs no data transfer while the game version
+ * does not change. Once a new game version appears, the realms data tells which categories changed, and only
+ * those are fetched and published. Readers are never stalled, as with cchamp_static_load().
+ *
+ * @return The categories that were published.
+ */
+uint16_t static_refresh()
+{
+    pthread_mutex_lock(&writer);
+
+    uint16_t loaded = 0;
+    uint16_t current = valid & ~(STATIC_VERSIONS | STATIC_REALMS);
+    const struct static_table* versions;
+    const struct static_table* realms;
+
+    if (categories == NULL || __static_category_load(STATIC_VERSIONS) <= 0) {
+        pthread_mutex_unlock(&writer);
+        return 0;
+    }
+
+    // A new ETag does not necessarily mean a new game version.
+    versions = (const struct static_table *)shadows[(int)get_bit_index(STATIC_VERSIONS)].__first_page;
+    if (__static_version() != NULL && strcmp(versions->version, __static_version()) == 0) {
+        __static_shadow_discard(STATIC_VERSIONS);
+        pthread_mutex_unlock(&writer);
+        return 0;
+    }
+
+    loaded |= STATIC_VERSIONS;
+
+    int size = __static_category_load(STATIC_REALMS);
+    if (size > 0) {
+        loaded |= STATIC_REALMS;
+        realms = (const struct static_table *)shadows[(int)get_bit_index(STATIC_REALMS)].__first_page;
+    } else if (size == CATEGORY_NOT_MODIFIED && (valid & STATIC_REALMS)) {
+        realms = (const struct static_table *)GET_FIRST_PAGE(STATIC_REALMS);
+    } else {
+        realms = NULL;
+    }
+
+    // Without the realms data, every category is assumed to have changed.
+    uint16_t stale = realms != NULL ? __static_stale(realms, current) : current;
+
+    for (uint16_t cat_index = 1; cat_index <= stale && cat_index <= STATIC_VERSIONS; cat_index <<= 1) {
+        if ((stale & cat_index) && __static_category_load(cat_index) > 0) {
+            loaded |= cat_index;
+        }
+    }
+
+    __static_pages_validate(loaded);
+
+    if (snapshot != NULL) {
+        snapshot_write(snapshot, valid, __static_version());
+    }
+
+    pthread_mutex_unlock(&writer);
+    return loaded;
+}
+
+/**
+ * Enters a static data read-side critical section.
+ * Pages observed inside the section are not unmapped before the matching cchamp_static_read_unlock().
+ *
+ * @return The lock token to hand back to cchamp_static_read_unlock().
+ */
+int cchamp_static_read_lock()
+{
+    if (stripe < 0) {
+        stripe = __atomic_fetch_add(&stripes_assigned, 1, __ATOMIC_RELAXED) % READER_STRIPES;
+    }
+
+    int parity = __atomic_load_n(&epoch, __ATOMIC_SEQ_CST) & 1;
+    __atomic_add_fetch(&readers[parity][stripe].count, 1, __ATOMIC_SEQ_CST);
+
+    return parity * READER_STRIPES + stripe;
+}
+
+/**
+ * Leaves a static data read-side critical section.
+ *
+ * @param lock The token returned by the matching cchamp_static_read_lock().
+ */
+void cchamp_static_read_unlock(int lock)
+{
+    __atomic_sub_fetch(&readers[lock / READER_STRIPES][lock % READER_STRIPES].count, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Configures the snapshot file used to share parsed static data between processes.
+ *
+ * @param path The path of the snapshot file; NULL disables snapshots.
+ */
+void cchamp_static_snapshot(char* path)
+{
+    free(snapshot);
+    snapshot = path == NULL ? NULL : strdup(path);
+}
+
+/**
+ * Reports the memory held by the specified static categories.
+ *
+ * @param data The static categories to report on.
+ *
+ * @return The size (in bytes) of the pages backing the categories.
+ */
+size_t cchamp_static_size(uint16_t data)
+{
+    size_t size = 0;
+    if (categories == NULL) return 0;
+
+    for (uint16_t cat_index = 1; cat_index <= data && cat_index <= STATIC_VERSIONS; cat_index <<= 1) {
+        if (data & cat_index) {
+            size += (size_t)GET_CATEGORY(cat_index)->__pages_size * PAGE_SIZE;
+        }
+    }
+
+    return size;
+}
+
+/**
+ * Reports the memory held by the static categories, including the shadows of a load in progress.
+ *
+ * @param reserved  Receives the size (in bytes) of the pages mapped for the categories.
+ * @param committed Receives the size (in bytes) of the anonymous ones among them; snapshot pages are file-backed.
+ */
+void static_pages_stats(size_t* reserved, size_t* committed)
+{
+    *reserved = 0;
+    *committed = 0;
+    if (categories == NULL) return;
+
+    for (int i = 0; i < STATIC_CATEGORY_SIZE; i++) {
+        struct category* cats[] = { categories + i, shadows + i };
+
+        for (int j = 0; j < 2; j++) {
+            size_t size = (size_t)__atomic_load_n(&cats[j]->__pages_size, __ATOMIC_RELAXED) * PAGE_SIZE;
+
+            *reserved += size;
+            *committed += cats[j]->__snapshot ? 0 : size;
+        }
+    }
+}
+
+/**
+ * Grows the pages of a category so that they hold at least size bytes.
+ * Growth is geometric so that a table written incrementally is only remapped a logarithmic number of times.
+ *
+ * @param cat   The category to grow.
+ * @param size  The minimum number of bytes required.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the pages could not be grown.
+ */
+int static_pages_grow(struct category* cat, size_t size)
+{
+    int pages = PAGES_FOR(size);
+    if (pages <= cat->__pages_size) return 0;
+
+    if (pages < cat->__pages_size * 2) {
+        pages = cat->__pages_size * 2;
+    }
+
+    return __static_pages_resize(cat, pages);
 }
 
 /**
  * Acquires memory for the storage of static data.
  *
  * @return  The size (in bytes) of memory allocated; or <br>
- *          0 if categories has already been allocated.
+ *          0 if categories has already been allocated; or <br>
+ *          -1 if the memory could not be allocated.
  */
 int static_pages_allocate()
 {
@@ -209,7 +743,8 @@ int static_pages_allocate()
         return 0;
     }
 
-    return __static_pages_allocate();
+    int size = __static_pages_allocate();
+    return size != 0 ? size : -1;
 }
 
 /**
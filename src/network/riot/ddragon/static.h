@@ -16,6 +16,7 @@
 #ifndef CCHAMP_STATIC_H
 #define CCHAMP_STATIC_H
 #include <inttypes.h>
+#include <stddef.h>
 #include <cchamp_utils.h>
 
 // The number of data categories accessible by the static API.
@@ -26,11 +27,17 @@
  * the static API.
  *
  * A category struct is in charge of:
- *  - declaring how many pages are to be allocated for the specifc category
+ *  - declaring how many pages are to be allocated for the specifc category when it is first loaded
+ *  - tracking how many pages are currently mapped (none until it is loaded), as categories are resized to fit
+ *    their data
  *  - Store the pointer to the first page of data.
+ *  - tracking whether the pages are mapped from a snapshot file rather than anonymous memory.
  */
 struct category {
     int     __init_pages_size;
+    int     __pages_size;
+    int     __used;
+    int     __snapshot;
     void*   __first_page;
 };
 
@@ -46,16 +53,22 @@ extern struct category* categories;
 /*
  * Thanks to the contiguous and respective manner assumption, accessing the first data page ptr is constant time.
  *
- * For GET_FIRST_PAGE, a NULL ptr is expected if the categories bit for the specific category flag is cleared.
+ * The first page ptr is swapped atomically whenever new data is published. Readers must only dereference it
+ * between cchamp_static_read_lock() and cchamp_static_read_unlock().
  */
 #define GET_CATEGORY(category)      (categories + get_bit_index(category))
-#define GET_FIRST_PAGE(category)    (void *)(GET_CATEGORY(category)->__first_page)
+#define GET_FIRST_PAGE(category)    __atomic_load_n(&GET_CATEGORY(category)->__first_page, __ATOMIC_ACQUIRE)
 
 void cchamp_static_load(uint16_t data);
 void cchamp_static_invalidate(uint16_t data);
+size_t cchamp_static_size(uint16_t data);
+void cchamp_static_snapshot(char* path);
+int cchamp_static_refresh(unsigned int interval);
+int cchamp_static_read_lock();
+void cchamp_static_read_unlock(int lock);
 
 /*
- * Maps all necessary pages for the static API.
+ * Prepares the static categories; their pages are only mapped when they are loaded.
  */
 int static_pages_allocate();
 
@@ -64,4 +77,19 @@ int static_pages_allocate();
  */
 void static_pages_free();
 
+/*
+ * Reports the memory reserved and committed by the static categories.
+ */
+void static_pages_stats(size_t* reserved, size_t* committed);
+
+/*
+ * Grows the pages of a category to hold at least size bytes. The pages may move.
+ */
+int static_pages_grow(struct category* cat, size_t size);
+
+/*
+ * Fetches and publishes the loaded categories that changed on the server (see refresh.c).
+ */
+uint16_t static_refresh();
+
 #endif
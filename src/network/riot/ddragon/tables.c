@@ -0,0 +1,818 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cchamp/cchamp.h>
+#include "static.h"
+#include "tables.h"
+#include "phash.h"
+#include "bitset.h"
+
+#define TABLE_ALIGNMENT 8
+#define ALIGN(size)     (((size) + TABLE_ALIGNMENT - 1) & ~(TABLE_ALIGNMENT - 1))
+
+// Returned by __table_reserve() and __table_intern() when the category pages are exhausted.
+#define TABLE_NOSPACE   UINT32_MAX
+
+/*
+ * Tracks the state of a table while it is being written.
+ *
+ * Strings are interned through a small open-addressing hash set that stores (pool offset + 1) of every
+ * string written so far. The set only lives for the duration of the build.
+ *
+ * The category pages are grown whenever the table outgrows them, which may move them. Hence, builder->table
+ * must be re-read after every reservation and never be cached across one.
+ */
+struct table_builder {
+    struct category*     cat;
+    struct static_table* table;
+    uint32_t    used;
+
+    uint32_t*   interned;
+    uint32_t    interned_size;
+    uint32_t    interned_count;
+
+    const char* tags[TABLE_TAGS_MAX];
+    const char* stats[TABLE_STATS_MAX];
+};
+
+
+/**
+ * FNV-1a hash of a null-terminated string.
+ *
+ * @param str The string to hash.
+ *
+ * @return The 32-bit hash of the string.
+ */
+static uint32_t __table_hash(const char* str)
+{
+    uint32_t hash = 2166136261u;
+    while (*str) {
+        hash ^= (uint8_t)*str++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+/**
+ * Reserves bytes at the end of the table, growing the category pages if needed.
+ *
+ * @param builder   The table being written.
+ * @param size      The number of bytes to reserve.
+ *
+ * @return The offset of the reserved bytes from the start of the table; or <br>
+ *         TABLE_NOSPACE if the category pages could not be grown.
+ */
+static uint32_t __table_reserve(struct table_builder* builder, size_t size)
+{
+    if (builder->used + size > (size_t)builder->cat->__pages_size * PAGE_SIZE) {
+        if (static_pages_grow(builder->cat, builder->used + size)) {
+            return TABLE_NOSPACE;
+        }
+
+        builder->table = (struct static_table *)builder->cat->__first_page;
+    }
+
+    uint32_t offset = builder->used;
+    builder->used += size;
+    return offset;
+}
+
+
+/**
+ * Writes a string into the pool, unless an identical string has already been written.
+ * The pool must be the last region of the table when this is invoked.
+ *
+ * @param builder   The table being written.
+ * @param str       The string to intern. NULL is interned as the empty string.
+ *
+ * @return The offset of the string inside the pool; or <br>
+ *         TABLE_NOSPACE if the category pages are exhausted.
+ */
+static uint32_t __table_intern(struct table_builder* builder, const char* str)
+{
+    struct static_table* table = builder->table;
+    if (str == NULL) {
+        str = "";
+    }
+
+    // Keep the load factor of the set under 50% so that probe sequences stay short.
+    if (builder->interned_count * 2 >= builder->interned_size) {
+        uint32_t size = builder->interned_size == 0 ? 256 : builder->interned_size * 2;
+        uint32_t* interned = calloc(size, sizeof(uint32_t));
+        if (interned == NULL) {
+            return TABLE_NOSPACE;
+        }
+
+        for (uint32_t i = 0; i < builder->interned_size; i++) {
+            uint32_t entry = builder->interned[i];
+            if (entry == 0) continue;
+
+            uint32_t slot = __table_hash(TABLE_STRING(table, entry - 1)) & (size - 1);
+            while (interned[slot] != 0) {
+                slot = (slot + 1) & (size - 1);
+            }
+            interned[slot] = entry;
+        }
+
+        free(builder->interned);
+        builder->interned = interned;
+        builder->interned_size = size;
+    }
+
+    uint32_t slot = __table_hash(str) & (builder->interned_size - 1);
+    while (builder->interned[slot] != 0) {
+        uint32_t entry = builder->interned[slot];
+        if (strcmp(TABLE_STRING(table, entry - 1), str) == 0) {
+            return entry - 1;
+        }
+        slot = (slot + 1) & (builder->interned_size - 1);
+    }
+
+    size_t len = strlen(str) + 1;
+    uint32_t offset = __table_reserve(builder, len);
+    if (offset == TABLE_NOSPACE) {
+        return TABLE_NOSPACE;
+    }
+
+    table = builder->table;
+    memcpy((char *)table + offset, str, len);
+    table->pool_size += len;
+    builder->interned[slot] = offset - table->pool + 1;
+    builder->interned_count++;
+
+    return offset - table->pool;
+}
+
+
+/**
+ * Lays out the header, the columns and the tag dictionary of a table and opens its string pool.
+ *
+ * @param builder   The table being written.
+ * @param category  The STATIC_* constant of the table.
+ * @param count     The number of records of the table.
+ * @param widths    The size (in bytes) of an element of each column.
+ * @param columns   The number of columns.
+ * @param tags      The number of tags collected in builder->tags.
+ * @param stats     The number of stats collected in builder->stats.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the category pages cannot hold the table.
+ */
+static int __table_layout(struct table_builder* builder, uint16_t category, uint32_t count,
+                          const uint8_t* widths, int columns, int tags, int stats)
+{
+    uint32_t offset;
+    if (__table_reserve(builder, ALIGN(sizeof(struct static_table))) == TABLE_NOSPACE) {
+        return 1;
+    }
+
+    builder->table->magic = TABLE_MAGIC;
+    builder->table->category = category;
+    builder->table->columns = columns;
+    builder->table->count = count;
+
+    for (int i = 0; i < columns; i++) {
+        offset = __table_reserve(builder, ALIGN(widths[i] * count));
+        if (offset == TABLE_NOSPACE) {
+            return 1;
+        }
+
+        builder->table->column[i] = offset;
+        builder->table->width[i] = widths[i];
+        memset((char *)builder->table + offset, 0x00, widths[i] * count);
+    }
+
+    offset = __table_reserve(builder, ALIGN(sizeof(uint32_t) * tags));
+    if (offset == TABLE_NOSPACE) {
+        return 1;
+    }
+
+    builder->table->tags = offset;
+    builder->table->tags_count = tags;
+
+    offset = __table_reserve(builder, ALIGN(sizeof(uint32_t) * stats));
+    if (offset == TABLE_NOSPACE) {
+        return 1;
+    }
+
+    builder->table->stats = offset;
+    builder->table->stats_count = stats;
+
+    offset = __table_reserve(builder, ALIGN(sizeof(float) * stats * count));
+    if (offset == TABLE_NOSPACE) {
+        return 1;
+    }
+
+    builder->table->stats_values = offset;
+    memset((char *)builder->table + offset, 0x00, sizeof(float) * stats * count);
+
+    // Everything from here on is part of the string pool.
+    builder->table->pool = builder->used;
+    builder->table->pool_size = 0;
+
+    for (int i = 0; i < tags; i++) {
+        offset = __table_intern(builder, builder->tags[i]);
+        if (offset == TABLE_NOSPACE) {
+            return 1;
+        }
+
+        ((uint32_t *)((char *)builder->table + builder->table->tags))[i] = offset;
+    }
+
+    for (int i = 0; i < stats; i++) {
+        offset = __table_intern(builder, builder->stats[i]);
+        if (offset == TABLE_NOSPACE) {
+            return 1;
+        }
+
+        ((uint32_t *)((char *)builder->table + builder->table->stats))[i] = offset;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Seals the table by recording its final size.
+ *
+ * @return The number of bytes used by the table.
+ */
+static int __table_finish(struct table_builder* builder)
+{
+    builder->used = ALIGN(builder->used);
+    builder->table->size = builder->used;
+    return builder->used;
+}
+
+
+/**
+ * Copies the data version of a static response into the table header.
+ */
+static void __table_version(struct table_builder* builder, const char* version)
+{
+    if (version != NULL) {
+        strncpy(builder->table->version, version, TABLE_VERSION_SIZE - 1);
+    }
+}
+
+
+/**
+ * Safe accessors for fields of a JSON object. Missing fields read as empty/zero.
+ */
+static const char* __json_string(cJSON* object, const char* key)
+{
+    cJSON* item = cJSON_GetObjectItemCaseSensitive(object, key);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+static int __json_number(cJSON* object, const char* key)
+{
+    cJSON* item = cJSON_GetObjectItemCaseSensitive(object, key);
+    return cJSON_IsNumber(item) ? item->valueint : 0;
+}
+
+
+/**
+ * First pass over the records: collects every distinct tag into the builder's tag dictionary.
+ * Tags beyond TABLE_TAGS_MAX are dropped.
+ *
+ * @return The number of distinct tags.
+ */
+static int __table_collect_tags(struct table_builder* builder, cJSON* records)
+{
+    int count = 0;
+    cJSON* record;
+    cJSON* tag;
+
+    cJSON_ArrayForEach(record, records) {
+        cJSON_ArrayForEach(tag, cJSON_GetObjectItemCaseSensitive(record, "tags")) {
+            if (!cJSON_IsString(tag)) continue;
+
+            int i = 0;
+            while (i < count && strcmp(builder->tags[i], tag->valuestring) != 0) {
+                i++;
+            }
+
+            if (i == count && count < TABLE_TAGS_MAX) {
+                builder->tags[count++] = tag->valuestring;
+            }
+        }
+    }
+
+    return count;
+}
+
+
+/**
+ * First pass over the records: collects every distinct stat into the builder's stat dictionary.
+ * Stats beyond TABLE_STATS_MAX are dropped.
+ *
+ * @return The number of distinct stats.
+ */
+static int __table_collect_stats(struct table_builder* builder, cJSON* records)
+{
+    int count = 0;
+    cJSON* record;
+    cJSON* stat;
+
+    cJSON_ArrayForEach(record, records) {
+        cJSON_ArrayForEach(stat, cJSON_GetObjectItemCaseSensitive(record, "stats")) {
+            if (!cJSON_IsNumber(stat)) continue;
+
+            int i = 0;
+            while (i < count && strcmp(builder->stats[i], stat->string) != 0) {
+                i++;
+            }
+
+            if (i == count && count < TABLE_STATS_MAX) {
+                builder->stats[count++] = stat->string;
+            }
+        }
+    }
+
+    return count;
+}
+
+
+/**
+ * Writes the stats object of a record into the stat columns of its row.
+ */
+static void __table_stats(struct table_builder* builder, cJSON* record, uint32_t row)
+{
+    cJSON* stat;
+
+    cJSON_ArrayForEach(stat, cJSON_GetObjectItemCaseSensitive(record, "stats")) {
+        if (!cJSON_IsNumber(stat)) continue;
+
+        for (uint32_t i = 0; i < builder->table->stats_count; i++) {
+            if (strcmp(builder->stats[i], stat->string) == 0) {
+                TABLE_STAT_COLUMN(builder->table, i)[row] = (float)stat->valuedouble;
+                break;
+            }
+        }
+    }
+}
+
+
+/**
+ * Translates the tags array of a record into a bitmask over the builder's tag dictionary.
+ */
+static uint64_t __table_tags_mask(struct table_builder* builder, cJSON* record)
+{
+    uint64_t mask = 0;
+    cJSON* tag;
+
+    cJSON_ArrayForEach(tag, cJSON_GetObjectItemCaseSensitive(record, "tags")) {
+        if (!cJSON_IsString(tag)) continue;
+
+        for (uint32_t i = 0; i < builder->table->tags_count; i++) {
+            if (strcmp(builder->tags[i], tag->valuestring) == 0) {
+                mask |= (uint64_t)1 << i;
+                break;
+            }
+        }
+    }
+
+    return mask;
+}
+
+
+/*
+ * Interns a string field of a record into a string column. Any failure aborts the current build.
+ */
+#define TABLE_INTERN(builder, col, row, str)                                        \
+    do {                                                                            \
+        uint32_t __offset = __table_intern(builder, str);                           \
+        if (__offset == TABLE_NOSPACE) return 0;                                    \
+        TABLE_COLUMN((builder)->table, uint32_t, col)[row] = __offset;              \
+    } while (0)
+
+
+/**
+ * Builds the STATIC_CHAMPIONS table.
+ */
+static int __table_build_champions(struct table_builder* builder, cJSON* json)
+{
+    static const uint8_t widths[] = { 4, 4, 4, 4, 8 };
+    cJSON* records = cJSON_GetObjectItemCaseSensitive(json, "data");
+    int tags = __table_collect_tags(builder, records);
+
+    if (__table_layout(builder, STATIC_CHAMPIONS, cJSON_GetArraySize(records), widths, 5, tags, 0)) {
+        return 0;
+    }
+
+    __table_version(builder, __json_string(json, "version"));
+
+    uint32_t row = 0;
+    cJSON* record;
+    cJSON_ArrayForEach(record, records) {
+        TABLE_COLUMN(builder->table, uint32_t, CHAMPION_ID)[row] = __json_number(record, "id");
+        TABLE_COLUMN(builder->table, uint64_t, CHAMPION_TAGS)[row] = __table_tags_mask(builder, record);
+        TABLE_INTERN(builder, CHAMPION_KEY, row, __json_string(record, "key"));
+        TABLE_INTERN(builder, CHAMPION_NAME, row, __json_string(record, "name"));
+        TABLE_INTERN(builder, CHAMPION_TITLE, row, __json_string(record, "title"));
+        row++;
+    }
+
+    return __table_finish(builder);
+}
+
+
+/**
+ * Builds the STATIC_ITEMS table.
+ */
+static int __table_build_items(struct table_builder* builder, cJSON* json)
+{
+    static const uint8_t widths[] = { 4, 4, 4, 2, 2, 2, 8, 4 };
+    cJSON* records = cJSON_GetObjectItemCaseSensitive(json, "data");
+    int tags = __table_collect_tags(builder, records);
+    int stats = __table_collect_stats(builder, records);
+
+    if (__table_layout(builder, STATIC_ITEMS, cJSON_GetArraySize(records), widths, 8, tags, stats)) {
+        return 0;
+    }
+
+    __table_version(builder, __json_string(json, "version"));
+
+    uint32_t row = 0;
+    cJSON* record;
+    cJSON_ArrayForEach(record, records) {
+        cJSON* gold = cJSON_GetObjectItemCaseSensitive(record, "gold");
+        cJSON* map;
+        uint32_t maps = 0;
+
+        // Maps are keyed by their id (i.e. {"11": true}); only ids that fit the bitmask are kept.
+        cJSON_ArrayForEach(map, cJSON_GetObjectItemCaseSensitive(record, "maps")) {
+            int id = atoi(map->string);
+            if (cJSON_IsTrue(map) && id >= 0 && id < 32) {
+                maps |= (uint32_t)1 << id;
+            }
+        }
+
+        TABLE_COLUMN(builder->table, uint32_t, ITEM_ID)[row] = __json_number(record, "id");
+        TABLE_COLUMN(builder->table, uint16_t, ITEM_GOLD_BASE)[row] = __json_number(gold, "base");
+        TABLE_COLUMN(builder->table, uint16_t, ITEM_GOLD_TOTAL)[row] = __json_number(gold, "total");
+        TABLE_COLUMN(builder->table, uint16_t, ITEM_GOLD_SELL)[row] = __json_number(gold, "sell");
+        TABLE_COLUMN(builder->table, uint64_t, ITEM_TAGS)[row] = __table_tags_mask(builder, record);
+        TABLE_COLUMN(builder->table, uint32_t, ITEM_MAPS)[row] = maps;
+        __table_stats(builder, record, row);
+        TABLE_INTERN(builder, ITEM_NAME, row, __json_string(record, "name"));
+        TABLE_INTERN(builder, ITEM_PLAINTEXT, row, __json_string(record, "plaintext"));
+        row++;
+    }
+
+    return __table_finish(builder);
+}
+
+
+/**
+ * Builds the STATIC_SUMMONER_SPELLS table.
+ */
+static int __table_build_spells(struct table_builder* builder, cJSON* json)
+{
+    static const uint8_t widths[] = { 4, 4, 4, 4, 2 };
+    cJSON* records = cJSON_GetObjectItemCaseSensitive(json, "data");
+
+    if (__table_layout(builder, STATIC_SUMMONER_SPELLS, cJSON_GetArraySize(records), widths, 5, 0, 0)) {
+        return 0;
+    }
+
+    __table_version(builder, __json_string(json, "version"));
+
+    uint32_t row = 0;
+    cJSON* record;
+    cJSON_ArrayForEach(record, records) {
+        TABLE_COLUMN(builder->table, uint32_t, SPELL_ID)[row] = __json_number(record, "id");
+        TABLE_COLUMN(builder->table, uint16_t, SPELL_LEVEL)[row] = __json_number(record, "summonerLevel");
+        TABLE_INTERN(builder, SPELL_KEY, row, __json_string(record, "key"));
+        TABLE_INTERN(builder, SPELL_NAME, row, __json_string(record, "name"));
+        TABLE_INTERN(builder, SPELL_DESCRIPTION, row, __json_string(record, "description"));
+        row++;
+    }
+
+    return __table_finish(builder);
+}
+
+
+/**
+ * Builds a table of (id, name) records, used by categories that are rarely read.
+ *
+ * @param id    The field holding the id of a record.
+ * @param name  The field holding the name of a record; NULL if records have no name.
+ */
+static int __table_build_named(struct table_builder* builder, uint16_t category, cJSON* json,
+                               const char* id, const char* name)
+{
+    static const uint8_t widths[] = { 4, 4 };
+    cJSON* records = cJSON_GetObjectItemCaseSensitive(json, "data");
+
+    if (__table_layout(builder, category, cJSON_GetArraySize(records), widths, 2, 0, 0)) {
+        return 0;
+    }
+
+    __table_version(builder, __json_string(json, "version"));
+
+    uint32_t row = 0;
+    cJSON* record;
+    cJSON_ArrayForEach(record, records) {
+        TABLE_COLUMN(builder->table, uint32_t, NAMED_ID)[row] = __json_number(record, id);
+        TABLE_INTERN(builder, NAMED_NAME, row, name == NULL ? NULL : __json_string(record, name));
+        row++;
+    }
+
+    return __table_finish(builder);
+}
+
+
+/**
+ * Builds the STATIC_REALMS table.
+ * Every string field becomes a (key, value) record. Nested objects (i.e. "n") are flattened to "n.item".
+ */
+static int __table_build_realms(struct table_builder* builder, cJSON* json)
+{
+    static const uint8_t widths[] = { 4, 4 };
+    char key[64];
+    cJSON* field;
+    cJSON* nested;
+    uint32_t count = 0;
+
+    cJSON_ArrayForEach(field, json) {
+        if (cJSON_IsString(field)) {
+            count++;
+        } else if (cJSON_IsObject(field)) {
+            count += cJSON_GetArraySize(field);
+        }
+    }
+
+    if (__table_layout(builder, STATIC_REALMS, count, widths, 2, 0, 0)) {
+        return 0;
+    }
+
+    __table_version(builder, __json_string(json, "v"));
+
+    uint32_t row = 0;
+    cJSON_ArrayForEach(field, json) {
+        if (cJSON_IsString(field)) {
+            TABLE_INTERN(builder, PAIR_KEY, row, field->string);
+            TABLE_INTERN(builder, PAIR_VALUE, row, field->valuestring);
+            row++;
+        } else if (cJSON_IsObject(field)) {
+            cJSON_ArrayForEach(nested, field) {
+                snprintf(key, sizeof(key), "%s.%s", field->string, nested->string);
+                TABLE_INTERN(builder, PAIR_KEY, row, key);
+                TABLE_INTERN(builder, PAIR_VALUE, row, cJSON_IsString(nested) ? nested->valuestring : NULL);
+                row++;
+            }
+        }
+    }
+
+    return __table_finish(builder);
+}
+
+
+/**
+ * Builds a table out of a JSON array of strings (STATIC_LANGUAGES, STATIC_VERSIONS).
+ * The version of the table is its first string, which is the latest for STATIC_VERSIONS.
+ */
+static int __table_build_strings(struct table_builder* builder, uint16_t category, cJSON* json)
+{
+    static const uint8_t widths[] = { 4 };
+
+    if (__table_layout(builder, category, cJSON_GetArraySize(json), widths, 1, 0, 0)) {
+        return 0;
+    }
+
+    cJSON* first = cJSON_GetArrayItem(json, 0);
+    __table_version(builder, cJSON_IsString(first) ? first->valuestring : NULL);
+
+    uint32_t row = 0;
+    cJSON* value;
+    cJSON_ArrayForEach(value, json) {
+        TABLE_INTERN(builder, STRING_VALUE, row, cJSON_IsString(value) ? value->valuestring : NULL);
+        row++;
+    }
+
+    return __table_finish(builder);
+}
+
+
+/**
+ * Parses a static-data response into its binary table.
+ * The JSON document is not referenced by the table afterwards and may be deleted.
+ *
+ * @param category  The STATIC_* constant of the response.
+ * @param json      The parsed response.
+ * @param cat       The category whose pages receive the table. The pages are grown as needed.
+ *
+ * @return The number of bytes used by the table; or <br>
+ *         0 if the response is malformed or the category pages could not be grown.
+ */
+int table_build(uint16_t category, cJSON* json, struct category* cat)
+{
+    if (json == NULL || cat == NULL || cat->__first_page == NULL) return 0;
+
+    struct table_builder builder = {
+        .cat = cat,
+        .table = (struct static_table *)cat->__first_page,
+        .used = 0
+    };
+    memset(cat->__first_page, 0x00, sizeof(struct static_table));
+    int size = 0;
+    switch (category) {
+        case STATIC_CHAMPIONS:
+            size = __table_build_champions(&builder, json);
+            break;
+        case STATIC_ITEMS:
+            size = __table_build_items(&builder, json);
+            break;
+        case STATIC_SUMMONER_SPELLS:
+            size = __table_build_spells(&builder, json);
+            break;
+        case STATIC_RUNES:
+        case STATIC_MASTERIES:
+            size = __table_build_named(&builder, category, json, "id", "name");
+            break;
+        case STATIC_MAPS:
+            size = __table_build_named(&builder, category, json, "mapId", "mapName");
+            break;
+        case STATIC_PROFILE_ICONS:
+            size = __table_build_named(&builder, category, json, "id", NULL);
+            break;
+        case STATIC_REALMS:
+            size = __table_build_realms(&builder, json);
+            break;
+        case STATIC_LANGUAGES:
+        case STATIC_VERSIONS:
+            size = __table_build_strings(&builder, category, json);
+            break;
+    }
+
+    free(builder.interned);
+    return size;
+}
+
+
+/**
+ * Finds the columns of a category that hold pool offsets rather than plain values.
+ *
+ * @param category  The STATIC_* constant of the table.
+ *
+ * @return A bitmask with one bit set per string column.
+ */
+static uint32_t __table_string_columns(uint16_t category)
+{
+    switch (category) {
+        case STATIC_CHAMPIONS:
+            return (1 << CHAMPION_KEY) | (1 << CHAMPION_NAME) | (1 << CHAMPION_TITLE);
+        case STATIC_ITEMS:
+            return (1 << ITEM_NAME) | (1 << ITEM_PLAINTEXT);
+        case STATIC_SUMMONER_SPELLS:
+            return (1 << SPELL_KEY) | (1 << SPELL_NAME) | (1 << SPELL_DESCRIPTION);
+        case STATIC_RUNES:
+        case STATIC_MASTERIES:
+        case STATIC_MAPS:
+        case STATIC_PROFILE_ICONS:
+            return 1 << NAMED_NAME;
+        case STATIC_REALMS:
+            return (1 << PAIR_KEY) | (1 << PAIR_VALUE);
+        case STATIC_LANGUAGES:
+        case STATIC_VERSIONS:
+            return 1 << STRING_VALUE;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Checks that every entry of an array of pool offsets points inside the string pool.
+ *
+ * @param table     The table holding the array.
+ * @param offset    The offset of the array from the start of the table.
+ * @param count     The number of entries in the array.
+ *
+ * @return 1 if every entry is in range; or <br>
+ *         0 otherwise.
+ */
+static int __table_offsets_valid(struct static_table* table, uint32_t offset, uint32_t count)
+{
+    uint32_t* offsets = (uint32_t *)((char *)table + offset);
+    for (uint32_t i = 0; i < count; i++) {
+        if (offsets[i] >= table->pool_size) return 0;
+    }
+
+    return 1;
+}
+
+
+/**
+ * Checks that a table is structurally sound: every column, the tag dictionary and the string pool lie within
+ * the table, the pool is null-terminated and every string offset falls inside it, so that no string read can
+ * run past the table.
+ *
+ * @param category  The STATIC_* constant the table is expected to hold.
+ * @param addr      The start of the table.
+ * @param size      The number of bytes readable at addr.
+ *
+ * @return 1 if the table is sound; or <br>
+ *         0 otherwise.
+ */
+int table_valid(uint16_t category, void* addr, size_t size)
+{
+    struct static_table* table = (struct static_table *)addr;
+
+    if (size < sizeof(struct static_table) || table->magic != TABLE_MAGIC || table->category != category
+            || table->size > size || table->columns > TABLE_COLUMNS_MAX
+            || table->version[TABLE_VERSION_SIZE - 1] != 0x00) {
+        return 0;
+    }
+
+    if (table->pool > table->size || table->pool_size > table->size - table->pool
+            || (table->pool_size != 0 && *((char *)table + table->pool + table->pool_size - 1) != 0x00)) {
+        return 0;
+    }
+
+    if (table->tags > table->pool || (uint64_t)table->tags_count * sizeof(uint32_t) > table->pool - table->tags) {
+        return 0;
+    }
+
+    if (table->stats > table->pool || (uint64_t)table->stats_count * sizeof(uint32_t) > table->pool - table->stats
+            || table->stats_values > table->pool
+            || (uint64_t)table->stats_count * table->count * sizeof(float) > table->pool - table->stats_values) {
+        return 0;
+    }
+
+    for (int i = 0; i < table->columns; i++) {
+        if (table->column[i] > table->pool
+                || (uint64_t)table->width[i] * table->count > table->pool - table->column[i]) {
+            return 0;
+        }
+    }
+
+    // Strings are read straight out of the pool, so a corrupt offset would otherwise read past the mapping.
+    uint32_t strings = __table_string_columns(category);
+    for (int i = 0; i < TABLE_COLUMNS_MAX; i++) {
+        if (!(strings & (1 << i))) continue;
+
+        if (i >= table->columns || table->width[i] != sizeof(uint32_t)
+                || !__table_offsets_valid(table, table->column[i], table->count)) {
+            return 0;
+        }
+    }
+
+    if (!__table_offsets_valid(table, table->tags, table->tags_count)
+            || !__table_offsets_valid(table, table->stats, table->stats_count)) {
+        return 0;
+    }
+
+    if (table->words != 0) {
+        uint64_t span = sizeof(uint64_t) * table->words * table->tags_count;
+        if (table->words < (table->count + 63) / 64 || table->tag_bitsets > table->size
+                || span > table->size - table->tag_bitsets) {
+            return 0;
+        }
+
+        span = sizeof(uint64_t) * table->words * (table->category == STATIC_ITEMS ? BITSET_MAPS : 0);
+        if (table->map_bitsets > table->size || span > table->size - table->map_bitsets) {
+            return 0;
+        }
+    }
+
+    // Rows of an index are used without any further check on lookups, so every one of them must be in range.
+    for (int i = 0; i < TABLE_INDEXES_MAX; i++) {
+        if (table->index[i] == 0) continue;
+
+        struct table_index* index = (struct table_index *)((char *)table + table->index[i]);
+        if (table->index[i] < table->pool || sizeof(struct table_index) > table->size - table->index[i]) {
+            return 0;
+        }
+
+        uint64_t span = sizeof(struct table_index) + sizeof(uint32_t) * ((uint64_t)index->buckets + table->count);
+        if (index->buckets == 0 || index->column >= table->columns || span > table->size - table->index[i]) {
+            return 0;
+        }
+
+        for (uint32_t slot = 0; slot < table->count; slot++) {
+            if (PHASH_ROWS(index)[slot] >= table->count) return 0;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,154 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_TABLES_H
+#define CCHAMP_TABLES_H
+#include <inttypes.h>
+#include <stddef.h>
+#include <cJSON.h>
+#include "static.h"
+
+/*
+ * Static categories are not kept around as JSON text. Once a response is received, it is parsed a single time
+ * into a binary table that lives directly inside the pages of its category.
+ *
+ * A table is laid out as a struct-of-arrays:
+ *
+ *  +--------------+----------+-----+----------------+-----------------+-------------+---------+---------+
+ *  | static_table | column 0 | ... | tag dictionary | stat dictionary | string pool | indexes | bitsets |
+ *  +--------------+----------+-----+----------------+-----------------+-------------+---------+---------+
+ *
+ * Every column holds exactly one fixed-size field for all records, so scanning a single field (i.e. the ids of
+ * all items) only ever touches the cache lines of that field. Strings are interned into a trailing pool and are
+ * referenced by their 32-bit offset into the pool.
+ *
+ * Stats (i.e. "FlatHPPoolMod") are sparse in the server data. Every stat present on at least one record gets a
+ * dense float column of its own, following the stat dictionary.
+ *
+ * Indexes and bitsets are appended once the table is final (see phash.h and bitset.h).
+ *
+ * All offsets are relative to the beginning of the table, which makes a table position-independent.
+ */
+#define TABLE_MAGIC         0x54434343
+#define TABLE_COLUMNS_MAX   8
+#define TABLE_TAGS_MAX      64
+#define TABLE_STATS_MAX     64
+#define TABLE_INDEXES_MAX   2
+#define TABLE_VERSION_SIZE  32
+
+struct static_table {
+    uint32_t    magic;
+
+    // The STATIC_* constant of the category stored in this table.
+    uint16_t    category;
+    uint16_t    columns;
+
+    // The number of records, and thus the number of elements in every column.
+    uint32_t    count;
+
+    // The total number of bytes used by the table, including the header.
+    uint32_t    size;
+
+    // The offset of each column array, and the size (in bytes) of its elements.
+    uint32_t    column[TABLE_COLUMNS_MAX];
+    uint8_t     width[TABLE_COLUMNS_MAX];
+
+    // Tags (i.e. "Boots", "Tank") are interned into a dictionary of up to TABLE_TAGS_MAX entries.
+    // Records reference them through a bitmask column where bit N is the N-th dictionary entry.
+    uint32_t    tags;
+    uint32_t    tags_count;
+
+    // The stat dictionary, followed by one float column per stat at stats_values.
+    uint32_t    stats;
+    uint32_t    stats_count;
+    uint32_t    stats_values;
+
+    uint32_t    pool;
+    uint32_t    pool_size;
+
+    // The offset of each lookup index; 0 if the index was not built.
+    uint32_t    index[TABLE_INDEXES_MAX];
+
+    // Precomputed bitsets of (words) 64-bit words each: one per tag, then one per map id (see bitset.h).
+    uint32_t    words;
+    uint32_t    tag_bitsets;
+    uint32_t    map_bitsets;
+
+    // The data version reported by the server (i.e. "7.24.1").
+    char        version[TABLE_VERSION_SIZE];
+};
+
+
+/*
+ * Column layouts for each kind of table.
+ * Strings columns are uint32_t pool offsets.
+ */
+
+// STATIC_CHAMPIONS
+#define CHAMPION_ID             0   // uint32_t
+#define CHAMPION_KEY            1   // string
+#define CHAMPION_NAME           2   // string
+#define CHAMPION_TITLE          3   // string
+#define CHAMPION_TAGS           4   // uint64_t tags bitmask
+
+// STATIC_ITEMS
+#define ITEM_ID                 0   // uint32_t
+#define ITEM_NAME               1   // string
+#define ITEM_PLAINTEXT          2   // string
+#define ITEM_GOLD_BASE          3   // uint16_t
+#define ITEM_GOLD_TOTAL         4   // uint16_t
+#define ITEM_GOLD_SELL          5   // uint16_t
+#define ITEM_TAGS               6   // uint64_t tags bitmask
+#define ITEM_MAPS               7   // uint32_t bitmask of map ids
+
+// STATIC_SUMMONER_SPELLS
+#define SPELL_ID                0   // uint32_t
+#define SPELL_KEY               1   // string
+#define SPELL_NAME              2   // string
+#define SPELL_DESCRIPTION       3   // string
+#define SPELL_LEVEL             4   // uint16_t
+
+// STATIC_RUNES, STATIC_MASTERIES, STATIC_MAPS, STATIC_PROFILE_ICONS
+#define NAMED_ID                0   // uint32_t
+#define NAMED_NAME              1   // string
+
+// STATIC_REALMS
+#define PAIR_KEY                0   // string
+#define PAIR_VALUE              1   // string
+
+// STATIC_LANGUAGES, STATIC_VERSIONS
+#define STRING_VALUE            0   // string
+
+
+/*
+ * Constant time accessors into a table.
+ */
+#define TABLE_COLUMN(table, type, col)  ((type *)((char *)(table) + (table)->column[col]))
+#define TABLE_STRING(table, offset)     ((const char *)(table) + (table)->pool + (offset))
+#define TABLE_TAG(table, index)         TABLE_STRING(table, ((uint32_t *)((char *)(table) + (table)->tags))[index])
+#define TABLE_STAT(table, index)        TABLE_STRING(table, ((uint32_t *)((char *)(table) + (table)->stats))[index])
+#define TABLE_STAT_COLUMN(table, index) ((float *)((char *)(table) + (table)->stats_values) + (index) * (table)->count)
+
+/*
+ * Parses the JSON document of the given static category into a binary table in the pages of cat.
+ */
+int     table_build(uint16_t category, cJSON* data, struct category* cat);
+
+/*
+ * Checks the structural integrity of a table that was not built by this process (i.e. from a snapshot).
+ */
+int     table_valid(uint16_t category, void* addr, size_t size);
+
+#endif
@@ -0,0 +1,542 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <curl/curl.h>
+#include <cchamp/cchamp.h>
+#include "api.h"
+#include "rate.h"
+#include "hedge.h"
+#include "breaker.h"
+#include "dispatch.h"
+
+/**
+ * Initializes a dispatcher with an easy handle per slot, so that connections are kept alive across requests.
+ * The number of slots (no more than the channel blocks that receive their responses), the retries and the
+ * timeouts of requests are read from the configuration (see cchamp_config_set_int()).
+ *
+ * @param dispatcher    The dispatcher.
+ *
+ * @return 0 on success; or <br>
+ *         1 if curl failed (cc_error is set to ECURL). The dispatcher must not be used in that case.
+ */
+int dispatch_init(Dispatcher* dispatcher)
+{
+    memset(dispatcher, 0x00, sizeof(Dispatcher));
+    dispatcher->wakeup = -1;
+    dispatcher->size = cchamp_config_get_int(CCHAMP_CONFIG_DISPATCH_SLOTS);
+    dispatcher->retries = cchamp_config_get_int(CCHAMP_CONFIG_DISPATCH_RETRIES);
+    dispatcher->backoff = cchamp_config_get_int(CCHAMP_CONFIG_DISPATCH_BACKOFF);
+
+    if (dispatcher->size > cchamp_config_get_int(CCHAMP_CONFIG_CHANNEL_BLOCKS)) {
+        dispatcher->size = cchamp_config_get_int(CCHAMP_CONFIG_CHANNEL_BLOCKS);
+    }
+
+    if ((dispatcher->multi = curl_multi_init()) == NULL) {
+        cc_error = ECURL;
+        return 1;
+    }
+
+    for (int i = 0; i < dispatcher->size; i++) {
+        struct dispatch_slot* slot = dispatcher->slots + i;
+
+        if ((slot->easy = curl_easy_init()) == NULL) {
+            dispatch_cleanup(dispatcher);
+            cc_error = ECURL;
+            return 1;
+        }
+
+        curl_easy_setopt(slot->easy, CURLOPT_WRITEFUNCTION, channel_response_received);
+        curl_easy_setopt(slot->easy, CURLOPT_HEADERFUNCTION, channel_header_received);
+        curl_easy_setopt(slot->easy, CURLOPT_WRITEDATA, &slot->request);
+        curl_easy_setopt(slot->easy, CURLOPT_HEADERDATA, &slot->request);
+        curl_easy_setopt(slot->easy, CURLOPT_PRIVATE, slot);
+        api_timeouts(slot->easy);
+    }
+
+    return 0;
+}
+
+
+/**
+ * Releases a dispatcher. Requests that did not complete are dropped without their callbacks being invoked.
+ *
+ * @param dispatcher    The dispatcher.
+ */
+void dispatch_cleanup(Dispatcher* dispatcher)
+{
+    for (int i = 0; i < dispatcher->size; i++) {
+        struct dispatch_slot* slot = dispatcher->slots + i;
+
+        if (slot->state == SLOT_RUNNING) {
+            curl_multi_remove_handle(dispatcher->multi, slot->easy);
+        }
+
+        if (slot->state != SLOT_FREE) {
+            curl_slist_free_all(slot->headers);
+            channel_clean(&slot->request);
+        }
+
+        if (slot->easy != NULL) {
+            curl_easy_cleanup(slot->easy);
+        }
+    }
+
+    if (dispatcher->multi != NULL) {
+        curl_multi_cleanup(dispatcher->multi);
+    }
+
+    memset(dispatcher, 0x00, sizeof(Dispatcher));
+}
+
+
+/**
+ * Claims a free slot of a dispatcher for a new request.
+ *
+ * @param dispatcher    The dispatcher.
+ *
+ * @return The flushed request of the slot, to be filled and handed to dispatch_submit(); or <br>
+ *         NULL if all slots are busy.
+ */
+Request* dispatch_request(Dispatcher* dispatcher)
+{
+    for (int i = 0; i < dispatcher->size; i++) {
+        struct dispatch_slot* slot = dispatcher->slots + i;
+
+        if (slot->state == SLOT_FREE) {
+            memset(&slot->request, 0x00, sizeof(Request));
+            slot->state = SLOT_PENDING;
+            slot->attempts = 0;
+            slot->not_before = 0;
+            slot->headers = NULL;
+            slot->callback = NULL;
+            slot->twin = NULL;
+            slot->hedge = 0;
+            dispatcher->busy++;
+            return &slot->request;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Starts a pending request, unless it is held back by its retry delay or the rate limit of its region.
+ * A request whose circuit is open, or whose url cannot be built, is rejected instead (it completes from within
+ * __dispatch_start()).
+ *
+ * @return 0 if the request was started or rejected; or <br>
+ *         the number of milliseconds to wait before trying again.
+ */
+static int __dispatch_try(Dispatcher* dispatcher, struct dispatch_slot* slot, uint64_t now)
+{
+    char* url;
+    int wait;
+
+    if (slot->not_before > now) {
+        return slot->not_before - now;
+    }
+
+    // A request that cannot be built is never sent (it completes with EARGUMENT).
+    if ((url = channel_url(&slot->request)) == NULL) {
+        slot->state = SLOT_INVALID;
+        return 0;
+    }
+
+    // The circuit is looked at before the rate limit, so that a rejected request does not use up any of it.
+    if (breaker_ready(slot->request.region, slot->request.api) != 0) {
+        slot->state = SLOT_REJECTED;
+        return 0;
+    }
+
+    if ((wait = rate_acquire(slot->request.region, &slot->request.key)) != 0) {
+        return wait;
+    }
+
+    if (breaker_allow(slot->request.region, slot->request.api) != 0) {
+        rate_release(slot->request.region, slot->request.key);
+        slot->state = SLOT_REJECTED;
+        return 0;
+    }
+
+    // A retry replaces whatever ETag the failed attempt received with the one the request was submitted with.
+    memcpy(slot->request.etag, slot->etag, REQUEST_ETAG_SIZE);
+
+    slot->headers = channel_conditional_headers(&slot->request);
+    curl_easy_setopt(slot->easy, CURLOPT_URL, url);
+    curl_easy_setopt(slot->easy, CURLOPT_HTTPHEADER, slot->headers != NULL ? slot->headers : channel_headers(&slot->request));
+
+    slot->request.retry_after = 0;
+    slot->state = SLOT_RUNNING;
+    slot->started = now;
+    hedge_sent(slot->request.region);
+    curl_multi_add_handle(dispatcher->multi, slot->easy);
+    return 0;
+}
+
+
+/**
+ * Hands a request to its callback and frees its slot.
+ */
+static void __dispatch_finish(Dispatcher* dispatcher, struct dispatch_slot* slot, uint16_t status)
+{
+    slot->callback(&slot->request, status, slot->data);
+
+    channel_clean(&slot->request);
+    slot->state = SLOT_FREE;
+    dispatcher->busy--;
+}
+
+
+/**
+ * Starts the pending requests that the rate limit allows, and completes the rejected ones.
+ *
+ * @return The number of milliseconds until another pending request may start; or <br>
+ *         -1 if no request is left pending.
+ */
+static int __dispatch_start(Dispatcher* dispatcher, int* completed)
+{
+    uint64_t now = rate_now();
+    int next = -1;
+
+    for (int i = 0; i < dispatcher->size; i++) {
+        struct dispatch_slot* slot = dispatcher->slots + i;
+        int wait;
+
+        if (slot->state == SLOT_REJECTED || slot->state == SLOT_INVALID) {
+            __dispatch_finish(dispatcher, slot, slot->state == SLOT_REJECTED ? ECIRCUIT : EARGUMENT);
+            (*completed)++;
+        }
+
+        if (slot->state != SLOT_PENDING || slot->callback == NULL) continue;
+
+        if ((wait = __dispatch_try(dispatcher, slot, now)) != 0 && (next == -1 || wait < next)) {
+            next = wait;
+        } else if (slot->state == SLOT_REJECTED || slot->state == SLOT_INVALID) {
+            next = 0;
+        }
+    }
+
+    return next;
+}
+
+
+/**
+ * Sends a running request again from a free slot, if the region has a hedge and the rate limit allows.
+ *
+ * @return 0 if the request was hedged; or <br>
+ *         1 if it was not.
+ */
+static int __dispatch_hedge(Dispatcher* dispatcher, struct dispatch_slot* slot)
+{
+    Request* request = &slot->request;
+    Request* copy;
+
+    if (rate_ready(request->region) != 0 || breaker_ready(request->region, request->api) != 0 ||
+        (copy = dispatch_request(dispatcher)) == NULL) {
+        return 1;
+    }
+
+    struct dispatch_slot* hedge = (struct dispatch_slot *)((char *)copy - offsetof(struct dispatch_slot, request));
+
+    // The rate limit goes first: it can be handed back, whereas a hedge credit cannot.
+    if (rate_acquire(request->region, &copy->key) != 0) {
+        hedge->state = SLOT_FREE;
+        dispatcher->busy--;
+        return 1;
+    }
+
+    if (hedge_acquire(request->region) != 0) {
+        rate_release(request->region, copy->key);
+        hedge->state = SLOT_FREE;
+        dispatcher->busy--;
+        return 1;
+    }
+
+    // The hedge goes to the same URL, but without arguments of its own (they stay with the request).
+    copy->region = request->region;
+    copy->api = request->api;
+    copy->blocks = request->blocks;
+    memcpy(copy->etag, slot->etag, REQUEST_ETAG_SIZE);
+
+    hedge->headers = channel_conditional_headers(copy);
+    curl_easy_setopt(hedge->easy, CURLOPT_URL, channel_url(request));
+    curl_easy_setopt(hedge->easy, CURLOPT_HTTPHEADER, hedge->headers != NULL ? hedge->headers : channel_headers(copy));
+
+    hedge->state = SLOT_RUNNING;
+    hedge->hedge = 1;
+    hedge->twin = slot;
+    slot->twin = hedge;
+    curl_multi_add_handle(dispatcher->multi, hedge->easy);
+    return 0;
+}
+
+
+/**
+ * Hedges the running requests that are past the threshold of their region and API.
+ *
+ * @return The number of milliseconds until another running request is due to be hedged; or <br>
+ *         -1 if none is.
+ */
+static int __dispatch_hedges(Dispatcher* dispatcher)
+{
+    uint64_t now = rate_now();
+    int next = -1;
+
+    for (int i = 0; i < dispatcher->size; i++) {
+        struct dispatch_slot* slot = dispatcher->slots + i;
+        uint64_t threshold;
+
+        if (slot->state != SLOT_RUNNING || slot->hedge || slot->twin != NULL) continue;
+
+        if ((threshold = hedge_threshold(slot->request.region, slot->request.api)) == 0) continue;
+
+        if (now - slot->started < threshold) {
+            if (next == -1 || (int)(slot->started + threshold - now) < next) next = slot->started + threshold - now;
+        } else if (__dispatch_hedge(dispatcher, slot) != 0 && dispatcher->busy == dispatcher->size) {
+            // No slot is left to hedge with until a request completes.
+            break;
+        }
+    }
+
+    return next;
+}
+
+
+/**
+ * Cancels the transfer of a slot, leaving its request as it was before it was sent.
+ */
+static void __dispatch_cancel(Dispatcher* dispatcher, struct dispatch_slot* slot)
+{
+    curl_multi_remove_handle(dispatcher->multi, slot->easy);
+    curl_slist_free_all(slot->headers);
+    slot->headers = NULL;
+    channel_release(&slot->request);
+}
+
+
+/**
+ * Frees the slot of a hedge, whether it completed or was cancelled.
+ */
+static void __dispatch_unhedge(Dispatcher* dispatcher, struct dispatch_slot* hedge)
+{
+    hedge->twin->twin = NULL;
+    hedge->twin = NULL;
+    hedge->hedge = 0;
+    hedge->state = SLOT_FREE;
+    dispatcher->busy--;
+}
+
+
+/**
+ * Schedules a request claimed with dispatch_request(). It starts right away if the rate limit allows,
+ * and otherwise from within dispatch_run() as soon as it does.
+ *
+ * @param dispatcher    The dispatcher.
+ * @param request       The request.
+ * @param callback      Invoked once the request completes.
+ * @param data          Passed on to the callback.
+ */
+void dispatch_submit(Dispatcher* dispatcher, Request* request, dispatch_callback callback, void* data)
+{
+    struct dispatch_slot* slot = (struct dispatch_slot *)((char *)request - offsetof(struct dispatch_slot, request));
+
+    slot->callback = callback;
+    slot->data = data;
+    memcpy(slot->etag, request->etag, REQUEST_ETAG_SIZE);
+
+    // Requests go out right away when the rate limit allows, so that it reflects them (see rate_ready()).
+    __dispatch_try(dispatcher, slot, rate_now());
+}
+
+
+/**
+ * Handles a transfer that curl completed: either schedules a retry, or hands the request to its callback and
+ * frees its slot.
+ */
+static void __dispatch_complete(Dispatcher* dispatcher, struct dispatch_slot* slot, CURLcode res)
+{
+    curl_multi_remove_handle(dispatcher->multi, slot->easy);
+    curl_easy_getinfo(slot->easy, CURLINFO_RESPONSE_CODE, &slot->request.http_code);
+    curl_slist_free_all(slot->headers);
+    slot->headers = NULL;
+
+    int answered = res == CURLE_OK && slot->request.http_code < 500 && slot->request.http_code != 429;
+
+    if (slot->hedge) {
+        struct dispatch_slot* hedge = slot;
+        slot = hedge->twin;
+
+        // A hedge that failed is dropped; the request it hedged still runs (its status is only accounted for).
+        if (!answered) {
+            api_status(&hedge->request, res);
+            channel_release(&hedge->request);
+            __dispatch_unhedge(dispatcher, hedge);
+            return;
+        }
+
+        // Otherwise its response is handed over to the request, as if the request had received it.
+        __dispatch_cancel(dispatcher, slot);
+        slot->request.response = hedge->request.response;
+        slot->request.http_code = hedge->request.http_code;
+        slot->request.retry_after = hedge->request.retry_after;
+        slot->request.key = hedge->request.key;
+        memcpy(slot->request.etag, hedge->request.etag, REQUEST_ETAG_SIZE);
+
+        hedge->request.response.addr = NULL;
+        hedge->request.response.size = 0;
+        __dispatch_unhedge(dispatcher, hedge);
+    } else if (slot->twin != NULL) {
+        __dispatch_cancel(dispatcher, slot->twin);
+        __dispatch_unhedge(dispatcher, slot->twin);
+    }
+
+    // A latency is recorded even when a hedge answered first: the request took at least that long.
+    if (answered) {
+        hedge_record(slot->request.region, slot->request.api, rate_now() - slot->started);
+    }
+
+    breaker_record(slot->request.region, slot->request.api, breaker_failed(res, slot->request.http_code),
+                   rate_now() - slot->started);
+
+    uint16_t status = api_status(&slot->request, res);
+    int transient = status == ERATELIMIT || res != CURLE_OK || slot->request.http_code >= 500;
+
+    // A request rejected for its key goes again right away with another one, as long as any is left.
+    int rekey = status == EAPIKEY && api_keys_usable() != 0;
+
+    if ((transient || rekey) && slot->attempts < dispatcher->retries) {
+        channel_release(&slot->request);
+
+        // A rate limit is already accounted for by the region and key (see rate_penalize()).
+        slot->not_before = status == ERATELIMIT || rekey ? 0 : rate_now() + ((uint64_t)dispatcher->backoff << slot->attempts);
+        slot->attempts++;
+        slot->state = SLOT_PENDING;
+        return;
+    }
+
+    __dispatch_finish(dispatcher, slot, status);
+}
+
+
+/**
+ * Completes the transfers that curl reports done.
+ *
+ * @return The number of transfers completed.
+ */
+static int __dispatch_collect(Dispatcher* dispatcher)
+{
+    CURLMsg* message;
+    int completed = 0;
+
+    while ((message = curl_multi_info_read(dispatcher->multi, &(int){0})) != NULL) {
+        if (message->msg == CURLMSG_DONE) {
+            struct dispatch_slot* slot;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char **)&slot);
+
+            // The transfer may have been cancelled by its twin completing first (see __dispatch_cancel()).
+            if (slot->state != SLOT_RUNNING) continue;
+
+            __dispatch_complete(dispatcher, slot, message->data.result);
+            completed++;
+        }
+    }
+
+    return completed;
+}
+
+
+/**
+ * Runs the requests of a dispatcher for up to (timeout) milliseconds, or until at least one of them completes.
+ *
+ * @param dispatcher    The dispatcher.
+ * @param timeout       The longest time to wait, in milliseconds.
+ *
+ * @return The number of requests left (pending or running).
+ */
+int dispatch_run(Dispatcher* dispatcher, int timeout)
+{
+    int running, completed = 0;
+
+    int next = __dispatch_start(dispatcher, &completed);
+    int hedge = __dispatch_hedges(dispatcher);
+    curl_multi_perform(dispatcher->multi, &running);
+
+    if (hedge != -1 && (next == -1 || hedge < next)) {
+        next = hedge;
+    }
+
+    completed += __dispatch_collect(dispatcher);
+
+    if (completed == 0 && dispatcher->busy != 0) {
+        if (next != -1 && next < timeout) {
+            timeout = next;
+        }
+
+        struct curl_waitfd wakeup = { .fd = dispatcher->wakeup, .events = CURL_WAIT_POLLIN };
+
+        // With nothing running, waiting on curl would return right away; the next start is slept on instead.
+        if (running != 0) {
+            curl_multi_wait(dispatcher->multi, &wakeup, dispatcher->wakeup != -1, timeout, NULL);
+        } else if (timeout > 0 && dispatcher->wakeup != -1) {
+            poll(&(struct pollfd){ .fd = dispatcher->wakeup, .events = POLLIN }, 1, timeout);
+        } else if (timeout > 0) {
+            struct timespec delay = { .tv_sec = timeout / 1000, .tv_nsec = (timeout % 1000) * 1000000L };
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    return dispatcher->busy;
+}
+
+
+/**
+ * Runs the requests of a dispatcher driven by an event loop rather than dispatch_run(): curl is handed the
+ * readiness of one of its sockets (or its timeout), and never waits. The multi handle must have been set up
+ * for the socket interface (CURLMOPT_SOCKETFUNCTION and CURLMOPT_TIMERFUNCTION) by the caller.
+ *
+ * @param dispatcher    The dispatcher.
+ * @param fd            The socket that is ready; or CURL_SOCKET_TIMEOUT if curl's timeout expired.
+ * @param events        The CURL_CSELECT_* readiness of the socket.
+ *
+ * @return The number of milliseconds until the dispatcher must be driven again, apart from curl's own
+ *         sockets and timeout (i.e. for a request held back by the rate limit); or <br>
+ *         -1 if nothing is waiting.
+ */
+int dispatch_socket(Dispatcher* dispatcher, int fd, int events)
+{
+    int running, completed = 0;
+
+    int next = __dispatch_start(dispatcher, &completed);
+    int hedge = __dispatch_hedges(dispatcher);
+    curl_multi_socket_action(dispatcher->multi, fd, events, &running);
+
+    if (hedge != -1 && (next == -1 || hedge < next)) {
+        next = hedge;
+    }
+
+    completed += __dispatch_collect(dispatcher);
+
+    // Completions may have left retries (or new requests from the callbacks) pending; they are started next.
+    if (completed != 0) {
+        next = 0;
+    }
+
+    return next;
+}
@@ -0,0 +1,94 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_DISPATCH_H
+#define CCHAMP_DISPATCH_H
+#include <inttypes.h>
+#include <network/channel.h>
+
+/*
+ * A dispatcher runs many requests concurrently over a curl multi handle, each within the rate limit of its
+ * region (see rate.h). Every request occupies a slot until it completes, and is retried on its own when the
+ * server reports the rate limit exceeded (429), fails with a 5xx or the transfer breaks.
+ *
+ * A request running for longer than usual may be hedged (see hedge.h): a free slot sends it again, and the
+ * request completes with whichever response arrives first, the other transfer being cancelled. The hedge
+ * counts as busy until then.
+ *
+ * A request for a region and API whose circuit is open (see breaker.h) is not sent; it completes with ECIRCUIT
+ * from within the next dispatch_run(). Neither is a request with an argument too long for its url (see
+ * path_arg()), which completes with EARGUMENT.
+ *
+ * The completion callback of a request receives it with its response, along with the cc_error code of its
+ * outcome; the response is released as soon as the callback returns. Requests are only ever run (and
+ * callbacks invoked) from within dispatch_run(), on the thread invoking it, or from within dispatch_socket() for
+ * a dispatcher driven by an event loop (see cchamp_loop_create()).
+ */
+#define DISPATCH_SLOTS      CHANNEL_BLOCKS_MAX
+
+typedef void (*dispatch_callback)(Request* request, uint16_t status, void* data);
+
+struct dispatch_slot {
+    void*               easy;
+    Request             request;
+    struct curl_slist*  headers;
+
+    dispatch_callback   callback;
+    void*               data;
+
+    // SLOT_FREE, SLOT_PENDING (waiting on the rate limit or a retry delay), SLOT_RUNNING, SLOT_REJECTED or
+    // SLOT_INVALID.
+    int                 state;
+    int                 attempts;
+    uint64_t            not_before;
+
+    // The ETag the request was submitted with; sending it clears it, but retries and hedges need it again.
+    char                etag[REQUEST_ETAG_SIZE];
+
+    // The time the running transfer started, and the slot hedging it (or the slot it hedges, for a hedge).
+    uint64_t            started;
+    struct dispatch_slot* twin;
+    int                 hedge;
+};
+
+#define SLOT_FREE       0
+#define SLOT_PENDING    1
+#define SLOT_RUNNING    2
+#define SLOT_REJECTED   3
+#define SLOT_INVALID    4
+
+struct dispatcher {
+    void*                   multi;
+    int                     busy;
+
+    // The slots in use (see CCHAMP_CONFIG_DISPATCH_SLOTS), and the retries of a request, read at creation.
+    int                     size;
+    int                     retries;
+    int                     backoff;
+
+    // A descriptor that cuts short the waits of dispatch_run() once readable (-1 if none, the default).
+    int                     wakeup;
+    struct dispatch_slot    slots[DISPATCH_SLOTS];
+};
+
+typedef struct dispatcher Dispatcher;
+
+int         dispatch_init(Dispatcher* dispatcher);
+void        dispatch_cleanup(Dispatcher* dispatcher);
+Request*    dispatch_request(Dispatcher* dispatcher);
+void        dispatch_submit(Dispatcher* dispatcher, Request* request, dispatch_callback callback, void* data);
+int         dispatch_run(Dispatcher* dispatcher, int timeout);
+int         dispatch_socket(Dispatcher* dispatcher, int fd, int events);
+#endif
@@ -0,0 +1,196 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include "api.h"
+#include "rate.h"
+#include "hedge.h"
+
+// The threshold is worked out again after this many new samples.
+#define HEDGE_REFRESH       16
+
+// The most hedges a region may have in hand, in hundredths, so that a quiet period does not bank a burst.
+#define HEDGE_CREDIT_MAX    1000
+
+/*
+ * The latest latencies (in ms) of the successful responses of a region and API, in a ring, along with the
+ * threshold they last gave.
+ */
+static struct hedge_latency {
+    pthread_mutex_t lock;
+    uint32_t        samples[HEDGE_SAMPLES];
+    uint32_t        count;
+    uint32_t        head;
+    uint64_t        threshold;
+} latencies[RATE_REGIONS][API_INDEXES] = {
+    [0 ... RATE_REGIONS - 1] = {
+        [0 ... API_INDEXES - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+    }
+};
+
+// The hedges each region has earned, in hundredths of a hedge.
+static int32_t credits[RATE_REGIONS];
+
+
+static int __hedge_compare(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * The latency samples of a region and API; NULL if the API is not one of the API_* constants.
+ */
+static struct hedge_latency* __hedge_latency(uint16_t region, uint16_t api)
+{
+    int index = get_bit_index(api);
+
+    if (api == 0 || index >= API_INDEXES) {
+        return NULL;
+    }
+
+    return &latencies[(int)get_bit_index(region)][index];
+}
+
+
+/**
+ * The time after which a request of a region and API is hedged.
+ *
+ * @param region    The region of the request.
+ * @param api       The API of the request.
+ *
+ * @return The threshold, in ms; or <br>
+ *         0 if such requests are not hedged (hedging is disabled, or too few responses were seen yet).
+ */
+uint64_t hedge_threshold(uint16_t region, uint16_t api)
+{
+    struct hedge_latency* latency = __hedge_latency(region, api);
+
+    if (latency == NULL || cchamp_config_get_int(CCHAMP_CONFIG_HEDGE_BUDGET) == 0) {
+        return 0;
+    }
+
+    return __atomic_load_n(&latency->threshold, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Records the latency of a successful response, which moves the threshold of its region and API.
+ *
+ * @param region    The region of the request.
+ * @param api       The API of the request.
+ * @param latency   The time the response took, in ms.
+ */
+void hedge_record(uint16_t region, uint16_t api, uint64_t latency)
+{
+    struct hedge_latency* samples = __hedge_latency(region, api);
+    uint32_t sorted[HEDGE_SAMPLES];
+
+    if (samples == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&samples->lock);
+
+    samples->samples[samples->head] = latency > UINT32_MAX ? UINT32_MAX : latency;
+    samples->head = (samples->head + 1) % HEDGE_SAMPLES;
+    samples->count++;
+
+    if (samples->count < HEDGE_MIN_SAMPLES || samples->count % HEDGE_REFRESH != 0) {
+        pthread_mutex_unlock(&samples->lock);
+        return;
+    }
+
+    uint32_t count = samples->count < HEDGE_SAMPLES ? samples->count : HEDGE_SAMPLES;
+    memcpy(sorted, samples->samples, sizeof(uint32_t) * count);
+    pthread_mutex_unlock(&samples->lock);
+
+    qsort(sorted, count, sizeof(uint32_t), __hedge_compare);
+
+    uint64_t threshold = sorted[(count * cchamp_config_get_int(CCHAMP_CONFIG_HEDGE_PERCENTILE) - 1) / 100];
+    uint64_t minimum = cchamp_config_get_int(CCHAMP_CONFIG_HEDGE_DELAY_MIN);
+
+    __atomic_store_n(&samples->threshold, threshold > minimum ? threshold : minimum, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Accounts for a request sent to a region, which earns the region a share of a hedge.
+ *
+ * @param region The region of the request.
+ */
+void hedge_sent(uint16_t region)
+{
+    int32_t* credit = &credits[(int)get_bit_index(region)];
+    int32_t budget = cchamp_config_get_int(CCHAMP_CONFIG_HEDGE_BUDGET);
+    int32_t current = __atomic_load_n(credit, __ATOMIC_RELAXED);
+
+    if (budget == 0) {
+        return;
+    }
+
+    while (current < HEDGE_CREDIT_MAX && !__atomic_compare_exchange_n(credit, &current,
+                                         current + budget > HEDGE_CREDIT_MAX ? HEDGE_CREDIT_MAX : current + budget,
+                                         0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+
+/**
+ * Spends a hedge of a region.
+ *
+ * @param region The region of the request to hedge.
+ *
+ * @return 0 if the request may be hedged; or <br>
+ *         1 if the region has no hedge left.
+ */
+int hedge_acquire(uint16_t region)
+{
+    int32_t* credit = &credits[(int)get_bit_index(region)];
+    int32_t current = __atomic_load_n(credit, __ATOMIC_RELAXED);
+
+    do {
+        if (current < 100) {
+            return 1;
+        }
+    } while (!__atomic_compare_exchange_n(credit, &current, current - 100, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    return 0;
+}
+
+
+/**
+ * Forgets all latencies and hedges earned.
+ */
+void hedge_reset()
+{
+    for (int i = 0; i < RATE_REGIONS; i++) {
+        for (int j = 0; j < API_INDEXES; j++) {
+            struct hedge_latency* latency = &latencies[i][j];
+
+            pthread_mutex_lock(&latency->lock);
+            latency->count = 0;
+            latency->head = 0;
+            latency->threshold = 0;
+            pthread_mutex_unlock(&latency->lock);
+        }
+
+        __atomic_store_n(&credits[i], 0, __ATOMIC_RELAXED);
+    }
+}
@@ -0,0 +1,36 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_HEDGE_H
+#define CCHAMP_HEDGE_H
+#include <inttypes.h>
+
+/*
+ * A request that has not completed within the usual latency of its region and API (the percentile set by
+ * CCHAMP_CONFIG_HEDGE_PERCENTILE, over its latest HEDGE_SAMPLES responses) is hedged by the dispatcher: a
+ * duplicate is sent on another connection, and whichever response arrives first is kept (see dispatch.h).
+ *
+ * Hedges are extra requests against the rate limit, so a region only earns one for every
+ * (100 / CCHAMP_CONFIG_HEDGE_BUDGET) requests sent to it; with a budget of 0 (the default), nothing is hedged.
+ */
+#define HEDGE_SAMPLES       128
+#define HEDGE_MIN_SAMPLES   20
+
+uint64_t    hedge_threshold(uint16_t region, uint16_t api);
+void        hedge_record(uint16_t region, uint16_t api, uint64_t latency);
+void        hedge_sent(uint16_t region);
+int         hedge_acquire(uint16_t region);
+void        hedge_reset();
+#endif
@@ -0,0 +1,378 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include "api.h"
+#include "rate.h"
+
+/*
+ * The send times (in ms) of the latest requests of a region are kept in a ring, sized for the longest window.
+ */
+static struct rate_bucket {
+    pthread_mutex_t lock;
+    uint64_t*       sent;
+    uint32_t        capacity;
+
+    // The number of requests sent so far; the next send time is stored at (head % capacity).
+    uint64_t        head;
+
+    // No request is sent before this time, after the server reported the limit exceeded.
+    uint64_t        blocked_until;
+} buckets[API_KEYS_MAX][RATE_REGIONS] = {
+    [0 ... API_KEYS_MAX - 1] = {
+        [0 ... RATE_REGIONS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+    }
+};
+
+
+/**
+ * Milliseconds on the monotonic clock.
+ */
+uint64_t rate_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/**
+ * The time to wait before the next request of a bucket may be sent. The bucket must be locked.
+ */
+static uint64_t __rate_bucket_wait(struct rate_bucket* bucket, uint32_t per_second, uint32_t per_two_minutes,
+                                   uint64_t now)
+{
+    uint64_t wait = 0;
+
+    if (per_second > per_two_minutes) {
+        per_second = per_two_minutes;
+    }
+
+    if (now < bucket->blocked_until) {
+        wait = bucket->blocked_until - now;
+    }
+
+    if (bucket->head >= per_second) {
+        uint64_t oldest = bucket->sent[(bucket->head - per_second) % bucket->capacity];
+        if (oldest + 1000 > now + wait) wait = oldest + 1000 - now;
+    }
+
+    if (bucket->head >= per_two_minutes) {
+        uint64_t oldest = bucket->sent[bucket->head % bucket->capacity];
+        if (oldest + 120000 > now + wait) wait = oldest + 120000 - now;
+    }
+
+    return wait;
+}
+
+
+/**
+ * The limits requests are held to: the configured ones, less the headroom (see CCHAMP_CONFIG_RATE_HEADROOM).
+ *
+ * @return 0 if requests are limited; or <br>
+ *         1 if they are not (either limit is 0).
+ */
+int rate_limits(uint32_t* per_second, uint32_t* per_two_minutes)
+{
+    uint32_t headroom = cchamp_config_get_int(CCHAMP_CONFIG_RATE_HEADROOM);
+
+    *per_second = api.rate.per_second;
+    *per_two_minutes = api.rate.per_two_minutes;
+
+    if (*per_second == 0 || *per_two_minutes == 0) {
+        return 1;
+    }
+
+    *per_second = *per_second * (100 - headroom) / 100;
+    *per_two_minutes = *per_two_minutes * (100 - headroom) / 100;
+
+    if (*per_second == 0) *per_second = 1;
+    if (*per_two_minutes == 0) *per_two_minutes = 1;
+    if (*per_second > *per_two_minutes) *per_second = *per_two_minutes;
+
+    return 0;
+}
+
+
+/**
+ * Sizes the ring of a bucket for the current limits. The bucket must be locked.
+ *
+ * @return 0 on success; or <br>
+ *         1 if the ring could not be allocated.
+ */
+static int __rate_bucket_prepare(struct rate_bucket* bucket, uint32_t per_two_minutes)
+{
+    // The limits were changed (cchamp_set_max_requests()); the history is dropped along with the ring.
+    if (bucket->capacity != per_two_minutes) {
+        uint64_t* sent = realloc(bucket->sent, sizeof(uint64_t) * per_two_minutes);
+        if (sent == NULL) {
+            return 1;
+        }
+
+        bucket->sent = sent;
+        bucket->capacity = per_two_minutes;
+        bucket->head = 0;
+    }
+
+    return 0;
+}
+
+
+/**
+ * The number of requests of a bucket sent within the last second (up to per_second). The bucket must be locked.
+ */
+static uint32_t __rate_bucket_load(struct rate_bucket* bucket, uint32_t per_second, uint64_t now)
+{
+    uint32_t load = 0;
+
+    while (load < per_second && load < bucket->head &&
+           bucket->sent[(bucket->head - load - 1) % bucket->capacity] + 1000 > now) {
+        load++;
+    }
+
+    return load;
+}
+
+
+/**
+ * Tells whether a key is passed over when picking one for a request.
+ */
+static int __rate_key_skipped(int key, int usable)
+{
+    return usable != 0 && __atomic_load_n(&api.keys[key].revoked, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Attempts to take a request from the rate limit of a region, with the least loaded key that allows it.
+ *
+ * @param region    The REGION_* constant of the request.
+ * @param key       Set to the index of the key to send the request with (in api.keys).
+ *
+ * @return 0 if the request may be sent right away (it is then counted); or <br>
+ *         the number of milliseconds to wait before trying again.
+ */
+int rate_acquire(uint16_t region, uint8_t* key)
+{
+    int index = get_bit_index(region);
+    int count = __atomic_load_n(&api.key_count, __ATOMIC_ACQUIRE);
+    int usable = api_keys_usable();
+    uint32_t per_second, per_two_minutes;
+    uint64_t now = rate_now();
+    uint64_t wait = 1000;
+
+    struct rate_bucket* best = NULL;
+    uint32_t best_load = 0;
+
+    if (count == 0) {
+        count = 1;
+    }
+
+    if (rate_limits(&per_second, &per_two_minutes) != 0) {
+        for (*key = 0; __rate_key_skipped(*key, usable); (*key)++);
+        return 0;
+    }
+
+    /*
+     * The best bucket so far is kept locked until a better one is found, so that it cannot fill up in between.
+     * Buckets are always locked in the order of their keys, and at most two at once.
+     */
+    for (int k = 0; k < count; k++) {
+        struct rate_bucket* bucket = &buckets[k][index];
+        uint64_t bucket_wait;
+        uint32_t load;
+
+        if (__rate_key_skipped(k, usable)) continue;
+
+        pthread_mutex_lock(&bucket->lock);
+
+        if (__rate_bucket_prepare(bucket, per_two_minutes) != 0) {
+            pthread_mutex_unlock(&bucket->lock);
+            continue;
+        }
+
+        if ((bucket_wait = __rate_bucket_wait(bucket, per_second, per_two_minutes, now)) != 0) {
+            if (bucket_wait < wait) wait = bucket_wait;
+            pthread_mutex_unlock(&bucket->lock);
+            continue;
+        }
+
+        load = __rate_bucket_load(bucket, per_second, now);
+        if (best != NULL && load >= best_load) {
+            pthread_mutex_unlock(&bucket->lock);
+            continue;
+        }
+
+        if (best != NULL) {
+            pthread_mutex_unlock(&best->lock);
+        }
+
+        best = bucket;
+        best_load = load;
+        *key = k;
+    }
+
+    if (best == NULL) {
+        return wait;
+    }
+
+    best->sent[best->head++ % best->capacity] = now;
+    pthread_mutex_unlock(&best->lock);
+    return 0;
+}
+
+
+/**
+ * Tells how long a request to a region would have to wait, without taking it from the rate limit.
+ *
+ * @param region    The REGION_* constant of the request.
+ *
+ * @return 0 if a request may be sent right away (with any of the keys); or <br>
+ *         the number of milliseconds until one may be sent.
+ */
+int rate_ready(uint16_t region)
+{
+    int index = get_bit_index(region);
+    int count = __atomic_load_n(&api.key_count, __ATOMIC_ACQUIRE);
+    int usable = api_keys_usable();
+    uint32_t per_second, per_two_minutes;
+    uint64_t wait = 0;
+
+    if (count == 0) {
+        count = 1;
+    }
+
+    if (rate_limits(&per_second, &per_two_minutes) != 0) {
+        return 0;
+    }
+
+    for (int k = 0; k < count; k++) {
+        struct rate_bucket* bucket = &buckets[k][index];
+        uint64_t bucket_wait = 0;
+
+        if (__rate_key_skipped(k, usable)) continue;
+
+        pthread_mutex_lock(&bucket->lock);
+
+        // A ring sized for other limits is reset by the next rate_acquire(); it tells nothing until then.
+        if (bucket->capacity == per_two_minutes) {
+            bucket_wait = __rate_bucket_wait(bucket, per_second, per_two_minutes, rate_now());
+        }
+
+        pthread_mutex_unlock(&bucket->lock);
+
+        if (bucket_wait == 0) {
+            return 0;
+        } else if (wait == 0 || bucket_wait < wait) {
+            wait = bucket_wait;
+        }
+    }
+
+    return wait;
+}
+
+
+/**
+ * Blocks until a request may be sent to a region, and counts it.
+ *
+ * @param region    The REGION_* constant of the request.
+ *
+ * @return The index of the key to send the request with (in api.keys).
+ */
+uint8_t rate_wait(uint16_t region)
+{
+    uint8_t key = 0;
+    int wait;
+
+    while ((wait = rate_acquire(region, &key)) != 0) {
+        struct timespec delay = { .tv_sec = wait / 1000, .tv_nsec = (wait % 1000) * 1000000L };
+        nanosleep(&delay, NULL);
+    }
+
+    return key;
+}
+
+
+/**
+ * Gives a request back to the rate limit of a region, when it was taken (see rate_acquire()) but not sent after all.
+ *
+ * The latest request of the key is dropped, which is either this one or one taken a moment later. Once the ring has
+ * wrapped around, the request it held before is long gone; the oldest one left stands in for it, which can only
+ * hold requests back for longer, never let more through.
+ *
+ * @param region    The REGION_* constant of the request.
+ * @param key       The index of the key the request was taken with.
+ */
+void rate_release(uint16_t region, uint8_t key)
+{
+    struct rate_bucket* bucket = &buckets[key][(int)get_bit_index(region)];
+
+    pthread_mutex_lock(&bucket->lock);
+    if (bucket->head > 0 && bucket->capacity > 0) {
+        bucket->head--;
+
+        if (bucket->head >= bucket->capacity) {
+            bucket->sent[bucket->head % bucket->capacity] = bucket->sent[(bucket->head + 1) % bucket->capacity];
+        }
+    }
+    pthread_mutex_unlock(&bucket->lock);
+}
+
+
+/**
+ * Holds back all requests to a region with a key after the server reported the rate limit exceeded (http 429).
+ *
+ * @param region    The REGION_* constant of the request.
+ * @param key       The index of the key the request was sent with.
+ * @param seconds   The Retry-After delay reported by the server; 1 second is assumed if it is missing.
+ */
+void rate_penalize(uint16_t region, uint8_t key, int seconds)
+{
+    struct rate_bucket* bucket = &buckets[key][(int)get_bit_index(region)];
+    uint64_t until = rate_now() + (seconds > 0 ? seconds : 1) * 1000;
+
+    pthread_mutex_lock(&bucket->lock);
+    if (until > bucket->blocked_until) {
+        bucket->blocked_until = until;
+    }
+    pthread_mutex_unlock(&bucket->lock);
+}
+
+
+/**
+ * Releases the memory held by the rate limits.
+ */
+void rate_free()
+{
+    for (int k = 0; k < API_KEYS_MAX; k++) {
+        for (int i = 0; i < RATE_REGIONS; i++) {
+            struct rate_bucket* bucket = &buckets[k][i];
+
+            pthread_mutex_lock(&bucket->lock);
+            free(bucket->sent);
+            bucket->sent = NULL;
+            bucket->capacity = 0;
+            bucket->head = 0;
+            bucket->blocked_until = 0;
+            pthread_mutex_unlock(&bucket->lock);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_RATE_H
+#define CCHAMP_RATE_H
+#include <inttypes.h>
+
+/*
+ * Rate limits are enforced per API key and region, as Riot counts them, through a sliding window over the send
+ * times of the latest requests: a request may only be sent once the (per_second)th latest request is a second
+ * old and the (per_two_minutes)th latest request is two minutes old (see api.rate).
+ *
+ * A request goes out with the least loaded key that the rate limit allows, i.e. the one that sent the fewest
+ * requests to the region within the last second. Revoked keys are passed over, unless all keys are revoked.
+ */
+#define RATE_REGIONS 11
+
+int     rate_acquire(uint16_t region, uint8_t* key);
+int     rate_ready(uint16_t region);
+uint8_t rate_wait(uint16_t region);
+void    rate_release(uint16_t region, uint8_t key);
+void    rate_penalize(uint16_t region, uint8_t key, int seconds);
+void    rate_free();
+int     rate_limits(uint32_t* per_second, uint32_t* per_two_minutes);
+
+/*
+ * Milliseconds on the monotonic clock.
+ */
+uint64_t rate_now();
+#endif
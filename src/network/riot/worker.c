@@ -0,0 +1,403 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <cchamp/cchamp.h>
+#include <cchamp_utils.h>
+#include "api.h"
+#include "rate.h"
+#include "worker.h"
+
+/*
+ * The longest a worker sleeps with requests in flight, in milliseconds.
+ */
+#define WORKER_WAIT     1000
+
+/*
+ * A request handed to a worker, waiting in its queue.
+ */
+struct worker_job {
+    struct worker_job*  next;
+    Request             request;
+    dispatch_callback   callback;
+    void*               data;
+};
+
+/*
+ * The queue of a worker has many producers (the threads submitting requests) and a single consumer (the
+ * worker). A producer links its job in by atomically swapping the head, so that it never waits on another one;
+ * the worker takes the jobs out from the tail. The queue is never empty of nodes: the stub stands in for the
+ * last job when all jobs are taken out.
+ */
+static struct worker {
+    pthread_t           thread;
+
+    // Set while the worker takes requests; producers in the middle of handing one over are counted.
+    int                 running;
+    int                 submitting;
+
+    // Set once the worker may exit, i.e. when it is done with all requests already handed over.
+    int                 stopping;
+
+    // Written to after every submission, to wake the worker up (see Dispatcher.wakeup).
+    int                 wakeup;
+
+    struct worker_job*  head;
+    struct worker_job*  tail;
+    struct worker_job   stub;
+
+    Dispatcher          dispatcher;
+    __CBUFF*            blocks;
+} workers[RATE_REGIONS];
+
+/*
+ * A request sent with worker_send(), waiting for its response.
+ */
+struct worker_call {
+    Request*            request;
+    uint16_t            status;
+    int                 done;
+
+    pthread_mutex_t     lock;
+    pthread_cond_t      completed;
+};
+
+// Serializes cchamp_workers_start() and cchamp_workers_stop().
+static pthread_mutex_t workers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Links a job in at the head of the queue of a worker. Safe to invoke from any number of threads at once.
+ */
+static void __worker_push(struct worker* worker, struct worker_job* job)
+{
+    job->next = NULL;
+
+    struct worker_job* previous = __atomic_exchange_n(&worker->head, job, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&previous->next, job, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Takes the job at the tail of the queue of a worker out. Only invoked by the worker.
+ *
+ * @return The job; or <br>
+ *         NULL if the queue is empty, or if the next job is still being linked in by its producer (which then
+ *         wakes the worker up once it is).
+ */
+static struct worker_job* __worker_pop(struct worker* worker)
+{
+    struct worker_job* tail = worker->tail;
+    struct worker_job* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &worker->stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+
+        worker->tail = tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next != NULL) {
+        worker->tail = next;
+        return tail;
+    }
+
+    // The tail is the last job linked in; the stub must take its place before it can be taken out.
+    if (tail != __atomic_load_n(&worker->head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    __worker_push(worker, &worker->stub);
+
+    if ((next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE)) != NULL) {
+        worker->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Moves the jobs in the queue of a worker to the free slots of its dispatcher. Jobs are only taken out while a
+ * slot is free; the others wait in the queue for a request to complete.
+ */
+static void __worker_schedule(struct worker* worker)
+{
+    struct worker_job* job;
+
+    while (worker->dispatcher.busy < worker->dispatcher.size && (job = __worker_pop(worker)) != NULL) {
+        Request* request = dispatch_request(&worker->dispatcher);
+
+        *request = job->request;
+        request->blocks = worker->blocks;
+        dispatch_submit(&worker->dispatcher, request, job->callback, job->data);
+        free(job);
+    }
+}
+
+
+/**
+ * Tells whether the queue of a worker is empty. Only invoked by the worker.
+ */
+static int __worker_idle(struct worker* worker)
+{
+    return worker->tail == &worker->stub && __atomic_load_n(&worker->head, __ATOMIC_ACQUIRE) == &worker->stub;
+}
+
+
+/**
+ * The event loop of a worker: moves submitted requests into its dispatcher and runs them, sleeping until a
+ * transfer progresses, a request may start or a new one is submitted. Exits once stopped and out of requests.
+ */
+static void* __worker_loop(void* argument)
+{
+    struct worker* worker = (struct worker *)argument;
+    eventfd_t wakeups;
+
+    cc_error = EPASS;
+
+    for (;;) {
+        // The wakeup is reset before looking at the queue, so that no submission goes unnoticed.
+        eventfd_read(worker->wakeup, &wakeups);
+
+        int stopping = __atomic_load_n(&worker->stopping, __ATOMIC_ACQUIRE);
+        __worker_schedule(worker);
+
+        if (dispatch_run(&worker->dispatcher, WORKER_WAIT) != 0 || !__worker_idle(worker)) {
+            continue;
+        }
+
+        if (stopping) {
+            break;
+        }
+
+        poll(&(struct pollfd){ .fd = worker->wakeup, .events = POLLIN }, 1, -1);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Gives up the resources of a worker that is not running.
+ */
+static void __worker_release(struct worker* worker)
+{
+    dispatch_cleanup(&worker->dispatcher);
+    channel_blocks_destroy(worker->blocks);
+    worker->blocks = NULL;
+
+    if (worker->wakeup != -1) {
+        close(worker->wakeup);
+        worker->wakeup = -1;
+    }
+}
+
+
+/**
+ * Starts the thread of a worker along with its dispatcher, channel blocks and queue.
+ *
+ * @return 0 on success; or <br>
+ *         1 on failure.
+ */
+static int __worker_start(struct worker* worker)
+{
+    // The count of producers is left alone: a producer may be checking whether the worker runs at this moment.
+    worker->wakeup = -1;
+    worker->blocks = NULL;
+    worker->stopping = 0;
+    worker->stub.next = NULL;
+    worker->head = worker->tail = &worker->stub;
+
+    if (dispatch_init(&worker->dispatcher) != 0) {
+        return 1;
+    }
+
+    if ((worker->blocks = channel_blocks_create()) == NULL ||
+        (worker->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        __worker_release(worker);
+        return 1;
+    }
+
+    worker->dispatcher.wakeup = worker->wakeup;
+    if (pthread_create(&worker->thread, NULL, __worker_loop, worker) != 0) {
+        __worker_release(worker);
+        return 1;
+    }
+
+    __atomic_store_n(&worker->running, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+
+/**
+ * Hands a request over to the worker of its region. The worker takes its arguments over, and cleans it up once
+ * the callback returns.
+ *
+ * @param request   The request; it is copied, so it may live on the stack of the caller.
+ * @param callback  Invoked on the worker thread once the request completes.
+ * @param data      Passed on to the callback.
+ *
+ * @return 0 if the request was handed over; or <br>
+ *         1 if no worker runs for its region (or the job could not be allocated).
+ */
+int worker_submit(Request* request, dispatch_callback callback, void* data)
+{
+    struct worker* worker = workers + get_bit_index(request->region);
+    struct worker_job* job = NULL;
+
+    // The worker is not stopped while a producer is counted (see cchamp_workers_stop()).
+    __atomic_add_fetch(&worker->submitting, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&worker->running, __ATOMIC_SEQ_CST) && (job = malloc(sizeof(struct worker_job))) != NULL) {
+        job->request = *request;
+        job->callback = callback;
+        job->data = data;
+
+        __worker_push(worker, job);
+        eventfd_write(worker->wakeup, 1);
+    }
+
+    __atomic_sub_fetch(&worker->submitting, 1, __ATOMIC_SEQ_CST);
+    return job == NULL;
+}
+
+
+/**
+ * Hands the response of a request sent with worker_send() back to the waiting caller.
+ */
+static void __worker_sent(Request* request, uint16_t status, void* data)
+{
+    struct worker_call* call = (struct worker_call *)data;
+    Request* caller = call->request;
+
+    // The response (in a block of the worker) and the arguments are cleaned up by the caller, as usual.
+    caller->response = request->response;
+    caller->http_code = request->http_code;
+    caller->retry_after = request->retry_after;
+    caller->blocks = request->blocks;
+    memcpy(caller->etag, request->etag, REQUEST_ETAG_SIZE);
+
+    memset(&request->arguments, 0x00, sizeof(struct arguments));
+    request->response.addr = NULL;
+    request->response.size = 0;
+
+    pthread_mutex_lock(&call->lock);
+    call->status = status;
+    call->done = 1;
+    pthread_cond_signal(&call->completed);
+    pthread_mutex_unlock(&call->lock);
+}
+
+
+/**
+ * Sends a request through the worker of its region and waits for the response.
+ * On return, cc_error is set and the request holds the response just as if sent with cchamp_send_request().
+ *
+ * @param request   The request.
+ *
+ * @return 0 if the request was sent by a worker; or <br>
+ *         1 if no worker runs for its region. The request is left untouched.
+ */
+int worker_send(Request* request)
+{
+    struct worker_call call = {
+        .request    = request,
+        .lock       = PTHREAD_MUTEX_INITIALIZER,
+        .completed  = PTHREAD_COND_INITIALIZER
+    };
+
+    if (worker_submit(request, __worker_sent, &call) != 0) {
+        return 1;
+    }
+
+    pthread_mutex_lock(&call.lock);
+    while (!call.done) {
+        pthread_cond_wait(&call.completed, &call.lock);
+    }
+    pthread_mutex_unlock(&call.lock);
+
+    cc_error = call.status;
+    return 0;
+}
+
+
+/**
+ * Starts a worker for each of the given regions that has none running yet.
+ *
+ * @param regions   The regions (REGION_* constants or'ed together).
+ *
+ * @return 0 on success; or <br>
+ *         1 if a worker could not be started. The others are started regardless.
+ */
+int cchamp_workers_start(uint16_t regions)
+{
+    int failed = 0;
+
+    pthread_mutex_lock(&workers_lock);
+    for (int i = 0; i < RATE_REGIONS; i++) {
+        if ((regions & (1 << i)) == 0 || workers[i].running) continue;
+
+        failed |= __worker_start(workers + i);
+    }
+    pthread_mutex_unlock(&workers_lock);
+
+    return failed;
+}
+
+
+/**
+ * Stops all workers, once they are done with the requests handed to them. Further calls for their regions are
+ * sent from the calling thread.
+ */
+void cchamp_workers_stop()
+{
+    uint16_t stopped = 0;
+
+    pthread_mutex_lock(&workers_lock);
+    for (int i = 0; i < RATE_REGIONS; i++) {
+        struct worker* worker = workers + i;
+
+        if (!worker->running) continue;
+
+        // Once no producer is counted, none can hand a request over anymore.
+        __atomic_store_n(&worker->running, 0, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&worker->submitting, __ATOMIC_SEQ_CST) != 0) {
+            sched_yield();
+        }
+
+        __atomic_store_n(&worker->stopping, 1, __ATOMIC_RELEASE);
+        eventfd_write(worker->wakeup, 1);
+        stopped |= 1 << i;
+    }
+
+    // The workers finish their requests at the same time; they are only waited for once all are told to stop.
+    for (int i = 0; i < RATE_REGIONS; i++) {
+        if (stopped & (1 << i)) {
+            pthread_join(workers[i].thread, NULL);
+            __worker_release(workers + i);
+        }
+    }
+    pthread_mutex_unlock(&workers_lock);
+}
@@ -0,0 +1,34 @@
+/* This file is part of CChamp.
+ *
+ * CChamp is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * CChamp is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with CChamp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CCHAMP_WORKER_H
+#define CCHAMP_WORKER_H
+#include <inttypes.h>
+#include <network/channel.h>
+#include "dispatch.h"
+
+/*
+ * A worker is a thread that owns everything needed to send the requests of one region: a dispatcher (and so its
+ * connections), a set of channel blocks, and in practice the rate limit of the region, as nobody else sends to
+ * it. Requests are handed to it through a lock-free queue (see cchamp_workers_start()).
+ *
+ * worker_submit() hands over a request whose callback is then invoked on the worker thread; the request must
+ * not be cleaned by the caller, as the worker takes its arguments over. worker_send() hands over a request and
+ * waits for its response, just like cchamp_send_request(). Both return 1 if no worker runs for the region of the
+ * request, in which case it is left untouched.
+ */
+int     worker_submit(Request* request, dispatch_callback callback, void* data);
+int     worker_send(Request* request);
+#endif